@@ -0,0 +1,82 @@
+// MouseJiggler - Adaptive jiggle controller
+//
+// Instead of injecting on every deadline, adaptive jiggling reads the system
+// idle time back: the jiggle task waits (idle_for) until the idle time can
+// reach the threshold before the next deadline, and reads the idle timer back
+// shortly after each injection. Movement starts at the smallest level (zen) and
+// escalates when a jiggle fails to reset the idle timer; after a run of verified
+// jiggles it tries the next smaller level again, waiting twice as long each time
+// that fails. The idle time and its threshold come from the caller, so the
+// tests can drive the controller with a simulated user.
+
+#pragma once
+
+#include <stdint.h>
+
+#define ADAPTIVE_LEVEL_ZEN      0   // No pointer movement
+#define ADAPTIVE_LEVEL_NUDGE    1   // 1 px
+#define ADAPTIVE_LEVEL_PATTERN  2   // Configured pattern
+#define ADAPTIVE_VERIFY_MS      100 // Delay before reading the idle timer back
+#define ADAPTIVE_PROMOTE_AFTER  20  // Verified jiggles before trying a smaller level
+#define ADAPTIVE_PROMOTE_MAX    1280
+#define ADAPTIVE_DEFAULT_IDLE_S 300 // Threshold when no screensaver timeout is set
+
+// Idle time after which the next deadline can matter, i.e. the idle time could
+// reach the threshold (less a 10% margin) before it
+inline uint64_t AdaptiveIdleWaitMs(uint64_t thresholdMs, uint64_t periodMs) {
+    uint64_t needed = thresholdMs - thresholdMs / 10;
+    return needed > periodMs ? needed - periodMs : 0;
+}
+
+struct AdaptiveController {
+    int level = ADAPTIVE_LEVEL_ZEN;             // ADAPTIVE_LEVEL_*
+    int verifiedStreak = 0;                     // Consecutive verified jiggles at this level
+    int promoteAfter = ADAPTIVE_PROMOTE_AFTER;  // Streak needed before trying a smaller level
+    uint64_t deadlines = 0;                     // Deadlines seen (what a fixed schedule would inject)
+    uint64_t injected = 0;
+    uint64_t skippedIdle = 0;                   // Deadlines skipped because the idle timer was far from the threshold
+    uint64_t verifyFailures = 0;
+    uint64_t startedAt = 0;                     // ms, UTC FILETIME epoch
+
+    // Whether a deadline needs a jiggle at all (the user may have been active
+    // since the idle wait ended)
+    bool IsNeeded(uint64_t idleMs, uint64_t idleWaitMs) {
+        deadlines++;
+        if (idleMs < idleWaitMs) {
+            skippedIdle++;
+            return false;
+        }
+        return true;
+    }
+
+    // Deadlines that passed while the user was active
+    void CountUnneeded(uint64_t count) {
+        deadlines += count;
+        skippedIdle += count;
+    }
+
+    // Read back after an injection: whether it reset the idle timer. 'zenOnly'
+    // keeps the level at zen (ZenJiggle=1). Returns whether the level escalated.
+    bool Verify(bool registered, bool zenOnly) {
+        if (registered) {
+            verifiedStreak++;
+            if (level > ADAPTIVE_LEVEL_ZEN && verifiedStreak >= promoteAfter) {
+                level--;    // Try a smaller movement
+                verifiedStreak = 0;
+            }
+            return false;
+        }
+
+        verifyFailures++;
+        verifiedStreak = 0;
+        if (level >= ADAPTIVE_LEVEL_PATTERN || zenOnly) {
+            return false;
+        }
+        level++;
+
+        // Backing off from a level that failed: be slower to try it again
+        promoteAfter *= 2;
+        if (promoteAfter > ADAPTIVE_PROMOTE_MAX) promoteAfter = ADAPTIVE_PROMOTE_MAX;
+        return true;
+    }
+};
@@ -0,0 +1,222 @@
+// MouseJiggler - Play/pause button faces
+//
+// The play/pause button of the main window as a software-rasterised picture:
+// background, border and the play triangle or pause bars, scaled by DPI, in
+// 32-bit 0x00RRGGBB pixels (the layout of a top-down 32 bpp DIB section). All
+// coordinates are integers and the triangle's edges are anti-aliased by 4x4
+// supersampling with integer edge functions, so a face is bit-for-bit the same
+// on every platform and the tests compare it with golden images. The label is
+// the platform's text; ButtonFaceLayout says where it goes and in which colour.
+// ButtonFaceCache keeps the four faces of one size and DPI and renders each on
+// first use into a bitmap created through ButtonFaceHost (a DIB section in
+// Main.cpp).
+
+#pragma once
+
+#include <stdint.h>
+
+#define BUTTON_FACE_COUNT       4       // (paused, playing) x (normal, hot)
+#define BUTTON_FACE_RGB(r, g, b) (((uint32_t)(r) << 16) | ((uint32_t)(g) << 8) | (uint32_t)(b))
+
+#define BUTTON_FACE_PAUSED_BACKGROUND   BUTTON_FACE_RGB(255, 255, 255)  // White when inactive
+#define BUTTON_FACE_PLAYING_BACKGROUND  BUTTON_FACE_RGB(240, 240, 240)  // Light gray when active
+#define BUTTON_FACE_BORDER              BUTTON_FACE_RGB(0, 120, 215)    // Blue
+#define BUTTON_FACE_PLAY_COLOR          BUTTON_FACE_RGB(50, 180, 50)    // Green
+#define BUTTON_FACE_PAUSE_COLOR         BUTTON_FACE_RGB(220, 50, 50)    // Red
+
+// Pixels of one face; 'stride' is in pixels
+struct ButtonFaceBitmap {
+    uint32_t* pixels;
+    int width;
+    int height;
+    int stride;
+};
+
+// Where the platform draws the label of a face
+struct ButtonFaceLayout {
+    bool isJiggling;            // "Jiggling..." rather than "Click to Start"
+    int width;                  // Of the face
+    int height;
+    int dpi;
+    int textLeft;               // Left edge of the label; it is vertically centred in the face
+    int fontHeight;             // Bold, in pixels
+    uint32_t textColor;
+};
+
+// 'value' at 96 DPI scaled to 'dpi', rounded as MulDiv rounds
+inline int ScaleForDpi(int value, int dpi) {
+    int64_t scaled = (int64_t)value * dpi;
+    return (int)(scaled >= 0 ? (scaled + 48) / 96 : (scaled - 48) / 96);
+}
+
+inline void FillFaceRect(const ButtonFaceBitmap& bitmap, int left, int top, int right, int bottom, uint32_t color) {
+    if (left < 0) left = 0;
+    if (top < 0) top = 0;
+    if (right > bitmap.width) right = bitmap.width;
+    if (bottom > bitmap.height) bottom = bitmap.height;
+    for (int y = top; y < bottom; y++) {
+        uint32_t* row = bitmap.pixels + (int64_t)y * bitmap.stride;
+        for (int x = left; x < right; x++) {
+            row[x] = color;
+        }
+    }
+}
+
+// 'color' over 'pixel' with coverage/16 opacity
+inline uint32_t BlendFacePixel(uint32_t pixel, uint32_t color, int coverage) {
+    uint32_t result = 0;
+    for (int shift = 0; shift <= 16; shift += 8) {
+        int under = (int)((pixel >> shift) & 0xFF);
+        int over = (int)((color >> shift) & 0xFF);
+        result |= (uint32_t)((under * (16 - coverage) + over * coverage + 8) / 16) << shift;
+    }
+    return result;
+}
+
+// Twice the signed area of (a, b, p); >= 0 when p is left of or on a->b (y down)
+inline int64_t FaceEdge(int ax, int ay, int bx, int by, int px, int py) {
+    return (int64_t)(bx - ax) * (py - ay) - (int64_t)(by - ay) * (px - ax);
+}
+
+// Fill a triangle given in pixel corners, each pixel covered in proportion to
+// how many of its 4x4 sample points are inside (on an edge counts as inside)
+inline void FillFaceTriangle(const ButtonFaceBitmap& bitmap, const int (&points)[3][2], uint32_t color) {
+    // In eighths of a pixel, so every sample point ((2i+1)/8) is an integer
+    int x[3], y[3];
+    int minX = bitmap.width, minY = bitmap.height, maxX = 0, maxY = 0;
+    for (int i = 0; i < 3; i++) {
+        x[i] = points[i][0] * 8;
+        y[i] = points[i][1] * 8;
+        if (points[i][0] < minX) minX = points[i][0];
+        if (points[i][1] < minY) minY = points[i][1];
+        if (points[i][0] > maxX) maxX = points[i][0];
+        if (points[i][1] > maxY) maxY = points[i][1];
+    }
+    if (minX < 0) minX = 0;
+    if (minY < 0) minY = 0;
+    if (maxX > bitmap.width) maxX = bitmap.width;
+    if (maxY > bitmap.height) maxY = bitmap.height;
+    bool clockwise = FaceEdge(x[0], y[0], x[1], y[1], x[2], y[2]) < 0;
+
+    for (int py = minY; py < maxY; py++) {
+        uint32_t* row = bitmap.pixels + (int64_t)py * bitmap.stride;
+        for (int px = minX; px < maxX; px++) {
+            int coverage = 0;
+            for (int sy = 0; sy < 4; sy++) {
+                for (int sx = 0; sx < 4; sx++) {
+                    int sampleX = px * 8 + sx * 2 + 1;
+                    int sampleY = py * 8 + sy * 2 + 1;
+                    bool inside = true;
+                    for (int i = 0; i < 3 && inside; i++) {
+                        int j = (i + 1) % 3;
+                        int64_t edge = FaceEdge(x[i], y[i], x[j], y[j], sampleX, sampleY);
+                        inside = clockwise ? edge <= 0 : edge >= 0;
+                    }
+                    if (inside) coverage++;
+                }
+            }
+            if (coverage > 0) {
+                row[px] = BlendFacePixel(row[px], color, coverage);
+            }
+        }
+    }
+}
+
+// Render one face into 'bitmap' and say where its label goes
+inline void RenderButtonFace(const ButtonFaceBitmap& bitmap, int dpi, bool isJiggling, bool isHot,
+                             ButtonFaceLayout* layout) {
+    FillFaceRect(bitmap, 0, 0, bitmap.width, bitmap.height,
+                 isJiggling ? BUTTON_FACE_PLAYING_BACKGROUND : BUTTON_FACE_PAUSED_BACKGROUND);
+
+    // Border, thicker when hot or focused
+    int border = ScaleForDpi(isHot ? 2 : 1, dpi);
+    if (border < 1) border = 1;
+    FillFaceRect(bitmap, 0, 0, bitmap.width, border, BUTTON_FACE_BORDER);
+    FillFaceRect(bitmap, 0, bitmap.height - border, bitmap.width, bitmap.height, BUTTON_FACE_BORDER);
+    FillFaceRect(bitmap, 0, 0, border, bitmap.height, BUTTON_FACE_BORDER);
+    FillFaceRect(bitmap, bitmap.width - border, 0, bitmap.width, bitmap.height, BUTTON_FACE_BORDER);
+
+    // Icon, centred
+    int centerX = bitmap.width / 2;
+    int centerY = bitmap.height / 2;
+    int half = ScaleForDpi(12, dpi) / 2;    // Half the icon size
+    if (isJiggling) {
+        // Pause: two vertical bars
+        FillFaceRect(bitmap, centerX - ScaleForDpi(6, dpi), centerY - half, centerX - ScaleForDpi(2, dpi), centerY + half,
+                     BUTTON_FACE_PAUSE_COLOR);
+        FillFaceRect(bitmap, centerX + ScaleForDpi(2, dpi), centerY - half, centerX + ScaleForDpi(6, dpi), centerY + half,
+                     BUTTON_FACE_PAUSE_COLOR);
+    } else {
+        // Play: a right-pointing triangle
+        const int triangle[3][2] = {
+            { centerX - ScaleForDpi(5, dpi), centerY - half },
+            { centerX - ScaleForDpi(5, dpi), centerY + half },
+            { centerX + ScaleForDpi(7, dpi), centerY },
+        };
+        FillFaceTriangle(bitmap, triangle, BUTTON_FACE_PLAY_COLOR);
+    }
+
+    layout->isJiggling = isJiggling;
+    layout->width = bitmap.width;
+    layout->height = bitmap.height;
+    layout->dpi = dpi;
+    layout->textLeft = centerX + ScaleForDpi(15, dpi);
+    layout->fontHeight = ScaleForDpi(14, dpi);
+    layout->textColor = isJiggling ? BUTTON_FACE_PAUSE_COLOR : BUTTON_FACE_PLAY_COLOR;
+}
+
+// What the cache needs from the platform
+struct ButtonFaceHost {
+    // A width x height bitmap for a face: its handle (0 if it cannot be had) and pixels
+    intptr_t (*create)(int width, int height, ButtonFaceBitmap* bitmap);
+    void (*label)(intptr_t face, const ButtonFaceLayout& layout);  // Draw the text; may be null
+    void (*destroy)(intptr_t face);
+};
+
+// The faces of one size and DPI, each rendered once on first use
+struct ButtonFaceCache {
+    const ButtonFaceHost* host = nullptr;
+    intptr_t faces[BUTTON_FACE_COUNT] = {};
+    int width = 0;
+    int height = 0;
+    int dpi = 0;
+    uint32_t renders = 0;
+
+    static int Index(bool isJiggling, bool isHot) {
+        return (isJiggling ? 2 : 0) + (isHot ? 1 : 0);
+    }
+
+    // Drop every face (size, DPI or theme changed)
+    void Reset() {
+        for (int i = 0; i < BUTTON_FACE_COUNT; i++) {
+            if (faces[i]) {
+                host->destroy(faces[i]);
+                faces[i] = 0;
+            }
+        }
+        width = height = dpi = 0;
+    }
+
+    // The face for a state at this size and DPI, rendered if needed; 0 if it could not be created
+    intptr_t Get(int faceWidth, int faceHeight, int faceDpi, bool isJiggling, bool isHot) {
+        if (faceWidth != width || faceHeight != height || faceDpi != dpi) {
+            Reset();
+            width = faceWidth;
+            height = faceHeight;
+            dpi = faceDpi;
+        }
+
+        intptr_t& face = faces[Index(isJiggling, isHot)];
+        if (!face && width > 0 && height > 0) {
+            ButtonFaceBitmap bitmap;
+            face = host->create(width, height, &bitmap);
+            if (face) {
+                ButtonFaceLayout layout;
+                RenderButtonFace(bitmap, dpi, isJiggling, isHot, &layout);
+                if (host->label) host->label(face, layout);
+                renders++;
+            }
+        }
+        return face;
+    }
+};
@@ -0,0 +1,68 @@
+// MouseJiggler - Jiggle cadence
+//
+// Deadline arithmetic for the jiggle timer. Deadlines are absolute points on a
+// grid of k * period + phase milliseconds, so re-arming never accumulates drift.
+// Everything here is a pure function of its arguments (no clock, no Win32), so
+// the tests can drive it with a virtual clock.
+
+#pragma once
+
+#include <stdint.h>
+
+// Missed deadline policies
+#define MISSED_JIGGLE_SKIP      0   // Drop missed deadlines entirely; wait for the next one
+#define MISSED_JIGGLE_ONCE      1   // Fire a single jiggle no matter how many were missed
+#define MISSED_JIGGLE_BURST     2   // Fire one jiggle per missed deadline (capped)
+
+#define MAX_JIGGLE_BURST        10  // Upper bound on catch-up jiggles for MISSED_JIGGLE_BURST
+
+// First deadline strictly after 'now' on the grid k * periodMs + phaseMs.
+// A period change keeps the configured phase (e.g. on the minute).
+inline uint64_t NextAlignedDeadline(uint64_t now, uint64_t periodMs, uint64_t phaseMs) {
+    phaseMs %= periodMs;
+    if (now < phaseMs) {
+        return phaseMs;
+    }
+    return ((now - phaseMs) / periodMs + 1) * periodMs + phaseMs;
+}
+
+// Whether a deadline lies on the grid k * periodMs + phaseMs
+inline bool IsOnGrid(uint64_t deadline, uint64_t periodMs, uint64_t phaseMs) {
+    return deadline % periodMs == phaseMs % periodMs;
+}
+
+// First deadline on the grid at or after 'deadline'; realigns a deadline taken
+// from another grid (e.g. saved before the period changed)
+inline uint64_t AlignDeadline(uint64_t deadline, uint64_t periodMs, uint64_t phaseMs) {
+    if (IsOnGrid(deadline, periodMs, phaseMs)) {
+        return deadline;
+    }
+    return NextAlignedDeadline(deadline, periodMs, phaseMs);
+}
+
+// What to do for a deadline that has come due
+struct DeadlineOutcome {
+    uint64_t jiggles;           // Jiggles to perform now
+    uint64_t missed;            // Grid deadlines that passed after the due one
+    uint64_t nextDue;           // Following deadline, strictly after 'now'
+};
+
+// Resolve the deadline 'due' at time 'now' (now >= due) under a MISSED_JIGGLE_* policy
+inline DeadlineOutcome ResolveDeadline(uint64_t due, uint64_t now, uint64_t periodMs, int policy) {
+    DeadlineOutcome outcome;
+    outcome.missed = (now - due) / periodMs;
+    outcome.nextDue = due + (outcome.missed + 1) * periodMs;
+
+    switch (policy) {
+    case MISSED_JIGGLE_SKIP:
+        outcome.jiggles = (outcome.missed == 0) ? 1 : 0;
+        break;
+    case MISSED_JIGGLE_BURST:
+        outcome.jiggles = (outcome.missed + 1 < MAX_JIGGLE_BURST) ? outcome.missed + 1 : MAX_JIGGLE_BURST;
+        break;
+    default:
+        outcome.jiggles = 1;
+        break;
+    }
+    return outcome;
+}
@@ -0,0 +1,256 @@
+// MouseJiggler - VM guest sessions
+//
+// The QMP side of VM guest keep-alive (see Main.cpp): the connection states,
+// the greeting and qmp_capabilities negotiation, pipelined input-send-event
+// commands whose replies come back in order, the connect and reply timeouts
+// and each guest's deadline. The platform owns the sockets: it starts the
+// non-blocking connect, reports completion and received bytes, and sends and
+// closes through GuestHost (Winsock in Main.cpp, POSIX sockets in the tests,
+// which run it against a fake QMP server).
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define GUEST_NAME_LENGTH       32
+#define GUEST_PIPELINE_DEPTH    8       // Commands in flight before a guest's deadline is skipped
+#define GUEST_CONNECT_TIMEOUT_MS 10000  // A connect that has not completed by then is retried
+#define GUEST_REPLY_TIMEOUT_MS  10000   // A monitor that stays silent this long is reconnected
+#define GUEST_RECEIVE_BUFFER    4096
+#define GUEST_NO_CONNECTION     ((intptr_t)-1)
+
+#define GUEST_DISCONNECTED      0
+#define GUEST_CONNECTING        1
+#define GUEST_NEGOTIATING       2       // Connected; greeting awaited, then qmp_capabilities sent
+#define GUEST_READY             3
+
+struct GuestStats {
+    uint64_t commandsSent;
+    uint64_t replies;
+    uint64_t errors;            // Error replies, failed sends and skipped deadlines
+    uint64_t connects;
+    uint64_t timeouts;          // Connections dropped because the connect or the monitor stalled
+    uint64_t latencyTotalUs;    // Send to reply
+    uint64_t latencyMaxUs;
+};
+
+// What a session needs from the platform
+struct GuestHost {
+    uint64_t (*nowUs)();                                        // Monotonic clock
+    bool (*send)(intptr_t connection, const char* data, int length);    // All of it, or false
+    void (*close)(intptr_t connection);
+};
+
+struct GuestSession {
+    const GuestHost* host = nullptr;
+    intptr_t connection = GUEST_NO_CONNECTION;  // The platform's socket
+    int state = GUEST_DISCONNECTED;
+    int jigglePeriod = 60;                      // s
+    uint64_t nextDue = 0;                       // ms
+    uint64_t stateSince = 0;                    // ms, when connecting or negotiating began
+
+    uint64_t sentAt[GUEST_PIPELINE_DEPTH] = {}; // us, commands awaiting a reply (ring)
+    int inflightHead = 0;
+    int inflightCount = 0;
+
+    char received[GUEST_RECEIVE_BUFFER] = {};   // Partial reply line
+    int receivedLength = 0;
+
+    GuestStats stats = {};
+
+    uint64_t NowMs() const {
+        return host->nowUs() / 1000;
+    }
+
+    // Send a complete QMP command; the socket buffer always has room for one
+    bool Send(const char* command, int length) {
+        if (!host->send(connection, command, length)) {
+            stats.errors++;
+            return false;
+        }
+        return true;
+    }
+
+    // The platform started a non-blocking connect on 'socket'
+    void Connecting(intptr_t socket) {
+        connection = socket;
+        state = GUEST_CONNECTING;
+        stateSince = NowMs();
+    }
+
+    // The connect completed; the server speaks first with its greeting
+    void Connected() {
+        state = GUEST_NEGOTIATING;
+        stateSince = NowMs();
+        stats.connects++;
+    }
+
+    void Disconnect() {
+        if (connection != GUEST_NO_CONNECTION) {
+            host->close(connection);
+            connection = GUEST_NO_CONNECTION;
+        }
+        state = GUEST_DISCONNECTED;
+        inflightCount = 0;
+        receivedLength = 0;
+    }
+
+    // Send one input-send-event carrying both axes; false if it was not sent
+    bool Jiggle(int dx, int dy) {
+        if (inflightCount == GUEST_PIPELINE_DEPTH) {
+            stats.errors++;     // Guest stopped answering; don't queue more
+            return false;
+        }
+
+        char command[256];
+        int length = snprintf(command, sizeof(command),
+            "{\"execute\":\"input-send-event\",\"arguments\":{\"events\":["
+            "{\"type\":\"rel\",\"data\":{\"axis\":\"x\",\"value\":%d}},"
+            "{\"type\":\"rel\",\"data\":{\"axis\":\"y\",\"value\":%d}}]}}\r\n",
+            dx, dy);
+
+        uint64_t now = host->nowUs();
+        if (!Send(command, length)) {
+            return false;
+        }
+        sentAt[(inflightHead + inflightCount) % GUEST_PIPELINE_DEPTH] = now;
+        inflightCount++;
+        stats.commandsSent++;
+        return true;
+    }
+
+    // Handle one line from the monitor
+    void OnLine(const char* line) {
+        if (strstr(line, "\"event\"") && !strstr(line, "\"return\"")) {
+            return;     // Asynchronous event, not a reply
+        }
+
+        if (state == GUEST_NEGOTIATING) {
+            if (strstr(line, "\"QMP\"")) {
+                static const char capabilities[] = "{\"execute\":\"qmp_capabilities\"}\r\n";
+                Send(capabilities, sizeof(capabilities) - 1);
+            } else if (strstr(line, "\"return\"")) {
+                state = GUEST_READY;
+            } else if (strstr(line, "\"error\"")) {
+                stats.errors++;
+                Disconnect();
+            }
+            return;
+        }
+
+        if (state != GUEST_READY || inflightCount == 0) {
+            return;
+        }
+
+        // Replies come back in command order
+        uint64_t latency = host->nowUs() - sentAt[inflightHead];
+        inflightHead = (inflightHead + 1) % GUEST_PIPELINE_DEPTH;
+        inflightCount--;
+
+        stats.replies++;
+        stats.latencyTotalUs += latency;
+        if (latency > stats.latencyMaxUs) stats.latencyMaxUs = latency;
+        if (strstr(line, "\"error\"")) {
+            stats.errors++;
+        }
+    }
+
+    // Where the platform receives into, and how much fits
+    char* ReceiveBuffer() {
+        return received + receivedLength;
+    }
+
+    int ReceiveSpace() const {
+        return GUEST_RECEIVE_BUFFER - 1 - receivedLength;
+    }
+
+    // 'length' bytes arrived in ReceiveBuffer(): handle complete lines, keep the remainder
+    void OnReceived(int length) {
+        receivedLength += length;
+        received[receivedLength] = '\0';
+
+        char* lineStart = received;
+        char* lineEnd;
+        while ((lineEnd = strchr(lineStart, '\n')) != nullptr) {
+            *lineEnd = '\0';
+            OnLine(lineStart);
+            if (state == GUEST_DISCONNECTED) return;
+            lineStart = lineEnd + 1;
+        }
+        receivedLength = (int)(received + receivedLength - lineStart);
+        memmove(received, lineStart, (size_t)receivedLength);
+
+        // A line that fills the buffer is not QMP; drop the connection
+        if (receivedLength == GUEST_RECEIVE_BUFFER - 1) {
+            stats.errors++;
+            Disconnect();
+        }
+    }
+
+    // ms by which the connect must complete or the monitor answer (greeting or
+    // oldest command), 0 if nothing is outstanding
+    uint64_t ReplyDue() const {
+        if (state == GUEST_CONNECTING) {
+            return stateSince + GUEST_CONNECT_TIMEOUT_MS;
+        }
+        if (state == GUEST_NEGOTIATING) {
+            return stateSince + GUEST_REPLY_TIMEOUT_MS;
+        }
+        if (state == GUEST_READY && inflightCount > 0) {
+            return sentAt[inflightHead] / 1000 + GUEST_REPLY_TIMEOUT_MS;
+        }
+        return 0;
+    }
+
+    // A wedged monitor can keep TCP open without answering, and a connect to an
+    // unreachable host hangs for the TCP retry time; drop either. Returns whether it did.
+    bool TimedOut(uint64_t nowMs) {
+        uint64_t due = ReplyDue();
+        if (due == 0 || nowMs < due) {
+            return false;
+        }
+        stats.timeouts++;
+        Disconnect();
+        return true;
+    }
+
+    // Move past the deadline just served; missed deadlines are not made up
+    void Reschedule(uint64_t nowMs) {
+        uint64_t period = (uint64_t)jigglePeriod * 1000;
+        nextDue += ((nowMs - nextDue) / period + 1) * period;
+    }
+};
+
+// Split Address=host:port in place. An IPv6 address goes in brackets
+// ([::1]:4444); a bare one with a port would be ambiguous and is rejected.
+template <typename Char>
+bool SplitGuestAddress(Char* address, Char** host, Char** port) {
+    Char* colon;
+    if (address[0] == '[') {
+        Char* bracket = address + 1;
+        while (*bracket && *bracket != ']') bracket++;
+        if (*bracket != ']' || bracket[1] != ':') {
+            return false;
+        }
+        *bracket = '\0';
+        *host = address + 1;
+        colon = bracket + 1;
+    } else {
+        colon = nullptr;
+        for (Char* c = address; *c; c++) {
+            if (*c == ':') {
+                if (colon) return false;
+                colon = c;
+            }
+        }
+        if (!colon) {
+            return false;
+        }
+        *colon = '\0';
+        *host = address;
+    }
+    *port = colon + 1;
+    return (*host)[0] != '\0' && (*port)[0] != '\0';
+}
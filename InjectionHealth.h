@@ -0,0 +1,150 @@
+// MouseJiggler - Injection health
+//
+// Failed injections are classified by their likely cause; each class backs off
+// exponentially (in jiggle periods) instead of retrying every period. While UIPI
+// blocks injection the host keeps the system awake another way (on Windows,
+// SetThreadExecutionState). Success, the elevated window losing the foreground or
+// a session unlock/reconnect resets it all. The probes and the injection itself
+// go through InjectionHost, so Main.cpp and the tests run the same state machine.
+
+#pragma once
+
+#include <stdint.h>
+#include "InputSink.h"
+
+#define INJECT_OK               0
+#define INJECT_BLOCKED          1   // UIPI: a higher-integrity window has focus
+#define INJECT_SECURE_DESKTOP   2   // Lock screen, UAC or Ctrl+Alt+Del owns input
+#define INJECT_DISCONNECTED     3   // Session has no console or remote client attached
+#define INJECT_TRANSIENT        4   // Anything else; retried soon
+#define INJECT_CLASS_COUNT      5
+
+#define INJECT_BACKOFF_MAX          32  // periods
+#define INJECT_TRANSIENT_BACKOFF_MAX 4  // periods
+
+// What the state machine needs from the application
+struct InjectionHost {
+    bool (*secureDesktop)();                        // Lock screen, UAC or Ctrl+Alt+Del owns input
+    bool (*foregroundAbove)();                      // A window of higher integrity has focus (UIPI
+                                                    // would drop input, and report success)
+    int (*inject)(const MJInputEvent* events, uint32_t count, uint32_t* delivered);
+                                                    // Send a batch; returns INJECT_OK or Classify()
+    void (*fallback)(bool active);                  // Start or stop the keep-alive without input
+    void (*recovered)();                            // Injection works again after a failure
+};
+
+struct InjectionHealth {
+    const InjectionHost* host = nullptr;
+
+    int lastClass = INJECT_OK;                      // INJECT_* of the last attempt
+    int backoff[INJECT_CLASS_COUNT] = {};           // Current backoff length per class, in periods
+    int skipRemaining = 0;                          // Deadlines left before the next injection attempt
+    bool sessionDisconnected = false;
+    bool sessionLocked = false;
+    bool fallbackActive = false;                    // Keep-alive fallback in effect
+    uint64_t failures[INJECT_CLASS_COUNT] = {};     // Wasted attempts per class
+    uint64_t skipped = 0;                           // Attempts avoided by backoff or known blockers
+
+    // Work out why an injection failed. Input dropped by UIPI is reported as
+    // delivered, so the integrity check is the only reliable signal for INJECT_BLOCKED.
+    int Classify() {
+        if (sessionDisconnected) return INJECT_DISCONNECTED;
+        if (host->secureDesktop()) return INJECT_SECURE_DESKTOP;
+        if (host->foregroundAbove()) return INJECT_BLOCKED;
+        return INJECT_TRANSIENT;
+    }
+
+    // Only UIPI gets the fallback. Lock, secure desktop and disconnect get none:
+    // the user is away or the system owns input, and the machine should be free
+    // to sleep as it normally would.
+    void SetFallback(bool active) {
+        if (active == fallbackActive) return;
+        fallbackActive = active;
+        host->fallback(active);
+    }
+
+    // Record the outcome of an injection attempt and set up the backoff
+    void Record(int injectClass) {
+        if (injectClass == INJECT_OK) {
+            if (lastClass != INJECT_OK) {
+                host->recovered();
+            }
+            for (int i = 0; i < INJECT_CLASS_COUNT; i++) {
+                backoff[i] = 0;
+            }
+            lastClass = INJECT_OK;
+            SetFallback(false);
+            return;
+        }
+
+        int limit = (injectClass == INJECT_TRANSIENT) ? INJECT_TRANSIENT_BACKOFF_MAX : INJECT_BACKOFF_MAX;
+        int length = backoff[injectClass];
+        length = (length == 0) ? 1 : length * 2;
+        if (length > limit) length = limit;
+
+        backoff[injectClass] = length;
+        skipRemaining = length;
+        failures[injectClass]++;
+        lastClass = injectClass;
+
+        SetFallback(injectClass == INJECT_BLOCKED);
+    }
+
+    // A blocker went away (session unlocked or reconnected): retry on the next deadline
+    void ResetBackoff() {
+        for (int i = 0; i < INJECT_CLASS_COUNT; i++) {
+            backoff[i] = 0;
+        }
+        skipRemaining = 0;
+    }
+
+    void SetSessionLocked(bool locked) {
+        sessionLocked = locked;
+        if (locked) {
+            SetFallback(false);
+        } else {
+            ResetBackoff();
+        }
+    }
+
+    void SetSessionDisconnected(bool disconnected) {
+        sessionDisconnected = disconnected;
+        if (disconnected) {
+            SetFallback(false);
+        } else {
+            ResetBackoff();
+        }
+    }
+
+    // Inject a batch of movements unless injection is known to fail right now;
+    // returns how many were delivered
+    uint32_t Inject(const MJInputEvent* events, uint32_t count) {
+        // Don't inject into a locked or disconnected session, or while backing off
+        if (sessionLocked || sessionDisconnected) {
+            skipped++;
+            SetFallback(false);
+            return 0;
+        }
+
+        // UIPI would silently drop the input: record the block without sending, and
+        // end a UIPI backoff as soon as the elevated window loses the foreground
+        bool blocked = host->foregroundAbove();
+        if (skipRemaining > 0 && lastClass == INJECT_BLOCKED && !blocked) {
+            ResetBackoff();
+        }
+        if (skipRemaining > 0) {
+            skipRemaining--;
+            skipped++;
+            return 0;
+        }
+        if (blocked) {
+            skipped++;
+            Record(INJECT_BLOCKED);
+            return 0;
+        }
+
+        uint32_t delivered;
+        Record(host->inject(events, count, &delivered));
+        return delivered;
+    }
+};
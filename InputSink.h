@@ -0,0 +1,79 @@
+// MouseJiggler - Input sink plugin interface
+//
+// An input sink delivers the jiggler's synthetic input. The built-in sinks use
+// SendInput (uinput on Linux) or discard events; other sinks are DLLs (shared
+// objects on Linux) named by InputSink= in MouseJiggler.ini. This is a plain C
+// interface. New ABI versions only append fields to MJInputSink, so a host
+// accepts a sink of any version up to its own whose size covers the version 1
+// fields; fields past the sink's size read as zero.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define MJ_INPUT_SINK_ABI_VERSION   1
+
+// Calling convention of the sink functions: __cdecl on Windows (also for 32-bit
+// builds), the platform's C convention elsewhere
+#ifdef _WIN32
+#define MJ_CALL                     __cdecl
+#else
+#define MJ_CALL
+#endif
+
+// Name of the exported entry point
+#define MJ_INPUT_SINK_ENTRY         "MJCreateInputSink"
+
+// MJInputEvent.type
+#define MJ_EVENT_MOVE               0   // Relative pointer movement by dx, dy
+#define MJ_EVENT_KEY                1   // Virtual key (Win32 VK_* code) down or up
+
+// MJInputEvent.flags
+#define MJ_EVENT_KEY_UP             0x0001
+
+// Per-event status returned by submit
+#define MJ_SINK_OK                  0   // Delivered
+#define MJ_SINK_DENIED              1   // Refused by the system (e.g. UIPI); retrying soon will not help
+#define MJ_SINK_FAILED              2   // Not delivered; may succeed next time
+#define MJ_SINK_UNSUPPORTED         3   // The sink cannot deliver this event type
+
+typedef struct MJInputEvent {
+    uint32_t type;      // MJ_EVENT_*
+    int32_t dx;         // MJ_EVENT_MOVE
+    int32_t dy;
+    uint16_t key;       // MJ_EVENT_KEY
+    uint16_t flags;     // MJ_EVENT_*
+} MJInputEvent;
+
+typedef struct MJInputSink {
+    uint32_t abiVersion;    // MJ_INPUT_SINK_ABI_VERSION the sink was built against
+    uint32_t size;          // sizeof(MJInputSink) the sink was built against
+    const char* name;       // Shown in debug output; must outlive the sink
+    void* context;          // Passed back to submit and destroy
+
+    // Deliver a batch of events in order. timestampUs is the host's UTC time in
+    // microseconds since 1601-01-01 (FILETIME / 10). status[i] receives the
+    // MJ_SINK_* result of events[i]. Returns the number of events delivered.
+    uint32_t (MJ_CALL *submit)(void* context, const MJInputEvent* events, uint32_t count,
+                              uint64_t timestampUs, uint32_t* status);
+
+    // Release the sink; may be NULL
+    void (MJ_CALL *destroy)(void* context);
+} MJInputSink;
+
+// Size of the version 1 fields (abiVersion through destroy), the least a host accepts
+#define MJ_INPUT_SINK_V1_SIZE       (offsetof(MJInputSink, destroy) + sizeof(((MJInputSink*)0)->destroy))
+
+// Entry point exported by sink DLLs and shared objects. Fill in the fields of *sink up to the lower of
+// hostAbiVersion and the sink's own version, set abiVersion and size to match, and
+// return nonzero; or return zero if hostAbiVersion is not supported.
+typedef int (MJ_CALL *MJCreateInputSinkFn)(uint32_t hostAbiVersion, MJInputSink* sink);
+
+#ifdef __cplusplus
+}
+#endif
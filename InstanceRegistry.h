@@ -0,0 +1,179 @@
+// MouseJiggler - Instance registry slots
+//
+// Layout and lock-free protocol of the machine-wide instance registry. Every
+// running instance owns one InstanceSlot in shared memory (a file mapping on
+// Windows, a POSIX shared memory object on Linux) and publishes its status into
+// it; a monitor reads all slots without locks or IPC round-trips.
+//
+// Each slot is written by its owner only, guarded by a seqlock: the writer
+// makes 'sequence' odd before writing and even again afterwards, so readers
+// copy a slot and retry if the sequence changed underneath them. Ownership is
+// taken with a compare-and-swap of 'ownerPid' to the claimant's negated PID,
+// and the real PID is stored only after ownerCreated has been written, so a
+// slot never shows one owner's PID with another owner's creation time. Nothing
+// here depends on the platform; the platform supplies the liveness check.
+
+#pragma once
+
+#include <atomic>
+#include <stdint.h>
+#include <string.h>
+#include "ResourceMonitor.h"
+
+#define REGISTRY_MAGIC          0x4A4A4D52  // 'RMJJ'
+#define REGISTRY_VERSION        6
+#define REGISTRY_MAX_SLOTS      64
+#define REGISTRY_READ_ATTEMPTS  100         // Seqlock retries before a slot counts as busy
+
+// What an instance publishes
+struct InstanceStatus {
+    uint32_t sessionId;
+    uint32_t isJiggling;
+    uint32_t zenJiggle;
+    uint32_t jigglePeriod;          // seconds
+    uint32_t enableTimeRestriction;
+    uint32_t startMinutes;          // minutes after midnight
+    uint32_t endMinutes;            // minutes after midnight
+    uint32_t enabledDaysMask;       // bit 0 = Sun ... bit 6 = Sat
+    uint64_t nextJiggleDue;         // ms on the publisher's wall clock
+    uint64_t jigglesSent;
+    uint64_t jiggleFailures;
+    uint64_t lastUpdate;            // ms on the publisher's wall clock
+    uint32_t gdiObjects;            // Latest resource sample (0 where the platform has none)
+    uint32_t userObjects;
+    uint32_t handleCount;
+    uint32_t resourceAlert;
+    uint64_t workingSet;            // bytes
+    uint64_t privateBytes;          // bytes
+    uint32_t injectionClass;        // INJECT_* of the last attempt
+    uint32_t fallbackActive;
+    uint64_t injectionsSkipped;
+    uint64_t cpuTime;               // ms, whole process
+    uint32_t subsystemCpuMs[SUBSYSTEM_COUNT];   // UI thread CPU time by SUBSYSTEM_*
+};
+
+struct InstanceSlot {
+    std::atomic<int32_t> ownerPid;      // 0 = free, > 0 = owner, < 0 = being claimed (or released) by -ownerPid
+    std::atomic<uint32_t> sequence;     // Seqlock; odd while the owner is writing
+    std::atomic<uint64_t> ownerCreated; // Owner's process creation time, to detect PID reuse; 0 while free
+    uint32_t magic;                     // REGISTRY_MAGIC and REGISTRY_VERSION once claimed; slots of
+    uint32_t version;                   // another layout are left to their owners
+    InstanceStatus status;
+};
+
+static_assert(std::atomic<int32_t>::is_always_lock_free && std::atomic<uint64_t>::is_always_lock_free,
+              "slot atomics are shared between processes");
+
+// Owner of a slot as a reader saw it
+struct InstanceOwner {
+    int32_t pid;
+    uint64_t created;
+};
+
+// Whether the process 'pid' created at 'created' has exited (0 = creation time unknown)
+typedef bool (*RegistryOwnerGone)(int32_t pid, uint64_t created);
+
+// Seqlock write side. A sequence left odd by an owner that died mid-write is
+// moved on to the next odd value.
+inline uint32_t BeginSlotWrite(InstanceSlot* slot) {
+    uint32_t sequence = slot->sequence.load(std::memory_order_relaxed);
+    sequence += 1 + (sequence & 1);
+    slot->sequence.store(sequence, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return sequence;
+}
+
+inline void EndSlotWrite(InstanceSlot* slot, uint32_t sequence) {
+    slot->sequence.store(sequence + 1, std::memory_order_release);
+}
+
+// Publish a new status into a slot this process owns
+inline void WriteInstanceStatus(InstanceSlot* slot, const InstanceStatus* status) {
+    uint32_t sequence = BeginSlotWrite(slot);
+    memcpy(&slot->status, status, sizeof(InstanceStatus));
+    EndSlotWrite(slot, sequence);
+}
+
+// Copy a slot written by another process. False if it is free, being claimed,
+// of another layout, or kept changing.
+inline bool ReadInstanceSlot(const InstanceSlot* slot, InstanceOwner* owner, InstanceStatus* status) {
+    for (int attempt = 0; attempt < REGISTRY_READ_ATTEMPTS; attempt++) {
+        uint32_t before = slot->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            continue;
+        }
+        int32_t pid = slot->ownerPid.load(std::memory_order_relaxed);
+        uint64_t created = slot->ownerCreated.load(std::memory_order_relaxed);
+        uint32_t magic = slot->magic;
+        uint32_t version = slot->version;
+        memcpy(status, &slot->status, sizeof(InstanceStatus));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot->sequence.load(std::memory_order_relaxed) == before) {
+            owner->pid = pid;
+            owner->created = created;
+            return pid > 0 && magic == REGISTRY_MAGIC && version == REGISTRY_VERSION;
+        }
+    }
+    return false;
+}
+
+// Take a free slot, or one whose owner (or claimant) is gone. On success the slot
+// carries this process's PID and creation time and an empty status.
+inline bool ClaimInstanceSlot(InstanceSlot* slot, int32_t pid, uint64_t created, RegistryOwnerGone ownerGone) {
+    // The PID is published after the creation time, so this creation time
+    // belongs to 'owner' or to a later owner of the slot (caught below)
+    int32_t owner = slot->ownerPid.load(std::memory_order_acquire);
+    uint64_t ownerCreated = slot->ownerCreated.load(std::memory_order_acquire);
+    if (owner != 0) {
+        if (slot->magic != 0 && (slot->magic != REGISTRY_MAGIC || slot->version != REGISTRY_VERSION)) {
+            return false;   // Another layout
+        }
+        bool claiming = owner < 0;
+        if (!ownerGone(claiming ? -owner : owner, claiming ? 0 : ownerCreated)) {
+            return false;
+        }
+    }
+
+    if (!slot->ownerPid.compare_exchange_strong(owner, -pid, std::memory_order_acq_rel)) {
+        return false;
+    }
+
+    // The slot changed hands between the two loads above and its PID came back
+    // (a reused PID): the owner we judged gone was an earlier one, so hand it back
+    if (owner > 0 && slot->ownerCreated.load(std::memory_order_acquire) != ownerCreated) {
+        slot->ownerPid.store(owner, std::memory_order_release);
+        return false;
+    }
+
+    uint32_t sequence = BeginSlotWrite(slot);
+    slot->ownerCreated.store(created, std::memory_order_relaxed);
+    slot->magic = REGISTRY_MAGIC;
+    slot->version = REGISTRY_VERSION;
+    memset(&slot->status, 0, sizeof(InstanceStatus));
+    EndSlotWrite(slot, sequence);
+
+    slot->ownerPid.store(pid, std::memory_order_release);
+    return true;
+}
+
+// Free a slot this process owns: clear the creation time before the PID, so a
+// claimant never pairs a new PID with the old creation time
+inline void ReleaseInstanceSlot(InstanceSlot* slot, int32_t pid) {
+    // A claimant may hold the slot for a moment while it checks us (and hands it back)
+    for (int attempt = 0;; attempt++) {
+        int32_t owner = pid;
+        if (slot->ownerPid.compare_exchange_strong(owner, -pid, std::memory_order_acq_rel)) {
+            break;
+        }
+        if (owner >= 0 || attempt == REGISTRY_READ_ATTEMPTS) {
+            return;     // Not ours (any more)
+        }
+    }
+
+    uint32_t sequence = BeginSlotWrite(slot);
+    slot->ownerCreated.store(0, std::memory_order_relaxed);
+    memset(&slot->status, 0, sizeof(InstanceStatus));
+    EndSlotWrite(slot, sequence);
+
+    slot->ownerPid.store(0, std::memory_order_release);
+}
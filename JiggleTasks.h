@@ -0,0 +1,171 @@
+// MouseJiggler - Jiggle tasks
+//
+// The two scheduler tasks behind jiggling: the jiggle task, which fires one
+// jiggle (or a catch-up burst) per deadline on the period grid, and the time
+// window task, which starts and stops jiggling at the window's boundaries.
+// Everything the tasks need from the application (settings, injection, state
+// persistence, UI updates) goes through JiggleHost, so Main.cpp and the
+// simulated day test run the same task bodies.
+
+#pragma once
+
+#include <stdint.h>
+#include "Cadence.h"
+#include "Scheduler.h"
+
+// Tasks, as reported to JiggleHost::spawnFailed
+#define JIGGLE_TASK_JIGGLE          0
+#define JIGGLE_TASK_TIME_WINDOW     1
+
+// What the tasks need from the application. Times are ms on the scheduler's clock.
+struct JiggleHost {
+    uint64_t (*periodMs)();
+    uint64_t (*phaseMs)();
+    int (*missedPolicy)();                          // MISSED_JIGGLE_*
+
+    // Adaptive mode: wait until the user has been idle for adaptiveIdleWaitMs()
+    // before each deadline, and call verify() verifyDelayMs after a delivered batch
+    bool (*adaptive)();
+    uint64_t (*adaptiveIdleWaitMs)();
+    void (*unneeded)(uint64_t deadlines);           // Deadlines passed while the user was active
+    void (*verify)();
+    uint64_t verifyDelayMs;
+
+    uint64_t (*jiggle)(uint64_t due, uint32_t count);   // Inject a batch; returns how many were delivered
+    void (*deadlineDone)();                         // Publish and persist the state after a deadline
+    void (*started)();                              // Jiggling started or stopped
+    void (*stopped)();
+    void (*spawnFailed)(int task);                  // No frame or slot for a JIGGLE_TASK_* (a jiggle
+                                                    // task failure stops jiggling first)
+};
+
+struct JiggleTasks {
+    Scheduler* scheduler = nullptr;
+    const JiggleHost* host = nullptr;
+
+    bool isJiggling = false;
+    uint64_t nextDue = 0;           // Absolute deadline of the next jiggle
+    uint32_t jiggleTask = 0;        // JiggleLoop while jiggling
+    uint32_t timeWindowTask = 0;    // TimeWindowLoop while the time restriction is enabled
+
+    // The jiggle task: one jiggle (or a catch-up burst) per deadline on the
+    // period grid. In adaptive mode it first waits until the user has been idle
+    // long enough for the next deadline to matter.
+    SchedulerTask JiggleLoop() {
+        for (;;) {
+            uint64_t period = host->periodMs();
+            uint64_t phase = host->phaseMs();
+
+            // Clock was set backwards: the deadline is no longer on the grid ahead of us
+            uint64_t now = scheduler->host.now();
+            if (nextDue > now + period) {
+                nextDue = NextAlignedDeadline(now, period, phase);
+            }
+
+            if (host->adaptive()) {
+                co_await idle_for(host->adaptiveIdleWaitMs());
+
+                // Deadlines that passed while the user was active were not needed, not missed
+                now = scheduler->host.now();
+                if (nextDue < now) {
+                    uint64_t aligned = AlignDeadline(now, period, phase);
+                    host->unneeded((aligned - nextDue) / period);
+                    nextDue = aligned;
+                }
+            }
+
+            co_await sleep_until(nextDue);
+
+            uint64_t due = nextDue;
+            DeadlineOutcome outcome = ResolveDeadline(due, scheduler->host.now(), period, host->missedPolicy());
+            nextDue = outcome.nextDue;
+
+            uint64_t delivered = 0;
+            if (outcome.jiggles > 0) {
+                delivered = host->jiggle(due, (uint32_t)outcome.jiggles);
+            }
+            host->deadlineDone();
+
+            if (host->adaptive() && delivered > 0) {
+                co_await sleep_until(scheduler->host.now() + host->verifyDelayMs);
+                host->verify();
+            }
+        }
+    }
+
+    // The time window task: start jiggling when the window opens and stop when
+    // it closes. A manual start or stop holds until the next boundary.
+    SchedulerTask TimeWindowLoop() {
+        for (;;) {
+            uint64_t nextChange;
+            if (scheduler->host.windowOpen(scheduler->host.now(), &nextChange)) {
+                Start();
+                co_await next_window_close();
+            } else {
+                Stop();
+                co_await next_window_open();
+            }
+        }
+    }
+
+    // Realign to the grid and restart the jiggle task (start, period change, clock change)
+    bool ScheduleNext() {
+        nextDue = NextAlignedDeadline(scheduler->host.now(), host->periodMs(), host->phaseMs());
+        return RestartJiggleTask();
+    }
+
+    // Start the jiggle task from nextDue, replacing any running one. Without its
+    // task jiggling would only look active, so a failed spawn stops jiggling.
+    bool RestartJiggleTask() {
+        scheduler->Cancel(jiggleTask);
+        jiggleTask = scheduler->Spawn(JiggleLoop());
+        if (jiggleTask) {
+            return true;
+        }
+        if (isJiggling) {
+            isJiggling = false;
+            host->stopped();
+        }
+        host->spawnFailed(JIGGLE_TASK_JIGGLE);
+        return false;
+    }
+
+    // Start or stop the time window task. A new task applies the window at once
+    // (auto-start or auto-stop).
+    void RestartTimeWindowTask(bool enabled) {
+        scheduler->Cancel(timeWindowTask);
+        timeWindowTask = 0;
+        if (enabled) {
+            timeWindowTask = scheduler->Spawn(TimeWindowLoop());
+            if (!timeWindowTask) {
+                host->spawnFailed(JIGGLE_TASK_TIME_WINDOW);
+            }
+        }
+    }
+
+    void Start() {
+        if (!isJiggling) {
+            isJiggling = true;
+            if (ScheduleNext()) {
+                host->started();
+            }
+        }
+    }
+
+    void Stop() {
+        if (isJiggling) {
+            isJiggling = false;
+            scheduler->Cancel(jiggleTask);
+            jiggleTask = 0;
+            host->stopped();
+        }
+    }
+
+    // End both tasks (shutdown); the deadline is kept for the runtime state
+    void CancelAll() {
+        scheduler->Cancel(jiggleTask);
+        scheduler->Cancel(timeWindowTask);
+        jiggleTask = 0;
+        timeWindowTask = 0;
+    }
+};
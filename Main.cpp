@@ -9,24 +9,55 @@
 #define _UNICODE
 #define WIN32_LEAN_AND_MEAN
 
+#include <winsock2.h>
+#include <ws2tcpip.h>
 #include <windows.h>
 #include <commctrl.h>
 #include <shellapi.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <tchar.h>
+#include <sddl.h>
+#include <psapi.h>
+#include <wtsapi32.h>
 #include "Resource.h"
+#include "InputSink.h"
+#include "AdaptiveController.h"
+#include "ButtonFace.h"
+#include "GuestSession.h"
+#include "InjectionHealth.h"
+#include "InstanceRegistry.h"
+#include "ResourceMonitor.h"
+#include "Cadence.h"
+#include "RuntimeState.h"
+#include "Scheduler.h"
+#include "StatusModel.h"
+#include "JiggleTasks.h"
+#include "TimeWindow.h"
+#include "Trace.h"
+
+#ifdef _DEBUG
+#include <crtdbg.h>
+#endif
 
 #pragma comment(lib, "comctl32.lib")
+#pragma comment(lib, "advapi32.lib")
+#pragma comment(lib, "psapi.lib")
+#pragma comment(lib, "wtsapi32.lib")
+#pragma comment(lib, "ws2_32.lib")
 #pragma comment(linker, "/manifestdependency:\"type='win32' name='Microsoft.Windows.Common-Controls' version='6.0.0.0' processorArchitecture='*' publicKeyToken='6595b64144ccf1df' language='*'\"")
 
 // Global variables
 HINSTANCE g_hInst = NULL;
 HWND g_hMainDlg = NULL;
 NOTIFYICONDATA g_nid = { 0 };
-HMENU g_hTrayMenu = NULL;
+HMENU g_hTrayMenu = NULL;           // Built on first use, see GetTrayMenu()
+HMENU g_hTrayProfileMenu = NULL;    // Submenu of g_hTrayMenu, if there are profiles
 UINT g_uTaskbarCreated = 0;  // TaskbarCreated message
 
-// Settings
+// Settings. The application keeps one working copy (g_Settings); [Settings] and
+// each named profile are loaded into snapshots that are swapped in whole.
 struct Settings {
     bool minimizeOnStartup;
     bool zenJiggle;
@@ -40,32 +71,278 @@ struct Settings {
     int endHour;        // 0-23
     int endMinute;      // 0-59
     bool enabledDays[7];  // 0=Sun, 1=Mon, ..., 6=Sat (matches SYSTEMTIME.wDayOfWeek)
-} g_Settings = { false, false, 60, false, false, 9, 0, 18, 0, { true, true, true, true, true, true, true } };
+
+    // Jiggle cadence
+    int jigglePhase;         // seconds; deadlines fall on UTC multiples of the period plus this offset
+    int missedJigglePolicy;  // MISSED_JIGGLE_* (what to do when deadlines were missed, e.g. after sleep)
+    int jigglePattern;       // Index into g_JigglePatterns (ignored while zen jiggling)
+
+    // Adaptive jiggling
+    bool adaptiveJiggle;     // Verify each jiggle and inject only what keeps the machine awake
+    int idleThreshold;       // seconds the machine may stay idle; 0 = screensaver timeout
+};
+
+// Defaults for keys missing from the INI file
+static const Settings g_DefaultSettings = { false, false, 60, false, false, 9, 0, 18, 0, { true, true, true, true, true, true, true }, 0, 1, 0, false, 0 };
+Settings g_Settings = g_DefaultSettings;
+
+static const TCHAR* g_DayNames[7] = {
+    _T("Sun"), _T("Mon"), _T("Tue"), _T("Wed"),
+    _T("Thu"), _T("Fri"), _T("Sat")
+};
+
+// Named profiles: [Profile:<name>] sections holding the keys that differ from [Settings].
+// Switching swaps a preloaded snapshot into g_Settings and writes only ActiveProfile.
+#define MAX_PROFILES            16
+#define PROFILE_NAME_LENGTH     32
+#define PROFILE_NONE            -1
+#define PROFILE_SECTION_PREFIX  _T("Profile:")
+
+struct Profile {
+    TCHAR name[PROFILE_NAME_LENGTH];
+    Settings settings;
+};
+
+Settings g_BaseSettings = g_DefaultSettings;    // [Settings] snapshot
+Profile g_Profiles[MAX_PROFILES];
+int g_ProfileCount = 0;
+int g_ActiveProfile = PROFILE_NONE;
+int g_SavedActiveProfile = PROFILE_NONE;    // As last read from or written to the INI file (or set by -p, which is not saved)
+bool g_SavedMinimizeOnStartup = false;
+
+// Jiggle settings given on the command line. They override the INI file for this run,
+// including after an external edit reloads it, until the same setting is changed from
+// the window or the tray.
+struct CommandLineOverrides {
+    TCHAR profile[PROFILE_NAME_LENGTH];     // -p; empty = none
+    bool zenJiggle;                         // -z
+    bool adaptiveJiggle;                    // -a
+    int jigglePeriod;                       // -s; 0 = none
+} g_CommandLine = { { 0 }, false, false, 0 };
+
+// Jiggle patterns: each deadline performs the next step of the active pattern.
+// New movements are new tables here, not new state flags in the timer handler.
+struct JiggleStep {
+    int dx;
+    int dy;
+};
+
+struct JigglePattern {
+    const TCHAR* name;      // As written to the INI file
+    const JiggleStep* steps;
+    int stepCount;
+};
+
+static const JiggleStep g_ZigZagSteps[] = { { 4, 4 }, { -4, -4 } };
+static const JiggleStep g_SquareSteps[] = { { 4, 0 }, { 0, 4 }, { -4, 0 }, { 0, -4 } };
+static const JiggleStep g_NudgeSteps[] = { { 1, 0 }, { -1, 0 } };
+static const JiggleStep g_ZenSteps[] = { { 0, 0 } };  // Registers activity without moving the pointer
+
+static const JigglePattern g_JigglePatterns[] = {
+    { _T("ZigZag"), g_ZigZagSteps, 2 },
+    { _T("Square"), g_SquareSteps, 4 },
+    { _T("Nudge"), g_NudgeSteps, 2 },
+};
+static const JigglePattern g_ZenPattern = { _T("Zen"), g_ZenSteps, 1 };
+static const JigglePattern g_NudgePattern = { _T("Nudge"), g_NudgeSteps, 2 };
+
+#define JIGGLE_PATTERN_COUNT    (int)(sizeof(g_JigglePatterns) / sizeof(g_JigglePatterns[0]))
+
+#define JIGGLE_TIMER_SLACK_MS   20  // WM_TIMER may fire up to one tick early; the scheduler clock runs this far ahead
+#define JIGGLE_EXTRA_INFO       0x4D4A4A47  // 'MJJG'; tags injected events so hooks can recognise ours
 
 // State
-bool g_IsJiggling = false;
-bool g_Zig = true;
+int g_PatternStep = 0;           // Next step of the active jiggle pattern
+DWORD g_InjectedTick = 0;        // Tick count of the last injection, for adaptive verification
+
+// Coroutine scheduler (Scheduler.h) and the jiggle tasks (JiggleTasks.h), resumed
+// from TIMER_SCHEDULER. Deadlines are ms on the scheduler clock (UTC FILETIME epoch).
+Scheduler g_Scheduler;
+JiggleTasks g_Jiggle;
 TCHAR g_IniFilePath[MAX_PATH] = { 0 };
+TCHAR g_StateFilePath[MAX_PATH] = { 0 };
+HANDLE g_hSettingsChange = NULL;    // Change notification for the INI file's directory
+FILETIME g_IniWriteTime = { 0, 0 }; // Last known write time and size of the INI file
+ULONGLONG g_IniSize = 0;
+
+// Counters
+struct Counters {
+    ULONGLONG jigglesSent;
+    ULONGLONG jiggleFailures;
+} g_Counters = { 0, 0 };
+
+InjectionHealth g_Injection;    // Injection failure classes and backoff (InjectionHealth.h)
+
+AdaptiveController g_Adaptive;  // Adaptive jiggle level and counters (AdaptiveController.h)
+
+// Machine-wide instance registry: one slot file per running instance under
+// %ProgramData%\MouseJiggler\Instances, laid out and claimed as in InstanceRegistry.h
+#define REGISTRY_DIRECTORY_SDDL _T("D:P(A;OICI;GA;;;SY)(A;OICI;GA;;;BA)(A;;0x1200AB;;;AU)(A;OIIO;GA;;;CO)(A;OIIO;GR;;;AU)")
+#define INSTANCE_REPORT_ENTRY   512     // TCHARs per instance in the -l report (three lines)
+
+#ifdef _DEBUG
+// Allocation guard (debug builds). After startup the message loop should not touch
+// the CRT heap or create kernel, GDI or USER objects it keeps; every allocation made
+// once the guard is armed is counted, and the object counts at arm time are compared
+// with those at teardown. Both are reported on exit. With --alloc-guard the exit code
+// is 3 if there were any allocations or any object growth.
+LONG g_AllocationsAfterInit = 0;
+bool g_AllocationGuardArmed = false;
+bool g_AllocationGuardExitCode = false;
+
+struct GuardObjects {
+    DWORD gdiObjects;
+    DWORD userObjects;
+    DWORD handleCount;
+};
+
+GuardObjects g_GuardObjectsArmed = { 0, 0, 0 };
+GuardObjects g_GuardObjectGrowth = { 0, 0, 0 };
+
+void CountGuardObjects(GuardObjects* out) {
+    HANDLE hProcess = GetCurrentProcess();
+    out->gdiObjects = GetGuiResources(hProcess, GR_GDIOBJECTS);
+    out->userObjects = GetGuiResources(hProcess, GR_USEROBJECTS);
+    out->handleCount = 0;
+    GetProcessHandleCount(hProcess, &out->handleCount);
+}
+
+// Objects held now beyond those held when the guard was armed. Called at teardown
+// once the caches and connections made after startup (button faces, tray menu,
+// guest sockets) are released, but before the objects opened at startup are closed.
+void MeasureGuardObjectGrowth() {
+    GuardObjects now;
+    CountGuardObjects(&now);
+    g_GuardObjectGrowth.gdiObjects = now.gdiObjects > g_GuardObjectsArmed.gdiObjects ? now.gdiObjects - g_GuardObjectsArmed.gdiObjects : 0;
+    g_GuardObjectGrowth.userObjects = now.userObjects > g_GuardObjectsArmed.userObjects ? now.userObjects - g_GuardObjectsArmed.userObjects : 0;
+    g_GuardObjectGrowth.handleCount = now.handleCount > g_GuardObjectsArmed.handleCount ? now.handleCount - g_GuardObjectsArmed.handleCount : 0;
+}
+
+int __cdecl AllocationGuardHook(int allocType, void* userData, size_t size, int blockType,
+                                long requestNumber, const unsigned char* fileName, int lineNumber) {
+    UNREFERENCED_PARAMETER(userData);
+    UNREFERENCED_PARAMETER(size);
+    UNREFERENCED_PARAMETER(requestNumber);
+    UNREFERENCED_PARAMETER(fileName);
+    UNREFERENCED_PARAMETER(lineNumber);
+
+    if (g_AllocationGuardArmed && allocType != _HOOK_FREE && blockType != _CRT_BLOCK) {
+        InterlockedIncrement(&g_AllocationsAfterInit);
+    }
+    return TRUE;
+}
+#endif
+
+// Resource usage (ResourceMonitor.h): sampled every few minutes and compared with the
+// first sample to spot leaks, with the UI thread's CPU time split by subsystem
+ResourceMonitor g_Resources;
+
+// Status model (StatusModel.h): the values the tray tooltip, play/pause button,
+// period label and instance registry display, and the version each view last rendered
+StatusTracker g_Status;
+
+TCHAR g_ScheduleText[128] = { 0 };  // "09:00 - 18:00 (Mon,Tue,...)", cached for the tooltip
+
+// Play/pause button faces (ButtonFace.h), rendered once per size/DPI into DIB sections
+// and blitted on every WM_DRAWITEM from this memory DC
+ButtonFaceCache g_ButtonFaces;
+HDC g_hButtonDC = NULL;
+
+// Runtime state file (RuntimeState.h), one per user and session (see InitializeStatePath)
+#define STATE_OPEN_ATTEMPTS     20      // Retries while a previous instance still holds the file
+#define STATE_OPEN_RETRY_MS     100
+
+HANDLE g_hStateFile = INVALID_HANDLE_VALUE;
+HANDLE g_hStateMapping = NULL;
+RuntimeStateFile* g_pStateFile = NULL;
+ULONGLONG g_StateSequence = 0;
+ULONGLONG g_ResumeJiggleDue = 0;    // Recovered deadline to resume on, 0 if none
+
+MJInputSink g_InputSink = { 0 };    // Where jiggles are delivered (LoadInputSink)
+HMODULE g_hSinkModule = NULL;       // Sink DLL, if one is loaded
+
+// VM guest keep-alive: jiggles QEMU guests through their QMP monitor socket
+// (input-send-event), so guests on this host don't need their own jiggler.
+// Guests are [Guest:<name>] sections with Address=host:port and optionally
+// JigglePeriod and JigglePattern. Each guest has its own deadline. The sockets
+// are non-blocking and report to the main dialog (WM_GUEST_SOCKET). Commands are
+// pipelined: a new one is sent without waiting for earlier replies, which QMP
+// returns in order. The protocol is in GuestSession.h.
+#define MAX_GUESTS              32
+#define GUEST_SECTION_PREFIX    _T("Guest:")
+
+struct Guest {
+    TCHAR name[GUEST_NAME_LENGTH];
+    sockaddr_storage address;
+    int addressLength;
+    int jigglePattern;          // Index into g_JigglePatterns
+    int patternStep;
+    GuestSession session;       // Socket, state, deadline and statistics
+};
+
+Guest g_Guests[MAX_GUESTS];
+int g_GuestCount = 0;
+bool g_GuestsRunning = false;
+bool g_WinsockStarted = false;
+ULONGLONG g_GuestsStartedAt = 0;    // GuestClockMs() when keep-alive first started
+
+HANDLE g_hRegistryFile = INVALID_HANDLE_VALUE;  // This instance's slot file (kept open while claimed)
+HANDLE g_hRegistryMapping = NULL;
+InstanceSlot* g_pRegistrySlot = NULL;
 
 // Function declarations
 INT_PTR CALLBACK MainDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
 INT_PTR CALLBACK AboutDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam);
 void LoadSettings();
 void SaveSettings();
-void UpdateTrayIcon();
+void ApplyCommandLineOverrides();
+void NotifyStatusChanged();
+bool OpenInstanceRegistry();
+void PublishInstanceStatus();
+void ReleaseInstanceRegistry();
+void ShowInstanceStatus();
+void LoadRuntimeState();
+void SaveRuntimeState();
+void CloseRuntimeState();
 void CreateTrayIcon();
 void UpdatePeriodLabel(HWND hDlg);
 void MinimizeToTray();
 void RestoreFromTray();
-void PerformJiggle(int delta);
+int PerformJiggle(int dx, int dy);
+int PerformJiggleBatch(const MJInputEvent* events, uint32_t count, uint32_t* delivered);
+uint32_t InjectJiggles(const MJInputEvent* events, uint32_t count);
+void ScheduleNextJiggle();
+void RestartJiggleTask();
+void ArmSchedulerTimer();
+void RunScheduler();
+void RestartTimeWindowTask();
 void StartJiggling();
 void StopJiggling();
 bool CreateSingleInstanceMutex();
-bool IsWithinTimeRange();
 void UpdateJigglingButton(HWND hDlg);
 void GetTimeRangeString(TCHAR* buffer, size_t bufferSize);
 void GetActiveDaysString(TCHAR* buffer, size_t bufferSize);
 void DrawPlayPauseButton(LPDRAWITEMSTRUCT pDIS);
+void ResetButtonCache();
+void EnableTimeControls(HWND hDlg, BOOL enable);
+void ApplySettingsToControls(HWND hDlg);
+bool RememberIniWriteTime();
+void InitializeStatePath();
+void StartSettingsWatch();
+void StopSettingsWatch();
+void OnSettingsFileChanged();
+void RetimeForSettings();
+bool SampleResources(ResourceSample* out);
+void OnResourceSample();
+void FormatResourceReport(TCHAR* buffer, size_t bufferSize);
+void StartGuestKeepAlive();
+void StopGuestKeepAlive();
+void OnGuestTimer();
+void OnGuestSocket(SOCKET socket, LPARAM lParam);
+void ArmGuestTimer();
+void DisconnectGuests();
+void CloseGuests();
+void FormatGuestReport(TCHAR* buffer, size_t bufferSize);
 
 // Get INI file path (in the same directory as the executable)
 void InitializeIniPath() {
@@ -75,38 +352,84 @@ void InitializeIniPath() {
         *(lastSlash + 1) = _T('\0');
         _tcscat_s(g_IniFilePath, MAX_PATH, _T("MouseJiggler.ini"));
     }
+
+    InitializeStatePath();
 }
 
-// Load settings from INI file
-void LoadSettings() {
-    g_Settings.minimizeOnStartup = GetPrivateProfileInt(_T("Settings"), _T("MinimizeOnStartup"), 0, g_IniFilePath) != 0;
-    g_Settings.zenJiggle = GetPrivateProfileInt(_T("Settings"), _T("ZenJiggle"), 0, g_IniFilePath) != 0;
-    g_Settings.jigglePeriod = GetPrivateProfileInt(_T("Settings"), _T("JigglePeriod"), 60, g_IniFilePath);
+// Runtime state belongs to one user's session, so instances in other sessions (of the
+// same or another user) never open the same file:
+// %LOCALAPPDATA%\MouseJiggler\MouseJiggler-<session>.state. Without a usable
+// %LOCALAPPDATA% it goes next to the INI file, still keyed by session.
+void InitializeStatePath() {
+    DWORD sessionId = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &sessionId);
+
+    TCHAR name[48];
+    _stprintf_s(name, 48, _T("MouseJiggler-%lu.state"), (unsigned long)sessionId);
+
+    DWORD length = GetEnvironmentVariable(_T("LOCALAPPDATA"), g_StateFilePath, MAX_PATH);
+    if (length > 0 && length < MAX_PATH - 64) {
+        _tcscat_s(g_StateFilePath, MAX_PATH, _T("\\MouseJiggler"));
+        CreateDirectory(g_StateFilePath, NULL);
+
+        DWORD attributes = GetFileAttributes(g_StateFilePath);
+        if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            _tcscat_s(g_StateFilePath, MAX_PATH, _T("\\"));
+            _tcscat_s(g_StateFilePath, MAX_PATH, name);
+            return;
+        }
+    }
+
+    _tcscpy_s(g_StateFilePath, MAX_PATH, g_IniFilePath);
+    TCHAR* lastSlash = _tcsrchr(g_StateFilePath, _T('\\'));
+    if (lastSlash) {
+        *(lastSlash + 1) = _T('\0');
+    }
+    _tcscat_s(g_StateFilePath, MAX_PATH, name);
+}
+
+// Format the enabled days as a comma-separated list of day names
+void FormatEnabledDays(const bool enabledDays[7], TCHAR* buffer, size_t bufferSize) {
+    buffer[0] = _T('\0');
+
+    bool first = true;
+    for (int i = 0; i < 7; i++) {
+        if (enabledDays[i]) {
+            if (!first) {
+                _tcscat_s(buffer, bufferSize, _T(","));
+            }
+            _tcscat_s(buffer, bufferSize, g_DayNames[i]);
+            first = false;
+        }
+    }
+}
+
+// Read the jiggle settings of one INI section. Keys missing from the section keep
+// the values already in *out, so a profile only lists what differs from [Settings].
+void ReadSettingsSection(const TCHAR* section, Settings* out) {
+    out->zenJiggle = GetPrivateProfileInt(section, _T("ZenJiggle"), out->zenJiggle ? 1 : 0, g_IniFilePath) != 0;
+    out->jigglePeriod = GetPrivateProfileInt(section, _T("JigglePeriod"), out->jigglePeriod, g_IniFilePath);
 
     // Load time restriction settings
-    g_Settings.enableTimeRestriction = GetPrivateProfileInt(_T("Settings"), _T("EnableTimeRestriction"), 0, g_IniFilePath) != 0;
-    g_Settings.startHour = GetPrivateProfileInt(_T("Settings"), _T("StartHour"), 9, g_IniFilePath);
-    g_Settings.startMinute = GetPrivateProfileInt(_T("Settings"), _T("StartMinute"), 0, g_IniFilePath);
-    g_Settings.endHour = GetPrivateProfileInt(_T("Settings"), _T("EndHour"), 18, g_IniFilePath);
-    g_Settings.endMinute = GetPrivateProfileInt(_T("Settings"), _T("EndMinute"), 0, g_IniFilePath);
+    out->enableTimeRestriction = GetPrivateProfileInt(section, _T("EnableTimeRestriction"), out->enableTimeRestriction ? 1 : 0, g_IniFilePath) != 0;
+    out->startHour = GetPrivateProfileInt(section, _T("StartHour"), out->startHour, g_IniFilePath);
+    out->startMinute = GetPrivateProfileInt(section, _T("StartMinute"), out->startMinute, g_IniFilePath);
+    out->endHour = GetPrivateProfileInt(section, _T("EndHour"), out->endHour, g_IniFilePath);
+    out->endMinute = GetPrivateProfileInt(section, _T("EndMinute"), out->endMinute, g_IniFilePath);
+
+    // Load weekday settings
+    TCHAR defaultDays[256];
+    FormatEnabledDays(out->enabledDays, defaultDays, 256);
 
-    // Load weekday settings (default: all days enabled)
     TCHAR enabledDaysStr[256];
-    GetPrivateProfileString(_T("Settings"), _T("EnabledDays"),
-                           _T("Sun,Mon,Tue,Wed,Thu,Fri,Sat"),
-                           enabledDaysStr, 256, g_IniFilePath);
+    GetPrivateProfileString(section, _T("EnabledDays"), defaultDays, enabledDaysStr, 256, g_IniFilePath);
 
     // Initialize all days to false first
     for (int i = 0; i < 7; i++) {
-        g_Settings.enabledDays[i] = false;
+        out->enabledDays[i] = false;
     }
 
     // Parse comma-separated day names
-    static const TCHAR* dayNames[7] = {
-        _T("Sun"), _T("Mon"), _T("Tue"), _T("Wed"),
-        _T("Thu"), _T("Fri"), _T("Sat")
-    };
-
     TCHAR* context = NULL;
     TCHAR* token = _tcstok_s(enabledDaysStr, _T(","), &context);
     while (token != NULL) {
@@ -115,8 +438,8 @@ void LoadSettings() {
 
         // Find matching day name (case-insensitive)
         for (int i = 0; i < 7; i++) {
-            if (_tcsicmp(token, dayNames[i]) == 0) {
-                g_Settings.enabledDays[i] = true;
+            if (_tcsicmp(token, g_DayNames[i]) == 0) {
+                out->enabledDays[i] = true;
                 break;
             }
         }
@@ -124,723 +447,2407 @@ void LoadSettings() {
     }
 
     // Validate jiggle period
-    if (g_Settings.jigglePeriod < 1) g_Settings.jigglePeriod = 1;
-    if (g_Settings.jigglePeriod > 10800) g_Settings.jigglePeriod = 10800;
+    if (out->jigglePeriod < 1) out->jigglePeriod = 1;
+    if (out->jigglePeriod > 10800) out->jigglePeriod = 10800;
 
     // Validate time values
-    if (g_Settings.startHour < 0 || g_Settings.startHour > 23) g_Settings.startHour = 9;
-    if (g_Settings.startMinute < 0 || g_Settings.startMinute > 59) g_Settings.startMinute = 0;
-    if (g_Settings.endHour < 0 || g_Settings.endHour > 23) g_Settings.endHour = 18;
-    if (g_Settings.endMinute < 0 || g_Settings.endMinute > 59) g_Settings.endMinute = 0;
+    if (out->startHour < 0 || out->startHour > 23) out->startHour = 9;
+    if (out->startMinute < 0 || out->startMinute > 59) out->startMinute = 0;
+    if (out->endHour < 0 || out->endHour > 23) out->endHour = 18;
+    if (out->endMinute < 0 || out->endMinute > 59) out->endMinute = 0;
+
+    // Load cadence settings
+    out->jigglePhase = GetPrivateProfileInt(section, _T("JigglePhase"), out->jigglePhase, g_IniFilePath);
+    out->missedJigglePolicy = GetPrivateProfileInt(section, _T("MissedJigglePolicy"), out->missedJigglePolicy, g_IniFilePath);
+
+    if (out->jigglePhase < 0 || out->jigglePhase >= 10800) out->jigglePhase = 0;
+    if (out->missedJigglePolicy < MISSED_JIGGLE_SKIP || out->missedJigglePolicy > MISSED_JIGGLE_BURST) {
+        out->missedJigglePolicy = MISSED_JIGGLE_ONCE;
+    }
+
+    // Load jiggle pattern by name (unknown names fall back to the default zig/zag)
+    TCHAR patternName[32];
+    GetPrivateProfileString(section, _T("JigglePattern"), g_JigglePatterns[out->jigglePattern].name,
+                           patternName, 32, g_IniFilePath);
+
+    out->jigglePattern = 0;
+    for (int i = 0; i < JIGGLE_PATTERN_COUNT; i++) {
+        if (_tcsicmp(patternName, g_JigglePatterns[i].name) == 0) {
+            out->jigglePattern = i;
+            break;
+        }
+    }
+
+    // Load adaptive jiggle settings
+    out->adaptiveJiggle = GetPrivateProfileInt(section, _T("AdaptiveJiggle"), out->adaptiveJiggle ? 1 : 0, g_IniFilePath) != 0;
+    out->idleThreshold = GetPrivateProfileInt(section, _T("IdleThreshold"), out->idleThreshold, g_IniFilePath);
+    if (out->idleThreshold < 0) out->idleThreshold = 0;
 }
 
-// Save settings to INI file
-void SaveSettings() {
-    TCHAR buffer[32];
+// Load [Profile:*] sections into snapshots based on the [Settings] values
+void LoadProfiles() {
+    g_ProfileCount = 0;
 
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.minimizeOnStartup ? 1 : 0);
-    WritePrivateProfileString(_T("Settings"), _T("MinimizeOnStartup"), buffer, g_IniFilePath);
+    static TCHAR sectionNames[4096];
+    DWORD length = GetPrivateProfileSectionNames(sectionNames, 4096, g_IniFilePath);
+    if (length == 0) {
+        return;
+    }
 
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.zenJiggle ? 1 : 0);
-    WritePrivateProfileString(_T("Settings"), _T("ZenJiggle"), buffer, g_IniFilePath);
+    size_t prefixLength = _tcslen(PROFILE_SECTION_PREFIX);
+    for (const TCHAR* section = sectionNames; *section && g_ProfileCount < MAX_PROFILES; section += _tcslen(section) + 1) {
+        if (_tcsnicmp(section, PROFILE_SECTION_PREFIX, prefixLength) != 0 || section[prefixLength] == _T('\0')) {
+            continue;
+        }
 
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.jigglePeriod);
-    WritePrivateProfileString(_T("Settings"), _T("JigglePeriod"), buffer, g_IniFilePath);
+        Profile& profile = g_Profiles[g_ProfileCount++];
+        _tcsncpy_s(profile.name, PROFILE_NAME_LENGTH, section + prefixLength, _TRUNCATE);
+        profile.settings = g_BaseSettings;
+        ReadSettingsSection(section, &profile.settings);
+    }
+}
 
-    // Save time restriction settings
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.enableTimeRestriction ? 1 : 0);
-    WritePrivateProfileString(_T("Settings"), _T("EnableTimeRestriction"), buffer, g_IniFilePath);
+// Find a profile by name (case-insensitive); returns PROFILE_NONE if there is none
+int FindProfile(const TCHAR* name) {
+    for (int i = 0; i < g_ProfileCount; i++) {
+        if (_tcsicmp(g_Profiles[i].name, name) == 0) {
+            return i;
+        }
+    }
+    return PROFILE_NONE;
+}
 
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.startHour);
-    WritePrivateProfileString(_T("Settings"), _T("StartHour"), buffer, g_IniFilePath);
+// Replace the jiggle settings with a snapshot; application settings are kept
+void UseSettingsSnapshot(const Settings& snapshot) {
+    Settings next = snapshot;
+    next.minimizeOnStartup = g_Settings.minimizeOnStartup;
+    next.startJiggling = g_Settings.startJiggling;
+    g_Settings = next;
+}
 
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.startMinute);
-    WritePrivateProfileString(_T("Settings"), _T("StartMinute"), buffer, g_IniFilePath);
+// Load settings from INI file
+void LoadSettings() {
+    MJ_TRACE_SCOPE("LoadSettings");
+    SubsystemScope scope(g_Resources, SUBSYSTEM_SETTINGS);
 
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.endHour);
-    WritePrivateProfileString(_T("Settings"), _T("EndHour"), buffer, g_IniFilePath);
+    g_Settings.minimizeOnStartup = GetPrivateProfileInt(_T("Settings"), _T("MinimizeOnStartup"), 0, g_IniFilePath) != 0;
+    g_SavedMinimizeOnStartup = g_Settings.minimizeOnStartup;
 
-    _stprintf_s(buffer, 32, _T("%d"), g_Settings.endMinute);
-    WritePrivateProfileString(_T("Settings"), _T("EndMinute"), buffer, g_IniFilePath);
+    // [Settings] values first; profiles inherit any keys they leave out
+    g_BaseSettings = g_DefaultSettings;
+    ReadSettingsSection(_T("Settings"), &g_BaseSettings);
+    LoadProfiles();
 
-    // Save weekday settings
-    TCHAR enabledDaysStr[256] = { 0 };
-    static const TCHAR* dayNames[7] = {
-        _T("Sun"), _T("Mon"), _T("Tue"), _T("Wed"),
-        _T("Thu"), _T("Fri"), _T("Sat")
-    };
+    TCHAR profileName[PROFILE_NAME_LENGTH];
+    GetPrivateProfileString(_T("Settings"), _T("ActiveProfile"), _T(""), profileName, PROFILE_NAME_LENGTH, g_IniFilePath);
+    g_ActiveProfile = FindProfile(profileName);
+    g_SavedActiveProfile = g_ActiveProfile;
 
-    bool first = true;
-    for (int i = 0; i < 7; i++) {
-        if (g_Settings.enabledDays[i]) {
-            if (!first) {
-                _tcscat_s(enabledDaysStr, 256, _T(","));
-            }
-            _tcscat_s(enabledDaysStr, 256, dayNames[i]);
-            first = false;
+    UseSettingsSnapshot(g_ActiveProfile == PROFILE_NONE ? g_BaseSettings : g_Profiles[g_ActiveProfile].settings);
+}
+
+// Apply the command-line overrides on top of the loaded settings (at startup and
+// after every reload). A profile replaces all jiggle settings, so it goes first.
+// It applies to this run only: the INI file keeps its ActiveProfile.
+void ApplyCommandLineOverrides() {
+    if (g_CommandLine.profile[0]) {
+        int profile = FindProfile(g_CommandLine.profile);
+        if (profile != PROFILE_NONE) {
+            g_ActiveProfile = profile;
+            g_SavedActiveProfile = profile;
+            UseSettingsSnapshot(g_Profiles[profile].settings);
+        } else {
+            OutputDebugString(_T("Unknown profile on command line"));
         }
     }
-
-    // Save comma-separated day list (empty string if no days enabled)
-    WritePrivateProfileString(_T("Settings"), _T("EnabledDays"), enabledDaysStr, g_IniFilePath);
+    if (g_CommandLine.zenJiggle) {
+        g_Settings.zenJiggle = true;
+    }
+    if (g_CommandLine.adaptiveJiggle) {
+        g_Settings.adaptiveJiggle = true;
+    }
+    if (g_CommandLine.jigglePeriod) {
+        g_Settings.jigglePeriod = g_CommandLine.jigglePeriod;
+    }
 }
 
-// Perform the mouse jiggle
-void PerformJiggle(int delta) {
-    INPUT input = { 0 };
-    input.type = INPUT_MOUSE;
-    input.mi.dx = delta;
-    input.mi.dy = delta;
-    input.mi.dwFlags = MOUSEEVENTF_MOVE;
+// Save settings to INI file (jiggle settings go to the active profile's section, if any).
+// Every WritePrivateProfileString rewrites the whole file, so only keys whose value
+// differs from the last loaded or saved snapshot are written.
+void SaveSettings() {
+    MJ_TRACE_SCOPE("SaveSettings");
+    SubsystemScope scope(g_Resources, SUBSYSTEM_SETTINGS);
+    TCHAR buffer[32];
 
-    UINT result = SendInput(1, &input, sizeof(INPUT));
-    if (result != 1) {
-        DWORD error = GetLastError();
-        TCHAR msg[256];
-        _stprintf_s(msg, 256, _T("Failed to send input: error code 0x%08X"), error);
-        OutputDebugString(msg);
+    // A missing file is written in full
+    bool all = GetFileAttributes(g_IniFilePath) == INVALID_FILE_ATTRIBUTES;
+
+    if (all || g_Settings.minimizeOnStartup != g_SavedMinimizeOnStartup) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.minimizeOnStartup ? 1 : 0);
+        WritePrivateProfileString(_T("Settings"), _T("MinimizeOnStartup"), buffer, g_IniFilePath);
+        g_SavedMinimizeOnStartup = g_Settings.minimizeOnStartup;
     }
-}
 
-// Start jiggling
-void StartJiggling() {
-    if (!g_IsJiggling) {
-        g_IsJiggling = true;
-        SetTimer(g_hMainDlg, TIMER_JIGGLE, g_Settings.jigglePeriod * 1000, NULL);
-        UpdateTrayIcon();
+    if (all || g_ActiveProfile != g_SavedActiveProfile) {
+        WritePrivateProfileString(_T("Settings"), _T("ActiveProfile"),
+                                  g_ActiveProfile == PROFILE_NONE ? _T("") : g_Profiles[g_ActiveProfile].name, g_IniFilePath);
+        g_SavedActiveProfile = g_ActiveProfile;
     }
-}
 
-// Stop jiggling
-void StopJiggling() {
-    if (g_IsJiggling) {
-        g_IsJiggling = false;
-        KillTimer(g_hMainDlg, TIMER_JIGGLE);
-        UpdateTrayIcon();
+    // Edits made while a profile is active belong to that profile; its snapshot is replaced
+    TCHAR section[64] = _T("Settings");
+    Settings* snapshot = &g_BaseSettings;
+    if (g_ActiveProfile != PROFILE_NONE) {
+        _stprintf_s(section, 64, _T("%s%s"), PROFILE_SECTION_PREFIX, g_Profiles[g_ActiveProfile].name);
+        snapshot = &g_Profiles[g_ActiveProfile].settings;
     }
-}
+    const Settings saved = *snapshot;
+    *snapshot = g_Settings;
 
-// Check if current time is within allowed time range
-bool IsWithinTimeRange() {
-    if (!g_Settings.enableTimeRestriction) {
-        return true;  // No restriction = always allowed
+    if (all || g_Settings.zenJiggle != saved.zenJiggle) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.zenJiggle ? 1 : 0);
+        WritePrivateProfileString(section, _T("ZenJiggle"), buffer, g_IniFilePath);
     }
 
-    SYSTEMTIME st;
-    GetLocalTime(&st);
+    if (all || g_Settings.jigglePeriod != saved.jigglePeriod) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.jigglePeriod);
+        WritePrivateProfileString(section, _T("JigglePeriod"), buffer, g_IniFilePath);
+    }
 
-    // First check if current day is enabled (st.wDayOfWeek: 0=Sun, 1=Mon, ..., 6=Sat)
-    if (!g_Settings.enabledDays[st.wDayOfWeek]) {
-        return false;  // Day is disabled, regardless of time
+    // Save time restriction settings
+    if (all || g_Settings.enableTimeRestriction != saved.enableTimeRestriction) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.enableTimeRestriction ? 1 : 0);
+        WritePrivateProfileString(section, _T("EnableTimeRestriction"), buffer, g_IniFilePath);
     }
 
-    // Then check time range
-    int currentMinutes = st.wHour * 60 + st.wMinute;
-    int startMinutes = g_Settings.startHour * 60 + g_Settings.startMinute;
-    int endMinutes = g_Settings.endHour * 60 + g_Settings.endMinute;
+    if (all || g_Settings.startHour != saved.startHour) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.startHour);
+        WritePrivateProfileString(section, _T("StartHour"), buffer, g_IniFilePath);
+    }
 
-    // Handle overnight time range (e.g., 22:00 - 06:00)
-    if (startMinutes > endMinutes) {
-        return currentMinutes >= startMinutes || currentMinutes < endMinutes;
-    } else {
-        return currentMinutes >= startMinutes && currentMinutes < endMinutes;
+    if (all || g_Settings.startMinute != saved.startMinute) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.startMinute);
+        WritePrivateProfileString(section, _T("StartMinute"), buffer, g_IniFilePath);
     }
-}
 
-// Update jiggling button (trigger repaint)
-void UpdateJigglingButton(HWND hDlg) {
-    HWND hButton = GetDlgItem(hDlg, IDC_CHECK_JIGGLING);
-    InvalidateRect(hButton, NULL, TRUE);
-}
+    if (all || g_Settings.endHour != saved.endHour) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.endHour);
+        WritePrivateProfileString(section, _T("EndHour"), buffer, g_IniFilePath);
+    }
 
-// Draw play/pause button with GDI
-void DrawPlayPauseButton(LPDRAWITEMSTRUCT pDIS) {
-    HDC hdc = pDIS->hDC;
-    RECT rc = pDIS->rcItem;
+    if (all || g_Settings.endMinute != saved.endMinute) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.endMinute);
+        WritePrivateProfileString(section, _T("EndMinute"), buffer, g_IniFilePath);
+    }
 
-    // Use global state variable directly
-    bool isJiggling = g_IsJiggling;
-    bool isHot = (pDIS->itemState & ODS_FOCUS) || (pDIS->itemState & ODS_HOTLIGHT);
+    // Save comma-separated day list (empty string if no days enabled)
+    bool daysChanged = all;
+    for (int i = 0; i < 7; i++) {
+        if (g_Settings.enabledDays[i] != saved.enabledDays[i]) daysChanged = true;
+    }
+    if (daysChanged) {
+        TCHAR enabledDaysStr[256];
+        FormatEnabledDays(g_Settings.enabledDays, enabledDaysStr, 256);
+        WritePrivateProfileString(section, _T("EnabledDays"), enabledDaysStr, g_IniFilePath);
+    }
 
-    // Draw button background
-    HBRUSH hBrush;
-    if (isJiggling) {
-        hBrush = CreateSolidBrush(RGB(240, 240, 240));  // Light gray when active
-    } else {
-        hBrush = CreateSolidBrush(RGB(255, 255, 255));  // White when inactive
-    }
-    FillRect(hdc, &rc, hBrush);
-    DeleteObject(hBrush);
-
-    // Draw border
-    HPEN hPen = CreatePen(PS_SOLID, isHot ? 2 : 1, RGB(0, 120, 215));  // Blue border
-    HPEN hOldPen = (HPEN)SelectObject(hdc, hPen);
-    HBRUSH hOldBrush = (HBRUSH)SelectObject(hdc, GetStockObject(NULL_BRUSH));
-    Rectangle(hdc, rc.left, rc.top, rc.right, rc.bottom);
-    SelectObject(hdc, hOldPen);
-    SelectObject(hdc, hOldBrush);
-    DeleteObject(hPen);
-
-    // Calculate center position for icon
-    int centerX = (rc.left + rc.right) / 2;
-    int centerY = (rc.top + rc.bottom) / 2;
-    int iconSize = 12;
-
-    // Draw icon
-    if (isJiggling) {
-        // Draw PAUSE icon (two vertical bars) in RED
-        HBRUSH hIconBrush = CreateSolidBrush(RGB(220, 50, 50));  // Red
-
-        RECT bar1 = { centerX - 6, centerY - iconSize/2, centerX - 2, centerY + iconSize/2 };
-        RECT bar2 = { centerX + 2, centerY - iconSize/2, centerX + 6, centerY + iconSize/2 };
-
-        FillRect(hdc, &bar1, hIconBrush);
-        FillRect(hdc, &bar2, hIconBrush);
-
-        DeleteObject(hIconBrush);
-
-        // Draw text "Jiggling..." to the right
-        SetBkMode(hdc, TRANSPARENT);
-        SetTextColor(hdc, RGB(220, 50, 50));
-        HFONT hFont = CreateFont(14, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
-                                OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-                                DEFAULT_PITCH | FF_DONTCARE, _T("Segoe UI"));
-        HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
-
-        RECT textRc = rc;
-        textRc.left = centerX + 15;
-        DrawText(hdc, _T("Jiggling..."), -1, &textRc, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
-
-        SelectObject(hdc, hOldFont);
-        DeleteObject(hFont);
-    } else {
-        // Draw PLAY icon (right-pointing triangle) in GREEN
-        HBRUSH hIconBrush = CreateSolidBrush(RGB(50, 180, 50));  // Green
-        HBRUSH hOldIconBrush = (HBRUSH)SelectObject(hdc, hIconBrush);
+    // Save cadence settings
+    if (all || g_Settings.jigglePhase != saved.jigglePhase) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.jigglePhase);
+        WritePrivateProfileString(section, _T("JigglePhase"), buffer, g_IniFilePath);
+    }
 
-        POINT triangle[3];
-        triangle[0].x = centerX - 5;
-        triangle[0].y = centerY - iconSize/2;
-        triangle[1].x = centerX - 5;
-        triangle[1].y = centerY + iconSize/2;
-        triangle[2].x = centerX + 7;
-        triangle[2].y = centerY;
+    if (all || g_Settings.missedJigglePolicy != saved.missedJigglePolicy) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.missedJigglePolicy);
+        WritePrivateProfileString(section, _T("MissedJigglePolicy"), buffer, g_IniFilePath);
+    }
 
-        SetPolyFillMode(hdc, WINDING);
-        Polygon(hdc, triangle, 3);
+    if (all || g_Settings.jigglePattern != saved.jigglePattern) {
+        WritePrivateProfileString(section, _T("JigglePattern"),
+                                  g_JigglePatterns[g_Settings.jigglePattern].name, g_IniFilePath);
+    }
 
-        SelectObject(hdc, hOldIconBrush);
-        DeleteObject(hIconBrush);
+    // Save adaptive jiggle settings
+    if (all || g_Settings.adaptiveJiggle != saved.adaptiveJiggle) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.adaptiveJiggle ? 1 : 0);
+        WritePrivateProfileString(section, _T("AdaptiveJiggle"), buffer, g_IniFilePath);
+    }
 
-        // Draw text "Click to Start" to the right
-        SetBkMode(hdc, TRANSPARENT);
-        SetTextColor(hdc, RGB(50, 180, 50));
-        HFONT hFont = CreateFont(14, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
-                                OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
-                                DEFAULT_PITCH | FF_DONTCARE, _T("Segoe UI"));
-        HFONT hOldFont = (HFONT)SelectObject(hdc, hFont);
+    if (all || g_Settings.idleThreshold != saved.idleThreshold) {
+        _stprintf_s(buffer, 32, _T("%d"), g_Settings.idleThreshold);
+        WritePrivateProfileString(section, _T("IdleThreshold"), buffer, g_IniFilePath);
+    }
 
-        RECT textRc = rc;
-        textRc.left = centerX + 15;
-        DrawText(hdc, _T("Click to Start"), -1, &textRc, DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+    RememberIniWriteTime();
+}
 
-        SelectObject(hdc, hOldFont);
-        DeleteObject(hFont);
+// Whether the input desktop is something other than the user's Default desktop
+// (lock screen, UAC prompt, Ctrl+Alt+Del), where our input cannot be delivered
+bool IsSecureDesktopActive() {
+    HDESK hDesk = OpenInputDesktop(0, FALSE, DESKTOP_READOBJECTS);
+    if (!hDesk) {
+        return true;  // Winlogon desktop cannot be opened from the user session
     }
-}
 
-// Get time range string for tray tooltip
-void GetTimeRangeString(TCHAR* buffer, size_t bufferSize) {
-    _stprintf_s(buffer, bufferSize, _T("%02d:%02d - %02d:%02d"),
-                g_Settings.startHour, g_Settings.startMinute,
-                g_Settings.endHour, g_Settings.endMinute);
+    TCHAR name[64] = { 0 };
+    GetUserObjectInformation(hDesk, UOI_NAME, name, sizeof(name), NULL);
+    CloseDesktop(hDesk);
+    return _tcsicmp(name, _T("Default")) != 0;
 }
 
-// Get active days string for display
-void GetActiveDaysString(TCHAR* buffer, size_t bufferSize) {
-    static const TCHAR* dayAbbrevs[7] = {
-        _T("Sun"), _T("Mon"), _T("Tue"), _T("Wed"),
-        _T("Thu"), _T("Fri"), _T("Sat")
-    };
+// Mandatory integrity level (SECURITY_MANDATORY_*_RID) of a process, or 0 if it cannot be read
+DWORD GetProcessIntegrityLevel(HANDLE hProcess) {
+    HANDLE hToken = NULL;
+    if (!OpenProcessToken(hProcess, TOKEN_QUERY, &hToken)) {
+        return 0;
+    }
 
-    buffer[0] = _T('\0');
-    int count = 0;
+    DWORD level = 0;
+    BYTE buffer[64];
+    DWORD size = 0;
+    if (GetTokenInformation(hToken, TokenIntegrityLevel, buffer, sizeof(buffer), &size)) {
+        PSID sid = ((TOKEN_MANDATORY_LABEL*)buffer)->Label.Sid;
+        level = *GetSidSubAuthority(sid, *GetSidSubAuthorityCount(sid) - 1);
+    }
+    CloseHandle(hToken);
+    return level;
+}
 
-    for (int i = 0; i < 7; i++) {
-        if (g_Settings.enabledDays[i]) {
-            if (count > 0) {
-                _tcscat_s(buffer, bufferSize, _T(","));
-            }
-            _tcscat_s(buffer, bufferSize, dayAbbrevs[i]);
-            count++;
-        }
+// Whether UIPI drops our input: the foreground window belongs to a process of
+// higher integrity than ours (typically an elevated one). A process we cannot
+// query is assumed to be higher.
+bool IsForegroundAboveOurIntegrity() {
+    static DWORD ownLevel = GetProcessIntegrityLevel(GetCurrentProcess());
+
+    HWND hForeground = GetForegroundWindow();
+    if (!hForeground) {
+        return false;
     }
 
-    // Handle edge cases
-    if (count == 0) {
-        _tcscpy_s(buffer, bufferSize, _T("None"));
-    } else if (count == 7) {
-        _tcscpy_s(buffer, bufferSize, _T("Every day"));
+    DWORD pid = 0;
+    GetWindowThreadProcessId(hForeground, &pid);
+    if (pid == GetCurrentProcessId()) {
+        return false;
     }
-}
 
-// Update the period label
-void UpdatePeriodLabel(HWND hDlg) {
-    TCHAR text[64];
-    _stprintf_s(text, 64, _T("%d s"), g_Settings.jigglePeriod);
-    SetDlgItemText(hDlg, IDC_LABEL_PERIOD, text);
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!hProcess) {
+        return true;
+    }
+    DWORD level = GetProcessIntegrityLevel(hProcess);
+    CloseHandle(hProcess);
+    return level == 0 || level > ownLevel;
 }
 
-// Update tray icon tooltip
-void UpdateTrayIcon() {
-    if (g_nid.hWnd) {
-        TCHAR text[128];
-
-        if (!g_IsJiggling) {
-            if (g_Settings.enableTimeRestriction) {
-                TCHAR timeRange[64];
-                TCHAR days[64];
-                GetTimeRangeString(timeRange, 64);
-                GetActiveDaysString(days, 64);
-                _stprintf_s(text, 128, _T("Not jiggling. %s (%s)"), timeRange, days);
-                _tcscpy_s(g_nid.szTip, 128, text);
-            } else {
-                _tcscpy_s(g_nid.szTip, 128, _T("Not jiggling the mouse."));
-            }
-        } else {
-            if (g_Settings.enableTimeRestriction) {
-                TCHAR timeRange[64];
-                TCHAR days[64];
-                GetTimeRangeString(timeRange, 64);
-                GetActiveDaysString(days, 64);
-                _stprintf_s(text, 128, _T("Jiggling %d s, %s Zen. %s (%s)"),
-                    g_Settings.jigglePeriod,
-                    g_Settings.zenJiggle ? _T("with") : _T("without"),
-                    timeRange,
-                    days);
+// Built-in SendInput sink: a batch becomes one SendInput call
+uint32_t MJ_CALL SendInputSinkSubmit(void* context, const MJInputEvent* events, uint32_t count,
+                                    uint64_t timestampUs, uint32_t* status) {
+    UNREFERENCED_PARAMETER(context);
+    UNREFERENCED_PARAMETER(timestampUs);
+
+    static const uint32_t chunkSize = 16;
+    uint32_t delivered = 0;
+
+    for (uint32_t first = 0; first < count; first += chunkSize) {
+        INPUT inputs[chunkSize];
+        uint32_t eventIndex[chunkSize];
+        UINT inputCount = 0;
+
+        uint32_t last = first + chunkSize < count ? first + chunkSize : count;
+        for (uint32_t i = first; i < last; i++) {
+            const MJInputEvent& event = events[i];
+            INPUT& input = inputs[inputCount];
+            ZeroMemory(&input, sizeof(INPUT));
+
+            if (event.type == MJ_EVENT_MOVE) {
+                input.type = INPUT_MOUSE;
+                input.mi.dx = event.dx;
+                input.mi.dy = event.dy;
+                input.mi.dwFlags = MOUSEEVENTF_MOVE;
+                input.mi.dwExtraInfo = JIGGLE_EXTRA_INFO;
+            } else if (event.type == MJ_EVENT_KEY) {
+                input.type = INPUT_KEYBOARD;
+                input.ki.wVk = event.key;
+                input.ki.dwFlags = (event.flags & MJ_EVENT_KEY_UP) ? KEYEVENTF_KEYUP : 0;
+                input.ki.dwExtraInfo = JIGGLE_EXTRA_INFO;
             } else {
-                _stprintf_s(text, 128, _T("Jiggling %d s, %s Zen."),
-                    g_Settings.jigglePeriod,
-                    g_Settings.zenJiggle ? _T("with") : _T("without"));
+                status[i] = MJ_SINK_UNSUPPORTED;
+                continue;
             }
-            _tcscpy_s(g_nid.szTip, 128, text);
+            eventIndex[inputCount++] = i;
         }
-        Shell_NotifyIcon(NIM_MODIFY, &g_nid);
-    }
-}
 
-// Add or recreate tray icon
-void CreateTrayIcon() {
-    if (g_nid.hWnd == NULL) {
-        ZeroMemory(&g_nid, sizeof(g_nid));
-        g_nid.cbSize = sizeof(NOTIFYICONDATA);
-        g_nid.hWnd = g_hMainDlg;
-        g_nid.uID = 1;
-        g_nid.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
-        g_nid.uCallbackMessage = WM_TRAYICON;
-        g_nid.hIcon = LoadIcon(g_hInst, MAKEINTRESOURCE(IDI_TRAYICON));
-        UpdateTrayIcon();
+        if (inputCount == 0) continue;
+
+        // SendInput inserts events in order and stops at the first one that is refused
+        UINT sent = SendInput(inputCount, inputs, sizeof(INPUT));
+        uint32_t failure = GetLastError() == ERROR_ACCESS_DENIED ? MJ_SINK_DENIED : MJ_SINK_FAILED;
+        for (UINT j = 0; j < inputCount; j++) {
+            status[eventIndex[j]] = j < sent ? MJ_SINK_OK : failure;
+        }
+        delivered += sent;
     }
+    return delivered;
+}
 
-    BOOL result = Shell_NotifyIcon(NIM_ADD, &g_nid);
-    if (!result) {
-        DWORD error = GetLastError();
-        TCHAR msg[256];
-        _stprintf_s(msg, 256, _T("Failed to add tray icon: error 0x%08X"), error);
-        OutputDebugString(msg);
+// Built-in null sink: counts events and delivers nothing (for measuring the host side)
+struct NullSinkCounters {
+    ULONGLONG batches;
+    ULONGLONG events;
+};
+
+uint32_t MJ_CALL NullSinkSubmit(void* context, const MJInputEvent* events, uint32_t count,
+                               uint64_t timestampUs, uint32_t* status) {
+    UNREFERENCED_PARAMETER(events);
+    UNREFERENCED_PARAMETER(timestampUs);
+
+    NullSinkCounters* counters = (NullSinkCounters*)context;
+    counters->batches++;
+    counters->events += count;
+    for (uint32_t i = 0; i < count; i++) {
+        status[i] = MJ_SINK_OK;
     }
+    return count;
 }
 
-// Minimize to system tray
-void MinimizeToTray() {
-    ShowWindow(g_hMainDlg, SW_HIDE);
-    CreateTrayIcon();
+void MJ_CALL NullSinkDestroy(void* context) {
+    NullSinkCounters* counters = (NullSinkCounters*)context;
+    TCHAR msg[128];
+    _stprintf_s(msg, 128, _T("Null input sink: %llu events in %llu batches"), counters->events, counters->batches);
+    OutputDebugString(msg);
 }
 
-// Restore from system tray
-void RestoreFromTray() {
-    Shell_NotifyIcon(NIM_DELETE, &g_nid);
-    ShowWindow(g_hMainDlg, SW_SHOW);
-    SetForegroundWindow(g_hMainDlg);
+void UseSendInputSink() {
+    static const MJInputSink sendInputSink = {
+        MJ_INPUT_SINK_ABI_VERSION, sizeof(MJInputSink), "SendInput", NULL, SendInputSinkSubmit, NULL
+    };
+    g_InputSink = sendInputSink;
 }
 
-// About dialog procedure
-INT_PTR CALLBACK AboutDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    switch (message) {
-    case WM_INITDIALOG:
-        return TRUE;
+// Select the input sink named by InputSink= in [Settings]: empty or "SendInput" for
+// the built-in sink, "Null" for the counting null sink, otherwise a sink DLL path
+// (relative paths are resolved next to the INI file). Falls back to SendInput.
+void LoadInputSink() {
+    TCHAR sinkName[MAX_PATH];
+    GetPrivateProfileString(_T("Settings"), _T("InputSink"), _T(""), sinkName, MAX_PATH, g_IniFilePath);
 
-    case WM_COMMAND:
-        if (LOWORD(wParam) == IDOK || LOWORD(wParam) == IDCANCEL) {
-            EndDialog(hDlg, LOWORD(wParam));
-            return TRUE;
-        }
-        break;
+    UseSendInputSink();
+    if (sinkName[0] == _T('\0') || _tcsicmp(sinkName, _T("SendInput")) == 0) {
+        return;
     }
-    return FALSE;
-}
 
-// Main dialog procedure
-INT_PTR CALLBACK MainDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
-    switch (message) {
-    case WM_INITDIALOG:
-        {
-            g_hMainDlg = hDlg;
+    if (_tcsicmp(sinkName, _T("Null")) == 0) {
+        static NullSinkCounters nullCounters = { 0, 0 };
+        MJInputSink nullSink = {
+            MJ_INPUT_SINK_ABI_VERSION, sizeof(MJInputSink), "Null", &nullCounters, NullSinkSubmit, NullSinkDestroy
+        };
+        g_InputSink = nullSink;
+        return;
+    }
 
-            // Set icon
-            HICON hIcon = LoadIcon(g_hInst, MAKEINTRESOURCE(IDI_MAINICON));
-            SendMessage(hDlg, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
-            SendMessage(hDlg, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
+    TCHAR sinkPath[MAX_PATH];
+    if (!_tcschr(sinkName, _T(':')) && sinkName[0] != _T('\\')) {
+        _tcscpy_s(sinkPath, MAX_PATH, g_IniFilePath);
+        TCHAR* lastSlash = _tcsrchr(sinkPath, _T('\\'));
+        if (lastSlash) *(lastSlash + 1) = _T('\0');
+        _tcscat_s(sinkPath, MAX_PATH, sinkName);
+    } else {
+        _tcscpy_s(sinkPath, MAX_PATH, sinkName);
+    }
 
-            // Initialize controls
-            CheckDlgButton(hDlg, IDC_CHECK_MINIMIZE, g_Settings.minimizeOnStartup ? BST_CHECKED : BST_UNCHECKED);
-            CheckDlgButton(hDlg, IDC_CHECK_ZEN, g_Settings.zenJiggle ? BST_CHECKED : BST_UNCHECKED);
+    g_hSinkModule = LoadLibraryEx(sinkPath, NULL, LOAD_WITH_ALTERED_SEARCH_PATH);
+    if (!g_hSinkModule) {
+        OutputDebugString(_T("Failed to load input sink DLL; using SendInput"));
+        return;
+    }
 
-            // Setup trackbar
-            HWND hTrackbar = GetDlgItem(hDlg, IDC_SLIDER_PERIOD);
-            SendMessage(hTrackbar, TBM_SETRANGE, TRUE, MAKELPARAM(1, 180));
-            SendMessage(hTrackbar, TBM_SETPOS, TRUE, g_Settings.jigglePeriod);
-            SendMessage(hTrackbar, TBM_SETPAGESIZE, 0, 10);
+    MJCreateInputSinkFn create = (MJCreateInputSinkFn)GetProcAddress(g_hSinkModule, MJ_INPUT_SINK_ENTRY);
+    MJInputSink sink = { 0 };   // Fields an older sink does not know stay zero
+    if (!create || !create(MJ_INPUT_SINK_ABI_VERSION, &sink) ||
+        sink.abiVersion == 0 || sink.abiVersion > MJ_INPUT_SINK_ABI_VERSION ||
+        sink.size < MJ_INPUT_SINK_V1_SIZE || !sink.submit) {
+        OutputDebugString(_T("Input sink DLL is not compatible; using SendInput"));
+        if (create && sink.destroy) sink.destroy(sink.context);
+        FreeLibrary(g_hSinkModule);
+        g_hSinkModule = NULL;
+        return;
+    }
 
-            UpdatePeriodLabel(hDlg);
+    g_InputSink = sink;
+}
 
-            // Initialize time restriction controls
-            CheckDlgButton(hDlg, IDC_CHECK_ENABLE_TIME,
-                          g_Settings.enableTimeRestriction ? BST_CHECKED : BST_UNCHECKED);
+// Release the input sink
+void UnloadInputSink() {
+    if (g_InputSink.destroy) {
+        g_InputSink.destroy(g_InputSink.context);
+    }
+    UseSendInputSink();
 
-            // Setup spin controls and edit controls for time input
-            // Set edit control values first
-            SetDlgItemInt(hDlg, IDC_EDIT_START_HOUR, g_Settings.startHour, FALSE);
-            SetDlgItemInt(hDlg, IDC_EDIT_START_MINUTE, g_Settings.startMinute, FALSE);
-            SetDlgItemInt(hDlg, IDC_EDIT_END_HOUR, g_Settings.endHour, FALSE);
-            SetDlgItemInt(hDlg, IDC_EDIT_END_MINUTE, g_Settings.endMinute, FALSE);
+    if (g_hSinkModule) {
+        FreeLibrary(g_hSinkModule);
+        g_hSinkModule = NULL;
+    }
+}
 
-            // Then setup spin controls
-            HWND hSpinStartHour = GetDlgItem(hDlg, IDC_SPIN_START_HOUR);
-            SendMessage(hSpinStartHour, UDM_SETRANGE, 0, MAKELPARAM(23, 0));
-            SendMessage(hSpinStartHour, UDM_SETPOS, 0, g_Settings.startHour);
+// Perform up to MAX_JIGGLE_BURST jiggles in one submit to the input sink. *delivered
+// receives how many the sink delivered; returns INJECT_OK or the class of the first failure.
+int PerformJiggleBatch(const MJInputEvent* events, uint32_t count, uint32_t* delivered) {
+    MJ_TRACE_SCOPE("PerformJiggle");
+    uint32_t status[MAX_JIGGLE_BURST];
+    if (count > MAX_JIGGLE_BURST) count = MAX_JIGGLE_BURST;
+    for (uint32_t i = 0; i < count; i++) {
+        status[i] = MJ_SINK_FAILED;
+    }
 
-            HWND hSpinStartMinute = GetDlgItem(hDlg, IDC_SPIN_START_MINUTE);
-            SendMessage(hSpinStartMinute, UDM_SETRANGE, 0, MAKELPARAM(59, 0));
-            SendMessage(hSpinStartMinute, UDM_SETPOS, 0, g_Settings.startMinute);
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    uint64_t timestampUs = (((uint64_t)now.dwHighDateTime << 32) | now.dwLowDateTime) / 10;
 
-            HWND hSpinEndHour = GetDlgItem(hDlg, IDC_SPIN_END_HOUR);
-            SendMessage(hSpinEndHour, UDM_SETRANGE, 0, MAKELPARAM(23, 0));
-            SendMessage(hSpinEndHour, UDM_SETPOS, 0, g_Settings.endHour);
+    g_InputSink.submit(g_InputSink.context, events, count, timestampUs, status);
+    g_Counters.jigglesSent += count;
 
-            HWND hSpinEndMinute = GetDlgItem(hDlg, IDC_SPIN_END_MINUTE);
-            SendMessage(hSpinEndMinute, UDM_SETRANGE, 0, MAKELPARAM(59, 0));
-            SendMessage(hSpinEndMinute, UDM_SETPOS, 0, g_Settings.endMinute);
+    *delivered = 0;
+    uint32_t firstFailure = count;
+    for (uint32_t i = 0; i < count; i++) {
+        if (status[i] == MJ_SINK_OK) {
+            (*delivered)++;
+        } else if (firstFailure == count) {
+            firstFailure = i;
+        }
+    }
 
-            // Enable/disable time controls based on checkbox
-            BOOL enableTimeControls = g_Settings.enableTimeRestriction;
-            EnableWindow(GetDlgItem(hDlg, IDC_EDIT_START_HOUR), enableTimeControls);
-            EnableWindow(GetDlgItem(hDlg, IDC_EDIT_START_MINUTE), enableTimeControls);
-            EnableWindow(GetDlgItem(hDlg, IDC_EDIT_END_HOUR), enableTimeControls);
-            EnableWindow(GetDlgItem(hDlg, IDC_EDIT_END_MINUTE), enableTimeControls);
+    if (firstFailure < count) {
+        g_Counters.jiggleFailures += count - *delivered;
+        TCHAR msg[256];
+        _stprintf_s(msg, 256, _T("Failed to send input via %hs sink: status %u"), g_InputSink.name, status[firstFailure]);
+        OutputDebugString(msg);
+        return g_Injection.Classify();
+    }
+    return INJECT_OK;
+}
 
-            // Initialize weekday checkboxes
-            static const int weekdayControls[7] = {
-                IDC_CHECK_SUNDAY, IDC_CHECK_MONDAY, IDC_CHECK_TUESDAY,
-                IDC_CHECK_WEDNESDAY, IDC_CHECK_THURSDAY, IDC_CHECK_FRIDAY,
-                IDC_CHECK_SATURDAY
-            };
+// Perform one mouse jiggle through the input sink; returns INJECT_OK or the class of the failure
+int PerformJiggle(int dx, int dy) {
+    MJInputEvent event = { MJ_EVENT_MOVE, dx, dy, 0, 0 };
+    uint32_t delivered;
+    return PerformJiggleBatch(&event, 1, &delivered);
+}
 
-            for (int i = 0; i < 7; i++) {
-                CheckDlgButton(hDlg, weekdayControls[i],
-                               g_Settings.enabledDays[i] ? BST_CHECKED : BST_UNCHECKED);
-                EnableWindow(GetDlgItem(hDlg, weekdayControls[i]), enableTimeControls);
-            }
+// Injection host: keep the system (not the display) awake without input while UIPI blocks injection
+void SetKeepAliveFallback(bool active) {
+    if (active) {
+        SetThreadExecutionState(ES_CONTINUOUS | ES_SYSTEM_REQUIRED);
+        OutputDebugString(_T("Injection blocked by UIPI: using execution-state keep-alive"));
+    } else {
+        SetThreadExecutionState(ES_CONTINUOUS);
+    }
+}
 
-            // Start jiggling if requested
-            if (g_Settings.startJiggling) {
-                StartJiggling();
-            }
+void OnInjectionRecovered() {
+    OutputDebugString(_T("Injection recovered"));
+}
 
-            // Update button icon
-            UpdateJigglingButton(hDlg);
+static const InjectionHost g_InjectionHost = {
+    IsSecureDesktopActive,
+    IsForegroundAboveOurIntegrity,
+    PerformJiggleBatch,
+    SetKeepAliveFallback,
+    OnInjectionRecovered,
+};
+
+// Pattern used for the next jiggle (zen overrides the configured pattern)
+const JigglePattern* GetActivePattern() {
+    if (g_Settings.zenJiggle) {
+        return &g_ZenPattern;
+    }
+    if (g_Settings.adaptiveJiggle) {
+        if (g_Adaptive.level == ADAPTIVE_LEVEL_ZEN) return &g_ZenPattern;
+        if (g_Adaptive.level == ADAPTIVE_LEVEL_NUDGE) return &g_NudgePattern;
+    }
+    return &g_JigglePatterns[g_Settings.jigglePattern];
+}
 
-            // Start time check timer if restriction enabled
-            if (g_Settings.enableTimeRestriction) {
-                SetTimer(hDlg, TIMER_TIME_CHECK, 1000, NULL);  // Check every second
-            }
+// Idle time the machine is allowed to reach, in ms
+DWORD GetIdleThresholdMs() {
+    int seconds = g_Settings.idleThreshold;
+    if (seconds <= 0) {
+        SystemParametersInfo(SPI_GETSCREENSAVETIMEOUT, 0, &seconds, 0);
+    }
+    if (seconds <= 0) {
+        seconds = ADAPTIVE_DEFAULT_IDLE_S;
+    }
+    return (DWORD)seconds * 1000;
+}
 
-            // Minimize on startup if requested
+// Current system idle time in ms
+DWORD GetIdleTimeMs() {
+    LASTINPUTINFO info = { sizeof(LASTINPUTINFO), 0 };
+    GetLastInputInfo(&info);
+    return GetTickCount() - info.dwTime;
+}
+
+// Adaptive mode: idle time after which the next deadline can matter
+uint64_t GetAdaptiveIdleWaitMs() {
+    return AdaptiveIdleWaitMs(GetIdleThresholdMs(), (uint64_t)g_Settings.jigglePeriod * 1000);
+}
+
+// Adaptive mode: whether this deadline needs a jiggle at all
+bool IsJiggleNeeded() {
+    return g_Adaptive.IsNeeded(GetIdleTimeMs(), GetAdaptiveIdleWaitMs());
+}
+
+// Adaptive mode: read the idle timer back after the injections made at injectedTick
+void VerifyAdaptiveJiggle(DWORD injectedTick) {
+    LASTINPUTINFO info = { sizeof(LASTINPUTINFO), 0 };
+    GetLastInputInfo(&info);
+    bool registered = (int)(info.dwTime - injectedTick) >= 0;
+
+    if (g_Adaptive.Verify(registered, g_Settings.zenJiggle)) {
+        OutputDebugString(_T("Adaptive jiggle: movement did not register, escalating"));
+    }
+}
+
+// Inject a batch of movements unless injection is known to fail right now; returns
+// how many were delivered
+uint32_t InjectJiggles(const MJInputEvent* events, uint32_t count) {
+    return g_Injection.Inject(events, count);
+}
+
+// Current wall-clock time in milliseconds since 1601-01-01 UTC
+ULONGLONG GetWallClockMs() {
+    FILETIME ft;
+    GetSystemTimeAsFileTime(&ft);
+
+    ULARGE_INTEGER t;
+    t.LowPart = ft.dwLowDateTime;
+    t.HighPart = ft.dwHighDateTime;
+    return t.QuadPart / 10000;
+}
+
+// Jiggle grid of the current settings, in ms (see Cadence.h)
+uint64_t GetJigglePeriodMs() {
+    return (ULONGLONG)g_Settings.jigglePeriod * 1000;
+}
+
+uint64_t GetJigglePhaseMs() {
+    return (ULONGLONG)g_Settings.jigglePhase * 1000;
+}
+
+// Local time of a wall-clock time (ms since 1601-01-01 UTC)
+void GetLocalTimeAt(ULONGLONG wallMs, SYSTEMTIME* out) {
+    ULARGE_INTEGER t;
+    t.QuadPart = wallMs * 10000;
+
+    FILETIME ft;
+    ft.dwLowDateTime = t.LowPart;
+    ft.dwHighDateTime = t.HighPart;
+
+    SYSTEMTIME utc;
+    FileTimeToSystemTime(&ft, &utc);
+    SystemTimeToTzSpecificLocalTime(NULL, &utc, out);
+}
+
+// Time restriction window of the current settings (see TimeWindow.h)
+TimeWindow GetTimeWindow() {
+    TimeWindow window;
+    window.startMinutes = g_Settings.startHour * 60 + g_Settings.startMinute;
+    window.endMinutes = g_Settings.endHour * 60 + g_Settings.endMinute;
+    window.daysMask = 0;
+    for (int i = 0; i < 7; i++) {
+        if (g_Settings.enabledDays[i]) window.daysMask |= 1u << i;
+    }
+    return window;
+}
+
+// Scheduler host: the scheduler clock, the wall clock a little ahead (see JIGGLE_TIMER_SLACK_MS)
+uint64_t GetSchedulerClockMs() {
+    return GetWallClockMs() + JIGGLE_TIMER_SLACK_MS;
+}
+
+// Scheduler host: how long the user has been idle
+uint64_t GetSchedulerIdleMs() {
+    return GetIdleTimeMs();
+}
+
+// Scheduler host: whether jiggling is allowed at 'now' (scheduler clock), and
+// when that can next change
+bool IsTimeWindowOpenAt(uint64_t now, uint64_t* nextChange) {
+    if (!g_Settings.enableTimeRestriction) {
+        *nextChange = SCHEDULER_NEVER;
+        return true;  // No restriction = always allowed
+    }
+
+    SYSTEMTIME st;
+    GetLocalTimeAt(now, &st);
+    uint32_t msOfDay = ((st.wHour * 60 + st.wMinute) * 60 + st.wSecond) * 1000 + st.wMilliseconds;
+
+    // st.wDayOfWeek: 0=Sun, 1=Mon, ..., 6=Sat
+    TimeWindow window = GetTimeWindow();
+    *nextChange = now + MsUntilWindowCheck(window, msOfDay);
+    return IsInTimeWindow(window, st.wDayOfWeek, st.wHour * 60 + st.wMinute);
+}
+
+// Jiggle host: the settings behind the jiggle grid
+int GetMissedJigglePolicy() {
+    return g_Settings.missedJigglePolicy;
+}
+
+bool IsAdaptiveJiggle() {
+    return g_Settings.adaptiveJiggle;
+}
+
+// Jiggle host: deadlines that passed while the user was active (adaptive mode)
+void CountUnneededJiggles(uint64_t deadlines) {
+    g_Adaptive.CountUnneeded(deadlines);
+}
+
+// Jiggle host: one batch for a deadline, stepping through zen, the adaptive level
+// or the configured pattern. A catch-up burst goes to the sink as one batch.
+uint64_t SubmitJiggles(uint64_t due, uint32_t count) {
+    UNREFERENCED_PARAMETER(due);
+    g_InjectedTick = GetTickCount();
+    if (g_Settings.adaptiveJiggle && !IsJiggleNeeded()) {
+        return 0;
+    }
+
+    const JigglePattern* pattern = GetActivePattern();
+    MJInputEvent events[MAX_JIGGLE_BURST];
+    for (uint32_t i = 0; i < count; i++) {
+        const JiggleStep& step = pattern->steps[(g_PatternStep + i) % pattern->stepCount];
+        MJInputEvent event = { MJ_EVENT_MOVE, step.dx, step.dy, 0, 0 };
+        events[i] = event;
+    }
+    uint32_t injected = InjectJiggles(events, count);
+    g_PatternStep = (g_PatternStep + (int)injected) % pattern->stepCount;
+
+    if (g_Settings.adaptiveJiggle) {
+        g_Adaptive.injected += injected;
+    }
+    return injected;
+}
+
+// Jiggle host: after each deadline
+void OnJiggleDeadlineDone() {
+    PublishInstanceStatus();
+    SaveRuntimeState();
+}
+
+// Jiggle host: read the idle timer back after an adaptive batch
+void VerifyLastJiggle() {
+    VerifyAdaptiveJiggle(g_InjectedTick);
+}
+
+// Jiggle host: jiggling started or stopped (by the user or the time window)
+void OnJigglingStarted() {
+    if (g_Adaptive.startedAt == 0) {
+        g_Adaptive.startedAt = GetWallClockMs();
+    }
+    StartGuestKeepAlive();
+    NotifyStatusChanged();
+}
+
+void OnJigglingStopped() {
+    StopGuestKeepAlive();
+    g_Injection.SetFallback(false);
+    NotifyStatusChanged();
+}
+
+// Jiggle host: the scheduler had no frame or slot for a task. The task side has
+// already stopped jiggling; the error is shown once the scheduler is off the stack.
+void OnJiggleSpawnFailed(int task) {
+    OutputDebugString(_T("Scheduler: no frame for a jiggle task"));
+    PostMessage(g_hMainDlg, WM_TASK_FAILED, (WPARAM)task, 0);
+}
+
+static const JiggleHost g_JiggleHost = {
+    GetJigglePeriodMs, GetJigglePhaseMs, GetMissedJigglePolicy,
+    IsAdaptiveJiggle, GetAdaptiveIdleWaitMs, CountUnneededJiggles, VerifyLastJiggle, ADAPTIVE_VERIFY_MS,
+    SubmitJiggles, OnJiggleDeadlineDone, OnJigglingStarted, OnJigglingStopped, OnJiggleSpawnFailed
+};
+
+// Arm the scheduler timer for the earliest wake-up of its tasks
+void ArmSchedulerTimer() {
+    ULONGLONG wakeAt = g_Scheduler.NextWake();
+    if (wakeAt == SCHEDULER_NEVER) {
+        KillTimer(g_hMainDlg, TIMER_SCHEDULER);
+        return;
+    }
+
+    ULONGLONG now = GetSchedulerClockMs();
+    ULONGLONG wait = wakeAt > now ? wakeAt - now : 0;
+    if (wait < USER_TIMER_MINIMUM) wait = USER_TIMER_MINIMUM;
+    if (wait > USER_TIMER_MAXIMUM) wait = USER_TIMER_MAXIMUM;
+
+    SetTimer(g_hMainDlg, TIMER_SCHEDULER, (UINT)wait, NULL);
+}
+
+// Resume the tasks whose wait is over: on the scheduler timer, and whenever the
+// state behind a wait may have changed (resume from sleep)
+void RunScheduler() {
+    MJ_TRACE_SCOPE("RunScheduler");
+    SubsystemScope scope(g_Resources, SUBSYSTEM_TIMER);
+    g_Scheduler.Run();
+    ArmSchedulerTimer();
+}
+
+// Realign to the grid and restart the jiggle task (start, period change, clock change)
+void ScheduleNextJiggle() {
+    g_Jiggle.ScheduleNext();
+    ArmSchedulerTimer();
+}
+
+// Start the jiggle task from g_Jiggle.nextDue, replacing any running one
+void RestartJiggleTask() {
+    g_Jiggle.RestartJiggleTask();
+    ArmSchedulerTimer();
+}
+
+// Start or stop the time window task for the current time restriction settings
+void RestartTimeWindowTask() {
+    g_Jiggle.RestartTimeWindowTask(g_Settings.enableTimeRestriction);
+    ArmSchedulerTimer();
+}
+
+// Start jiggling
+void StartJiggling() {
+    g_Jiggle.Start();
+    ArmSchedulerTimer();
+}
+
+// Stop jiggling
+void StopJiggling() {
+    g_Jiggle.Stop();
+    ArmSchedulerTimer();
+}
+
+// Update jiggling button (trigger repaint)
+void UpdateJigglingButton(HWND hDlg) {
+    HWND hButton = GetDlgItem(hDlg, IDC_CHECK_JIGGLING);
+    InvalidateRect(hButton, NULL, FALSE);  // Cached face covers the whole button; no erase needed
+}
+
+// ButtonFaceHost: a top-down 32 bpp DIB section, whose pixels are the 0x00RRGGBB
+// layout the rasteriser draws in
+intptr_t CreateButtonFace(int width, int height, ButtonFaceBitmap* bitmap) {
+    if (!g_hButtonDC) {
+        g_hButtonDC = CreateCompatibleDC(NULL);
+        if (!g_hButtonDC) return 0;
+    }
+
+    BITMAPINFO bmi = {};
+    bmi.bmiHeader.biSize = sizeof(BITMAPINFOHEADER);
+    bmi.bmiHeader.biWidth = width;
+    bmi.bmiHeader.biHeight = -height;   // Top-down
+    bmi.bmiHeader.biPlanes = 1;
+    bmi.bmiHeader.biBitCount = 32;
+    bmi.bmiHeader.biCompression = BI_RGB;
+
+    void* bits = NULL;
+    HBITMAP hBitmap = CreateDIBSection(g_hButtonDC, &bmi, DIB_RGB_COLORS, &bits, NULL, 0);
+    if (!hBitmap) {
+        OutputDebugString(_T("Failed to create a button face"));
+        return 0;
+    }
+    bitmap->pixels = (uint32_t*)bits;
+    bitmap->width = width;
+    bitmap->height = height;
+    bitmap->stride = width;
+    return (intptr_t)hBitmap;
+}
+
+// ButtonFaceHost: the label, in the system's text renderer
+void LabelButtonFace(intptr_t face, const ButtonFaceLayout& layout) {
+    HGDIOBJ hOldBitmap = SelectObject(g_hButtonDC, (HBITMAP)face);
+
+    HFONT hFont = CreateFont(layout.fontHeight, 0, 0, 0, FW_BOLD, FALSE, FALSE, FALSE, DEFAULT_CHARSET,
+                            OUT_DEFAULT_PRECIS, CLIP_DEFAULT_PRECIS, DEFAULT_QUALITY,
+                            DEFAULT_PITCH | FF_DONTCARE, _T("Segoe UI"));
+    HFONT hOldFont = (HFONT)SelectObject(g_hButtonDC, hFont);
+    SetBkMode(g_hButtonDC, TRANSPARENT);
+    SetTextColor(g_hButtonDC, RGB((layout.textColor >> 16) & 0xFF, (layout.textColor >> 8) & 0xFF, layout.textColor & 0xFF));
+
+    RECT textRc = { layout.textLeft, 0, layout.width, layout.height };
+    DrawText(g_hButtonDC, layout.isJiggling ? _T("Jiggling...") : _T("Click to Start"), -1, &textRc,
+             DT_LEFT | DT_VCENTER | DT_SINGLELINE);
+
+    SelectObject(g_hButtonDC, hOldFont);
+    DeleteObject(hFont);
+    SelectObject(g_hButtonDC, hOldBitmap);
+}
+
+void DestroyButtonFace(intptr_t face) {
+    DeleteObject((HBITMAP)face);
+}
+
+const ButtonFaceHost g_ButtonFaceHost = { CreateButtonFace, LabelButtonFace, DestroyButtonFace };
+
+// Drop all cached button faces (size, DPI or theme changed)
+void ResetButtonCache() {
+    g_ButtonFaces.Reset();
+    if (g_hButtonDC) {
+        DeleteDC(g_hButtonDC);
+        g_hButtonDC = NULL;
+    }
+}
+
+// DPI of the monitor a window is on (the process is per-monitor aware, see
+// MouseJiggler.manifest). GetDpiForWindow needs Windows 10 1607; before that the
+// DC's DPI is the system DPI, which is what the window is drawn at.
+int GetWindowDpi(HWND hWnd, HDC hdc) {
+    typedef UINT (WINAPI *GetDpiForWindowFn)(HWND);
+    static GetDpiForWindowFn getDpiForWindow =
+        (GetDpiForWindowFn)GetProcAddress(GetModuleHandle(_T("user32.dll")), "GetDpiForWindow");
+
+    if (getDpiForWindow) {
+        UINT dpi = getDpiForWindow(hWnd);
+        if (dpi != 0) return (int)dpi;
+    }
+    return GetDeviceCaps(hdc, LOGPIXELSY);
+}
+
+// Draw play/pause button by blitting a cached face (rendered on first use)
+void DrawPlayPauseButton(LPDRAWITEMSTRUCT pDIS) {
+    MJ_TRACE_SCOPE("DrawPlayPauseButton");
+    SubsystemScope scope(g_Resources, SUBSYSTEM_PAINT);
+    HDC hdc = pDIS->hDC;
+    RECT rc = pDIS->rcItem;
+    int width = rc.right - rc.left;
+    int height = rc.bottom - rc.top;
+    int dpi = GetWindowDpi(pDIS->hwndItem, hdc);
+
+    // Use global state variable directly
+    bool isJiggling = g_Jiggle.isJiggling;
+    bool isHot = (pDIS->itemState & ODS_FOCUS) || (pDIS->itemState & ODS_HOTLIGHT);
+
+    HBITMAP hFace = (HBITMAP)g_ButtonFaces.Get(width, height, dpi, isJiggling, isHot);
+    if (!hFace) {
+        return;
+    }
+
+    HGDIOBJ hOld = SelectObject(g_hButtonDC, hFace);
+    BitBlt(hdc, rc.left, rc.top, width, height, g_hButtonDC, 0, 0, SRCCOPY);
+    SelectObject(g_hButtonDC, hOld);
+}
+
+// Get time range string for tray tooltip
+void GetTimeRangeString(TCHAR* buffer, size_t bufferSize) {
+    _stprintf_s(buffer, bufferSize, _T("%02d:%02d - %02d:%02d"),
+                g_Settings.startHour, g_Settings.startMinute,
+                g_Settings.endHour, g_Settings.endMinute);
+}
+
+// Get active days string for display
+void GetActiveDaysString(TCHAR* buffer, size_t bufferSize) {
+    static const TCHAR* dayAbbrevs[7] = {
+        _T("Sun"), _T("Mon"), _T("Tue"), _T("Wed"),
+        _T("Thu"), _T("Fri"), _T("Sat")
+    };
+
+    buffer[0] = _T('\0');
+    int count = 0;
+
+    for (int i = 0; i < 7; i++) {
+        if (g_Settings.enabledDays[i]) {
+            if (count > 0) {
+                _tcscat_s(buffer, bufferSize, _T(","));
+            }
+            _tcscat_s(buffer, bufferSize, dayAbbrevs[i]);
+            count++;
+        }
+    }
+
+    // Handle edge cases
+    if (count == 0) {
+        _tcscpy_s(buffer, bufferSize, _T("None"));
+    } else if (count == 7) {
+        _tcscpy_s(buffer, bufferSize, _T("Every day"));
+    }
+}
+
+// Update the period label
+void UpdatePeriodLabel(HWND hDlg) {
+    TCHAR text[64];
+    _stprintf_s(text, 64, _T("%d s"), g_Settings.jigglePeriod);
+    SetDlgItemText(hDlg, IDC_LABEL_PERIOD, text);
+}
+
+// The status model's values, from the current state and settings
+StatusValues GetStatusValues() {
+    StatusValues values;
+    values.isJiggling = g_Jiggle.isJiggling;
+    values.zenJiggle = g_Settings.zenJiggle;
+    values.jigglePeriod = g_Settings.jigglePeriod;
+    values.enableTimeRestriction = g_Settings.enableTimeRestriction;
+    values.startMinutes = g_Settings.startHour * 60 + g_Settings.startMinute;
+    values.endMinutes = g_Settings.endHour * 60 + g_Settings.endMinute;
+    values.enabledDaysMask = 0;
+    for (int i = 0; i < 7; i++) {
+        if (g_Settings.enabledDays[i]) values.enabledDaysMask |= 1u << i;
+    }
+    values.resourceAlert = g_Resources.alert;
+    values.resourceSamples = g_Resources.samples;
+    return values;
+}
+
+bool HasTrayIcon() {
+    return g_nid.hWnd != NULL;
+}
+
+bool HasMainDialog() {
+    return g_hMainDlg != NULL;
+}
+
+void BuildScheduleText() {
+    TCHAR timeRange[64];
+    TCHAR days[64];
+    GetTimeRangeString(timeRange, 64);
+    GetActiveDaysString(days, 64);
+    _stprintf_s(g_ScheduleText, 128, _T("%s (%s)"), timeRange, days);
+}
+
+// Rebuild the tray icon tooltip; only calls the shell if the text changed
+bool SetTrayTooltip() {
+    MJ_TRACE_SCOPE("UpdateTrayIcon");
+    SubsystemScope scope(g_Resources, SUBSYSTEM_TRAY);
+    const StatusModel& status = g_Status.model;
+    TCHAR text[128];
+
+    if (!status.isJiggling) {
+        if (status.enableTimeRestriction) {
+            _stprintf_s(text, 128, _T("Not jiggling. %s"), g_ScheduleText);
+        } else {
+            _tcscpy_s(text, 128, _T("Not jiggling the mouse."));
+        }
+    } else {
+        if (status.enableTimeRestriction) {
+            _stprintf_s(text, 128, _T("Jiggling %d s, %s Zen. %s"),
+                status.jigglePeriod,
+                status.zenJiggle ? _T("with") : _T("without"),
+                g_ScheduleText);
+        } else {
+            _stprintf_s(text, 128, _T("Jiggling %d s, %s Zen."),
+                status.jigglePeriod,
+                status.zenJiggle ? _T("with") : _T("without"));
+        }
+    }
+
+    if (status.resourceAlert && _tcslen(text) + 16 < 128) {
+        _tcscat_s(text, 128, _T(" Resource alert!"));
+    }
+
+    // UI thread CPU time by subsystem, as of the latest resource sample, if it fits
+    if (status.resourceSamples > 0) {
+        TCHAR cpu[64];
+        const double* ms = g_Resources.subsystemMs;
+        int length = _stprintf_s(cpu, 64, _T("\nCPU ms: timer %.0f, paint %.0f, INI %.0f, tray %.0f"),
+            ms[SUBSYSTEM_TIMER], ms[SUBSYSTEM_PAINT], ms[SUBSYSTEM_SETTINGS], ms[SUBSYSTEM_TRAY]);
+        if (length > 0 && _tcslen(text) + length < 128) {
+            _tcscat_s(text, 128, cpu);
+        }
+    }
+
+    if (_tcscmp(text, g_nid.szTip) == 0) {
+        return false;
+    }
+    _tcscpy_s(g_nid.szTip, 128, text);
+    Shell_NotifyIcon(NIM_MODIFY, &g_nid);
+    return true;
+}
+
+void RepaintJigglingButton() {
+    UpdateJigglingButton(g_hMainDlg);
+}
+
+void UpdateMainPeriodLabel() {
+    UpdatePeriodLabel(g_hMainDlg);
+}
+
+void PublishStatus() {
+    PublishInstanceStatus();
+    SaveRuntimeState();
+}
+
+static const StatusHost g_StatusHost = {
+    HasTrayIcon, HasMainDialog, BuildScheduleText, SetTrayTooltip,
+    RepaintJigglingButton, UpdateMainPeriodLabel, PublishStatus
+};
+
+// Propagate a state or settings change to every view that displays or publishes it
+void NotifyStatusChanged() {
+    g_Status.Notify(GetStatusValues());
+}
+
+// Add or recreate tray icon
+void CreateTrayIcon() {
+    SubsystemScope scope(g_Resources, SUBSYSTEM_TRAY);
+
+    if (g_nid.hWnd == NULL) {
+        ZeroMemory(&g_nid, sizeof(g_nid));
+        g_nid.cbSize = sizeof(NOTIFYICONDATA);
+        g_nid.hWnd = g_hMainDlg;
+        g_nid.uID = 1;
+        g_nid.uFlags = NIF_ICON | NIF_MESSAGE | NIF_TIP;
+        g_nid.uCallbackMessage = WM_TRAYICON;
+        g_nid.hIcon = LoadIcon(g_hInst, MAKEINTRESOURCE(IDI_TRAYICON));
+        g_Status.TrayIconCreated(GetStatusValues());
+    }
+
+    BOOL result = Shell_NotifyIcon(NIM_ADD, &g_nid);
+    if (!result) {
+        DWORD error = GetLastError();
+        TCHAR msg[256];
+        _stprintf_s(msg, 256, _T("Failed to add tray icon: error 0x%08X"), error);
+        OutputDebugString(msg);
+    }
+}
+
+// Tray context menu. It is built once and only its Start/Stop item and profile
+// check are updated before each use; a settings reload discards it (profiles may change).
+#define TRAY_MENU_TOGGLE_POSITION   2   // After "Open" and a separator
+
+HMENU GetTrayMenu() {
+    if (!g_hTrayMenu) {
+        g_hTrayMenu = CreatePopupMenu();
+        AppendMenu(g_hTrayMenu, MF_STRING, ID_TRAY_OPEN, _T("Open"));
+        AppendMenu(g_hTrayMenu, MF_SEPARATOR, 0, NULL);
+        AppendMenu(g_hTrayMenu, MF_STRING, ID_TRAY_START, _T("Start Jiggling"));
+
+        // Profiles submenu, with the active one checked
+        if (g_ProfileCount > 0) {
+            g_hTrayProfileMenu = CreatePopupMenu();
+            AppendMenu(g_hTrayProfileMenu, MF_STRING, ID_TRAY_PROFILE_FIRST, _T("Default"));
+            for (int i = 0; i < g_ProfileCount; i++) {
+                AppendMenu(g_hTrayProfileMenu, MF_STRING, ID_TRAY_PROFILE_FIRST + 1 + i, g_Profiles[i].name);
+            }
+            AppendMenu(g_hTrayMenu, MF_POPUP, (UINT_PTR)g_hTrayProfileMenu, _T("Profile"));
+        }
+
+        AppendMenu(g_hTrayMenu, MF_SEPARATOR, 0, NULL);
+        if (g_GuestCount > 0) {
+            AppendMenu(g_hTrayMenu, MF_STRING, ID_TRAY_GUESTS, _T("VM Guests..."));
+        }
+        AppendMenu(g_hTrayMenu, MF_STRING, ID_TRAY_RESOURCES, _T("Resource Usage..."));
+        AppendMenu(g_hTrayMenu, MF_STRING, ID_TRAY_EXIT, _T("Exit"));
+    }
+
+    MENUITEMINFO item = { sizeof(MENUITEMINFO) };
+    item.fMask = MIIM_ID | MIIM_STRING;
+    item.wID = g_Jiggle.isJiggling ? ID_TRAY_STOP : ID_TRAY_START;
+    item.dwTypeData = (LPTSTR)(g_Jiggle.isJiggling ? _T("Stop Jiggling") : _T("Start Jiggling"));
+    SetMenuItemInfo(g_hTrayMenu, TRAY_MENU_TOGGLE_POSITION, TRUE, &item);
+
+    if (g_hTrayProfileMenu) {
+        CheckMenuRadioItem(g_hTrayProfileMenu, ID_TRAY_PROFILE_FIRST, ID_TRAY_PROFILE_FIRST + g_ProfileCount,
+                           ID_TRAY_PROFILE_FIRST + 1 + g_ActiveProfile, MF_BYCOMMAND);
+    }
+    return g_hTrayMenu;
+}
+
+void DestroyTrayMenu() {
+    if (g_hTrayMenu) {
+        DestroyMenu(g_hTrayMenu);  // Destroys the profile submenu too
+        g_hTrayMenu = NULL;
+        g_hTrayProfileMenu = NULL;
+    }
+}
+
+// Minimize to system tray
+void MinimizeToTray() {
+    ShowWindow(g_hMainDlg, SW_HIDE);
+    CreateTrayIcon();
+}
+
+// Restore from system tray
+void RestoreFromTray() {
+    Shell_NotifyIcon(NIM_DELETE, &g_nid);
+    ShowWindow(g_hMainDlg, SW_SHOW);
+    SetForegroundWindow(g_hMainDlg);
+}
+
+// Enable/disable the time range and weekday controls
+void EnableTimeControls(HWND hDlg, BOOL enable) {
+    EnableWindow(GetDlgItem(hDlg, IDC_EDIT_START_HOUR), enable);
+    EnableWindow(GetDlgItem(hDlg, IDC_EDIT_START_MINUTE), enable);
+    EnableWindow(GetDlgItem(hDlg, IDC_EDIT_END_HOUR), enable);
+    EnableWindow(GetDlgItem(hDlg, IDC_EDIT_END_MINUTE), enable);
+
+    for (int i = 0; i < 7; i++) {
+        EnableWindow(GetDlgItem(hDlg, IDC_CHECK_SUNDAY + i), enable);
+    }
+}
+
+// Load the current settings into the dialog controls
+void ApplySettingsToControls(HWND hDlg) {
+    CheckDlgButton(hDlg, IDC_CHECK_MINIMIZE, g_Settings.minimizeOnStartup ? BST_CHECKED : BST_UNCHECKED);
+    CheckDlgButton(hDlg, IDC_CHECK_ZEN, g_Settings.zenJiggle ? BST_CHECKED : BST_UNCHECKED);
+    SendDlgItemMessage(hDlg, IDC_SLIDER_PERIOD, TBM_SETPOS, TRUE, g_Settings.jigglePeriod);
+
+    // Time restriction controls: edit values first, then spin positions
+    CheckDlgButton(hDlg, IDC_CHECK_ENABLE_TIME,
+                  g_Settings.enableTimeRestriction ? BST_CHECKED : BST_UNCHECKED);
+
+    SetDlgItemInt(hDlg, IDC_EDIT_START_HOUR, g_Settings.startHour, FALSE);
+    SetDlgItemInt(hDlg, IDC_EDIT_START_MINUTE, g_Settings.startMinute, FALSE);
+    SetDlgItemInt(hDlg, IDC_EDIT_END_HOUR, g_Settings.endHour, FALSE);
+    SetDlgItemInt(hDlg, IDC_EDIT_END_MINUTE, g_Settings.endMinute, FALSE);
+
+    SendDlgItemMessage(hDlg, IDC_SPIN_START_HOUR, UDM_SETPOS, 0, g_Settings.startHour);
+    SendDlgItemMessage(hDlg, IDC_SPIN_START_MINUTE, UDM_SETPOS, 0, g_Settings.startMinute);
+    SendDlgItemMessage(hDlg, IDC_SPIN_END_HOUR, UDM_SETPOS, 0, g_Settings.endHour);
+    SendDlgItemMessage(hDlg, IDC_SPIN_END_MINUTE, UDM_SETPOS, 0, g_Settings.endMinute);
+
+    // Weekday checkboxes (IDs are consecutive, Sun..Sat)
+    for (int i = 0; i < 7; i++) {
+        CheckDlgButton(hDlg, IDC_CHECK_SUNDAY + i,
+                       g_Settings.enabledDays[i] ? BST_CHECKED : BST_UNCHECKED);
+    }
+
+    EnableTimeControls(hDlg, g_Settings.enableTimeRestriction);
+}
+
+// Remember the INI file's write time and size, so our own SaveSettings() is not mistaken
+// for an external edit. Returns whether either changed; a file that cannot be read right
+// now (missing, or locked by the editor saving it) counts as unchanged.
+bool RememberIniWriteTime() {
+    WIN32_FILE_ATTRIBUTE_DATA data;
+    if (!GetFileAttributesEx(g_IniFilePath, GetFileExInfoStandard, &data)) {
+        return false;
+    }
+
+    ULONGLONG size = ((ULONGLONG)data.nFileSizeHigh << 32) | data.nFileSizeLow;
+    bool changed = CompareFileTime(&data.ftLastWriteTime, &g_IniWriteTime) != 0 || size != g_IniSize;
+    g_IniWriteTime = data.ftLastWriteTime;
+    g_IniSize = size;
+    return changed;
+}
+
+// Watch the INI file's directory; the message loop waits on the handle alongside messages
+void StartSettingsWatch() {
+    TCHAR directory[MAX_PATH];
+    _tcscpy_s(directory, MAX_PATH, g_IniFilePath);
+    TCHAR* lastSlash = _tcsrchr(directory, _T('\\'));
+    if (!lastSlash) {
+        return;
+    }
+    *lastSlash = _T('\0');
+
+    RememberIniWriteTime();
+    g_hSettingsChange = FindFirstChangeNotification(directory, FALSE, FILE_NOTIFY_CHANGE_LAST_WRITE);
+    if (g_hSettingsChange == INVALID_HANDLE_VALUE) {
+        g_hSettingsChange = NULL;
+        OutputDebugString(_T("Settings file watch unavailable"));
+    }
+}
+
+void StopSettingsWatch() {
+    if (g_hSettingsChange) {
+        FindCloseChangeNotification(g_hSettingsChange);
+        g_hSettingsChange = NULL;
+    }
+}
+
+// Something in the INI directory changed: reload if MouseJiggler.ini was edited externally.
+// The watch covers the whole directory, so writes to any other file there (a log, a
+// backup, another program's settings) land here too and must not reload anything.
+void OnSettingsFileChanged() {
+    FindNextChangeNotification(g_hSettingsChange);
+
+    if (!RememberIniWriteTime()) {
+        return;  // Another file, or our own write
+    }
+
+    OutputDebugString(_T("Settings file changed: reloading"));
+    LoadSettings();
+    ApplyCommandLineOverrides();
+    DestroyTrayMenu();
+    ApplySettingsToControls(g_hMainDlg);
+    RetimeForSettings();
+    NotifyStatusChanged();
+}
+
+// Restart the scheduler tasks after g_Settings was replaced
+void RetimeForSettings() {
+    if (g_Jiggle.isJiggling) {
+        ScheduleNextJiggle();
+    }
+    RestartTimeWindowTask();
+}
+
+// Switch to a profile (PROFILE_NONE = [Settings]): swap in its snapshot, record the
+// choice with a single INI write and retime once
+void SwitchProfile(int profile) {
+    MJ_TRACE_SCOPE("SwitchProfile");
+    if (profile == g_ActiveProfile) {
+        return;
+    }
+
+    g_ActiveProfile = profile;
+    UseSettingsSnapshot(profile == PROFILE_NONE ? g_BaseSettings : g_Profiles[profile].settings);
+    g_CommandLine.profile[0] = _T('\0');    // The user's choice replaces -p
+
+    {
+        SubsystemScope scope(g_Resources, SUBSYSTEM_SETTINGS);
+        WritePrivateProfileString(_T("Settings"), _T("ActiveProfile"),
+                                  profile == PROFILE_NONE ? _T("") : g_Profiles[profile].name, g_IniFilePath);
+        g_SavedActiveProfile = profile;
+        RememberIniWriteTime();
+    }
+
+    ApplySettingsToControls(g_hMainDlg);
+    RetimeForSettings();
+    NotifyStatusChanged();
+}
+
+// About dialog procedure
+INT_PTR CALLBACK AboutDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    switch (message) {
+    case WM_INITDIALOG:
+        return TRUE;
+
+    case WM_COMMAND:
+        if (LOWORD(wParam) == IDOK || LOWORD(wParam) == IDCANCEL) {
+            EndDialog(hDlg, LOWORD(wParam));
+            return TRUE;
+        }
+        break;
+    }
+    return FALSE;
+}
+
+// Trace event name for a main dialog message
+const char* TraceMessageName(UINT message) {
+    switch (message) {
+    case WM_INITDIALOG:         return "WM_INITDIALOG";
+    case WM_COMMAND:            return "WM_COMMAND";
+    case WM_DRAWITEM:           return "WM_DRAWITEM";
+    case WM_HSCROLL:            return "WM_HSCROLL";
+    case WM_TIMER:              return "WM_TIMER";
+    case WM_POWERBROADCAST:     return "WM_POWERBROADCAST";
+    case WM_WTSSESSION_CHANGE:  return "WM_WTSSESSION_CHANGE";
+    case WM_TRAYICON:           return "WM_TRAYICON";
+    case WM_GUEST_SOCKET:       return "WM_GUEST_SOCKET";
+    default:                    return "MainDialogProc";
+    }
+}
+
+// Main dialog procedure
+INT_PTR CALLBACK MainDialogProc(HWND hDlg, UINT message, WPARAM wParam, LPARAM lParam) {
+    MJ_TRACE_SCOPE(TraceMessageName(message));
+
+    switch (message) {
+    case WM_INITDIALOG:
+        {
+            g_hMainDlg = hDlg;
+
+            // Set icon
+            HICON hIcon = LoadIcon(g_hInst, MAKEINTRESOURCE(IDI_MAINICON));
+            SendMessage(hDlg, WM_SETICON, ICON_BIG, (LPARAM)hIcon);
+            SendMessage(hDlg, WM_SETICON, ICON_SMALL, (LPARAM)hIcon);
+
+            // Setup control ranges
+            HWND hTrackbar = GetDlgItem(hDlg, IDC_SLIDER_PERIOD);
+            SendMessage(hTrackbar, TBM_SETRANGE, TRUE, MAKELPARAM(1, 180));
+            SendMessage(hTrackbar, TBM_SETPAGESIZE, 0, 10);
+
+            SendDlgItemMessage(hDlg, IDC_SPIN_START_HOUR, UDM_SETRANGE, 0, MAKELPARAM(23, 0));
+            SendDlgItemMessage(hDlg, IDC_SPIN_START_MINUTE, UDM_SETRANGE, 0, MAKELPARAM(59, 0));
+            SendDlgItemMessage(hDlg, IDC_SPIN_END_HOUR, UDM_SETRANGE, 0, MAKELPARAM(23, 0));
+            SendDlgItemMessage(hDlg, IDC_SPIN_END_MINUTE, UDM_SETRANGE, 0, MAKELPARAM(59, 0));
+
+            // Initialize controls
+            ApplySettingsToControls(hDlg);
+
+            // Start jiggling if requested
+            if (g_Settings.startJiggling) {
+                StartJiggling();
+
+                // Resuming after a restart: keep the previous deadline (missed-deadline policy applies)
+                if (g_ResumeJiggleDue != 0) {
+                    g_Jiggle.nextDue = g_ResumeJiggleDue;
+                    RestartJiggleTask();
+                }
+            }
+
+            // Sync button, period label and registry with the initial state
+            NotifyStatusChanged();
+
+            // Apply the time window now; the task then waits for the next boundary
+            RestartTimeWindowTask();
+
+            // Minimize on startup if requested
             if (g_Settings.minimizeOnStartup) {
                 MinimizeToTray();
             }
 
-            return TRUE;
-        }
+            // Session lock/disconnect notifications drive injection backoff and recovery
+            WTSRegisterSessionNotification(hDlg, NOTIFY_FOR_THIS_SESSION);
+
+            // Take the resource baseline, then keep sampling in the background
+            OnResourceSample();
+            SetTimer(hDlg, TIMER_RESOURCE_SAMPLE, RESOURCE_SAMPLE_MS, NULL);
+
+            return TRUE;
+        }
+
+    default:
+        // Handle TaskbarCreated message (explorer.exe restart)
+        if (message == g_uTaskbarCreated && g_uTaskbarCreated != 0) {
+            // Recreate tray icon if window is hidden
+            if (!IsWindowVisible(hDlg) && g_nid.hWnd != NULL) {
+                OutputDebugString(_T("TaskbarCreated: Recreating tray icon"));
+                CreateTrayIcon();
+            }
+            return TRUE;
+        }
+        break;
+
+    case WM_COMMAND:
+        switch (LOWORD(wParam)) {
+        case IDC_CHECK_JIGGLING:
+            // Toggle jiggling state
+            if (g_Jiggle.isJiggling) {
+                StopJiggling();
+            } else {
+                StartJiggling();
+            }
+            break;
+
+        case IDC_CHECK_MINIMIZE:
+            g_Settings.minimizeOnStartup = IsDlgButtonChecked(hDlg, IDC_CHECK_MINIMIZE) == BST_CHECKED;
+            SaveSettings();
+            break;
+
+        case IDC_CHECK_ZEN:
+            g_Settings.zenJiggle = IsDlgButtonChecked(hDlg, IDC_CHECK_ZEN) == BST_CHECKED;
+            g_CommandLine.zenJiggle = false;
+            SaveSettings();
+            NotifyStatusChanged();
+            break;
+
+        case IDC_CHECK_ENABLE_TIME:
+            g_Settings.enableTimeRestriction = IsDlgButtonChecked(hDlg, IDC_CHECK_ENABLE_TIME) == BST_CHECKED;
+            SaveSettings();
+
+            // Enable/disable time input controls
+            EnableTimeControls(hDlg, g_Settings.enableTimeRestriction);
+
+            // Start/stop the time window task (it applies the window at once)
+            RestartTimeWindowTask();
+
+            NotifyStatusChanged();
+            break;
+
+        case IDC_EDIT_START_HOUR:
+        case IDC_EDIT_START_MINUTE:
+        case IDC_EDIT_END_HOUR:
+        case IDC_EDIT_END_MINUTE:
+            if (HIWORD(wParam) == EN_KILLFOCUS) {
+                // Update when user leaves the field (avoids initialization issues)
+                g_Settings.startHour = GetDlgItemInt(hDlg, IDC_EDIT_START_HOUR, NULL, FALSE);
+                g_Settings.startMinute = GetDlgItemInt(hDlg, IDC_EDIT_START_MINUTE, NULL, FALSE);
+                g_Settings.endHour = GetDlgItemInt(hDlg, IDC_EDIT_END_HOUR, NULL, FALSE);
+                g_Settings.endMinute = GetDlgItemInt(hDlg, IDC_EDIT_END_MINUTE, NULL, FALSE);
+
+                // Clamp values
+                if (g_Settings.startHour > 23) g_Settings.startHour = 23;
+                if (g_Settings.startMinute > 59) g_Settings.startMinute = 59;
+                if (g_Settings.endHour > 23) g_Settings.endHour = 23;
+                if (g_Settings.endMinute > 59) g_Settings.endMinute = 59;
+
+                // Boundaries moved: re-apply the window
+                if (g_Settings.enableTimeRestriction) {
+                    RestartTimeWindowTask();
+                }
+
+                NotifyStatusChanged();
+            }
+            break;
+
+        case IDC_CHECK_SUNDAY:
+        case IDC_CHECK_MONDAY:
+        case IDC_CHECK_TUESDAY:
+        case IDC_CHECK_WEDNESDAY:
+        case IDC_CHECK_THURSDAY:
+        case IDC_CHECK_FRIDAY:
+        case IDC_CHECK_SATURDAY:
+            {
+                // Map control ID to day index (0=Sun, 1=Mon, ..., 6=Sat)
+                int dayIndex = LOWORD(wParam) - IDC_CHECK_SUNDAY;
+                g_Settings.enabledDays[dayIndex] =
+                    IsDlgButtonChecked(hDlg, LOWORD(wParam)) == BST_CHECKED;
+                SaveSettings();
+
+                // Re-apply the window to auto-start/stop if needed
+                if (g_Settings.enableTimeRestriction) {
+                    RestartTimeWindowTask();
+                }
+
+                NotifyStatusChanged();
+            }
+            break;
+
+        case IDC_BUTTON_ABOUT:
+            DialogBox(g_hInst, MAKEINTRESOURCE(IDD_ABOUTDIALOG), hDlg, AboutDialogProc);
+            break;
 
-    default:
-        // Handle TaskbarCreated message (explorer.exe restart)
-        if (message == g_uTaskbarCreated && g_uTaskbarCreated != 0) {
-            // Recreate tray icon if window is hidden
-            if (!IsWindowVisible(hDlg) && g_nid.hWnd != NULL) {
-                OutputDebugString(_T("TaskbarCreated: Recreating tray icon"));
-                CreateTrayIcon();
+        case IDC_BUTTON_MINIMIZE:
+            // Exit button - confirm and close
+            if (MessageBox(hDlg,
+                _T("Are you sure you want to exit Mouse Jiggler?"),
+                _T("Confirm Exit"),
+                MB_YESNO | MB_ICONQUESTION) == IDYES) {
+                SendMessage(hDlg, WM_DESTROY, 0, 0);
             }
-            return TRUE;
-        }
-        break;
+            break;
 
-    case WM_COMMAND:
-        switch (LOWORD(wParam)) {
-        case IDC_CHECK_JIGGLING:
-            // Toggle jiggling state
-            if (g_IsJiggling) {
-                StopJiggling();
-            } else {
-                StartJiggling();
+        case ID_TRAY_OPEN:
+            RestoreFromTray();
+            break;
+
+        case ID_TRAY_START:
+            StartJiggling();
+            break;
+
+        case ID_TRAY_STOP:
+            StopJiggling();
+            break;
+
+        case ID_TRAY_GUESTS:
+            {
+                TCHAR report[MAX_GUESTS * 256 + 128];
+                FormatGuestReport(report, MAX_GUESTS * 256 + 128);
+                MessageBox(hDlg, report, _T("Mouse Jiggler - VM Guests"), MB_OK | MB_ICONINFORMATION);
             }
-            UpdateJigglingButton(hDlg);
             break;
 
-        case IDC_CHECK_MINIMIZE:
-            g_Settings.minimizeOnStartup = IsDlgButtonChecked(hDlg, IDC_CHECK_MINIMIZE) == BST_CHECKED;
-            SaveSettings();
+        case ID_TRAY_RESOURCES:
+            {
+                g_Resources.Sample();
+
+                TCHAR report[512];
+                FormatResourceReport(report, 512);
+                MessageBox(hDlg, report, _T("Mouse Jiggler - Resource Usage"), MB_OK | MB_ICONINFORMATION);
+            }
             break;
 
-        case IDC_CHECK_ZEN:
-            g_Settings.zenJiggle = IsDlgButtonChecked(hDlg, IDC_CHECK_ZEN) == BST_CHECKED;
-            SaveSettings();
-            UpdateTrayIcon();
+        case ID_TRAY_EXIT:
+            // Confirm and exit
+            if (MessageBox(hDlg,
+                _T("Are you sure you want to exit Mouse Jiggler?"),
+                _T("Confirm Exit"),
+                MB_YESNO | MB_ICONQUESTION) == IDYES) {
+                SendMessage(hDlg, WM_DESTROY, 0, 0);
+            }
             break;
 
-        case IDC_CHECK_ENABLE_TIME:
-            g_Settings.enableTimeRestriction = IsDlgButtonChecked(hDlg, IDC_CHECK_ENABLE_TIME) == BST_CHECKED;
+        default:
+            if (LOWORD(wParam) >= ID_TRAY_PROFILE_FIRST && LOWORD(wParam) <= ID_TRAY_PROFILE_FIRST + g_ProfileCount) {
+                // First entry is [Settings], then the profiles in INI order
+                SwitchProfile(LOWORD(wParam) - ID_TRAY_PROFILE_FIRST - 1);
+            }
+            break;
+        }
+        break;
+
+    case WM_DRAWITEM:
+        if (wParam == IDC_CHECK_JIGGLING) {
+            DrawPlayPauseButton((LPDRAWITEMSTRUCT)lParam);
+            return TRUE;
+        }
+        break;
+
+    case WM_DPICHANGED:
+        // Moved to a monitor with another DPI: take the size Windows suggests for it
+        {
+            const RECT* suggested = (const RECT*)lParam;
+            SetWindowPos(hDlg, NULL, suggested->left, suggested->top,
+                         suggested->right - suggested->left, suggested->bottom - suggested->top,
+                         SWP_NOZORDER | SWP_NOACTIVATE);
+        }
+        // fall through
+    case WM_THEMECHANGED:
+    case WM_SYSCOLORCHANGE:
+        // Cached button faces are stale; they are re-rendered on the next paint
+        ResetButtonCache();
+        UpdateJigglingButton(hDlg);
+        break;
+
+    case WM_HSCROLL:
+        if ((HWND)lParam == GetDlgItem(hDlg, IDC_SLIDER_PERIOD)) {
+            HWND hTrackbar = GetDlgItem(hDlg, IDC_SLIDER_PERIOD);
+            g_Settings.jigglePeriod = (int)SendMessage(hTrackbar, TBM_GETPOS, 0, 0);
+            g_CommandLine.jigglePeriod = 0;
             SaveSettings();
 
-            // Enable/disable time input controls
+            // Retime if jiggling (the phase is kept, only the grid spacing changes)
+            if (g_Jiggle.isJiggling) {
+                ScheduleNextJiggle();
+            }
+
+            NotifyStatusChanged();
+        }
+        break;
+
+    case WM_TIMER:
+        if (wParam == TIMER_SCHEDULER) {
+            RunScheduler();
+        }
+        else if (wParam == TIMER_GUEST_KEEPALIVE) {
+            OnGuestTimer();
+        }
+        else if (wParam == TIMER_RESOURCE_SAMPLE) {
+            OnResourceSample();
+        }
+        break;
+
+    case WM_POWERBROADCAST:
+        // After resume, settle missed deadlines and window changes now instead of
+        // whenever the stale timer fires
+        if (wParam == PBT_APMRESUMEAUTOMATIC) {
+            RunScheduler();
+        }
+        break;
+
+    case WM_WTSSESSION_CHANGE:
+        switch (wParam) {
+        case WTS_SESSION_LOCK:
+            g_Injection.SetSessionLocked(true);
+            break;
+        case WTS_SESSION_UNLOCK:
+            g_Injection.SetSessionLocked(false);
+            break;
+        case WTS_CONSOLE_DISCONNECT:
+        case WTS_REMOTE_DISCONNECT:
+            g_Injection.SetSessionDisconnected(true);
+            break;
+        case WTS_CONSOLE_CONNECT:
+        case WTS_REMOTE_CONNECT:
+            g_Injection.SetSessionDisconnected(false);
+            break;
+        }
+        break;
+
+    case WM_TIMECHANGE:
+        // Wall clock was adjusted: realign deadlines and the time window to the new time
+        if (g_Jiggle.isJiggling) {
+            ScheduleNextJiggle();
+        }
+        if (g_Settings.enableTimeRestriction) {
+            RestartTimeWindowTask();
+        }
+        break;
+
+    case WM_GUEST_SOCKET:
+        OnGuestSocket((SOCKET)wParam, lParam);
+        return TRUE;
+
+    case WM_TASK_FAILED:
+        MessageBox(hDlg,
+            wParam == JIGGLE_TASK_JIGGLE
+                ? _T("Jiggling could not be started: the scheduler has no room for the jiggle task.")
+                : _T("The time restriction could not be applied: the scheduler has no room for its task."),
+            _T("Mouse Jiggler - Error"), MB_OK | MB_ICONERROR);
+        return TRUE;
+
+    case WM_TRAYICON:
+        if (lParam == WM_LBUTTONDBLCLK) {
+            RestoreFromTray();
+        } else if (lParam == WM_RBUTTONUP) {
+            POINT pt;
+            GetCursorPos(&pt);
+
+            // Update the cached context menu (accounted to the tray; the modal menu loop is not)
+            HMENU hMenu;
             {
-                BOOL enableTimeControls = g_Settings.enableTimeRestriction;
-                EnableWindow(GetDlgItem(hDlg, IDC_EDIT_START_HOUR), enableTimeControls);
-                EnableWindow(GetDlgItem(hDlg, IDC_EDIT_START_MINUTE), enableTimeControls);
-                EnableWindow(GetDlgItem(hDlg, IDC_EDIT_END_HOUR), enableTimeControls);
-                EnableWindow(GetDlgItem(hDlg, IDC_EDIT_END_MINUTE), enableTimeControls);
-
-                // Enable/disable weekday checkboxes
-                static const int weekdayControls[7] = {
-                    IDC_CHECK_SUNDAY, IDC_CHECK_MONDAY, IDC_CHECK_TUESDAY,
-                    IDC_CHECK_WEDNESDAY, IDC_CHECK_THURSDAY, IDC_CHECK_FRIDAY,
-                    IDC_CHECK_SATURDAY
-                };
-
-                for (int i = 0; i < 7; i++) {
-                    EnableWindow(GetDlgItem(hDlg, weekdayControls[i]), enableTimeControls);
+                SubsystemScope scope(g_Resources, SUBSYSTEM_TRAY);
+                hMenu = GetTrayMenu();
+            }
+
+            SetForegroundWindow(hDlg);
+            TrackPopupMenu(hMenu, TPM_BOTTOMALIGN | TPM_LEFTALIGN, pt.x, pt.y, 0, hDlg, NULL);
+        }
+        break;
+
+    case WM_CLOSE:
+        // X button minimizes to tray instead of closing
+        MinimizeToTray();
+        break;
+
+    case WM_DESTROY:
+        // Save all settings
+        SaveSettings();
+
+        // Kill timers and end the scheduler tasks (the runtime state keeps the deadline)
+        KillTimer(hDlg, TIMER_SCHEDULER);
+        KillTimer(hDlg, TIMER_RESOURCE_SAMPLE);
+        g_Jiggle.CancelAll();
+        WTSUnRegisterSessionNotification(hDlg);
+        g_Injection.SetFallback(false);
+
+        // Remove tray icon
+        if (g_nid.hWnd) {
+            Shell_NotifyIcon(NIM_DELETE, &g_nid);
+        }
+
+        // Release what was built after startup (caches, guest connections) first
+        ResetButtonCache();
+        DestroyTrayMenu();
+        if (g_GuestCount > 0) {
+            TCHAR report[MAX_GUESTS * 256 + 128];
+            FormatGuestReport(report, MAX_GUESTS * 256 + 128);
+            OutputDebugString(report);
+            DisconnectGuests();
+        }
+#ifdef _DEBUG
+        if (g_AllocationGuardArmed) {
+            MeasureGuardObjectGrowth();
+        }
+#endif
+
+        ReleaseInstanceRegistry();
+        CloseRuntimeState();
+        StopSettingsWatch();
+        UnloadInputSink();
+        CloseGuests();
+
+        {
+            TCHAR msg[256];
+            _stprintf_s(msg, 256, _T("Status updates: %llu requested, %llu tooltip rebuilds, %llu shell calls, %llu button repaints, %llu label updates"),
+                g_Status.stats.updatesRequested, g_Status.stats.tooltipRebuilds, g_Status.stats.shellCalls,
+                g_Status.stats.buttonRepaints, g_Status.stats.labelUpdates);
+            OutputDebugString(msg);
+
+            _stprintf_s(msg, 256, _T("Injection: %llu skipped, failed %llu blocked, %llu secure desktop, %llu disconnected, %llu transient"),
+                g_Injection.skipped, g_Injection.failures[INJECT_BLOCKED], g_Injection.failures[INJECT_SECURE_DESKTOP],
+                g_Injection.failures[INJECT_DISCONNECTED], g_Injection.failures[INJECT_TRANSIENT]);
+            OutputDebugString(msg);
+
+            // Adaptive mode: injected jiggles per day versus one per deadline on the fixed schedule
+            if (g_Settings.adaptiveJiggle && g_Adaptive.startedAt != 0) {
+                ULONGLONG elapsed = GetWallClockMs() - g_Adaptive.startedAt;
+                if (elapsed > 0) {
+                    _stprintf_s(msg, 256, _T("Adaptive jiggle: %.0f injected/day vs %.0f fixed, %llu verify failures, level %d"),
+                        g_Adaptive.injected * 86400000.0 / elapsed, g_Adaptive.deadlines * 86400000.0 / elapsed,
+                        g_Adaptive.verifyFailures, g_Adaptive.level);
+                    OutputDebugString(msg);
                 }
+            }
+        }
+
+        PostQuitMessage(0);
+        break;
+    }
+
+    return FALSE;
+}
+
+// Creation time of a process as a FILETIME value, or 0 if it cannot be read
+ULONGLONG GetProcessCreationTime(HANDLE hProcess) {
+    FILETIME created, exited, kernel, user;
+    if (!GetProcessTimes(hProcess, &created, &exited, &kernel, &user)) {
+        return 0;
+    }
+    return ((ULONGLONG)created.dwHighDateTime << 32) | created.dwLowDateTime;
+}
+
+// Check whether the process that owns a registry slot has exited. Slot files
+// outlive a crash or a reboot, so a live process with the same PID but a
+// different creation time is a different process.
+bool IsSlotOwnerGone(int32_t pid, uint64_t created) {
+    HANDLE hProcess = OpenProcess(SYNCHRONIZE | PROCESS_QUERY_LIMITED_INFORMATION, FALSE, (DWORD)pid);
+    if (!hProcess) {
+        return GetLastError() == ERROR_INVALID_PARAMETER;  // No such process
+    }
+    bool gone = WaitForSingleObject(hProcess, 0) == WAIT_OBJECT_0;
+    if (!gone && created != 0) {
+        ULONGLONG actual = GetProcessCreationTime(hProcess);
+        gone = actual != 0 && actual != created;
+    }
+    CloseHandle(hProcess);
+    return gone;
+}
+
+// Open the mapping of registry slot 'index'. Slots are files under
+// %ProgramData%\MouseJiggler\Instances, which every session can map without
+// SeCreateGlobalPrivilege. Logged-on users may add files to the directory and
+// read every file in it; a slot file grants full access only to the user who
+// created it (and SYSTEM and administrators), so an instance can never write
+// another user's slot. A writable open keeps the file open in *hFile (the
+// owner deletes it through that handle on release); a read-only open never
+// creates anything. Without the directory, instances fall back to per-session
+// (Local) mappings.
+HANDLE OpenRegistrySlot(int index, bool writable, HANDLE* hFile) {
+    *hFile = INVALID_HANDLE_VALUE;
+
+    TCHAR path[MAX_PATH];
+    DWORD length = GetEnvironmentVariable(_T("ProgramData"), path, MAX_PATH);
+    if (length > 0 && length < MAX_PATH - 48) {
+        _tcscat_s(path, MAX_PATH, _T("\\MouseJiggler"));
+        if (writable) {
+            CreateDirectory(path, NULL);
+        }
+        _tcscat_s(path, MAX_PATH, _T("\\Instances"));
+
+        SECURITY_ATTRIBUTES sa = { sizeof(sa), NULL, FALSE };
+        if (writable && ConvertStringSecurityDescriptorToSecurityDescriptor(
+                REGISTRY_DIRECTORY_SDDL, SDDL_REVISION_1, &sa.lpSecurityDescriptor, NULL)) {
+            CreateDirectory(path, &sa);
+            LocalFree(sa.lpSecurityDescriptor);
+        }
+
+        DWORD attributes = GetFileAttributes(path);
+        if (attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_DIRECTORY)) {
+            TCHAR name[16];
+            _stprintf_s(name, 16, _T("\\Slot%02d.dat"), index);
+            _tcscat_s(path, MAX_PATH, name);
+
+            // Asking for DELETE fails on another user's slot; readers share delete
+            // so the owner can remove its file while they have it open
+            HANDLE file = CreateFile(path, writable ? GENERIC_READ | GENERIC_WRITE | DELETE : GENERIC_READ,
+                                     FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, NULL,
+                                     writable ? OPEN_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+            if (file == INVALID_HANDLE_VALUE) {
+                return NULL;    // Another user's slot, or none here
+            }
+
+            // Mapping a new (empty) file at this size extends it with zeros (a free slot)
+            HANDLE hMapping = writable
+                ? CreateFileMapping(file, NULL, PAGE_READWRITE, 0, sizeof(InstanceSlot), NULL)
+                : CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (hMapping && writable) {
+                *hFile = file;
+            } else {
+                CloseHandle(file);
+            }
+            return hMapping;
+        }
+    }
+
+    TCHAR localName[64];
+    _stprintf_s(localName, 64, _T("Local\\ArkaneSystems.MouseJiggler.Slot%02d"), index);
+    return writable
+        ? CreateFileMapping(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, 0, sizeof(InstanceSlot), localName)
+        : OpenFileMapping(FILE_MAP_READ, FALSE, localName);
+}
+
+// Whether a slot file is about to be deleted (its previous owner released it)
+bool IsRegistryFileDeleted(HANDLE hFile) {
+    FILE_STANDARD_INFO info;
+    return GetFileInformationByHandleEx(hFile, FileStandardInfo, &info, sizeof(info)) && info.DeletePending;
+}
+
+// Close a slot opened by OpenRegistrySlot
+void CloseRegistrySlot(InstanceSlot* slot, HANDLE hMapping, HANDLE hFile) {
+    if (slot) UnmapViewOfFile(slot);
+    if (hMapping) CloseHandle(hMapping);
+    if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+}
+
+// Claim a registry slot for this process
+bool OpenInstanceRegistry() {
+    int32_t pid = (int32_t)GetCurrentProcessId();
+    uint64_t created = GetProcessCreationTime(GetCurrentProcess());
+
+    for (int i = 0; i < REGISTRY_MAX_SLOTS; i++) {
+        HANDLE hFile;
+        HANDLE hMapping = OpenRegistrySlot(i, true, &hFile);
+        if (!hMapping) {
+            continue;
+        }
+
+        InstanceSlot* slot = (InstanceSlot*)MapViewOfFile(hMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(InstanceSlot));
+        if (slot && ClaimInstanceSlot(slot, pid, created, IsSlotOwnerGone)) {
+            // The previous owner deletes its file before it releases the slot; a
+            // file deleted under us would vanish from monitors, so leave it
+            if (hFile == INVALID_HANDLE_VALUE || !IsRegistryFileDeleted(hFile)) {
+                g_hRegistryFile = hFile;
+                g_hRegistryMapping = hMapping;
+                g_pRegistrySlot = slot;
+                PublishInstanceStatus();
+                return true;
+            }
+            ReleaseInstanceSlot(slot, pid);
+        }
+        CloseRegistrySlot(slot, hMapping, hFile);
+    }
+
+    OutputDebugString(_T("Instance registry full or unavailable"));
+    return false;
+}
+
+// Publish this instance's state into its registry slot
+void PublishInstanceStatus() {
+    if (!g_pRegistrySlot) return;
+
+    InstanceStatus status = { 0 };
+    DWORD sessionId = 0;
+    ProcessIdToSessionId(GetCurrentProcessId(), &sessionId);
+    status.sessionId = sessionId;
+
+    for (int i = 0; i < 7; i++) {
+        if (g_Settings.enabledDays[i]) status.enabledDaysMask |= 1u << i;
+    }
+
+    status.isJiggling = g_Jiggle.isJiggling;
+    status.zenJiggle = g_Settings.zenJiggle;
+    status.jigglePeriod = g_Settings.jigglePeriod;
+    status.enableTimeRestriction = g_Settings.enableTimeRestriction;
+    status.startMinutes = g_Settings.startHour * 60 + g_Settings.startMinute;
+    status.endMinutes = g_Settings.endHour * 60 + g_Settings.endMinute;
+    status.nextJiggleDue = g_Jiggle.isJiggling ? g_Jiggle.nextDue : 0;
+    status.jigglesSent = g_Counters.jigglesSent;
+    status.jiggleFailures = g_Counters.jiggleFailures;
+    status.lastUpdate = GetWallClockMs();
+    status.gdiObjects = g_Resources.latest.gdiObjects;
+    status.userObjects = g_Resources.latest.userObjects;
+    status.handleCount = g_Resources.latest.handleCount;
+    status.resourceAlert = g_Resources.alert;
+    status.workingSet = g_Resources.latest.workingSet;
+    status.privateBytes = g_Resources.latest.privateBytes;
+    status.cpuTime = g_Resources.latest.cpuTime;
+    for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+        status.subsystemCpuMs[i] = (uint32_t)g_Resources.subsystemMs[i];
+    }
+    status.injectionClass = g_Injection.lastClass;
+    status.fallbackActive = g_Injection.fallbackActive;
+    status.injectionsSkipped = g_Injection.skipped;
+
+    WriteInstanceStatus(g_pRegistrySlot, &status);
+}
+
+// Delete this instance's slot file, then free the slot (see OpenInstanceRegistry)
+void ReleaseInstanceRegistry() {
+    if (g_pRegistrySlot) {
+        if (g_hRegistryFile != INVALID_HANDLE_VALUE) {
+            FILE_DISPOSITION_INFO disposition = { TRUE };
+            SetFileInformationByHandle(g_hRegistryFile, FileDispositionInfo, &disposition, sizeof(disposition));
+        }
+        ReleaseInstanceSlot(g_pRegistrySlot, (int32_t)GetCurrentProcessId());
+    }
+    CloseRegistrySlot(g_pRegistrySlot, g_hRegistryMapping, g_hRegistryFile);
+    g_pRegistrySlot = NULL;
+    g_hRegistryMapping = NULL;
+    g_hRegistryFile = INVALID_HANDLE_VALUE;
+}
+
+// Show every running instance on the machine (-l, --list)
+void ShowInstanceStatus() {
+    // Room for three full lines per slot
+    static TCHAR report[REGISTRY_MAX_SLOTS * INSTANCE_REPORT_ENTRY];
+    size_t length = 0;
+    int found = 0;
+
+    for (int i = 0; i < REGISTRY_MAX_SLOTS; i++) {
+        HANDLE hFile;
+        HANDLE hMapping = OpenRegistrySlot(i, false, &hFile);
+        if (!hMapping) {
+            continue;
+        }
+        const InstanceSlot* slot = (const InstanceSlot*)MapViewOfFile(hMapping, FILE_MAP_READ, 0, 0, sizeof(InstanceSlot));
+
+        InstanceOwner owner;
+        InstanceStatus status;
+        bool running = slot && ReadInstanceSlot(slot, &owner, &status) && !IsSlotOwnerGone(owner.pid, owner.created);
+        CloseRegistrySlot((InstanceSlot*)slot, hMapping, hFile);
+        if (!running) {
+            continue;  // Free, or left behind by a crashed instance or a reboot
+        }
+
+        int written = _sntprintf_s(report + length, INSTANCE_REPORT_ENTRY, _TRUNCATE,
+            _T("Session %lu (PID %ld): %s, %lu s%s%s, %llu jiggles, %llu failed, %llu skipped%s\n")
+            _T("    GDI %lu, USER %lu, handles %lu, working set %llu KB%s\n")
+            _T("    CPU %llu ms; UI thread: timer %lu ms, painting %lu ms, settings I/O %lu ms, tray %lu ms\n"),
+            (unsigned long)status.sessionId, (long)owner.pid,
+            status.isJiggling ? _T("jiggling") : _T("idle"),
+            (unsigned long)status.jigglePeriod,
+            status.zenJiggle ? _T(", zen") : _T(""),
+            status.enableTimeRestriction ? _T(", scheduled") : _T(""),
+            (unsigned long long)status.jigglesSent, (unsigned long long)status.jiggleFailures,
+            (unsigned long long)status.injectionsSkipped,
+            status.fallbackActive ? _T(", blocked (keep-alive fallback)") : _T(""),
+            (unsigned long)status.gdiObjects, (unsigned long)status.userObjects, (unsigned long)status.handleCount,
+            (unsigned long long)(status.workingSet / 1024),
+            status.resourceAlert ? _T(", RESOURCE ALERT") : _T(""),
+            (unsigned long long)status.cpuTime,
+            (unsigned long)status.subsystemCpuMs[SUBSYSTEM_TIMER], (unsigned long)status.subsystemCpuMs[SUBSYSTEM_PAINT],
+            (unsigned long)status.subsystemCpuMs[SUBSYSTEM_SETTINGS], (unsigned long)status.subsystemCpuMs[SUBSYSTEM_TRAY]);
+        if (written > 0) {
+            length += written;
+        }
+        found++;
+    }
+
+    if (found == 0) {
+        _tcscpy_s(report, REGISTRY_MAX_SLOTS * INSTANCE_REPORT_ENTRY, _T("No running Mouse Jiggler instances found."));
+    }
+
+    MessageBox(NULL, report, _T("Mouse Jiggler - Instances"), MB_OK | MB_ICONINFORMATION);
+}
+
+// Map the state file and recover the newest intact record (call before creating the dialog)
+void LoadRuntimeState() {
+    // The single instance mutex keeps other instances of this session away from the file;
+    // one that is still holding it is a previous instance on its way out, so wait for it
+    for (int attempt = 0;; attempt++) {
+        g_hStateFile = CreateFile(g_StateFilePath, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                                  NULL, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+        if (g_hStateFile != INVALID_HANDLE_VALUE || GetLastError() != ERROR_SHARING_VIOLATION ||
+            attempt == STATE_OPEN_ATTEMPTS) {
+            break;
+        }
+        Sleep(STATE_OPEN_RETRY_MS);
+    }
+    if (g_hStateFile == INVALID_HANDLE_VALUE) {
+        // Run without persistence: jiggling works, but a restart will not resume it
+        TCHAR message[MAX_PATH + 96];
+        _stprintf_s(message, MAX_PATH + 96, _T("Runtime state unavailable (error %lu), not persisted: %s"),
+                    GetLastError(), g_StateFilePath);
+        OutputDebugString(message);
+        return;
+    }
+
+    // Mapping a new (empty) file at this size extends it with zeros
+    g_hStateMapping = CreateFileMapping(g_hStateFile, NULL, PAGE_READWRITE, 0, sizeof(RuntimeStateFile), NULL);
+    if (g_hStateMapping) {
+        g_pStateFile = (RuntimeStateFile*)MapViewOfFile(g_hStateMapping, FILE_MAP_READ | FILE_MAP_WRITE, 0, 0, sizeof(RuntimeStateFile));
+    }
+    if (!g_pStateFile) {
+        CloseRuntimeState();
+        return;
+    }
+
+    // Pick the newest record whose checksum is intact
+    int tornCount = 0;
+    const RuntimeRecord* newest = SelectRuntimeRecord(g_pStateFile, &tornCount);
+    if (tornCount > 0) {
+        OutputDebugString(_T("Runtime state: discarding torn record"));
+    }
+    if (!newest) {
+        return;
+    }
+
+    g_StateSequence = newest->sequence;
+    g_PatternStep = (int)newest->patternStep;
+    g_Counters.jigglesSent = newest->jigglesSent;
+    g_Counters.jiggleFailures = newest->jiggleFailures;
+
+    if (newest->isJiggling) {
+        // A deadline saved under another period or phase is moved to the first
+        // point of the current grid at or after it (missed-deadline policy applies)
+        g_Settings.startJiggling = true;
+        g_ResumeJiggleDue = AlignDeadline(newest->nextJiggleDue, GetJigglePeriodMs(), GetJigglePhaseMs());
+    }
+}
+
+// Write the current runtime state into the older of the two records
+void SaveRuntimeState() {
+    MJ_TRACE_SCOPE("SaveRuntimeState");
+    if (!g_pStateFile) return;
+
+    g_StateSequence++;
+
+    RuntimeRecord next = { 0 };
+    next.sequence = g_StateSequence;
+    next.isJiggling = g_Jiggle.isJiggling;
+    next.patternStep = g_PatternStep;
+    next.nextJiggleDue = g_Jiggle.isJiggling ? g_Jiggle.nextDue : 0;
+    next.jigglesSent = g_Counters.jigglesSent;
+    next.jiggleFailures = g_Counters.jiggleFailures;
+    next.savedAt = GetWallClockMs();
+
+    // Dirty pages of the mapping survive a process crash; no flush needed per update
+    StoreRuntimeRecord(g_pStateFile, &next);
+}
+
+// Save a final record, flush it to disk and release the mapping
+void CloseRuntimeState() {
+    if (g_pStateFile) {
+        SaveRuntimeState();
+        FlushViewOfFile(g_pStateFile, sizeof(RuntimeStateFile));
+        UnmapViewOfFile(g_pStateFile);
+        g_pStateFile = NULL;
+    }
+    if (g_hStateMapping) {
+        CloseHandle(g_hStateMapping);
+        g_hStateMapping = NULL;
+    }
+    if (g_hStateFile != INVALID_HANDLE_VALUE) {
+        CloseHandle(g_hStateFile);
+        g_hStateFile = INVALID_HANDLE_VALUE;
+    }
+}
+
+// Take a resource usage sample of this process
+bool SampleResources(ResourceSample* out) {
+    HANDLE hProcess = GetCurrentProcess();
+
+    out->gdiObjects = GetGuiResources(hProcess, GR_GDIOBJECTS);
+    out->userObjects = GetGuiResources(hProcess, GR_USEROBJECTS);
+
+    DWORD handleCount = 0;
+    GetProcessHandleCount(hProcess, &handleCount);
+    out->handleCount = handleCount;
+
+    PROCESS_MEMORY_COUNTERS_EX memory = { 0 };
+    memory.cb = sizeof(memory);
+    if (GetProcessMemoryInfo(hProcess, (PROCESS_MEMORY_COUNTERS*)&memory, sizeof(memory))) {
+        out->workingSet = memory.WorkingSetSize;
+        out->privateBytes = memory.PrivateUsage;
+    }
+
+    FILETIME creation, exitTime, kernel, user;
+    if (GetProcessTimes(hProcess, &creation, &exitTime, &kernel, &user)) {
+        ULARGE_INTEGER k, u;
+        k.LowPart = kernel.dwLowDateTime;
+        k.HighPart = kernel.dwHighDateTime;
+        u.LowPart = user.dwLowDateTime;
+        u.HighPart = user.dwHighDateTime;
+        out->cpuTime = (k.QuadPart + u.QuadPart) / 10000;
+    }
+    return true;
+}
 
-                // Start/stop time check timer
-                if (g_Settings.enableTimeRestriction) {
-                    SetTimer(hDlg, TIMER_TIME_CHECK, 1000, NULL);
-                    // Immediate check
-                    PostMessage(hDlg, WM_TIMER, TIMER_TIME_CHECK, 0);
-                } else {
-                    KillTimer(hDlg, TIMER_TIME_CHECK);
-                }
-            }
+// The UI thread's cycle counter only advances while it runs, so time blocked in
+// file or shell calls is not charged to a subsystem
+uint64_t GetThreadCycles() {
+    ULONG64 cycles = 0;
+    QueryThreadCycleTime(GetCurrentThread(), &cycles);
+    return cycles;
+}
 
-            UpdateTrayIcon();
-            break;
+// The UI thread's CPU time, to convert its cycles to ms
+double GetThreadCpuMs() {
+    FILETIME creation, exitTime, kernel, user;
+    if (!GetThreadTimes(GetCurrentThread(), &creation, &exitTime, &kernel, &user)) {
+        return 0.0;
+    }
+    ULARGE_INTEGER k, u;
+    k.LowPart = kernel.dwLowDateTime;
+    k.HighPart = kernel.dwHighDateTime;
+    u.LowPart = user.dwLowDateTime;
+    u.HighPart = user.dwHighDateTime;
+    return (k.QuadPart + u.QuadPart) / 10000.0;
+}
 
-        case IDC_EDIT_START_HOUR:
-        case IDC_EDIT_START_MINUTE:
-        case IDC_EDIT_END_HOUR:
-        case IDC_EDIT_END_MINUTE:
-            if (HIWORD(wParam) == EN_KILLFOCUS) {
-                // Update when user leaves the field (avoids initialization issues)
-                g_Settings.startHour = GetDlgItemInt(hDlg, IDC_EDIT_START_HOUR, NULL, FALSE);
-                g_Settings.startMinute = GetDlgItemInt(hDlg, IDC_EDIT_START_MINUTE, NULL, FALSE);
-                g_Settings.endHour = GetDlgItemInt(hDlg, IDC_EDIT_END_HOUR, NULL, FALSE);
-                g_Settings.endMinute = GetDlgItemInt(hDlg, IDC_EDIT_END_MINUTE, NULL, FALSE);
+static const ResourceHost g_ResourceHost = { SampleResources, GetThreadCycles, GetThreadCpuMs };
 
-                // Clamp values
-                if (g_Settings.startHour > 23) g_Settings.startHour = 23;
-                if (g_Settings.startMinute > 59) g_Settings.startMinute = 59;
-                if (g_Settings.endHour > 23) g_Settings.endHour = 23;
-                if (g_Settings.endMinute > 59) g_Settings.endMinute = 59;
+// Periodic sample: the first one is the baseline, later ones are checked for leaks
+void OnResourceSample() {
+    if (g_Resources.Sample()) {
+        TCHAR report[512];
+        FormatResourceReport(report, 512);
+        OutputDebugString(_T("Resource alert: possible handle leak"));
+        OutputDebugString(report);
 
-                UpdateTrayIcon();
-            }
-            break;
+        // Balloon from the tray icon, if it is shown
+        if (g_nid.hWnd) {
+            g_nid.uFlags |= NIF_INFO;
+            g_nid.dwInfoFlags = NIIF_WARNING;
+            _tcscpy_s(g_nid.szInfoTitle, 64, _T("Mouse Jiggler resource alert"));
+            _stprintf_s(g_nid.szInfo, 256, _T("Handle usage keeps growing: GDI %lu, USER %lu, kernel %lu."),
+                g_Resources.latest.gdiObjects, g_Resources.latest.userObjects, g_Resources.latest.handleCount);
+            Shell_NotifyIcon(NIM_MODIFY, &g_nid);
+            g_nid.uFlags &= ~NIF_INFO;
+        }
+    }
 
-        case IDC_CHECK_SUNDAY:
-        case IDC_CHECK_MONDAY:
-        case IDC_CHECK_TUESDAY:
-        case IDC_CHECK_WEDNESDAY:
-        case IDC_CHECK_THURSDAY:
-        case IDC_CHECK_FRIDAY:
-        case IDC_CHECK_SATURDAY:
-            {
-                // Map control ID to day index (0=Sun, 1=Mon, ..., 6=Sat)
-                int dayIndex = LOWORD(wParam) - IDC_CHECK_SUNDAY;
-                g_Settings.enabledDays[dayIndex] =
-                    IsDlgButtonChecked(hDlg, LOWORD(wParam)) == BST_CHECKED;
-                SaveSettings();
+    PublishInstanceStatus();
+    NotifyStatusChanged();
+}
 
-                // Immediate time check to auto-start/stop if needed
-                if (g_Settings.enableTimeRestriction) {
-                    PostMessage(hDlg, WM_TIMER, TIMER_TIME_CHECK, 0);
-                }
+// Human-readable resource report for the tray menu
+void FormatResourceReport(TCHAR* buffer, size_t bufferSize) {
+    const ResourceSample& latest = g_Resources.latest;
+    const ResourceSample& baseline = g_Resources.baseline;
+    double ms[SUBSYSTEM_COUNT];
+    g_Resources.SubsystemMs(ms);
+
+    _stprintf_s(buffer, bufferSize,
+        _T("GDI objects: %lu (at start %lu)\n")
+        _T("USER objects: %lu (at start %lu)\n")
+        _T("Kernel handles: %lu (at start %lu)\n")
+        _T("Working set: %llu KB\n")
+        _T("Private bytes: %llu KB\n")
+        _T("CPU time: %llu ms\n")
+        _T("  UI thread: timer %.1f ms, painting %.1f ms, settings I/O %.1f ms, tray %.1f ms\n")
+        _T("%s"),
+        latest.gdiObjects, baseline.gdiObjects,
+        latest.userObjects, baseline.userObjects,
+        latest.handleCount, baseline.handleCount,
+        latest.workingSet / 1024,
+        latest.privateBytes / 1024,
+        latest.cpuTime,
+        ms[SUBSYSTEM_TIMER], ms[SUBSYSTEM_PAINT], ms[SUBSYSTEM_SETTINGS], ms[SUBSYSTEM_TRAY],
+        g_Resources.alert ? _T("\nAlert: handle usage has grown well above the start value.") : _T(""));
+}
 
-                UpdateTrayIcon();
-            }
-            break;
+// GuestHost: QPC in us, and the guest's socket
+uint64_t GuestClockUs() {
+    static LARGE_INTEGER frequency = { 0 };
+    if (frequency.QuadPart == 0) QueryPerformanceFrequency(&frequency);
+    LARGE_INTEGER now;
+    QueryPerformanceCounter(&now);
+    // Whole seconds and the remainder separately, so the product cannot overflow
+    return (uint64_t)(now.QuadPart / frequency.QuadPart) * 1000000 +
+        (uint64_t)(now.QuadPart % frequency.QuadPart) * 1000000 / (uint64_t)frequency.QuadPart;
+}
 
-        case IDC_BUTTON_ABOUT:
-            DialogBox(g_hInst, MAKEINTRESOURCE(IDD_ABOUTDIALOG), hDlg, AboutDialogProc);
-            break;
+ULONGLONG GuestClockMs() {
+    return GuestClockUs() / 1000;
+}
 
-        case IDC_BUTTON_MINIMIZE:
-            // Exit button - confirm and close
-            if (MessageBox(hDlg,
-                _T("Are you sure you want to exit Mouse Jiggler?"),
-                _T("Confirm Exit"),
-                MB_YESNO | MB_ICONQUESTION) == IDYES) {
-                SendMessage(hDlg, WM_DESTROY, 0, 0);
-            }
-            break;
+bool SendGuestSocket(intptr_t connection, const char* data, int length) {
+    return send((SOCKET)connection, data, length, 0) == length;
+}
 
-        case ID_TRAY_OPEN:
-            RestoreFromTray();
-            break;
+void CloseGuestSocket(intptr_t connection) {
+    closesocket((SOCKET)connection);
+}
 
-        case ID_TRAY_START:
-            StartJiggling();
-            UpdateJigglingButton(hDlg);
-            break;
+const GuestHost g_GuestHost = { GuestClockUs, SendGuestSocket, CloseGuestSocket };
 
-        case ID_TRAY_STOP:
-            StopJiggling();
-            UpdateJigglingButton(hDlg);
-            break;
+// Load [Guest:*] sections and start Winsock if there are any
+void LoadGuests() {
+    g_GuestCount = 0;
 
-        case ID_TRAY_EXIT:
-            // Confirm and exit
-            if (MessageBox(hDlg,
-                _T("Are you sure you want to exit Mouse Jiggler?"),
-                _T("Confirm Exit"),
-                MB_YESNO | MB_ICONQUESTION) == IDYES) {
-                SendMessage(hDlg, WM_DESTROY, 0, 0);
-            }
-            break;
-        }
-        break;
+    static TCHAR sectionNames[4096];
+    if (GetPrivateProfileSectionNames(sectionNames, 4096, g_IniFilePath) == 0) {
+        return;
+    }
 
-    case WM_DRAWITEM:
-        if (wParam == IDC_CHECK_JIGGLING) {
-            DrawPlayPauseButton((LPDRAWITEMSTRUCT)lParam);
-            return TRUE;
+    size_t prefixLength = _tcslen(GUEST_SECTION_PREFIX);
+    for (const TCHAR* section = sectionNames; *section && g_GuestCount < MAX_GUESTS; section += _tcslen(section) + 1) {
+        if (_tcsnicmp(section, GUEST_SECTION_PREFIX, prefixLength) != 0 || section[prefixLength] == _T('\0')) {
+            continue;
         }
-        break;
 
-    case WM_HSCROLL:
-        if ((HWND)lParam == GetDlgItem(hDlg, IDC_SLIDER_PERIOD)) {
-            HWND hTrackbar = GetDlgItem(hDlg, IDC_SLIDER_PERIOD);
-            g_Settings.jigglePeriod = (int)SendMessage(hTrackbar, TBM_GETPOS, 0, 0);
-            UpdatePeriodLabel(hDlg);
-            SaveSettings();
+        // Address=host:port or [IPv6]:port (a local name or IP; resolved once here)
+        TCHAR address[128];
+        GetPrivateProfileString(section, _T("Address"), _T(""), address, 128, g_IniFilePath);
+        TCHAR* host;
+        TCHAR* port;
+        if (!SplitGuestAddress(address, &host, &port)) {
+            OutputDebugString(_T("VM guest without Address=host:port ignored"));
+            continue;
+        }
 
-            // Update timer if jiggling
-            if (g_IsJiggling) {
-                KillTimer(hDlg, TIMER_JIGGLE);
-                SetTimer(hDlg, TIMER_JIGGLE, g_Settings.jigglePeriod * 1000, NULL);
+        ADDRINFOW hints = { 0 };
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_protocol = IPPROTO_TCP;
+        // Winsock is started once, for the first guest section with an address
+        if (!g_WinsockStarted) {
+            WSADATA wsaData;
+            if (WSAStartup(MAKEWORD(2, 2), &wsaData) != 0) {
+                OutputDebugString(_T("WSAStartup failed; VM guest keep-alive disabled"));
+                return;
             }
-
-            UpdateTrayIcon();
+            g_WinsockStarted = true;
         }
-        break;
 
-    case WM_TIMER:
-        if (wParam == TIMER_JIGGLE) {
-            if (g_Settings.zenJiggle) {
-                PerformJiggle(0);
-            } else if (g_Zig) {
-                PerformJiggle(4);
-            } else {
-                PerformJiggle(-4);
-            }
-            g_Zig = !g_Zig;
+        ADDRINFOW* result = NULL;
+        if (GetAddrInfoW(host, port, &hints, &result) != 0 || !result) {
+            OutputDebugString(_T("VM guest address could not be resolved"));
+            continue;
         }
-        else if (wParam == TIMER_TIME_CHECK) {
-            // Check if we should auto-start or auto-stop
-            if (g_Settings.enableTimeRestriction) {
-                bool shouldBeJiggling = IsWithinTimeRange();
 
-                if (shouldBeJiggling && !g_IsJiggling) {
-                    // Auto-start: We're in time range but not jiggling
-                    StartJiggling();
-                    UpdateJigglingButton(hDlg);
-                }
-                else if (!shouldBeJiggling && g_IsJiggling) {
-                    // Auto-stop: We're outside time range but still jiggling
-                    StopJiggling();
-                    UpdateJigglingButton(hDlg);
-                }
+        Guest& guest = g_Guests[g_GuestCount++];
+        guest = Guest();
+        guest.session.host = &g_GuestHost;
+        _tcsncpy_s(guest.name, GUEST_NAME_LENGTH, section + prefixLength, _TRUNCATE);
+        memcpy(&guest.address, result->ai_addr, result->ai_addrlen);
+        guest.addressLength = (int)result->ai_addrlen;
+        FreeAddrInfoW(result);
+
+        int period = GetPrivateProfileInt(section, _T("JigglePeriod"), g_Settings.jigglePeriod, g_IniFilePath);
+        guest.session.jigglePeriod = period < 1 ? 1 : (period > 10800 ? 10800 : period);
+
+        TCHAR patternName[32];
+        GetPrivateProfileString(section, _T("JigglePattern"), g_JigglePatterns[0].name, patternName, 32, g_IniFilePath);
+        for (int i = 0; i < JIGGLE_PATTERN_COUNT; i++) {
+            if (_tcsicmp(patternName, g_JigglePatterns[i].name) == 0) {
+                guest.jigglePattern = i;
+                break;
             }
         }
-        break;
+    }
+}
 
-    case WM_TRAYICON:
-        if (lParam == WM_LBUTTONDBLCLK) {
-            RestoreFromTray();
-        } else if (lParam == WM_RBUTTONUP) {
-            POINT pt;
-            GetCursorPos(&pt);
+// Start a non-blocking connect; completion arrives as FD_CONNECT
+void ConnectGuest(Guest& guest) {
+    SOCKET guestSocket = socket(guest.address.ss_family, SOCK_STREAM, IPPROTO_TCP);
+    if (guestSocket == INVALID_SOCKET) {
+        guest.session.stats.errors++;
+        return;
+    }
 
-            // Create context menu
-            HMENU hMenu = CreatePopupMenu();
-            AppendMenu(hMenu, MF_STRING, ID_TRAY_OPEN, _T("Open"));
-            AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
+    BOOL noDelay = TRUE;
+    setsockopt(guestSocket, IPPROTO_TCP, TCP_NODELAY, (const char*)&noDelay, sizeof(noDelay));
 
-            if (!g_IsJiggling) {
-                AppendMenu(hMenu, MF_STRING, ID_TRAY_START, _T("Start Jiggling"));
-            } else {
-                AppendMenu(hMenu, MF_STRING, ID_TRAY_STOP, _T("Stop Jiggling"));
-            }
+    guest.session.Connecting((intptr_t)guestSocket);
+    WSAAsyncSelect(guestSocket, g_hMainDlg, WM_GUEST_SOCKET, FD_CONNECT | FD_READ | FD_CLOSE);
+    if (connect(guestSocket, (const sockaddr*)&guest.address, guest.addressLength) == SOCKET_ERROR &&
+        WSAGetLastError() != WSAEWOULDBLOCK) {
+        guest.session.stats.errors++;
+        guest.session.Disconnect();
+    }
+}
 
-            AppendMenu(hMenu, MF_SEPARATOR, 0, NULL);
-            AppendMenu(hMenu, MF_STRING, ID_TRAY_EXIT, _T("Exit"));
+// Send the next pattern step as one input-send-event carrying both axes
+void JiggleGuest(Guest& guest) {
+    const JigglePattern& pattern = g_JigglePatterns[guest.jigglePattern];
+    const JiggleStep& step = pattern.steps[guest.patternStep];
+    if (guest.session.Jiggle(step.dx, step.dy)) {
+        guest.patternStep = (guest.patternStep + 1) % pattern.stepCount;
+    }
+}
 
-            SetForegroundWindow(hDlg);
-            TrackPopupMenu(hMenu, TPM_BOTTOMALIGN | TPM_LEFTALIGN, pt.x, pt.y, 0, hDlg, NULL);
-            DestroyMenu(hMenu);
+// WM_GUEST_SOCKET: connect completion, replies and disconnects
+void OnGuestSocket(SOCKET socket, LPARAM lParam) {
+    GuestSession* session = NULL;
+    for (int i = 0; i < g_GuestCount; i++) {
+        if (g_Guests[i].session.connection == (intptr_t)socket) {
+            session = &g_Guests[i].session;
+            break;
         }
+    }
+    if (!session) return;   // Already closed
+
+    if (WSAGETSELECTERROR(lParam) != 0) {
+        session->stats.errors++;
+        session->Disconnect();
+        return;
+    }
+
+    switch (WSAGETSELECTEVENT(lParam)) {
+    case FD_CONNECT:
+        session->Connected();
+        if (g_GuestsRunning) ArmGuestTimer();   // Greeting timeout
         break;
 
-    case WM_CLOSE:
-        // X button minimizes to tray instead of closing
-        MinimizeToTray();
+    case FD_READ:
+        {
+            int received = recv(socket, session->ReceiveBuffer(), session->ReceiveSpace(), 0);
+            if (received <= 0) {
+                if (received == 0 || WSAGetLastError() != WSAEWOULDBLOCK) session->Disconnect();
+                return;
+            }
+            session->OnReceived(received);
+        }
         break;
 
-    case WM_DESTROY:
-        // Save all settings
-        SaveSettings();
+    case FD_CLOSE:
+        session->Disconnect();
+        break;
+    }
+}
 
-        // Kill timers
-        if (g_IsJiggling) {
-            KillTimer(hDlg, TIMER_JIGGLE);
-        }
-        if (g_Settings.enableTimeRestriction) {
-            KillTimer(hDlg, TIMER_TIME_CHECK);
+// Arm the guest timer for the earliest guest deadline, connect or reply timeout
+void ArmGuestTimer() {
+    ULONGLONG now = GuestClockMs();
+    ULONGLONG earliest = 0;
+    for (int i = 0; i < g_GuestCount; i++) {
+        if (earliest == 0 || g_Guests[i].session.nextDue < earliest) earliest = g_Guests[i].session.nextDue;
+
+        ULONGLONG replyDue = g_Guests[i].session.ReplyDue();
+        if (replyDue != 0 && replyDue < earliest) earliest = replyDue;
+    }
+    UINT delay = earliest > now ? (UINT)(earliest - now) : USER_TIMER_MINIMUM;
+    SetTimer(g_hMainDlg, TIMER_GUEST_KEEPALIVE, delay, NULL);
+}
+
+// TIMER_GUEST_KEEPALIVE: serve every guest whose deadline has passed in one pass
+void OnGuestTimer() {
+    MJ_TRACE_SCOPE("OnGuestTimer");
+    SubsystemScope scope(g_Resources, SUBSYSTEM_TIMER);
+    ULONGLONG now = GuestClockMs();
+
+    for (int i = 0; i < g_GuestCount; i++) {
+        Guest& guest = g_Guests[i];
+
+        // A stalled connect or wedged monitor is dropped and retried
+        if (guest.session.TimedOut(now)) {
+            OutputDebugString(_T("VM guest monitor did not connect or stopped answering; reconnecting"));
         }
 
-        // Remove tray icon
-        if (g_nid.hWnd) {
-            Shell_NotifyIcon(NIM_DELETE, &g_nid);
+        if (now < guest.session.nextDue) continue;
+
+        if (guest.session.state == GUEST_READY) {
+            JiggleGuest(guest);
+        } else if (guest.session.state == GUEST_DISCONNECTED) {
+            ConnectGuest(guest);    // Jiggles start on the next deadline
         }
+        guest.session.Reschedule(now);
+    }
+    ArmGuestTimer();
+}
 
-        PostQuitMessage(0);
-        break;
+// Start or stop guest keep-alive together with local jiggling
+void StartGuestKeepAlive() {
+    if (g_GuestCount == 0 || g_GuestsRunning) return;
+    g_GuestsRunning = true;
+
+    ULONGLONG now = GuestClockMs();
+    if (g_GuestsStartedAt == 0) g_GuestsStartedAt = now;
+    for (int i = 0; i < g_GuestCount; i++) {
+        g_Guests[i].session.nextDue = now;  // Connect (or jiggle) right away
     }
+    ArmGuestTimer();
+}
 
-    return FALSE;
+void StopGuestKeepAlive() {
+    if (!g_GuestsRunning) return;
+    g_GuestsRunning = false;
+    KillTimer(g_hMainDlg, TIMER_GUEST_KEEPALIVE);
+}
+
+// Stop keep-alive and close all guest connections
+void DisconnectGuests() {
+    StopGuestKeepAlive();
+    for (int i = 0; i < g_GuestCount; i++) {
+        g_Guests[i].session.Disconnect();
+    }
+}
+
+// Close all guest connections and stop Winsock
+void CloseGuests() {
+    DisconnectGuests();
+    if (g_WinsockStarted) {
+        WSACleanup();
+        g_WinsockStarted = false;
+    }
+}
+
+// Format per-guest statistics for the tray report and debug output
+void FormatGuestReport(TCHAR* buffer, size_t bufferSize) {
+    static const TCHAR* stateNames[4] = { _T("disconnected"), _T("connecting"), _T("negotiating"), _T("ready") };
+
+    ULONGLONG totalCommands = 0;
+    buffer[0] = _T('\0');
+    for (int i = 0; i < g_GuestCount; i++) {
+        const Guest& guest = g_Guests[i];
+        const GuestStats& stats = guest.session.stats;
+        double averageMs = stats.replies ? stats.latencyTotalUs / 1000.0 / stats.replies : 0.0;
+        double maxMs = stats.latencyMaxUs / 1000.0;
+
+        TCHAR line[256];
+        _stprintf_s(line, 256, _T("%s (%s, every %d s): %llu sent, %llu replies, %llu errors, %llu timeouts, latency avg %.2f ms, max %.2f ms\n"),
+            guest.name, stateNames[guest.session.state], guest.session.jigglePeriod,
+            stats.commandsSent, stats.replies, stats.errors, stats.timeouts, averageMs, maxMs);
+        _tcscat_s(buffer, bufferSize, line);
+        totalCommands += stats.commandsSent;
+    }
+
+    ULONGLONG elapsed = g_GuestsStartedAt ? GuestClockMs() - g_GuestsStartedAt : 0;
+    TCHAR total[128];
+    _stprintf_s(total, 128, _T("\nTotal: %llu commands, %.3f per second"),
+        totalCommands, elapsed ? totalCommands * 1000.0 / elapsed : 0.0);
+    _tcscat_s(buffer, bufferSize, total);
 }
 
-// Create single instance mutex
+// Create single instance mutex (one instance per session)
 bool CreateSingleInstanceMutex() {
-    HANDLE hMutex = CreateMutex(NULL, TRUE, _T("Global\\ArkaneSystems.MouseJiggler"));
+    HANDLE hMutex = CreateMutex(NULL, TRUE, _T("Local\\ArkaneSystems.MouseJiggler"));
     if (GetLastError() == ERROR_ALREADY_EXISTS) {
         if (hMutex) CloseHandle(hMutex);
 
@@ -869,11 +2876,188 @@ bool CreateSingleInstanceMutex() {
     return true;
 }
 
+// Injection probe (--probe): measures how long a jiggle takes from PerformJiggle
+// to the low-level mouse hook, and whether it resets the system idle timer.
+#define PROBE_MAX_SAMPLES       1000
+#define PROBE_TIMEOUT_MS        250     // Count an event as dropped if not seen by then
+#define PROBE_SPACING_MS        50      // Gap between samples, so GetLastInputInfo ticks advance
+
+struct ProbeState {
+    LONGLONG frequency;
+    volatile LONGLONG observedAt;       // QPC of the hook seeing our event, 0 while waiting
+} g_Probe = { 0, 0 };
+
+LRESULT CALLBACK ProbeMouseHookProc(int nCode, WPARAM wParam, LPARAM lParam) {
+    if (nCode == HC_ACTION && wParam == WM_MOUSEMOVE) {
+        const MSLLHOOKSTRUCT* info = (const MSLLHOOKSTRUCT*)lParam;
+        if ((info->flags & LLMHF_INJECTED) && info->dwExtraInfo == JIGGLE_EXTRA_INFO && g_Probe.observedAt == 0) {
+            LARGE_INTEGER now;
+            QueryPerformanceCounter(&now);
+            g_Probe.observedAt = now.QuadPart;
+        }
+    }
+    return CallNextHookEx(NULL, nCode, wParam, lParam);
+}
+
+// Pump messages (the hook runs on this thread) until the hook fires or the timeout elapses
+void ProbeWait(DWORD timeoutMs, bool stopWhenObserved) {
+    ULONGLONG deadline = GetTickCount64() + timeoutMs;
+    for (;;) {
+        MSG msg;
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            DispatchMessage(&msg);
+        }
+        if (stopWhenObserved && g_Probe.observedAt != 0) {
+            return;
+        }
+
+        ULONGLONG now = GetTickCount64();
+        if (now >= deadline) {
+            return;
+        }
+        MsgWaitForMultipleObjects(0, NULL, FALSE, (DWORD)(deadline - now), QS_ALLINPUT);
+    }
+}
+
+int CompareLatency(const void* a, const void* b) {
+    LONGLONG x = *(const LONGLONG*)a;
+    LONGLONG y = *(const LONGLONG*)b;
+    return (x > y) - (x < y);
+}
+
+// Inject 'samples' jiggles of zen and of each pattern in g_JigglePatterns (stepping
+// through its moves) via the selected input sink, and write MouseJiggler-probe.txt
+void RunInjectionProbe(int samples) {
+    static LONGLONG latencies[PROBE_MAX_SAMPLES];
+
+    if (samples < 1) samples = 1;
+    if (samples > PROBE_MAX_SAMPLES) samples = PROBE_MAX_SAMPLES;
+
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    g_Probe.frequency = frequency.QuadPart;
+
+    HHOOK hHook = SetWindowsHookEx(WH_MOUSE_LL, ProbeMouseHookProc, g_hInst, 0);
+
+    TCHAR report[2048];
+    _stprintf_s(report, 2048,
+        _T("Mouse Jiggler injection probe: %d samples per movement type via %hs sink%s\r\n")
+        _T("type     observed  registered    p50 us    p90 us    p99 us    max us\r\n"),
+        samples, g_InputSink.name, hHook ? _T("") : _T(" (mouse hook unavailable, latencies not measured)"));
+
+    // Zen first, then every pattern
+    for (int type = 0; type <= JIGGLE_PATTERN_COUNT; type++) {
+        const JigglePattern* pattern = (type == 0) ? &g_ZenPattern : &g_JigglePatterns[type - 1];
+        int observed = 0;
+        int registered = 0;
+
+        for (int i = 0; i < samples; i++) {
+            LASTINPUTINFO before = { sizeof(LASTINPUTINFO), 0 };
+            LASTINPUTINFO after = { sizeof(LASTINPUTINFO), 0 };
+            GetLastInputInfo(&before);
+
+            g_Probe.observedAt = 0;
+            LARGE_INTEGER injectedAt;
+            QueryPerformanceCounter(&injectedAt);
+            const JiggleStep& step = pattern->steps[i % pattern->stepCount];
+            PerformJiggle(step.dx, step.dy);
+
+            ProbeWait(PROBE_TIMEOUT_MS, true);
+            if (g_Probe.observedAt != 0) {
+                latencies[observed++] = (g_Probe.observedAt - injectedAt.QuadPart) * 1000000 / g_Probe.frequency;
+            }
+
+            GetLastInputInfo(&after);
+            if (after.dwTime != before.dwTime) {
+                registered++;
+            }
+
+            ProbeWait(PROBE_SPACING_MS, false);
+        }
+
+        TCHAR line[160];
+        if (observed > 0) {
+            qsort(latencies, observed, sizeof(LONGLONG), CompareLatency);
+            _stprintf_s(line, 160, _T("%-8s %4d/%-4d  %4d/%-4d  %8lld  %8lld  %8lld  %8lld\r\n"),
+                pattern->name, observed, samples, registered, samples,
+                latencies[observed * 50 / 100], latencies[observed * 90 / 100],
+                latencies[observed * 99 / 100], latencies[observed - 1]);
+        } else {
+            _stprintf_s(line, 160, _T("%-8s %4d/%-4d  %4d/%-4d         -         -         -         -\r\n"),
+                pattern->name, observed, samples, registered, samples);
+        }
+        _tcscat_s(report, 2048, line);
+    }
+
+    if (hHook) UnhookWindowsHookEx(hHook);
+
+    OutputDebugString(report);
+
+    // Write the report next to the INI file
+    TCHAR reportPath[MAX_PATH];
+    _tcscpy_s(reportPath, MAX_PATH, g_IniFilePath);
+    TCHAR* extension = _tcsrchr(reportPath, _T('.'));
+    if (extension) {
+        *extension = _T('\0');
+    }
+    _tcscat_s(reportPath, MAX_PATH, _T("-probe.txt"));
+
+    char utf8[4096];
+    int length = WideCharToMultiByte(CP_UTF8, 0, report, -1, utf8, sizeof(utf8), NULL, NULL);
+    HANDLE hFile = CreateFile(reportPath, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (hFile != INVALID_HANDLE_VALUE) {
+        DWORD written;
+        if (length > 0) WriteFile(hFile, utf8, (DWORD)(length - 1), &written, NULL);
+        CloseHandle(hFile);
+    }
+}
+
+// Tracing (--trace <file>, Trace.h): open the trace file and start the writer thread
+bool StartTracing(const TCHAR* path) {
+    FILE* file = NULL;
+    if (_tfopen_s(&file, path, _T("wb")) != 0 || !file) {
+        OutputDebugString(_T("Failed to create trace file"));
+        return false;
+    }
+    if (!TraceStart(file, GetCurrentProcessId())) {
+        OutputDebugString(_T("Failed to start trace writer"));
+        fclose(file);
+        return false;
+    }
+    return true;
+}
+
 // Parse command line arguments
 void ParseCommandLine() {
     int argc;
     LPWSTR* argv = CommandLineToArgvW(GetCommandLineW(), &argc);
 
+    // Jiggle setting overrides first, so they apply wherever they appear (see ApplyCommandLineOverrides)
+    for (int i = 1; i < argc; i++) {
+        if (_tcscmp(argv[i], _T("-z")) == 0 || _tcscmp(argv[i], _T("--zen")) == 0) {
+            g_CommandLine.zenJiggle = true;
+        }
+        else if (_tcscmp(argv[i], _T("-a")) == 0 || _tcscmp(argv[i], _T("--adaptive")) == 0) {
+            g_CommandLine.adaptiveJiggle = true;
+        }
+        else if (_tcscmp(argv[i], _T("-s")) == 0 || _tcscmp(argv[i], _T("--seconds")) == 0) {
+            if (i + 1 < argc) {
+                int seconds = _ttoi(argv[i + 1]);
+                if (seconds >= 1 && seconds <= 10800) {
+                    g_CommandLine.jigglePeriod = seconds;
+                }
+                i++;
+            }
+        }
+        else if (_tcscmp(argv[i], _T("-p")) == 0 || _tcscmp(argv[i], _T("--profile")) == 0) {
+            if (i + 1 < argc) {
+                _tcsncpy_s(g_CommandLine.profile, PROFILE_NAME_LENGTH, argv[i + 1], _TRUNCATE);
+                i++;
+            }
+        }
+    }
+    ApplyCommandLineOverrides();
+
     for (int i = 1; i < argc; i++) {
         if (_tcscmp(argv[i], _T("-j")) == 0 || _tcscmp(argv[i], _T("--jiggle")) == 0) {
             g_Settings.startJiggling = true;
@@ -881,17 +3065,36 @@ void ParseCommandLine() {
         else if (_tcscmp(argv[i], _T("-m")) == 0 || _tcscmp(argv[i], _T("--minimized")) == 0) {
             g_Settings.minimizeOnStartup = true;
         }
-        else if (_tcscmp(argv[i], _T("-z")) == 0 || _tcscmp(argv[i], _T("--zen")) == 0) {
-            g_Settings.zenJiggle = true;
+        else if (_tcscmp(argv[i], _T("-s")) == 0 || _tcscmp(argv[i], _T("--seconds")) == 0 ||
+                 _tcscmp(argv[i], _T("-p")) == 0 || _tcscmp(argv[i], _T("--profile")) == 0) {
+            i++;    // Applied above
         }
-        else if (_tcscmp(argv[i], _T("-s")) == 0 || _tcscmp(argv[i], _T("--seconds")) == 0) {
+#ifdef _DEBUG
+        else if (_tcscmp(argv[i], _T("--alloc-guard")) == 0) {
+            g_AllocationGuardExitCode = true;
+        }
+#endif
+        else if (_tcscmp(argv[i], _T("--trace")) == 0) {
             if (i + 1 < argc) {
-                int seconds = _ttoi(argv[i + 1]);
-                if (seconds >= 1 && seconds <= 10800) {
-                    g_Settings.jigglePeriod = seconds;
-                }
+                StartTracing(argv[i + 1]);
+                i++;
+            }
+        }
+        else if (_tcscmp(argv[i], _T("--probe")) == 0) {
+            int samples = 100;
+            if (i + 1 < argc) {
+                samples = _ttoi(argv[i + 1]);
                 i++;
             }
+            RunInjectionProbe(samples);
+            UnloadInputSink();
+            TraceStop();
+            ExitProcess(0);
+        }
+        else if (_tcscmp(argv[i], _T("-l")) == 0 || _tcscmp(argv[i], _T("--list")) == 0) {
+            ShowInstanceStatus();
+            TraceStop();
+            ExitProcess(0);
         }
         else if (_tcscmp(argv[i], _T("-h")) == 0 || _tcscmp(argv[i], _T("--help")) == 0 || _tcscmp(argv[i], _T("-?")) == 0) {
             MessageBox(NULL,
@@ -900,10 +3103,16 @@ void ParseCommandLine() {
                 _T("  -j, --jiggle               Start with jiggling enabled\n")
                 _T("  -m, --minimized            Start minimized\n")
                 _T("  -z, --zen                  Start with zen (invisible) jiggling enabled\n")
+                _T("  -a, --adaptive             Verify jiggles and only inject what keeps the machine awake\n")
                 _T("  -s, --seconds <seconds>    Set number of seconds for the jiggle interval\n")
+                _T("  -p, --profile <name>       Use the named profile from MouseJiggler.ini\n")
+                _T("  -l, --list                 List running instances in all sessions\n")
+                _T("      --probe <samples>      Measure injection latency and write MouseJiggler-probe.txt\n")
+                _T("      --trace <file>         Record a Chrome trace-event JSON file while running\n")
                 _T("  -?, -h, --help             Show help and usage information\n"),
                 _T("Mouse Jiggler - Help"),
                 MB_OK | MB_ICONINFORMATION);
+            TraceStop();
             ExitProcess(0);
         }
     }
@@ -922,6 +3131,15 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     UNREFERENCED_PARAMETER(nCmdShow);
 
     g_hInst = hInstance;
+    g_Resources.host = &g_ResourceHost;     // Settings I/O is accounted from the start
+
+    // Initialize INI file path and load settings
+    InitializeIniPath();
+    LoadSettings();
+    LoadInputSink();
+
+    // Parse command line (informational switches exit here, even while another instance runs)
+    ParseCommandLine();
 
     // Check for single instance
     if (!CreateSingleInstanceMutex()) {
@@ -929,6 +3147,7 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
             _T("Mouse Jiggler is already running. Aborting."),
             _T("Mouse Jiggler"),
             MB_OK | MB_ICONWARNING);
+        TraceStop();
         return 1;
     }
 
@@ -941,31 +3160,86 @@ int APIENTRY wWinMain(_In_ HINSTANCE hInstance,
     // Register TaskbarCreated message for explorer.exe restart detection
     g_uTaskbarCreated = RegisterWindowMessage(_T("TaskbarCreated"));
 
-    // Initialize INI file path and load settings
-    InitializeIniPath();
-    LoadSettings();
+    // Recover runtime state of a previous run (jiggling, cadence, counters)
+    LoadRuntimeState();
 
-    // Parse command line
-    ParseCommandLine();
+    // Publish this instance to the machine-wide registry
+    OpenInstanceRegistry();
+
+    // VM guests to keep alive over QMP while jiggling
+    LoadGuests();
+
+    // Environment of the scheduler tasks (jiggle, time window) and of injection
+    g_Scheduler.host.now = GetSchedulerClockMs;
+    g_Scheduler.host.idleTime = GetSchedulerIdleMs;
+    g_Scheduler.host.windowOpen = IsTimeWindowOpenAt;
+    g_Jiggle.scheduler = &g_Scheduler;
+    g_Jiggle.host = &g_JiggleHost;
+    g_Injection.host = &g_InjectionHost;
+    g_Status.host = &g_StatusHost;
+    g_ButtonFaces.host = &g_ButtonFaceHost;
 
     // Create main dialog
     HWND hDlg = CreateDialogParam(hInstance, MAKEINTRESOURCE(IDD_MAINDIALOG), NULL, MainDialogProc, 0);
 
     if (!hDlg) {
         MessageBox(NULL, _T("Failed to create main dialog"), _T("Error"), MB_OK | MB_ICONERROR);
+        TraceStop();
         return 1;
     }
 
     ShowWindow(hDlg, SW_SHOW);
 
-    // Message loop
-    MSG msg;
-    while (GetMessage(&msg, NULL, 0, 0)) {
-        if (!IsDialogMessage(hDlg, &msg)) {
-            TranslateMessage(&msg);
-            DispatchMessage(&msg);
+    // Reload settings when MouseJiggler.ini is edited externally
+    StartSettingsWatch();
+
+#ifdef _DEBUG
+    // Startup is done; from here on the CRT heap should not be used
+    _CrtSetAllocHook(AllocationGuardHook);
+    CountGuardObjects(&g_GuardObjectsArmed);
+    g_AllocationGuardArmed = true;
+#endif
+
+    // Message loop: sleeps until a message arrives or the settings directory changes
+    MSG msg = { 0 };
+    bool running = true;
+    while (running) {
+        DWORD handleCount = g_hSettingsChange ? 1 : 0;
+        DWORD wait = MsgWaitForMultipleObjectsEx(handleCount, &g_hSettingsChange, INFINITE, QS_ALLINPUT, MWMO_INPUTAVAILABLE);
+        if (handleCount && wait == WAIT_OBJECT_0) {
+            OnSettingsFileChanged();
+            continue;
+        }
+
+        while (PeekMessage(&msg, NULL, 0, 0, PM_REMOVE)) {
+            if (msg.message == WM_QUIT) {
+                running = false;
+                break;
+            }
+            if (!IsDialogMessage(hDlg, &msg)) {
+                TranslateMessage(&msg);
+                DispatchMessage(&msg);
+            }
         }
     }
 
+#ifdef _DEBUG
+    g_AllocationGuardArmed = false;
+    {
+        TCHAR report[256];
+        _stprintf_s(report, 256, _T("Allocation guard: %ld CRT heap allocations after startup; grew by %lu GDI, %lu USER, %lu kernel objects"),
+            g_AllocationsAfterInit, g_GuardObjectGrowth.gdiObjects, g_GuardObjectGrowth.userObjects, g_GuardObjectGrowth.handleCount);
+        OutputDebugString(report);
+    }
+    bool objectsGrew = g_GuardObjectGrowth.gdiObjects > 0 || g_GuardObjectGrowth.userObjects > 0 ||
+                       g_GuardObjectGrowth.handleCount > 0;
+    if (g_AllocationGuardExitCode && (g_AllocationsAfterInit > 0 || objectsGrew)) {
+        TraceStop();
+        return 3;
+    }
+#endif
+
+    TraceStop();
+
     return (int)msg.wParam;
 }
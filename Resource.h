@@ -47,17 +47,23 @@
 #define ID_TRAY_START                   2002
 #define ID_TRAY_STOP                    2003
 #define ID_TRAY_EXIT                    2004
+#define ID_TRAY_RESOURCES               2005
+#define ID_TRAY_GUESTS                  2006
+#define ID_TRAY_PROFILE_FIRST           2100
 
 #define WM_TRAYICON                     (WM_USER + 1)
-#define TIMER_JIGGLE                    1
-#define TIMER_TIME_CHECK                2
+#define WM_GUEST_SOCKET                 (WM_APP + 1)
+#define WM_TASK_FAILED                  (WM_APP + 2)
+#define TIMER_SCHEDULER                 1
+#define TIMER_RESOURCE_SAMPLE           3
+#define TIMER_GUEST_KEEPALIVE           5
 
 // Next default values for new objects
 //
 #ifdef APSTUDIO_INVOKED
 #ifndef APSTUDIO_READONLY_SYMBOLS
 #define _APS_NEXT_RESOURCE_VALUE        104
-#define _APS_NEXT_COMMAND_VALUE         2005
+#define _APS_NEXT_COMMAND_VALUE         2007
 #define _APS_NEXT_CONTROL_VALUE         1032
 #define _APS_NEXT_SYMED_VALUE           101
 #endif
@@ -0,0 +1,111 @@
+// MouseJiggler - Resource monitor
+//
+// Samples the process's handle counts, memory and CPU time every few minutes
+// and compares them with the first sample, raising an alert when the handles
+// grow past a threshold (a leak). CPU time on the UI thread (the daemon's only
+// thread on Linux) is split by subsystem: scopes switch the subsystem being
+// charged, and the thread's CPU clock (cycles on Windows, ns on Linux) is charged
+// exclusively to the innermost one. The platform supplies the samples and the
+// clocks through ResourceHost (Win32 calls in Main.cpp, /proc in
+// linux/ProcResources.h), so the tests run the same accounting.
+
+#pragma once
+
+#include <stdint.h>
+
+#define SUBSYSTEM_NONE          -1
+#define SUBSYSTEM_TIMER         0   // Jiggle deadlines and schedule checks
+#define SUBSYSTEM_PAINT         1   // Owner-draw button
+#define SUBSYSTEM_SETTINGS      2   // INI file I/O
+#define SUBSYSTEM_TRAY          3   // Tooltip and tray menu (the control socket on Linux)
+#define SUBSYSTEM_COUNT         4
+
+#define RESOURCE_SAMPLE_MS          (5 * 60 * 1000)
+#define RESOURCE_GDI_ALERT_GROWTH   200     // GDI objects above the baseline
+#define RESOURCE_USER_ALERT_GROWTH  200     // USER objects above the baseline
+#define RESOURCE_HANDLE_ALERT_GROWTH 500    // Kernel handles (file descriptors on Linux) above the baseline
+
+struct ResourceSample {
+    uint32_t gdiObjects;    // 0 where the platform has none
+    uint32_t userObjects;
+    uint32_t handleCount;
+    uint64_t workingSet;    // bytes
+    uint64_t privateBytes;  // bytes
+    uint64_t cpuTime;       // ms, user + kernel, whole process
+};
+
+// What the monitor needs from the platform
+struct ResourceHost {
+    bool (*sample)(ResourceSample* out);
+    uint64_t (*threadClock)();      // Calling thread's CPU clock, in any unit
+    double (*threadCpuMs)();        // The same thread's CPU time in ms, to convert that unit
+};
+
+struct ResourceMonitor {
+    const ResourceHost* host = nullptr;
+    ResourceSample baseline = {};
+    ResourceSample latest = {};
+    bool baselineTaken = false;
+    bool alert = false;
+    uint32_t samples = 0;
+    uint64_t subsystemTicks[SUBSYSTEM_COUNT] = {};  // threadClock units
+    double subsystemMs[SUBSYSTEM_COUNT] = {};       // As of the latest sample
+    int currentSubsystem = SUBSYSTEM_NONE;
+    uint64_t subsystemSince = 0;
+
+    // Charge the clock since the last switch to the current subsystem, then switch
+    void SwitchSubsystem(int next) {
+        uint64_t now = host->threadClock();
+        if (currentSubsystem != SUBSYSTEM_NONE) {
+            subsystemTicks[currentSubsystem] += now - subsystemSince;
+        }
+        currentSubsystem = next;
+        subsystemSince = now;
+    }
+
+    // CPU time charged to each subsystem so far, in ms (call on the accounted thread)
+    void SubsystemMs(double ms[SUBSYSTEM_COUNT]) const {
+        uint64_t ticks = host->threadClock();
+        double threadMs = host->threadCpuMs();
+        for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+            ms[i] = ticks ? (double)subsystemTicks[i] * threadMs / (double)ticks : 0.0;
+        }
+    }
+
+    // Take a sample; the first one is the baseline. Returns true when the alert
+    // is newly raised (it clears again once the counts fall back).
+    bool Sample() {
+        ResourceSample sample = {};
+        if (!host->sample(&sample)) {
+            return false;
+        }
+        latest = sample;
+        samples++;
+        SubsystemMs(subsystemMs);
+
+        if (!baselineTaken) {
+            baseline = latest;
+            baselineTaken = true;
+        }
+
+        bool wasAlert = alert;
+        alert = latest.gdiObjects > baseline.gdiObjects + RESOURCE_GDI_ALERT_GROWTH ||
+            latest.userObjects > baseline.userObjects + RESOURCE_USER_ALERT_GROWTH ||
+            latest.handleCount > baseline.handleCount + RESOURCE_HANDLE_ALERT_GROWTH;
+        return alert && !wasAlert;
+    }
+};
+
+// Charges the enclosed code to a subsystem, then returns to the enclosing one
+struct SubsystemScope {
+    ResourceMonitor& monitor;
+    int previous;
+
+    SubsystemScope(ResourceMonitor& resourceMonitor, int subsystem)
+        : monitor(resourceMonitor), previous(resourceMonitor.currentSubsystem) {
+        monitor.SwitchSubsystem(subsystem);
+    }
+    ~SubsystemScope() {
+        monitor.SwitchSubsystem(previous);
+    }
+};
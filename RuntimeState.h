@@ -0,0 +1,77 @@
+// MouseJiggler - Runtime state records
+//
+// Runtime state persisted in MouseJiggler.state so a restarted process (logoff,
+// update, crash) resumes where the previous one left off. The file is mapped and
+// holds two records written alternately; each carries a sequence number and a
+// checksum, so a torn write only ever damages the record being replaced and
+// recovery picks the newest record that still checks out. The record logic is
+// plain C++ (no Win32), so the tests can tear writes at every byte.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define STATE_MAGIC             0x534A4A4D  // 'MJJS'
+#define STATE_VERSION           2
+
+struct RuntimeRecord {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sequence;
+    uint32_t isJiggling;
+    uint32_t patternStep;
+    uint64_t nextJiggleDue;     // ms, UTC FILETIME epoch
+    uint64_t jigglesSent;
+    uint64_t jiggleFailures;
+    uint64_t savedAt;           // ms, UTC FILETIME epoch
+    uint32_t checksum;          // FNV-1a over every byte before this field
+    uint32_t reserved;
+};
+
+struct RuntimeStateFile {
+    RuntimeRecord records[2];
+};
+
+// FNV-1a checksum of a runtime record, excluding the checksum field itself
+inline uint32_t RuntimeRecordChecksum(const RuntimeRecord* record) {
+    const uint8_t* bytes = (const uint8_t*)record;
+    size_t length = offsetof(RuntimeRecord, checksum);
+
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; i++) {
+        hash ^= bytes[i];
+        hash *= 16777619u;
+    }
+    return hash;
+}
+
+// Newest record whose checksum is intact, or NULL. *tornCount receives the number
+// of records of the current version that failed their checksum.
+inline const RuntimeRecord* SelectRuntimeRecord(const RuntimeStateFile* file, int* tornCount) {
+    const RuntimeRecord* newest = NULL;
+    *tornCount = 0;
+
+    for (int i = 0; i < 2; i++) {
+        const RuntimeRecord* record = &file->records[i];
+        if (record->magic != STATE_MAGIC || record->version != STATE_VERSION) continue;
+        if (record->checksum != RuntimeRecordChecksum(record)) {
+            (*tornCount)++;
+            continue;
+        }
+        if (!newest || record->sequence > newest->sequence) {
+            newest = record;
+        }
+    }
+    return newest;
+}
+
+// Seal a record (magic, version, checksum) and write it over the older of the two
+// records, which is the one its sequence number selects
+inline void StoreRuntimeRecord(RuntimeStateFile* file, RuntimeRecord* record) {
+    record->magic = STATE_MAGIC;
+    record->version = STATE_VERSION;
+    record->checksum = RuntimeRecordChecksum(record);
+    memcpy(&file->records[record->sequence % 2], record, sizeof(RuntimeRecord));
+}
@@ -0,0 +1,280 @@
+// MouseJiggler - Coroutine scheduler
+//
+// A single-threaded executor for C++20 coroutines. Jiggle sequences and schedules
+// are written as plain loops that co_await sleep_until, idle_for, next_window_open
+// or next_window_close, and the host resumes them from one timer by calling Run().
+// Task frames come from a fixed pool, so running tasks never touch the heap. The
+// environment (clock, idle time, time window) is supplied by the host through
+// SchedulerHost, so the tests drive the same code with a virtual clock.
+
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <stddef.h>
+#include <stdint.h>
+
+#define SCHEDULER_MAX_TASKS     4           // Concurrent tasks (one pooled frame each)
+#define SCHEDULER_FRAME_SIZE    2048        // Bytes per pooled frame
+#define SCHEDULER_NEVER         UINT64_MAX  // Wake time of a wait that only a change of state can end
+
+static_assert(SCHEDULER_MAX_TASKS <= 16, "task ids keep the slot in 4 bits");
+
+// Environment of the tasks. Times are ms on the host's clock.
+struct SchedulerHost {
+    uint64_t (*now)();
+    uint64_t (*idleTime)();                                 // How long the user has been idle
+    bool (*windowOpen)(uint64_t now, uint64_t* nextChange); // Time window state; *nextChange receives
+                                                            // when it can next change (or SCHEDULER_NEVER)
+};
+
+// Frame pool shared by all schedulers (operator new of a promise cannot see its scheduler)
+struct SchedulerFramePool {
+    alignas(__STDCPP_DEFAULT_NEW_ALIGNMENT__) unsigned char frames[SCHEDULER_MAX_TASKS][SCHEDULER_FRAME_SIZE];
+    bool used[SCHEDULER_MAX_TASKS];
+    uint32_t refused;           // Frames refused (pool exhausted or frame too large)
+};
+
+inline SchedulerFramePool g_SchedulerFrames = {};
+
+struct Scheduler;
+
+// A coroutine run by the scheduler. It starts suspended; Scheduler::Spawn adopts it.
+struct SchedulerTask {
+    struct promise_type {
+        Scheduler* scheduler = nullptr;
+        int slot = -1;
+
+        static void* operator new(size_t size) noexcept {
+            if (size <= SCHEDULER_FRAME_SIZE) {
+                for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+                    if (!g_SchedulerFrames.used[i]) {
+                        g_SchedulerFrames.used[i] = true;
+                        return g_SchedulerFrames.frames[i];
+                    }
+                }
+            }
+            g_SchedulerFrames.refused++;
+            return nullptr;
+        }
+
+        static void operator delete(void* frame) noexcept {
+            size_t i = ((unsigned char*)frame - &g_SchedulerFrames.frames[0][0]) / SCHEDULER_FRAME_SIZE;
+            g_SchedulerFrames.used[i] = false;
+        }
+
+        static SchedulerTask get_return_object_on_allocation_failure() noexcept {
+            return SchedulerTask(nullptr);
+        }
+
+        SchedulerTask get_return_object() noexcept {
+            return SchedulerTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        void return_void() noexcept {}
+        void unhandled_exception() noexcept { std::terminate(); }
+    };
+
+    typedef std::coroutine_handle<promise_type> Handle;
+
+    explicit SchedulerTask(Handle handle) noexcept : handle(handle) {}
+    SchedulerTask(SchedulerTask&& other) noexcept : handle(other.handle) { other.handle = nullptr; }
+    SchedulerTask(const SchedulerTask&) = delete;
+    SchedulerTask& operator=(const SchedulerTask&) = delete;
+
+    ~SchedulerTask() {
+        if (handle) handle.destroy();   // Never spawned
+    }
+
+    Handle handle;
+};
+
+// Condition of a wait: returns 0 once it holds, otherwise the time to check again
+typedef uint64_t (*SchedulerPoll)(const SchedulerHost* host, uint64_t arg, uint64_t now);
+
+// Awaitable returned by sleep_until, idle_for, next_window_open and next_window_close
+struct SchedulerWait {
+    SchedulerPoll poll;
+    uint64_t arg;
+
+    bool await_ready() const noexcept { return false; }
+    inline bool await_suspend(SchedulerTask::Handle handle) noexcept;
+    void await_resume() const noexcept {}
+};
+
+struct Scheduler {
+    struct Slot {
+        SchedulerTask::Handle handle;   // Null: free
+        uint32_t id;                    // Identifies this task to Cancel
+        SchedulerPoll poll;             // What the task waits for
+        uint64_t arg;
+        uint64_t wakeAt;                // Last poll result
+        bool resuming;                  // On the stack right now; cannot be destroyed yet
+        bool cancelled;                 // Destroy as soon as it is off the stack
+    };
+
+    SchedulerHost host = {};
+    Slot slots[SCHEDULER_MAX_TASKS] = {};
+    uint32_t nextId = 0;
+    uint64_t resumes = 0;               // Task resumptions, for overhead accounting
+
+    ~Scheduler() {
+        for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+            if (slots[i].handle) Release(slots[i]);
+        }
+    }
+
+    // Adopt a task and run it up to its first wait. Returns its id, or 0 if the
+    // frame pool or the task table is full (the task is then discarded).
+    uint32_t Spawn(SchedulerTask task) {
+        if (!task.handle) return 0;
+
+        for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+            Slot& slot = slots[i];
+            if (slot.handle) continue;
+
+            nextId = (nextId + 1) & 0x0FFFFFFF;
+            if (nextId == 0) nextId = 1;
+            slot.handle = task.handle;
+            slot.id = (nextId << 4) | (uint32_t)i;
+            slot.poll = nullptr;
+            slot.wakeAt = 0;
+            slot.resuming = false;
+            slot.cancelled = false;
+            task.handle = nullptr;
+
+            slot.handle.promise().scheduler = this;
+            slot.handle.promise().slot = i;
+            uint32_t id = slot.id;
+            Resume(i);
+            return id;
+        }
+        return 0;
+    }
+
+    // Destroy a task (no-op for 0 or a task that has already finished). A task that
+    // is on the stack, e.g. the one calling Cancel, is destroyed at its next wait.
+    void Cancel(uint32_t id) {
+        if (id == 0) return;
+
+        Slot& slot = slots[id & 0x0F];
+        if (!slot.handle || slot.id != id) return;
+
+        if (slot.resuming) {
+            slot.cancelled = true;
+        } else {
+            Release(slot);
+        }
+    }
+
+    // Resume every task whose wait is over; returns the earliest time a task needs
+    // to be checked again, or SCHEDULER_NEVER. Call it when that time comes and
+    // whenever the state behind a wait may have changed (settings, wall clock).
+    uint64_t Run() {
+        for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+            Slot& slot = slots[i];
+            if (!slot.handle || slot.resuming) continue;
+
+            slot.wakeAt = slot.poll(&host, slot.arg, host.now());
+            if (slot.wakeAt == 0) {
+                Resume(i);
+            }
+        }
+        return NextWake();
+    }
+
+    // Earliest wake time of the waiting tasks, without resuming any
+    uint64_t NextWake() const {
+        uint64_t next = SCHEDULER_NEVER;
+        for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+            const Slot& slot = slots[i];
+            if (slot.handle && !slot.resuming && slot.wakeAt < next) {
+                next = slot.wakeAt;
+            }
+        }
+        return next;
+    }
+
+    // Called by SchedulerWait: record what the task waits for. Returns false if the
+    // wait is already over and the task should carry on without suspending.
+    bool Wait(int i, SchedulerPoll poll, uint64_t arg) {
+        Slot& slot = slots[i];
+        slot.poll = poll;
+        slot.arg = arg;
+        if (slot.cancelled) {
+            slot.wakeAt = SCHEDULER_NEVER;
+            return true;
+        }
+        slot.wakeAt = poll(&host, arg, host.now());
+        return slot.wakeAt != 0;
+    }
+
+private:
+    void Resume(int i) {
+        Slot& slot = slots[i];
+        slot.resuming = true;
+        slot.handle.resume();
+        slot.resuming = false;
+        resumes++;
+
+        if (slot.handle.done() || slot.cancelled) {
+            Release(slot);
+        }
+    }
+
+    static void Release(Slot& slot) {
+        slot.handle.destroy();
+        slot.handle = nullptr;
+        slot.id = 0;
+        slot.cancelled = false;
+    }
+};
+
+inline bool SchedulerWait::await_suspend(SchedulerTask::Handle handle) noexcept {
+    SchedulerTask::promise_type& promise = handle.promise();
+    return promise.scheduler->Wait(promise.slot, poll, arg);
+}
+
+inline uint64_t SchedulerPollSleep(const SchedulerHost* host, uint64_t deadline, uint64_t now) {
+    (void)host;
+    return now >= deadline ? 0 : deadline;
+}
+
+inline uint64_t SchedulerPollIdle(const SchedulerHost* host, uint64_t idleMs, uint64_t now) {
+    uint64_t idle = host->idleTime();
+    return idle >= idleMs ? 0 : now + (idleMs - idle);
+}
+
+inline uint64_t SchedulerPollWindowOpen(const SchedulerHost* host, uint64_t arg, uint64_t now) {
+    (void)arg;
+    uint64_t nextChange = SCHEDULER_NEVER;
+    return host->windowOpen(now, &nextChange) ? 0 : nextChange;
+}
+
+inline uint64_t SchedulerPollWindowClose(const SchedulerHost* host, uint64_t arg, uint64_t now) {
+    (void)arg;
+    uint64_t nextChange = SCHEDULER_NEVER;
+    return host->windowOpen(now, &nextChange) ? nextChange : 0;
+}
+
+// Resume at 'deadline' (host clock) or right away if it has passed
+inline SchedulerWait sleep_until(uint64_t deadline) {
+    return SchedulerWait{ SchedulerPollSleep, deadline };
+}
+
+// Resume once the user has been idle for at least idleMs
+inline SchedulerWait idle_for(uint64_t idleMs) {
+    return SchedulerWait{ SchedulerPollIdle, idleMs };
+}
+
+// Resume once the time window is open (right away if it is)
+inline SchedulerWait next_window_open() {
+    return SchedulerWait{ SchedulerPollWindowOpen, 0 };
+}
+
+// Resume once the time window is closed (right away if it is)
+inline SchedulerWait next_window_close() {
+    return SchedulerWait{ SchedulerPollWindowClose, 0 };
+}
@@ -0,0 +1,162 @@
+// MouseJiggler - Status model
+//
+// The values the tray tooltip, play/pause button, period label and instance
+// registry display. Every field remembers the model version at which it last
+// changed; each view remembers the version it last rendered, so a view only
+// does work when one of the fields it shows has actually changed. The views are
+// drawn through StatusHost, so Main.cpp and the tests run the same tracking.
+
+#pragma once
+
+#include <stdint.h>
+
+// The displayed values, as taken from the settings and jiggling state
+struct StatusValues {
+    bool isJiggling;
+    bool zenJiggle;
+    int jigglePeriod;               // s
+    bool enableTimeRestriction;
+    int startMinutes;               // Minutes after midnight
+    int endMinutes;
+    uint32_t enabledDaysMask;       // Bit 0 = Sunday
+    bool resourceAlert;
+    uint32_t resourceSamples;       // Resource samples taken (the tooltip shows the latest CPU split)
+};
+
+// What the views need from the application. The callbacks read the model
+// through the application's StatusTracker.
+struct StatusHost {
+    bool (*hasTrayIcon)();
+    bool (*hasDialog)();
+    void (*buildScheduleText)();    // Cache the time range and days for the tooltip
+    bool (*setTooltip)();           // Rebuild the tooltip; returns whether the shell had to be called
+    void (*repaintButton)();
+    void (*updatePeriodLabel)();
+    void (*publish)();              // Instance registry and runtime state
+};
+
+struct StatusModel {
+    uint32_t version;                       // Bumped on every field change
+    bool isJiggling;            uint32_t isJigglingVersion;
+    bool zenJiggle;             uint32_t zenJiggleVersion;
+    int jigglePeriod;           uint32_t jigglePeriodVersion;
+    bool enableTimeRestriction; uint32_t enableTimeRestrictionVersion;
+    int startMinutes;           uint32_t startMinutesVersion;
+    int endMinutes;             uint32_t endMinutesVersion;
+    uint32_t enabledDaysMask;   uint32_t enabledDaysMaskVersion;
+    bool resourceAlert;         uint32_t resourceAlertVersion;
+    uint32_t resourceSamples;   uint32_t resourceSamplesVersion;
+
+    // Store a field, bumping its version only if the value changed
+    template <typename T>
+    void Set(T& field, uint32_t& fieldVersion, T value) {
+        if (field != value) {
+            field = value;
+            fieldVersion = ++version;
+        }
+    }
+
+    void Refresh(const StatusValues& values) {
+        Set(isJiggling, isJigglingVersion, values.isJiggling);
+        Set(zenJiggle, zenJiggleVersion, values.zenJiggle);
+        Set(jigglePeriod, jigglePeriodVersion, values.jigglePeriod);
+        Set(enableTimeRestriction, enableTimeRestrictionVersion, values.enableTimeRestriction);
+        Set(startMinutes, startMinutesVersion, values.startMinutes);
+        Set(endMinutes, endMinutesVersion, values.endMinutes);
+        Set(enabledDaysMask, enabledDaysMaskVersion, values.enabledDaysMask);
+        Set(resourceAlert, resourceAlertVersion, values.resourceAlert);
+        Set(resourceSamples, resourceSamplesVersion, values.resourceSamples);
+    }
+
+    // The tooltip shows every field
+    bool TooltipChangedSince(uint32_t seen) const {
+        return isJigglingVersion > seen || zenJiggleVersion > seen ||
+            jigglePeriodVersion > seen || enableTimeRestrictionVersion > seen ||
+            startMinutesVersion > seen || endMinutesVersion > seen ||
+            enabledDaysMaskVersion > seen || resourceAlertVersion > seen ||
+            resourceSamplesVersion > seen;
+    }
+
+    // The schedule text only depends on the time range and days
+    bool ScheduleChangedSince(uint32_t seen) const {
+        return startMinutesVersion > seen || endMinutesVersion > seen || enabledDaysMaskVersion > seen;
+    }
+};
+
+// Last model version rendered by each view (0 = never rendered)
+struct StatusViews {
+    uint32_t tooltip;
+    uint32_t scheduleText;
+    uint32_t button;
+    uint32_t periodLabel;
+    uint32_t registry;
+};
+
+// Update counters, to check that views skip redundant work
+struct StatusStats {
+    uint64_t updatesRequested;
+    uint64_t tooltipRebuilds;
+    uint64_t shellCalls;
+    uint64_t buttonRepaints;
+    uint64_t labelUpdates;
+    uint64_t publishes;
+};
+
+struct StatusTracker {
+    const StatusHost* host = nullptr;
+    StatusModel model = {};
+    StatusViews seen = {};
+    StatusStats stats = {};
+
+    // Rebuild the tooltip if a field it shows changed (and there is a tray icon)
+    void UpdateTooltip() {
+        if (!host->hasTrayIcon() || !model.TooltipChangedSince(seen.tooltip)) {
+            return;
+        }
+        uint32_t scheduleSeen = seen.scheduleText;
+        seen.tooltip = model.version;
+
+        if (model.enableTimeRestriction && (model.ScheduleChangedSince(scheduleSeen) || scheduleSeen == 0)) {
+            host->buildScheduleText();
+            seen.scheduleText = model.version;
+        }
+
+        stats.tooltipRebuilds++;
+        if (host->setTooltip()) {
+            stats.shellCalls++;
+        }
+    }
+
+    // Propagate a state or settings change to every view that displays or publishes it
+    void Notify(const StatusValues& values) {
+        stats.updatesRequested++;
+        model.Refresh(values);
+
+        UpdateTooltip();
+
+        if (host->hasDialog() && model.isJigglingVersion > seen.button) {
+            seen.button = model.version;
+            stats.buttonRepaints++;
+            host->repaintButton();
+        }
+
+        if (host->hasDialog() && model.jigglePeriodVersion > seen.periodLabel) {
+            seen.periodLabel = model.version;
+            stats.labelUpdates++;
+            host->updatePeriodLabel();
+        }
+
+        if (model.version > seen.registry) {
+            seen.registry = model.version;
+            stats.publishes++;
+            host->publish();
+        }
+    }
+
+    // A new tray icon has no tooltip yet
+    void TrayIconCreated(const StatusValues& values) {
+        seen.tooltip = 0;
+        model.Refresh(values);
+        UpdateTooltip();
+    }
+};
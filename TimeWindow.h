@@ -0,0 +1,49 @@
+// MouseJiggler - Time restriction window
+//
+// Whether jiggling is allowed at a given local time, and when that can next
+// change. Pure functions of the window and the local time (no Win32), shared by
+// the time window task and the tests.
+
+#pragma once
+
+#include <stdint.h>
+
+#define WINDOW_DAY_MS           (24u * 60 * 60 * 1000)
+#define WINDOW_MAX_CHECK_MS     (60u * 60 * 1000)   // Re-check at least hourly so DST shifts are picked up
+
+struct TimeWindow {
+    int startMinutes;           // minutes after midnight
+    int endMinutes;             // minutes after midnight; before startMinutes for an overnight window
+    uint32_t daysMask;          // bit 0 = Sun ... bit 6 = Sat
+};
+
+// Whether the window is open on dayOfWeek (0 = Sun) at minuteOfDay. The day is
+// checked first, so an overnight window (e.g. 22:00 - 06:00) follows each day's flag.
+inline bool IsInTimeWindow(const TimeWindow& window, int dayOfWeek, int minuteOfDay) {
+    if (!(window.daysMask & (1u << dayOfWeek))) {
+        return false;
+    }
+
+    if (window.startMinutes > window.endMinutes) {
+        return minuteOfDay >= window.startMinutes || minuteOfDay < window.endMinutes;
+    }
+    return minuteOfDay >= window.startMinutes && minuteOfDay < window.endMinutes;
+}
+
+// Time from msOfDay to the next moment the window can change: its start or end,
+// or midnight (the day of week changes). Capped at WINDOW_MAX_CHECK_MS.
+inline uint32_t MsUntilWindowCheck(const TimeWindow& window, uint32_t msOfDay) {
+    uint32_t boundaries[3] = {
+        (uint32_t)window.startMinutes * 60 * 1000,
+        (uint32_t)window.endMinutes * 60 * 1000,
+        0   // Midnight
+    };
+
+    uint32_t wait = WINDOW_MAX_CHECK_MS;
+    for (int i = 0; i < 3; i++) {
+        uint32_t delta = boundaries[i] > msOfDay ? boundaries[i] - msOfDay
+                                                 : boundaries[i] + WINDOW_DAY_MS - msOfDay;
+        if (delta < wait) wait = delta;
+    }
+    return wait;
+}
@@ -0,0 +1,257 @@
+// MouseJiggler - Scoped tracing
+//
+// MJ_TRACE_SCOPE("name") records a begin event and, when the scope exits, an end
+// event. Events go into a buffer owned by the recording thread. Full buffers are
+// handed to a writer thread that appends them to a Chrome trace-event JSON file,
+// which can be opened in chrome://tracing or Perfetto. Every buffer is allocated
+// by TraceStart: if the writer falls behind and none is free, events are dropped
+// and counted (droppedEvents in the file) rather than allocating more. While
+// tracing is off a scope costs one test of g_Trace.enabled. Define MJ_NO_TRACING
+// to compile the scopes out entirely. Standard C++ only, so the tests run it.
+
+#pragma once
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#define TRACE_BUFFER_EVENTS     4096
+#define TRACE_BUFFER_COUNT      4       // One filling per tracing thread, the rest queued or being written
+
+struct TraceEvent {
+    const char* name;   // String literal
+    uint64_t timestamp; // steady_clock ns
+    char phase;         // 'B' or 'E'
+};
+
+struct TraceBuffer {
+    TraceBuffer* next;
+    uint32_t threadId;
+    int count;
+    TraceEvent events[TRACE_BUFFER_EVENTS];
+};
+
+struct TraceState {
+    std::atomic<bool> enabled{ false };
+    FILE* file = nullptr;
+    uint32_t processId = 0;
+    std::thread writer;
+    std::mutex lock;                    // Guards the two lists and stopping
+    std::condition_variable wake;       // Buffers queued, or shutdown
+    TraceBuffer* buffers = nullptr;     // All of them, allocated by TraceStart
+    TraceBuffer* full = nullptr;        // Waiting to be written, newest first
+    TraceBuffer* free = nullptr;        // Written and ready for reuse
+    std::atomic<int> freeCount{ 0 };    // Length of 'free', read without the lock to drop cheaply
+    bool stopping = false;
+    uint64_t origin = 0;                // steady_clock ns at TraceStart
+    bool firstEvent = true;             // Writer thread only
+    std::atomic<uint64_t> dropped{ 0 }; // Events recorded while no buffer was free
+    std::atomic<uint32_t> threads{ 0 }; // Thread ids handed out
+};
+
+inline TraceState g_Trace;
+inline thread_local TraceBuffer* t_TraceBuffer = nullptr;
+inline thread_local uint32_t t_TraceThreadId = 0;
+
+inline uint64_t TraceClockNs() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// Hand the calling thread's buffer to the writer thread
+inline void TraceHandOff() {
+    TraceBuffer* buffer = t_TraceBuffer;
+    if (!buffer) return;
+    t_TraceBuffer = nullptr;
+
+    {
+        std::lock_guard<std::mutex> guard(g_Trace.lock);
+        buffer->next = g_Trace.full;
+        g_Trace.full = buffer;
+    }
+    g_Trace.wake.notify_one();
+}
+
+// Append one event to the calling thread's buffer
+inline void TraceRecord(const char* name, char phase) {
+    TraceBuffer* buffer = t_TraceBuffer;
+    if (!buffer) {
+        if (g_Trace.freeCount.load(std::memory_order_relaxed) > 0) {
+            std::lock_guard<std::mutex> guard(g_Trace.lock);
+            buffer = g_Trace.free;
+            if (buffer) {
+                g_Trace.free = buffer->next;
+                g_Trace.freeCount.fetch_sub(1, std::memory_order_relaxed);
+            }
+        }
+        if (!buffer) {
+            g_Trace.dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        if (t_TraceThreadId == 0) {
+            t_TraceThreadId = g_Trace.threads.fetch_add(1, std::memory_order_relaxed) + 1;
+        }
+        buffer->next = nullptr;
+        buffer->threadId = t_TraceThreadId;
+        buffer->count = 0;
+        t_TraceBuffer = buffer;
+    }
+
+    TraceEvent& event = buffer->events[buffer->count++];
+    event.name = name;
+    event.timestamp = TraceClockNs();
+    event.phase = phase;
+
+    if (buffer->count == TRACE_BUFFER_EVENTS) {
+        TraceHandOff();
+    }
+}
+
+// Write one buffer as JSON objects (writer thread)
+inline void TraceWriteBuffer(const TraceBuffer* buffer) {
+    static char text[64 * 1024];
+    int length = 0;
+
+    for (int i = 0; i < buffer->count; i++) {
+        const TraceEvent& event = buffer->events[i];
+        unsigned long long micros = (unsigned long long)((event.timestamp - g_Trace.origin) / 1000);
+
+        length += snprintf(text + length, sizeof(text) - length,
+            "%s{\"name\":\"%s\",\"ph\":\"%c\",\"ts\":%llu,\"pid\":%lu,\"tid\":%lu}",
+            g_Trace.firstEvent ? "\n" : ",\n", event.name, event.phase, micros,
+            (unsigned long)g_Trace.processId, (unsigned long)buffer->threadId);
+        g_Trace.firstEvent = false;
+
+        if (length > (int)sizeof(text) - 512 || i == buffer->count - 1) {
+            fwrite(text, 1, (size_t)length, g_Trace.file);
+            length = 0;
+        }
+    }
+}
+
+// Writer thread: drains queued buffers until shutdown
+inline void TraceWriterLoop() {
+    for (;;) {
+        TraceBuffer* queued;
+        bool stopping;
+        {
+            std::unique_lock<std::mutex> guard(g_Trace.lock);
+            g_Trace.wake.wait(guard, [] { return g_Trace.full != nullptr || g_Trace.stopping; });
+            queued = g_Trace.full;
+            g_Trace.full = nullptr;
+            stopping = g_Trace.stopping;
+        }
+
+        // Queued newest first; reverse so the file stays roughly in time order
+        TraceBuffer* ordered = nullptr;
+        while (queued) {
+            TraceBuffer* next = queued->next;
+            queued->next = ordered;
+            ordered = queued;
+            queued = next;
+        }
+
+        while (ordered) {
+            TraceBuffer* next = ordered->next;
+            TraceWriteBuffer(ordered);
+
+            std::lock_guard<std::mutex> guard(g_Trace.lock);
+            ordered->next = g_Trace.free;
+            g_Trace.free = ordered;
+            g_Trace.freeCount.fetch_add(1, std::memory_order_relaxed);
+            ordered = next;
+        }
+
+        if (stopping) return;
+    }
+}
+
+// Start tracing into 'file' (opened for writing; closed by TraceStop). Returns
+// false, leaving the file to the caller, if the buffers or the writer cannot be set up.
+inline bool TraceStart(FILE* file, uint32_t processId) {
+    if (g_Trace.enabled) return false;
+
+    g_Trace.buffers = (TraceBuffer*)malloc(sizeof(TraceBuffer) * TRACE_BUFFER_COUNT);
+    if (!g_Trace.buffers) {
+        return false;
+    }
+    g_Trace.free = nullptr;
+    for (int i = 0; i < TRACE_BUFFER_COUNT; i++) {
+        g_Trace.buffers[i].next = g_Trace.free;
+        g_Trace.free = &g_Trace.buffers[i];
+    }
+    g_Trace.freeCount = TRACE_BUFFER_COUNT;
+    g_Trace.full = nullptr;
+    g_Trace.stopping = false;
+    g_Trace.file = file;
+    g_Trace.processId = processId;
+    g_Trace.origin = TraceClockNs();
+    g_Trace.firstEvent = true;
+    g_Trace.dropped = 0;
+
+    static const char header[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[";
+    fwrite(header, 1, sizeof(header) - 1, file);
+
+    try {
+        g_Trace.writer = std::thread(TraceWriterLoop);
+    } catch (...) {
+        free(g_Trace.buffers);
+        g_Trace.buffers = nullptr;
+        g_Trace.free = nullptr;
+        g_Trace.freeCount = 0;
+        g_Trace.file = nullptr;
+        return false;
+    }
+
+    g_Trace.enabled = true;
+    return true;
+}
+
+// Flush the calling thread's events, stop the writer and close the file. Buffers
+// still held by other threads at this point are dropped; stop them first.
+inline void TraceStop() {
+    if (!g_Trace.enabled) return;
+    g_Trace.enabled = false;
+
+    TraceHandOff();
+    {
+        std::lock_guard<std::mutex> guard(g_Trace.lock);
+        g_Trace.stopping = true;
+    }
+    g_Trace.wake.notify_one();
+    g_Trace.writer.join();
+
+    fprintf(g_Trace.file, "\n],\"droppedEvents\":%llu}\n", (unsigned long long)g_Trace.dropped.load());
+    fclose(g_Trace.file);
+    g_Trace.file = nullptr;
+
+    free(g_Trace.buffers);
+    g_Trace.buffers = nullptr;
+    g_Trace.free = nullptr;
+    g_Trace.freeCount = 0;
+    g_Trace.full = nullptr;
+}
+
+#ifdef MJ_NO_TRACING
+#define MJ_TRACE_SCOPE(name)
+#else
+#define MJ_TRACE_CONCAT2(a, b)  a##b
+#define MJ_TRACE_CONCAT(a, b)   MJ_TRACE_CONCAT2(a, b)
+#define MJ_TRACE_SCOPE(name)    TraceScope MJ_TRACE_CONCAT(traceScope, __LINE__)(name)
+#endif
+
+struct TraceScope {
+    const char* name;
+
+    explicit TraceScope(const char* scopeName) : name(scopeName) {
+        if (g_Trace.enabled.load(std::memory_order_relaxed)) TraceRecord(name, 'B');
+    }
+    ~TraceScope() {
+        if (g_Trace.enabled.load(std::memory_order_relaxed)) TraceRecord(name, 'E');
+    }
+};
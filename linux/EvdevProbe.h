@@ -0,0 +1,231 @@
+// MouseJiggler - evdev injection probe
+//
+// The Linux counterpart of --probe in Main.cpp, for machines without a display.
+// It injects jiggles of each movement type (zen out and back, then each daemon
+// pattern, stepping through its moves) through the daemon's input sink and reads
+// them back from the evdev node of the uinput device. A jiggle is observed when
+// its first motion is read back, with the time from submit to read as its
+// latency. It is registered when every motion comes back with the injected
+// deltas, i.e. the kernel input layer took all of it as activity. The reader is
+// any descriptor that yields struct input_event, so the tests can use a pipe.
+
+#pragma once
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/input.h>
+#include <linux/uinput.h>
+#include <poll.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+#include "../InputSink.h"
+#include "JigglerDaemon.h"
+#include "UinputSink.h"
+
+#define PROBE_MAX_SAMPLES       1000
+#define PROBE_TIMEOUT_MS        250     // Count a jiggle as dropped if not all read back by then
+#define PROBE_NODE_WAIT_MS      2000    // For udev to create the evdev node of a new device
+#define PROBE_MAX_MOTIONS       2       // Per jiggle (zen: out and back)
+
+inline int64_t ProbeClockUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+// Whether /dev/input/<name> is an evdev node of a device named 'deviceName'; returns it opened, or -1
+inline int OpenEvdevIfNamed(const char* name, const char* deviceName) {
+    char path[64];
+    snprintf(path, sizeof(path), "/dev/input/%.32s", name);
+    int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+    char actual[UINPUT_MAX_NAME_SIZE] = "";
+    if (!deviceName || (ioctl(fd, EVIOCGNAME(sizeof(actual) - 1), actual) >= 0 && strcmp(actual, deviceName) == 0)) {
+        return fd;
+    }
+    close(fd);
+    return -1;
+}
+
+// Open the evdev node of a uinput device. With its uinput descriptor the node is
+// found through sysfs (UI_GET_SYSNAME, Linux 3.15); otherwise (a sink plugin owns
+// the device) the newest node named UINPUT_DEVICE_NAME is used. Waits for udev to
+// create the node. Returns -1 with errno set if there is none or it cannot be read.
+inline int OpenUinputEvdev(int uinputFd) {
+    char sysname[64] = "";
+    if (uinputFd >= 0 && ioctl(uinputFd, UI_GET_SYSNAME(sizeof(sysname)), sysname) < 0) {
+        sysname[0] = '\0';
+    }
+
+    int error = ENOENT;
+    for (int waited = 0; waited <= PROBE_NODE_WAIT_MS; waited += 50) {
+        char directoryPath[128];
+        if (sysname[0]) {
+            snprintf(directoryPath, sizeof(directoryPath), "/sys/devices/virtual/input/%s", sysname);
+        } else {
+            snprintf(directoryPath, sizeof(directoryPath), "/dev/input");
+        }
+
+        DIR* directory = opendir(directoryPath);
+        int best = -1;
+        int bestNumber = -1;
+        if (directory) {
+            while (const struct dirent* entry = readdir(directory)) {
+                if (strncmp(entry->d_name, "event", 5) != 0) continue;
+                int number = atoi(entry->d_name + 5);
+                if (number <= bestNumber) continue;
+                int fd = OpenEvdevIfNamed(entry->d_name, sysname[0] ? nullptr : UINPUT_DEVICE_NAME);
+                if (fd < 0) {
+                    if (errno == EACCES || errno == EPERM) error = errno;
+                    continue;
+                }
+                if (best >= 0) close(best);
+                best = fd;
+                bestNumber = number;
+            }
+            closedir(directory);
+        }
+        if (best >= 0) {
+            return best;
+        }
+        if (error != ENOENT) {
+            break;
+        }
+        usleep(50 * 1000);
+    }
+    errno = error;
+    return -1;
+}
+
+// Discard whatever the reader holds
+inline void DrainProbeReader(int readerFd) {
+    struct input_event events[64];
+    struct pollfd reader = { readerFd, POLLIN, 0 };
+    while (poll(&reader, 1, 0) > 0 && (reader.revents & POLLIN)) {
+        if (read(readerFd, events, sizeof(events)) <= 0) break;
+    }
+}
+
+// Inject one jiggle and read it back. Returns whether its first motion was seen
+// (with 'latencyUs' set) and sets 'registered' if every motion came back intact.
+inline bool ProbeJiggle(const MJInputSink* sink, int readerFd, const MJInputEvent* moves, uint32_t count,
+                        int timeoutMs, int64_t* latencyUs, bool* registered) {
+    DrainProbeReader(readerFd);
+
+    uint32_t status[PROBE_MAX_MOTIONS];
+    int64_t injectedAt = ProbeClockUs();
+    sink->submit(sink->context, moves, count, (uint64_t)injectedAt, status);
+
+    int64_t deadline = injectedAt + (int64_t)timeoutMs * 1000;
+    uint32_t seen = 0;
+    bool intact = true;
+    int32_t dx = 0, dy = 0;
+    *registered = false;
+
+    while (seen < count) {
+        int64_t now = ProbeClockUs();
+        if (now >= deadline) break;
+        struct pollfd reader = { readerFd, POLLIN, 0 };
+        int remainingMs = (int)((deadline - now + 999) / 1000);
+        int ready = poll(&reader, 1, remainingMs);
+        if (ready < 0 && errno == EINTR) continue;
+        if (ready <= 0) break;
+
+        struct input_event events[64];
+        ssize_t length = read(readerFd, events, sizeof(events));
+        if (length <= 0) {
+            if (length < 0 && (errno == EAGAIN || errno == EINTR)) continue;
+            break;
+        }
+        int64_t readAt = ProbeClockUs();
+        for (size_t i = 0; i < (size_t)length / sizeof(struct input_event) && seen < count; i++) {
+            const struct input_event& event = events[i];
+            if (event.type == EV_REL && event.code == REL_X) dx += event.value;
+            if (event.type == EV_REL && event.code == REL_Y) dy += event.value;
+            if (event.type != EV_SYN || event.code != SYN_REPORT || (dx == 0 && dy == 0)) continue;
+
+            // One motion per report
+            if (seen == 0) *latencyUs = readAt - injectedAt;
+            if (dx != moves[seen].dx || dy != moves[seen].dy) intact = false;
+            seen++;
+            dx = dy = 0;
+        }
+    }
+
+    *registered = seen == count && intact;
+    return seen > 0;
+}
+
+inline int CompareProbeLatency(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// Inject 'samples' jiggles of zen and of each daemon pattern through 'sink',
+// read them back from 'readerFd' and write the report, in the layout of the
+// Windows MouseJiggler-probe.txt, into 'report'
+inline void RunEvdevProbe(const MJInputSink* sink, int readerFd, int samples, int timeoutMs,
+                          char* report, size_t reportSize) {
+    static int64_t latencies[PROBE_MAX_SAMPLES];
+    if (samples < 1) samples = 1;
+    if (samples > PROBE_MAX_SAMPLES) samples = PROBE_MAX_SAMPLES;
+
+    size_t length = (size_t)snprintf(report, reportSize,
+        "Mouse Jiggler injection probe: %d samples per movement type via %s sink%s\n"
+        "type     observed  registered    p50 us    p90 us    p99 us    max us\n",
+        samples, sink->name ? sink->name : "?", readerFd >= 0 ? "" : " (no evdev node, nothing observed)");
+
+    // Zen first, then every pattern
+    for (int type = 0; type <= DAEMON_PATTERN_COUNT; type++) {
+        int observed = 0;
+        int registered = 0;
+        for (int i = 0; i < samples; i++) {
+            MJInputEvent moves[PROBE_MAX_MOTIONS] = {};
+            uint32_t count;
+            if (type == 0) {
+                moves[0].dx = 1;
+                moves[1].dx = -1;
+                count = 2;
+            } else {
+                const DaemonPattern& pattern = g_DaemonPatterns[type - 1];
+                moves[0].dx = pattern.steps[i % pattern.stepCount][0];
+                moves[0].dy = pattern.steps[i % pattern.stepCount][1];
+                count = 1;
+            }
+
+            int64_t latency = 0;
+            bool intact = false;
+            if (readerFd >= 0 && ProbeJiggle(sink, readerFd, moves, count, timeoutMs, &latency, &intact)) {
+                latencies[observed++] = latency;
+            } else if (readerFd < 0) {
+                uint32_t status[PROBE_MAX_MOTIONS];
+                sink->submit(sink->context, moves, count, (uint64_t)ProbeClockUs(), status);
+            }
+            if (intact) registered++;
+        }
+
+        const char* name = type == 0 ? "Zen" : g_DaemonPatterns[type - 1].name;
+        if (length >= reportSize) break;
+        if (observed > 0) {
+            qsort(latencies, (size_t)observed, sizeof(int64_t), CompareProbeLatency);
+            length += (size_t)snprintf(report + length, reportSize - length,
+                "%-8s %4d/%-4d  %4d/%-4d  %8lld  %8lld  %8lld  %8lld\n",
+                name, observed, samples, registered, samples,
+                (long long)latencies[observed * 50 / 100], (long long)latencies[observed * 90 / 100],
+                (long long)latencies[observed * 99 / 100], (long long)latencies[observed - 1]);
+        } else {
+            length += (size_t)snprintf(report + length, reportSize - length,
+                "%-8s %4d/%-4d  %4d/%-4d         -         -         -         -\n",
+                name, observed, samples, registered, samples);
+        }
+    }
+}
@@ -0,0 +1,224 @@
+// MouseJiggler - INI file reader
+//
+// Reads MouseJiggler.ini the way the Win32 profile functions do: [Section]
+// headers and key=value lines, names compared without regard to case,
+// whitespace around names and values ignored, ';' and '#' lines skipped, and
+// the first occurrence of a key winning. The file is read into a fixed buffer
+// once per load, so lookups never touch the disk or the heap. SetIniString
+// changes one key in that buffer and writes the file back, as
+// WritePrivateProfileString does.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+
+#define INI_MAX_SIZE            (64 * 1024)     // Larger files are read up to this size
+#define INI_MAX_LINE            512
+
+struct IniFile {
+    char text[INI_MAX_SIZE + 1];
+    size_t length;
+};
+
+// Read a file into 'ini'. A missing or unreadable file loads as empty (every key
+// then takes its default) and returns false.
+inline bool LoadIniFile(const char* path, IniFile* ini) {
+    ini->length = 0;
+    ini->text[0] = '\0';
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    ini->length = fread(ini->text, 1, INI_MAX_SIZE, file);
+    ini->text[ini->length] = '\0';
+    fclose(file);
+    return true;
+}
+
+// Copy one line of the file, without its line break and surrounding whitespace,
+// into 'line'; returns where the next line starts (NULL at the end)
+inline const char* ReadIniLine(const IniFile* ini, const char* position, char* line, size_t lineSize) {
+    const char* end = ini->text + ini->length;
+    if (position >= end) {
+        return NULL;
+    }
+    const char* lineEnd = (const char*)memchr(position, '\n', end - position);
+    const char* next = lineEnd ? lineEnd + 1 : end;
+    if (!lineEnd) lineEnd = end;
+
+    while (position < lineEnd && (*position == ' ' || *position == '\t')) position++;
+    while (lineEnd > position && (lineEnd[-1] == ' ' || lineEnd[-1] == '\t' || lineEnd[-1] == '\r')) lineEnd--;
+
+    size_t length = (size_t)(lineEnd - position);
+    if (length >= lineSize) length = lineSize - 1;
+    memcpy(line, position, length);
+    line[length] = '\0';
+    return next;
+}
+
+// Name of the section a "[name]" line opens, in place; NULL for any other line
+inline char* ParseIniSection(char* line) {
+    if (line[0] != '[') {
+        return NULL;
+    }
+    char* close = strchr(line, ']');
+    if (!close) {
+        return NULL;
+    }
+    *close = '\0';
+    return line + 1;
+}
+
+// Look up section/key. Returns whether the key exists; 'out' receives its value
+// or 'defaultValue'.
+inline bool GetIniString(const IniFile* ini, const char* section, const char* key, const char* defaultValue,
+                         char* out, size_t outSize) {
+    char line[INI_MAX_LINE];
+    bool inSection = false;
+    for (const char* position = ini->text; (position = ReadIniLine(ini, position, line, sizeof(line))) != NULL;) {
+        char* name = ParseIniSection(line);
+        if (name) {
+            inSection = strcasecmp(name, section) == 0;
+            continue;
+        }
+        if (!inSection || line[0] == ';' || line[0] == '#') {
+            continue;
+        }
+
+        char* equals = strchr(line, '=');
+        if (!equals) {
+            continue;
+        }
+        char* keyEnd = equals;
+        while (keyEnd > line && (keyEnd[-1] == ' ' || keyEnd[-1] == '\t')) keyEnd--;
+        *keyEnd = '\0';
+        if (strcasecmp(line, key) != 0) {
+            continue;
+        }
+
+        const char* value = equals + 1;
+        while (*value == ' ' || *value == '\t') value++;
+        snprintf(out, outSize, "%s", value);
+        return true;
+    }
+    snprintf(out, outSize, "%s", defaultValue);
+    return false;
+}
+
+// Integer value of section/key, or 'defaultValue' if the key is missing. Like
+// GetPrivateProfileInt, a value without leading digits reads as 0.
+inline int GetIniInt(const IniFile* ini, const char* section, const char* key, int defaultValue) {
+    char value[32];
+    if (!GetIniString(ini, section, key, "", value, sizeof(value))) {
+        return defaultValue;
+    }
+    return (int)strtol(value, NULL, 10);
+}
+
+// Every section name, each followed by a null and the list by a second null
+// (the GetPrivateProfileSectionNames format); returns the length without the
+// final null
+inline size_t GetIniSectionNames(const IniFile* ini, char* out, size_t outSize) {
+    char line[INI_MAX_LINE];
+    size_t length = 0;
+    for (const char* position = ini->text; (position = ReadIniLine(ini, position, line, sizeof(line))) != NULL;) {
+        char* name = ParseIniSection(line);
+        if (!name) {
+            continue;
+        }
+        size_t nameLength = strlen(name);
+        if (length + nameLength + 2 > outSize) {
+            break;
+        }
+        memcpy(out + length, name, nameLength + 1);
+        length += nameLength + 1;
+    }
+    if (outSize > 0) {
+        out[length < outSize ? length : outSize - 1] = '\0';
+    }
+    return length;
+}
+
+// Set section/key to 'value' in the file at 'path', read afresh into 'ini'
+// (replacing the first occurrence, adding the key at the end of its section, or
+// the section at the end of the file), and write the file back with a single
+// write(). Other lines, comments and line endings are kept. Returns false if the
+// file would be too large or cannot be written, with errno set.
+inline bool SetIniString(IniFile* ini, const char* path, const char* section, const char* key, const char* value) {
+    LoadIniFile(path, ini);
+    const char* newline = strstr(ini->text, "\r\n") ? "\r\n" : "\n";
+    char line[INI_MAX_LINE];
+    const char* replaceStart = NULL;     // Range of ini->text the new text replaces
+    const char* replaceEnd = NULL;
+    const char* sectionEnd = NULL;      // After the last non-blank line of the section
+    bool inSection = false;
+
+    for (const char* position = ini->text, *next; !replaceStart && (next = ReadIniLine(ini, position, line, sizeof(line))) != NULL; position = next) {
+        char* name = ParseIniSection(line);
+        if (name) {
+            inSection = strcasecmp(name, section) == 0;
+            if (inSection && !sectionEnd) sectionEnd = next;
+            continue;
+        }
+        if (!inSection || line[0] == '\0' || line[0] == ';' || line[0] == '#') {
+            continue;
+        }
+        sectionEnd = next;
+
+        char* equals = strchr(line, '=');
+        if (!equals) {
+            continue;
+        }
+        char* keyEnd = equals;
+        while (keyEnd > line && (keyEnd[-1] == ' ' || keyEnd[-1] == '\t')) keyEnd--;
+        *keyEnd = '\0';
+        if (strcasecmp(line, key) == 0) {
+            replaceStart = position;
+            replaceEnd = next;
+        }
+    }
+
+    char insert[INI_MAX_LINE + 64];
+    int insertLength;
+    if (replaceStart) {
+        insertLength = snprintf(insert, sizeof(insert), "%s=%s%s", key, value, newline);
+    } else if (sectionEnd) {
+        replaceStart = replaceEnd = sectionEnd;
+        bool terminated = sectionEnd > ini->text && sectionEnd[-1] == '\n';
+        insertLength = snprintf(insert, sizeof(insert), "%s%s=%s%s", terminated ? "" : newline, key, value, newline);
+    } else {
+        replaceStart = replaceEnd = ini->text + ini->length;
+        bool terminated = ini->length == 0 || ini->text[ini->length - 1] == '\n';
+        insertLength = snprintf(insert, sizeof(insert), "%s[%s]%s%s=%s%s", terminated ? "" : newline,
+                                section, newline, key, value, newline);
+    }
+    if (insertLength < 0 || insertLength >= (int)sizeof(insert)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    size_t start = (size_t)(replaceStart - ini->text);
+    size_t removed = (size_t)(replaceEnd - replaceStart);
+    size_t length = ini->length - removed + (size_t)insertLength;
+    if (length > INI_MAX_SIZE) {
+        errno = EFBIG;
+        return false;
+    }
+    memmove(ini->text + start + insertLength, ini->text + start + removed, ini->length - start - removed);
+    memcpy(ini->text + start, insert, (size_t)insertLength);
+    ini->length = length;
+    ini->text[length] = '\0';
+
+    int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        return false;
+    }
+    bool written = write(fd, ini->text, ini->length) == (ssize_t)ini->length;
+    return close(fd) == 0 && written;
+}
@@ -0,0 +1,978 @@
+// MouseJiggler - Linux daemon
+//
+// The jiggler without a GUI: one thread, one epoll set, and nothing that wakes
+// up unless there is work. A timerfd on CLOCK_REALTIME resumes the scheduler
+// (Scheduler.h) at the earliest wait of the jiggle and time window tasks
+// (JiggleTasks.h), the same tasks Main.cpp runs from TIMER_SCHEDULER, and its
+// TFD_TIMER_CANCEL_ON_SET reports wall clock changes the way WM_TIMECHANGE
+// does. A signalfd turns SIGTERM and SIGINT into shutdown and SIGHUP into a
+// reload; an inotify watch on the INI file's directory reloads the settings
+// when MouseJiggler.ini itself is written or replaced (but not for the
+// daemon's own ActiveProfile write); and a Unix socket takes one-line control
+// commands. Settings come from the same MouseJiggler.ini
+// format as the Windows build (adaptive jiggling needs an idle timer and is
+// not available here). Resources are sampled from /proc (ProcResources.h)
+// when the status is published, at most every RESOURCE_SAMPLE_MS, so an idle
+// daemon is never woken for them. Input goes through an MJInputSink (InputSink.h), the
+// uinput sink in UinputSink.h by default, so the soak test runs the real loop
+// without /dev/uinput.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdarg.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+#include <sys/epoll.h>
+#include <sys/inotify.h>
+#include <sys/mman.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/timerfd.h>
+#include <sys/un.h>
+#include <time.h>
+#include <unistd.h>
+#include "../Cadence.h"
+#include "../InputSink.h"
+#include "../JiggleTasks.h"
+#include "../RuntimeState.h"
+#include "../Scheduler.h"
+#include "../TimeWindow.h"
+#include "IniFile.h"
+#include "PosixRegistry.h"
+#include "ProcResources.h"
+
+#define DAEMON_MAX_CLIENTS          8
+#define DAEMON_COMMAND_LENGTH       128
+#define DAEMON_REPLY_LENGTH         512
+#define DAEMON_MAX_PROFILES         16
+#define DAEMON_PROFILE_NAME_LENGTH  32
+#define DAEMON_PROFILE_PREFIX       "Profile:"
+#define DAEMON_EPOCH_OFFSET_MS      11644473600000ull   // 1601-01-01 to 1970-01-01; the scheduler clock
+                                                        // counts from the FILETIME epoch, as in Main.cpp
+
+// epoll_event.data.u64 of each descriptor; clients follow DAEMON_TAG_CLIENT
+#define DAEMON_TAG_TIMER            0
+#define DAEMON_TAG_SIGNAL           1
+#define DAEMON_TAG_SETTINGS         2
+#define DAEMON_TAG_LISTEN           3
+#define DAEMON_TAG_CLIENT           4
+
+// Jiggle settings of one INI section (the keys of Main.cpp's Settings that apply here)
+struct DaemonSettings {
+    bool zenJiggle;
+    int jigglePeriod;           // seconds
+    bool enableTimeRestriction;
+    int startHour;
+    int startMinute;
+    int endHour;
+    int endMinute;
+    bool enabledDays[7];        // 0=Sun ... 6=Sat
+    int jigglePhase;            // seconds
+    int missedJigglePolicy;     // MISSED_JIGGLE_*
+    int jigglePattern;          // Index into g_DaemonPatterns
+};
+
+static const DaemonSettings g_DaemonDefaults = { false, 60, false, 9, 0, 18, 0, { true, true, true, true, true, true, true }, 0, 1, 0 };
+
+static const char* const g_DaemonDayNames[7] = { "Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat" };
+
+// Jiggle patterns, as in Main.cpp. Zen jiggling moves out and back within one
+// batch: the kernel drops a zero movement, so it could not register activity.
+struct DaemonPattern {
+    const char* name;
+    const int32_t (*steps)[2];
+    int stepCount;
+};
+
+static const int32_t g_DaemonZigZag[][2] = { { 4, 4 }, { -4, -4 } };
+static const int32_t g_DaemonSquare[][2] = { { 4, 0 }, { 0, 4 }, { -4, 0 }, { 0, -4 } };
+static const int32_t g_DaemonNudge[][2] = { { 1, 0 }, { -1, 0 } };
+
+static const DaemonPattern g_DaemonPatterns[] = {
+    { "ZigZag", g_DaemonZigZag, 2 },
+    { "Square", g_DaemonSquare, 4 },
+    { "Nudge", g_DaemonNudge, 2 },
+};
+
+#define DAEMON_PATTERN_COUNT    (int)(sizeof(g_DaemonPatterns) / sizeof(g_DaemonPatterns[0]))
+
+struct DaemonProfile {
+    char name[DAEMON_PROFILE_NAME_LENGTH];
+    DaemonSettings settings;
+};
+
+// Jiggle settings given on the command line. They override the INI file for the
+// whole run, including after every reload; a profile chosen over the control
+// socket replaces -p.
+struct DaemonOverrides {
+    char profile[DAEMON_PROFILE_NAME_LENGTH];   // -p; empty = none
+    bool zenJiggle;                             // -z
+    int jigglePeriod;                           // -s; 0 = none
+    bool startJiggling;                         // -j
+};
+
+// Wakeup and CPU accounting for the soak report
+struct DaemonStats {
+    uint64_t wakeups;           // Returns from epoll_wait
+    uint64_t timerWakeups;      // ... by descriptor (one wakeup can serve several)
+    uint64_t signalWakeups;
+    uint64_t settingsWakeups;
+    uint64_t controlWakeups;
+    uint64_t reloads;
+    uint64_t commands;
+    uint64_t clockChanges;
+    uint64_t startedNs;         // CLOCK_MONOTONIC at Open
+    uint64_t cpuStartedNs;      // CLOCK_THREAD_CPUTIME_ID at Open
+};
+
+struct DaemonClient {
+    int fd;                     // -1 = free
+    size_t length;
+    char command[DAEMON_COMMAND_LENGTH];
+};
+
+inline void DaemonLog(const char* format, ...) {
+    va_list args;
+    va_start(args, format);
+    fputs("mousejigglerd: ", stderr);
+    vfprintf(stderr, format, args);
+    fputc('\n', stderr);
+    va_end(args);
+}
+
+inline uint64_t DaemonClockNs(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Read the jiggle settings of one INI section. Keys missing from the section keep
+// the values already in *out, so a profile only lists what differs from [Settings].
+inline void ReadDaemonSettings(const IniFile* ini, const char* section, DaemonSettings* out) {
+    out->zenJiggle = GetIniInt(ini, section, "ZenJiggle", out->zenJiggle ? 1 : 0) != 0;
+    out->jigglePeriod = GetIniInt(ini, section, "JigglePeriod", out->jigglePeriod);
+    out->enableTimeRestriction = GetIniInt(ini, section, "EnableTimeRestriction", out->enableTimeRestriction ? 1 : 0) != 0;
+    out->startHour = GetIniInt(ini, section, "StartHour", out->startHour);
+    out->startMinute = GetIniInt(ini, section, "StartMinute", out->startMinute);
+    out->endHour = GetIniInt(ini, section, "EndHour", out->endHour);
+    out->endMinute = GetIniInt(ini, section, "EndMinute", out->endMinute);
+
+    // Comma-separated day names; a missing key keeps the inherited days
+    char days[256];
+    if (GetIniString(ini, section, "EnabledDays", "", days, sizeof(days))) {
+        for (int i = 0; i < 7; i++) {
+            out->enabledDays[i] = false;
+        }
+        char* context = NULL;
+        for (char* token = strtok_r(days, ",", &context); token; token = strtok_r(NULL, ",", &context)) {
+            while (*token == ' ') token++;
+            for (int i = 0; i < 7; i++) {
+                if (strcasecmp(token, g_DaemonDayNames[i]) == 0) {
+                    out->enabledDays[i] = true;
+                    break;
+                }
+            }
+        }
+    }
+
+    if (out->jigglePeriod < 1) out->jigglePeriod = 1;
+    if (out->jigglePeriod > 10800) out->jigglePeriod = 10800;
+    if (out->startHour < 0 || out->startHour > 23) out->startHour = 9;
+    if (out->startMinute < 0 || out->startMinute > 59) out->startMinute = 0;
+    if (out->endHour < 0 || out->endHour > 23) out->endHour = 18;
+    if (out->endMinute < 0 || out->endMinute > 59) out->endMinute = 0;
+
+    out->jigglePhase = GetIniInt(ini, section, "JigglePhase", out->jigglePhase);
+    out->missedJigglePolicy = GetIniInt(ini, section, "MissedJigglePolicy", out->missedJigglePolicy);
+    if (out->jigglePhase < 0 || out->jigglePhase >= 10800) out->jigglePhase = 0;
+    if (out->missedJigglePolicy < MISSED_JIGGLE_SKIP || out->missedJigglePolicy > MISSED_JIGGLE_BURST) {
+        out->missedJigglePolicy = MISSED_JIGGLE_ONCE;
+    }
+
+    // Unknown pattern names fall back to the default zig/zag
+    char pattern[32];
+    if (GetIniString(ini, section, "JigglePattern", "", pattern, sizeof(pattern))) {
+        out->jigglePattern = 0;
+        for (int i = 0; i < DAEMON_PATTERN_COUNT; i++) {
+            if (strcasecmp(pattern, g_DaemonPatterns[i].name) == 0) {
+                out->jigglePattern = i;
+                break;
+            }
+        }
+    }
+}
+
+// Resource line of an instance, as the resources command and -l print it. The
+// file descriptor count at startup is only known to the instance itself (0 = not shown).
+inline void FormatResourceLine(char* buffer, size_t bufferSize, const InstanceStatus& status, uint32_t startFds) {
+    char start[32] = "";
+    if (startFds) {
+        snprintf(start, sizeof(start), " start_fds=%lu", (unsigned long)startFds);
+    }
+    snprintf(buffer, bufferSize,
+             "fds=%lu%s rss_kb=%llu anon_kb=%llu cpu_ms=%llu timer_ms=%lu settings_ms=%lu control_ms=%lu "
+             "alert=%d\n",
+             (unsigned long)status.handleCount, start, (unsigned long long)(status.workingSet / 1024),
+             (unsigned long long)(status.privateBytes / 1024), (unsigned long long)status.cpuTime,
+             (unsigned long)status.subsystemCpuMs[SUBSYSTEM_TIMER],
+             (unsigned long)status.subsystemCpuMs[SUBSYSTEM_SETTINGS],
+             (unsigned long)status.subsystemCpuMs[SUBSYSTEM_TRAY], status.resourceAlert ? 1 : 0);
+}
+
+struct JigglerDaemon;
+
+// The daemon the scheduler and jiggle hooks belong to (one per process)
+inline JigglerDaemon* g_Daemon = nullptr;
+
+struct JigglerDaemon {
+    // Configuration, set before Open
+    char iniPath[PATH_MAX] = {};
+    char socketPath[sizeof(((struct sockaddr_un*)0)->sun_path)] = {};
+    char statePath[PATH_MAX] = {};          // Empty = no runtime state
+    DaemonOverrides overrides = {};
+    MJInputSink sink = {};                  // Where jiggles go; owned by the caller
+
+    // Settings
+    IniFile ini;
+    DaemonSettings baseSettings = g_DaemonDefaults;     // [Settings] snapshot
+    DaemonSettings settings = g_DaemonDefaults;         // Working copy
+    DaemonProfile profiles[DAEMON_MAX_PROFILES];
+    int profileCount = 0;
+    int activeProfile = -1;                             // -1 = [Settings]
+    struct timespec iniWriteTime = {};                  // Last known write time, size and inode
+    off_t iniSize = -1;                                 // of the INI file (RememberIniWrite)
+    ino_t iniInode = 0;
+
+    Scheduler scheduler;
+    JiggleTasks jiggle;
+    int patternStep = 0;
+    uint64_t jigglesSent = 0;
+    uint64_t jiggleFailures = 0;
+
+    // Reactor
+    int epollFd = -1;
+    int timerFd = -1;
+    int signalFd = -1;
+    int settingsFd = -1;
+    int listenFd = -1;
+    DaemonClient clients[DAEMON_MAX_CLIENTS];
+    bool quitting = false;
+    DaemonStats stats = {};
+
+    // Runtime state (RuntimeState.h) and the instance registry slot
+    RuntimeStateFile* stateFile = nullptr;
+    uint64_t stateSequence = 0;
+    uint64_t resumeDue = 0;                 // Recovered deadline to resume jiggling on, 0 if none
+    InstanceSlot* registrySlot = nullptr;
+    int registryIndex = -1;
+    uint32_t sessionId = 0;
+
+    // Resource usage (ResourceMonitor.h); the control socket is charged as SUBSYSTEM_TRAY
+    ResourceMonitor resources;
+    uint64_t resourcesSampledNs = 0;        // CLOCK_MONOTONIC of the latest sample
+
+    // Scheduler host: ms since 1601-01-01 UTC
+    static uint64_t Now() {
+        return DaemonClockNs(CLOCK_REALTIME) / 1000000 + DAEMON_EPOCH_OFFSET_MS;
+    }
+
+    static uint64_t IdleTime() {
+        return 0;   // Only adaptive jiggling waits for idle time
+    }
+
+    // Scheduler host: whether jiggling is allowed at 'now', and when that can next change
+    static bool WindowOpen(uint64_t now, uint64_t* nextChange) {
+        const DaemonSettings& settings = g_Daemon->settings;
+        if (!settings.enableTimeRestriction) {
+            *nextChange = SCHEDULER_NEVER;
+            return true;
+        }
+
+        time_t seconds = (time_t)((now - DAEMON_EPOCH_OFFSET_MS) / 1000);
+        struct tm local;
+        localtime_r(&seconds, &local);
+        uint32_t msOfDay = (uint32_t)(((local.tm_hour * 60 + local.tm_min) * 60 + local.tm_sec) * 1000 + now % 1000);
+
+        TimeWindow window;
+        window.startMinutes = settings.startHour * 60 + settings.startMinute;
+        window.endMinutes = settings.endHour * 60 + settings.endMinute;
+        window.daysMask = 0;
+        for (int i = 0; i < 7; i++) {
+            if (settings.enabledDays[i]) window.daysMask |= 1u << i;
+        }
+        *nextChange = now + MsUntilWindowCheck(window, msOfDay);
+        return IsInTimeWindow(window, local.tm_wday, local.tm_hour * 60 + local.tm_min);
+    }
+
+    // Jiggle host
+    static uint64_t PeriodMs() { return (uint64_t)g_Daemon->settings.jigglePeriod * 1000; }
+    static uint64_t PhaseMs() { return (uint64_t)g_Daemon->settings.jigglePhase * 1000; }
+    static int MissedPolicy() { return g_Daemon->settings.missedJigglePolicy; }
+    static bool Adaptive() { return false; }
+    static uint64_t AdaptiveIdleWaitMs() { return 0; }
+    static void Unneeded(uint64_t) {}
+    static void Verify() {}
+
+    // Jiggle host: one batch for a deadline, out and back for zen or the pattern's next steps
+    static uint64_t Jiggle(uint64_t due, uint32_t count) {
+        (void)due;
+        JigglerDaemon* daemon = g_Daemon;
+        MJInputEvent events[MAX_JIGGLE_BURST * 2] = {};
+        uint32_t status[MAX_JIGGLE_BURST * 2];
+        uint32_t moves = 0;
+        uint64_t delivered;
+
+        if (daemon->settings.zenJiggle) {
+            for (uint32_t i = 0; i < count; i++) {
+                events[moves++].dx = 1;
+                events[moves++].dx = -1;
+            }
+            delivered = daemon->Submit(events, moves, status) / 2;
+        } else {
+            const DaemonPattern& pattern = g_DaemonPatterns[daemon->settings.jigglePattern];
+            for (uint32_t i = 0; i < count; i++) {
+                const int32_t* step = pattern.steps[(daemon->patternStep + i) % pattern.stepCount];
+                events[moves].dx = step[0];
+                events[moves++].dy = step[1];
+            }
+            delivered = daemon->Submit(events, moves, status);
+            daemon->patternStep = (int)((daemon->patternStep + delivered) % pattern.stepCount);
+        }
+
+        daemon->jigglesSent += delivered;
+        daemon->jiggleFailures += count - delivered;
+        return delivered;
+    }
+
+    // One batch through the sink, stamped with the scheduler clock in microseconds
+    uint32_t Submit(const MJInputEvent* events, uint32_t count, uint32_t* status) {
+        return sink.submit(sink.context, events, count, Now() * 1000, status);
+    }
+
+    static void DeadlineDone() {
+        g_Daemon->Publish();
+        g_Daemon->SaveState();
+    }
+
+    static void Started() {
+        g_Daemon->Publish();
+    }
+
+    static void Stopped() {
+        g_Daemon->Publish();
+    }
+
+    static void SpawnFailed(int task) {
+        DaemonLog("scheduler: no frame for the %s task", task == JIGGLE_TASK_JIGGLE ? "jiggle" : "time window");
+    }
+
+    static constexpr JiggleHost jiggleHost = {
+        PeriodMs, PhaseMs, MissedPolicy,
+        Adaptive, AdaptiveIdleWaitMs, Unneeded, Verify, 0,
+        Jiggle, DeadlineDone, Started, Stopped, SpawnFailed
+    };
+
+    // Load [Settings], the profiles and ActiveProfile, then apply the overrides
+    void LoadSettings() {
+        LoadIniFile(iniPath, &ini);
+
+        baseSettings = g_DaemonDefaults;
+        ReadDaemonSettings(&ini, "Settings", &baseSettings);
+
+        static char sections[4096];
+        GetIniSectionNames(&ini, sections, sizeof(sections));
+        size_t prefixLength = strlen(DAEMON_PROFILE_PREFIX);
+        profileCount = 0;
+        for (const char* section = sections; *section && profileCount < DAEMON_MAX_PROFILES; section += strlen(section) + 1) {
+            if (strncasecmp(section, DAEMON_PROFILE_PREFIX, prefixLength) != 0 || section[prefixLength] == '\0') {
+                continue;
+            }
+            DaemonProfile& profile = profiles[profileCount++];
+            snprintf(profile.name, sizeof(profile.name), "%s", section + prefixLength);
+            profile.settings = baseSettings;
+            ReadDaemonSettings(&ini, section, &profile.settings);
+        }
+
+        char name[DAEMON_PROFILE_NAME_LENGTH];
+        GetIniString(&ini, "Settings", "ActiveProfile", "", name, sizeof(name));
+        activeProfile = FindProfile(name);
+        settings = activeProfile < 0 ? baseSettings : profiles[activeProfile].settings;
+
+        ApplyOverrides();
+    }
+
+    int FindProfile(const char* name) const {
+        for (int i = 0; i < profileCount; i++) {
+            if (strcasecmp(profiles[i].name, name) == 0) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    // A profile replaces all jiggle settings, so -p goes first
+    void ApplyOverrides() {
+        if (overrides.profile[0]) {
+            int profile = FindProfile(overrides.profile);
+            if (profile >= 0) {
+                activeProfile = profile;
+                settings = profiles[profile].settings;
+            } else {
+                DaemonLog("unknown profile '%s'", overrides.profile);
+            }
+        }
+        if (overrides.zenJiggle) {
+            settings.zenJiggle = true;
+        }
+        if (overrides.jigglePeriod) {
+            settings.jigglePeriod = overrides.jigglePeriod;
+        }
+    }
+
+    // Reread the settings (SIGHUP, an edited INI file, the reload command) and retime
+    void Reload() {
+        stats.reloads++;
+        {
+            SubsystemScope scope(resources, SUBSYSTEM_SETTINGS);
+            LoadSettings();
+            RememberIniWrite();
+        }
+        Retime();
+    }
+
+    // Restart the tasks after the settings or the wall clock changed
+    void Retime() {
+        if (jiggle.isJiggling) {
+            jiggle.ScheduleNext();
+        }
+        jiggle.RestartTimeWindowTask(settings.enableTimeRestriction);
+        Publish();
+    }
+
+    // Remember the INI file's write time, size and inode, so the daemon's own write
+    // is not mistaken for an external edit. Returns whether any changed; a missing
+    // file counts as unchanged.
+    bool RememberIniWrite() {
+        struct stat st;
+        if (stat(iniPath, &st) != 0) {
+            return false;
+        }
+        bool changed = st.st_mtim.tv_sec != iniWriteTime.tv_sec || st.st_mtim.tv_nsec != iniWriteTime.tv_nsec ||
+                       st.st_size != iniSize || st.st_ino != iniInode;
+        iniWriteTime = st.st_mtim;
+        iniSize = st.st_size;
+        iniInode = st.st_ino;
+        return changed;
+    }
+
+    // Switch to a profile (-1 = [Settings]): swap in its settings, record the choice
+    // with a single write of ActiveProfile, as Main.cpp does, and retime once
+    void SwitchProfile(int profile) {
+        if (profile == activeProfile) {
+            return;
+        }
+        overrides.profile[0] = '\0';       // The user's choice replaces -p
+        activeProfile = profile;
+        settings = profile < 0 ? baseSettings : profiles[profile].settings;
+        if (overrides.zenJiggle) settings.zenJiggle = true;
+        if (overrides.jigglePeriod) settings.jigglePeriod = overrides.jigglePeriod;
+
+        {
+            SubsystemScope scope(resources, SUBSYSTEM_SETTINGS);
+            if (!SetIniString(&ini, iniPath, "Settings", "ActiveProfile", profile < 0 ? "" : profiles[profile].name)) {
+                DaemonLog("cannot write ActiveProfile to %s: %s", iniPath, strerror(errno));
+            }
+            RememberIniWrite();
+        }
+        Retime();
+    }
+
+    // Map the state file and recover the newest intact record
+    void OpenState() {
+        if (!statePath[0]) {
+            return;
+        }
+        int fd = open(statePath, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0 ||
+            (st.st_size < (off_t)sizeof(RuntimeStateFile) && ftruncate(fd, sizeof(RuntimeStateFile)) != 0)) {
+            DaemonLog("runtime state unavailable: %s: %s", statePath, strerror(errno));
+            if (fd >= 0) close(fd);
+            return;
+        }
+        void* view = mmap(nullptr, sizeof(RuntimeStateFile), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (view == MAP_FAILED) {
+            DaemonLog("runtime state unavailable: %s: %s", statePath, strerror(errno));
+            return;
+        }
+        stateFile = (RuntimeStateFile*)view;
+
+        int tornCount = 0;
+        const RuntimeRecord* newest = SelectRuntimeRecord(stateFile, &tornCount);
+        if (tornCount > 0) {
+            DaemonLog("runtime state: discarding torn record");
+        }
+        if (!newest) {
+            return;
+        }
+        stateSequence = newest->sequence;
+        patternStep = (int)newest->patternStep;
+        jigglesSent = newest->jigglesSent;
+        jiggleFailures = newest->jiggleFailures;
+        if (newest->isJiggling) {
+            resumeDue = AlignDeadline(newest->nextJiggleDue, PeriodMs(), PhaseMs());
+        }
+    }
+
+    void SaveState() {
+        if (!stateFile) return;
+
+        RuntimeRecord next = {};
+        next.sequence = ++stateSequence;
+        next.isJiggling = jiggle.isJiggling;
+        next.patternStep = (uint32_t)patternStep;
+        next.nextJiggleDue = jiggle.isJiggling ? jiggle.nextDue : 0;
+        next.jigglesSent = jigglesSent;
+        next.jiggleFailures = jiggleFailures;
+        next.savedAt = Now();
+        StoreRuntimeRecord(stateFile, &next);
+    }
+
+    void CloseState() {
+        if (stateFile) {
+            SaveState();
+            msync(stateFile, sizeof(RuntimeStateFile), MS_SYNC);
+            munmap(stateFile, sizeof(RuntimeStateFile));
+            stateFile = nullptr;
+        }
+    }
+
+    // Sample the resources, if the latest sample is older than RESOURCE_SAMPLE_MS
+    void SampleResources(bool now) {
+        uint64_t monotonicNs = DaemonClockNs(CLOCK_MONOTONIC);
+        if (!now && resources.samples > 0 && monotonicNs - resourcesSampledNs < RESOURCE_SAMPLE_MS * 1000000ull) {
+            return;
+        }
+        resourcesSampledNs = monotonicNs;
+        if (resources.Sample()) {
+            DaemonLog("resource alert: %lu file descriptors, %lu at start (possible leak)",
+                      (unsigned long)resources.latest.handleCount, (unsigned long)resources.baseline.handleCount);
+        }
+    }
+
+    // This instance's status as the registry publishes it
+    void GetStatus(InstanceStatus* out) const {
+        InstanceStatus status = {};
+        status.sessionId = sessionId;
+        status.isJiggling = jiggle.isJiggling;
+        status.zenJiggle = settings.zenJiggle;
+        status.jigglePeriod = (uint32_t)settings.jigglePeriod;
+        status.enableTimeRestriction = settings.enableTimeRestriction;
+        status.startMinutes = (uint32_t)(settings.startHour * 60 + settings.startMinute);
+        status.endMinutes = (uint32_t)(settings.endHour * 60 + settings.endMinute);
+        for (int i = 0; i < 7; i++) {
+            if (settings.enabledDays[i]) status.enabledDaysMask |= 1u << i;
+        }
+        status.nextJiggleDue = jiggle.isJiggling ? jiggle.nextDue : 0;
+        status.jigglesSent = jigglesSent;
+        status.jiggleFailures = jiggleFailures;
+        status.lastUpdate = Now();
+        status.handleCount = resources.latest.handleCount;
+        status.resourceAlert = resources.alert;
+        status.workingSet = resources.latest.workingSet;
+        status.privateBytes = resources.latest.privateBytes;
+        status.cpuTime = resources.latest.cpuTime;
+        for (int i = 0; i < SUBSYSTEM_COUNT; i++) {
+            status.subsystemCpuMs[i] = (uint32_t)resources.subsystemMs[i];
+        }
+        *out = status;
+    }
+
+    // Publish this instance's status to the registry (mousejigglerd -l and MouseJiggler -l alike)
+    void Publish() {
+        SampleResources(false);
+        if (!registrySlot) return;
+
+        InstanceStatus status;
+        GetStatus(&status);
+        WriteInstanceStatus(registrySlot, &status);
+    }
+
+    // Bind the control socket. A socket file left by a daemon that is gone is
+    // replaced; one that still answers means another daemon owns it.
+    bool OpenControlSocket() {
+        struct sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        snprintf(address.sun_path, sizeof(address.sun_path), "%s", socketPath);
+
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0) {
+            DaemonLog("control socket: %s", strerror(errno));
+            return false;
+        }
+        int result = bind(listenFd, (struct sockaddr*)&address, sizeof(address));
+        if (result != 0 && errno == EADDRINUSE) {
+            int probe = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            bool answered = probe >= 0 && connect(probe, (struct sockaddr*)&address, sizeof(address)) == 0;
+            if (probe >= 0) close(probe);
+            if (answered) {
+                DaemonLog("already running (%s)", socketPath);
+                close(listenFd);
+                listenFd = -1;
+                return false;
+            }
+            unlink(socketPath);
+            result = bind(listenFd, (struct sockaddr*)&address, sizeof(address));
+        }
+        if (result != 0 || listen(listenFd, DAEMON_MAX_CLIENTS) != 0) {
+            DaemonLog("control socket %s: %s", socketPath, strerror(errno));
+            return false;
+        }
+        return true;
+    }
+
+    bool Watch(int fd, uint64_t tag) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.u64 = tag;
+        return epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+    }
+
+    // Set up the descriptors, load the settings and start the tasks. Call it on the
+    // thread that calls Run, before any other thread starts, so every thread inherits
+    // the blocked signals. Returns false (after logging why) if the daemon cannot run.
+    bool Open() {
+        if (!sink.submit) {
+            DaemonLog("no input sink");
+            return false;
+        }
+        g_Daemon = this;
+        resources.host = &g_ProcResourceHost;
+        stats.startedNs = DaemonClockNs(CLOCK_MONOTONIC);
+        stats.cpuStartedNs = DaemonClockNs(CLOCK_THREAD_CPUTIME_ID);
+        for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+            clients[i].fd = -1;
+        }
+
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGHUP);
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+        signal(SIGPIPE, SIG_IGN);
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        timerFd = timerfd_create(CLOCK_REALTIME, TFD_NONBLOCK | TFD_CLOEXEC);
+        signalFd = signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC);
+        if (epollFd < 0 || timerFd < 0 || signalFd < 0 ||
+            !Watch(timerFd, DAEMON_TAG_TIMER) || !Watch(signalFd, DAEMON_TAG_SIGNAL)) {
+            DaemonLog("event loop: %s", strerror(errno));
+            return false;
+        }
+        if (!OpenControlSocket() || !Watch(listenFd, DAEMON_TAG_LISTEN)) {
+            return false;
+        }
+
+        // Watch the INI file's directory: editors often replace the file rather than rewrite it
+        char directory[PATH_MAX];
+        snprintf(directory, sizeof(directory), "%s", iniPath);
+        char* lastSlash = strrchr(directory, '/');
+        if (lastSlash) {
+            *(lastSlash == directory ? lastSlash + 1 : lastSlash) = '\0';
+        } else {
+            snprintf(directory, sizeof(directory), ".");
+        }
+        settingsFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if (settingsFd < 0 || inotify_add_watch(settingsFd, directory, IN_CLOSE_WRITE | IN_MOVED_TO) < 0 ||
+            !Watch(settingsFd, DAEMON_TAG_SETTINGS)) {
+            DaemonLog("settings file watch unavailable: %s", strerror(errno));
+            if (settingsFd >= 0) close(settingsFd);
+            settingsFd = -1;
+        }
+
+        {
+            SubsystemScope scope(resources, SUBSYSTEM_SETTINGS);
+            LoadSettings();
+            RememberIniWrite();
+        }
+        OpenState();
+
+        registrySlot = OpenInstanceRegistry(&registryIndex);
+        FILE* file = fopen("/proc/self/sessionid", "r");
+        if (file) {
+            unsigned long id = 0;
+            if (fscanf(file, "%lu", &id) == 1) sessionId = (uint32_t)id;
+            fclose(file);
+        }
+
+        scheduler.host.now = Now;
+        scheduler.host.idleTime = IdleTime;
+        scheduler.host.windowOpen = WindowOpen;
+        jiggle.scheduler = &scheduler;
+        jiggle.host = &jiggleHost;
+
+        // Start jiggling if requested; a resumed run keeps its deadline (missed-deadline policy applies)
+        if (overrides.startJiggling || resumeDue != 0) {
+            jiggle.Start();
+            if (resumeDue != 0 && jiggle.isJiggling) {
+                jiggle.nextDue = resumeDue;
+                jiggle.RestartJiggleTask();
+            }
+        }
+        jiggle.RestartTimeWindowTask(settings.enableTimeRestriction);
+        Publish();
+        ArmTimer();
+        return true;
+    }
+
+    void Close() {
+        jiggle.CancelAll();
+        CloseState();
+        if (registrySlot) {
+            ReleaseInstanceRegistry(registrySlot, registryIndex);
+            registrySlot = nullptr;
+        }
+        for (int i = 0; i < DAEMON_MAX_CLIENTS; i++) {
+            CloseClient(i);
+        }
+        if (listenFd >= 0) {
+            unlink(socketPath);
+        }
+        int* fds[] = { &settingsFd, &signalFd, &timerFd, &epollFd, &listenFd };
+        for (int* fd : fds) {
+            if (*fd >= 0) close(*fd);
+            *fd = -1;
+        }
+        if (g_Daemon == this) {
+            g_Daemon = nullptr;
+        }
+    }
+
+    // Arm the timer for the earliest wake-up of the tasks, or disarm it
+    void ArmTimer() {
+        struct itimerspec timer = {};
+        uint64_t wakeAt = scheduler.NextWake();
+        if (wakeAt != SCHEDULER_NEVER) {
+            uint64_t unixMs = wakeAt > DAEMON_EPOCH_OFFSET_MS ? wakeAt - DAEMON_EPOCH_OFFSET_MS : 1;
+            timer.it_value.tv_sec = (time_t)(unixMs / 1000);
+            timer.it_value.tv_nsec = (long)(unixMs % 1000) * 1000000;
+        }
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME | TFD_TIMER_CANCEL_ON_SET, &timer, nullptr);
+    }
+
+    void OnTimer() {
+        SubsystemScope scope(resources, SUBSYSTEM_TIMER);
+        stats.timerWakeups++;
+        uint64_t expirations;
+        if (read(timerFd, &expirations, sizeof(expirations)) < 0 && errno == ECANCELED) {
+            // Wall clock was set: realign deadlines and the time window to the new time
+            stats.clockChanges++;
+            if (jiggle.isJiggling) {
+                jiggle.ScheduleNext();
+            }
+            jiggle.RestartTimeWindowTask(settings.enableTimeRestriction);
+        }
+        scheduler.Run();
+    }
+
+    void OnSignal() {
+        stats.signalWakeups++;
+        struct signalfd_siginfo info;
+        while (read(signalFd, &info, sizeof(info)) == (ssize_t)sizeof(info)) {
+            if (info.ssi_signo == SIGHUP) {
+                Reload();
+            } else {
+                quitting = true;
+            }
+        }
+    }
+
+    // Something in the INI directory changed: reload only when MouseJiggler.ini itself
+    // was edited by someone else
+    void OnSettingsChanged() {
+        SubsystemScope scope(resources, SUBSYSTEM_SETTINGS);
+        stats.settingsWakeups++;
+        const char* lastSlash = strrchr(iniPath, '/');
+        const char* iniName = lastSlash ? lastSlash + 1 : iniPath;
+
+        alignas(struct inotify_event) char buffer[4096];
+        bool changed = false;
+        ssize_t length;
+        while ((length = read(settingsFd, buffer, sizeof(buffer))) > 0) {
+            for (char* position = buffer; position < buffer + length;) {
+                const struct inotify_event* event = (const struct inotify_event*)position;
+                if (event->len > 0 && strcmp(event->name, iniName) == 0) {
+                    changed = true;
+                }
+                position += sizeof(struct inotify_event) + event->len;
+            }
+        }
+        if (changed && RememberIniWrite()) {
+            Reload();
+        }
+    }
+
+    void OnAccept() {
+        SubsystemScope scope(resources, SUBSYSTEM_TRAY);
+        stats.controlWakeups++;
+        int fd;
+        while ((fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC)) >= 0) {
+            int i = 0;
+            while (i < DAEMON_MAX_CLIENTS && clients[i].fd >= 0) i++;
+            if (i == DAEMON_MAX_CLIENTS || !Watch(fd, DAEMON_TAG_CLIENT + i)) {
+                static const char busy[] = "error: too many clients\n";
+                send(fd, busy, sizeof(busy) - 1, MSG_NOSIGNAL);
+                close(fd);
+                continue;
+            }
+            clients[i].fd = fd;
+            clients[i].length = 0;
+        }
+    }
+
+    void CloseClient(int i) {
+        if (clients[i].fd >= 0) {
+            close(clients[i].fd);   // Also leaves the epoll set
+            clients[i].fd = -1;
+        }
+    }
+
+    // Run each complete line a client sent as a command and send back its reply
+    void OnClient(int i) {
+        SubsystemScope scope(resources, SUBSYSTEM_TRAY);
+        stats.controlWakeups++;
+        DaemonClient& client = clients[i];
+        for (;;) {
+            ssize_t received = recv(client.fd, client.command + client.length,
+                                    sizeof(client.command) - 1 - client.length, 0);
+            if (received == 0 || (received < 0 && errno != EAGAIN && errno != EINTR)) {
+                CloseClient(i);
+                return;
+            }
+            if (received < 0) {
+                return;
+            }
+            client.length += (size_t)received;
+            client.command[client.length] = '\0';
+
+            char* newline;
+            while ((newline = strchr(client.command, '\n')) != NULL) {
+                *newline = '\0';
+                if (newline > client.command && newline[-1] == '\r') newline[-1] = '\0';
+
+                char reply[DAEMON_REPLY_LENGTH];
+                RunCommand(client.command, reply, sizeof(reply));
+                send(client.fd, reply, strlen(reply), MSG_NOSIGNAL);
+
+                size_t rest = client.length - (size_t)(newline + 1 - client.command);
+                memmove(client.command, newline + 1, rest + 1);
+                client.length = rest;
+            }
+            if (client.length == sizeof(client.command) - 1) {
+                static const char tooLong[] = "error: command too long\n";
+                send(client.fd, tooLong, sizeof(tooLong) - 1, MSG_NOSIGNAL);
+                CloseClient(i);
+                return;
+            }
+        }
+    }
+
+    // One control command; 'reply' receives a single line
+    void RunCommand(char* command, char* reply, size_t replySize) {
+        stats.commands++;
+        char* argument = strchr(command, ' ');
+        if (argument) {
+            *argument++ = '\0';
+            while (*argument == ' ') argument++;
+        }
+
+        snprintf(reply, replySize, "ok\n");
+        if (strcmp(command, "status") == 0) {
+            FormatStatus(reply, replySize);
+        } else if (strcmp(command, "resources") == 0) {
+            SampleResources(true);
+            InstanceStatus status;
+            GetStatus(&status);
+            FormatResourceLine(reply, replySize, status, resources.baseline.handleCount);
+        } else if (strcmp(command, "start") == 0) {
+            jiggle.Start();
+        } else if (strcmp(command, "stop") == 0) {
+            jiggle.Stop();
+        } else if (strcmp(command, "toggle") == 0) {
+            if (jiggle.isJiggling) jiggle.Stop(); else jiggle.Start();
+        } else if (strcmp(command, "reload") == 0) {
+            Reload();
+        } else if (strcmp(command, "profile") == 0) {
+            int profile = argument && *argument ? FindProfile(argument) : -1;
+            if (argument && *argument && profile < 0) {
+                snprintf(reply, replySize, "error: unknown profile\n");
+            } else {
+                SwitchProfile(profile);
+            }
+        } else if (strcmp(command, "quit") == 0) {
+            quitting = true;
+        } else {
+            snprintf(reply, replySize, "error: unknown command (status, resources, start, stop, toggle, reload, profile [name], quit)\n");
+        }
+    }
+
+    // Status line, also the soak report: wakeups per hour and CPU time of the loop
+    // since Open (the daemon is single-threaded, so the thread's CPU time is all of it)
+    void FormatStatus(char* buffer, size_t bufferSize) const {
+        double uptime = (double)(DaemonClockNs(CLOCK_MONOTONIC) - stats.startedNs) / 1e9;
+        double cpu = (double)(DaemonClockNs(CLOCK_THREAD_CPUTIME_ID) - stats.cpuStartedNs) / 1e9;
+        snprintf(buffer, bufferSize,
+                 "%s period=%d zen=%d scheduled=%d profile=%s jiggles=%llu failures=%llu reloads=%llu "
+                 "wakeups=%llu timer=%llu signal=%llu settings=%llu control=%llu uptime_s=%.1f "
+                 "wakeups_per_hour=%.1f cpu_s=%.6f cpu_percent=%.5f\n",
+                 jiggle.isJiggling ? "jiggling" : "idle", settings.jigglePeriod, settings.zenJiggle ? 1 : 0,
+                 settings.enableTimeRestriction ? 1 : 0, activeProfile < 0 ? "-" : profiles[activeProfile].name,
+                 (unsigned long long)jigglesSent, (unsigned long long)jiggleFailures, (unsigned long long)stats.reloads,
+                 (unsigned long long)stats.wakeups, (unsigned long long)stats.timerWakeups,
+                 (unsigned long long)stats.signalWakeups, (unsigned long long)stats.settingsWakeups,
+                 (unsigned long long)stats.controlWakeups, uptime,
+                 uptime > 0 ? (double)stats.wakeups * 3600.0 / uptime : 0.0, cpu,
+                 uptime > 0 ? 100.0 * cpu / uptime : 0.0);
+    }
+
+    // The event loop: sleep in epoll_wait until a descriptor is ready, handle it,
+    // re-arm the timer. Returns 0 on shutdown, 1 if the loop failed.
+    int Run() {
+        struct epoll_event events[DAEMON_TAG_CLIENT + DAEMON_MAX_CLIENTS];
+        while (!quitting) {
+            int count = epoll_wait(epollFd, events, DAEMON_TAG_CLIENT + DAEMON_MAX_CLIENTS, -1);
+            if (count < 0) {
+                if (errno == EINTR) continue;
+                DaemonLog("epoll_wait: %s", strerror(errno));
+                return 1;
+            }
+            stats.wakeups++;
+
+            for (int i = 0; i < count; i++) {
+                uint64_t tag = events[i].data.u64;
+                if (tag == DAEMON_TAG_TIMER) {
+                    OnTimer();
+                } else if (tag == DAEMON_TAG_SIGNAL) {
+                    OnSignal();
+                } else if (tag == DAEMON_TAG_SETTINGS) {
+                    OnSettingsChanged();
+                } else if (tag == DAEMON_TAG_LISTEN) {
+                    OnAccept();
+                } else if (clients[tag - DAEMON_TAG_CLIENT].fd >= 0) {
+                    OnClient((int)(tag - DAEMON_TAG_CLIENT));
+                }
+            }
+            ArmTimer();
+        }
+        return 0;
+    }
+};
@@ -0,0 +1,189 @@
+// MouseJiggler - Instance registry on POSIX shared memory
+//
+// The Linux side of InstanceRegistry.h: one shared memory object per slot,
+// /ArkaneSystems.MouseJiggler.SlotNN, created by its first owner with mode 0644.
+// Only processes of that user can claim or write the slot; everyone can map it
+// read-only to see who is jiggling. An owner unlinks its object before releasing
+// it, and a slot whose owner died is reclaimed by the same user once its PID is
+// gone or belongs to a process started at another time.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../InstanceRegistry.h"
+
+#ifndef REGISTRY_SHM_NAME
+#define REGISTRY_SHM_NAME       "/ArkaneSystems.MouseJiggler.Slot%02d"
+#endif
+
+// Start time of a process in clock ticks after boot (field 22 of /proc/<pid>/stat), 0 if unknown
+inline uint64_t GetProcessStartTime(int32_t pid) {
+    char path[64];
+    snprintf(path, sizeof(path), "/proc/%d/stat", (int)pid);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return 0;
+    }
+    char line[1024];
+    size_t length = fread(line, 1, sizeof(line) - 1, file);
+    fclose(file);
+    line[length] = '\0';
+
+    // The command name may contain spaces and parentheses; fields resume after the last ')'
+    const char* field = strrchr(line, ')');
+    for (int i = 2; field && i < 22; i++) {
+        field = strchr(field + 1, ' ');
+    }
+    return field ? strtoull(field + 1, NULL, 10) : 0;
+}
+
+// Whether the process that owns a slot has exited. A live process with the same
+// PID but another start time is a different process.
+inline bool IsSlotOwnerGone(int32_t pid, uint64_t created) {
+    if (kill(pid, 0) != 0 && errno == ESRCH) {
+        return true;
+    }
+    if (created == 0) {
+        return false;
+    }
+    uint64_t actual = GetProcessStartTime(pid);
+    return actual != 0 && actual != created;
+}
+
+inline void GetRegistrySlotName(int index, char* name, size_t nameSize) {
+    snprintf(name, nameSize, REGISTRY_SHM_NAME, index);
+}
+
+// Map one slot. A writable map creates the object if needed and fails on
+// another user's slot; a read-only map never creates anything. 'inode'
+// receives the object's identity, if wanted.
+inline InstanceSlot* MapRegistrySlot(int index, bool writable, ino_t* inode = nullptr) {
+    char name[64];
+    GetRegistrySlotName(index, name, sizeof(name));
+
+    int fd;
+    if (writable) {
+        fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0644);
+        if (fd >= 0) {
+            fchmod(fd, 0644);       // Readable by everyone whatever the umask
+        } else if (errno == EEXIST) {
+            fd = shm_open(name, O_RDWR, 0);
+        }
+    } else {
+        fd = shm_open(name, O_RDONLY, 0);
+    }
+    if (fd < 0) {
+        return nullptr;
+    }
+
+    // A new object is extended with zeros (a free slot); a reader skips one
+    // whose creator has not sized it yet
+    struct stat st;
+    bool sized = fstat(fd, &st) == 0 && st.st_size >= (off_t)sizeof(InstanceSlot);
+    if (inode) *inode = st.st_ino;
+    if (!sized && writable) {
+        sized = ftruncate(fd, sizeof(InstanceSlot)) == 0;
+    }
+    void* view = MAP_FAILED;
+    if (sized) {
+        view = mmap(nullptr, sizeof(InstanceSlot), writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd);
+    return view == MAP_FAILED ? nullptr : (InstanceSlot*)view;
+}
+
+inline void UnmapRegistrySlot(const InstanceSlot* slot) {
+    munmap((void*)slot, sizeof(InstanceSlot));
+}
+
+// Whether the object mapped from slot 'index' is still the one under its name
+inline bool IsRegistrySlotLinked(int index, ino_t inode) {
+    char name[64];
+    GetRegistrySlotName(index, name, sizeof(name));
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat st;
+    bool linked = fstat(fd, &st) == 0 && st.st_ino == inode;
+    close(fd);
+    return linked;
+}
+
+// Claim a slot for this process; null if none is free or reclaimable.
+// *index receives the slot number, for ReleaseInstanceRegistry.
+inline InstanceSlot* OpenInstanceRegistry(int* index) {
+    int32_t pid = (int32_t)getpid();
+    uint64_t created = GetProcessStartTime(pid);
+    for (int i = 0; i < REGISTRY_MAX_SLOTS; i++) {
+        ino_t inode = 0;
+        InstanceSlot* slot = MapRegistrySlot(i, true, &inode);
+        if (!slot) {
+            continue;
+        }
+        if (ClaimInstanceSlot(slot, pid, created, IsSlotOwnerGone)) {
+            // The previous owner unlinks before it releases, so an object it
+            // freed under us is no longer visible to monitors: leave it
+            if (IsRegistrySlotLinked(i, inode)) {
+                *index = i;
+                return slot;
+            }
+            ReleaseInstanceSlot(slot, pid);
+        }
+        UnmapRegistrySlot(slot);
+    }
+    return nullptr;
+}
+
+// Unlink this process's slot, then free it (see OpenInstanceRegistry)
+inline void ReleaseInstanceRegistry(InstanceSlot* slot, int index) {
+    if (slot) {
+        char name[64];
+        GetRegistrySlotName(index, name, sizeof(name));
+        shm_unlink(name);
+        ReleaseInstanceSlot(slot, (int32_t)getpid());
+        UnmapRegistrySlot(slot);
+    }
+}
+
+// Every existing slot mapped read-only, for a monitor that reads the registry
+// repeatedly without reopening it (slots created later need a new view)
+struct RegistryView {
+    const InstanceSlot* slots[REGISTRY_MAX_SLOTS];
+};
+
+inline void OpenRegistryView(RegistryView* view) {
+    for (int i = 0; i < REGISTRY_MAX_SLOTS; i++) {
+        view->slots[i] = MapRegistrySlot(i, false);
+    }
+}
+
+inline void CloseRegistryView(RegistryView* view) {
+    for (int i = 0; i < REGISTRY_MAX_SLOTS; i++) {
+        if (view->slots[i]) UnmapRegistrySlot(view->slots[i]);
+        view->slots[i] = nullptr;
+    }
+}
+
+// Copy the status of every running instance; returns how many were found
+inline int ReadRegistryView(const RegistryView* view, InstanceOwner* owners, InstanceStatus* statuses) {
+    int found = 0;
+    for (int i = 0; i < REGISTRY_MAX_SLOTS; i++) {
+        if (!view->slots[i] || !ReadInstanceSlot(view->slots[i], &owners[found], &statuses[found])) {
+            continue;
+        }
+        if (IsSlotOwnerGone(owners[found].pid, owners[found].created)) {
+            continue;   // Left behind by a crashed instance or a reboot
+        }
+        found++;
+    }
+    return found;
+}
@@ -0,0 +1,126 @@
+// MouseJiggler - Resource samples from /proc
+//
+// The Linux side of ResourceMonitor.h: resident and anonymous memory from
+// <proc>/status, process CPU time from <proc>/stat and open file descriptors
+// (the counterpart of kernel handles) from <proc>/fd. There are no GDI or USER
+// objects, so those stay 0. The directory is a parameter so the tests can
+// point it at a fake /proc; the daemon samples /proc/self. The thread clock is
+// CLOCK_THREAD_CPUTIME_ID, already in ns.
+
+#pragma once
+
+#include <dirent.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "../ResourceMonitor.h"
+
+#define PROC_SELF               "/proc/self"
+#define PROC_FILE_LENGTH        4096
+
+// Read a small /proc file into 'text'; false if it cannot be read
+inline bool ReadProcFile(const char* procDir, const char* name, char* text, size_t textSize) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/%s", procDir, name);
+    FILE* file = fopen(path, "r");
+    if (!file) {
+        return false;
+    }
+    size_t length = fread(text, 1, textSize - 1, file);
+    fclose(file);
+    text[length] = '\0';
+    return length > 0;
+}
+
+// "Key:   1234 kB" from <proc>/status, in bytes; false if the key is missing
+inline bool ParseProcStatusKb(const char* text, const char* key, uint64_t* bytes) {
+    size_t keyLength = strlen(key);
+    const char* line = text;
+    while (line) {
+        if (strncmp(line, key, keyLength) == 0 && line[keyLength] == ':') {
+            *bytes = strtoull(line + keyLength + 1, nullptr, 10) * 1024;
+            return true;
+        }
+        line = strchr(line, '\n');
+        if (line) line++;
+    }
+    return false;
+}
+
+// utime + stime (fields 14 and 15 of <proc>/stat) in ms; false if the line is malformed
+inline bool ParseProcStatCpuMs(const char* text, long ticksPerSecond, uint64_t* cpuMs) {
+    // The command name may contain spaces and parentheses; fields resume after the last ')'
+    const char* field = strrchr(text, ')');
+    for (int i = 2; field && i < 14; i++) {
+        field = strchr(field + 1, ' ');
+    }
+    if (!field || ticksPerSecond <= 0) {
+        return false;
+    }
+    char* end;
+    uint64_t user = strtoull(field + 1, &end, 10);
+    if (end == field + 1) {
+        return false;
+    }
+    uint64_t system = strtoull(end, nullptr, 10);
+    *cpuMs = (user + system) * 1000 / (uint64_t)ticksPerSecond;
+    return true;
+}
+
+// Open descriptors in <proc>/fd, not counting the one used to list them
+inline bool CountProcFds(const char* procDir, uint32_t* count) {
+    char path[256];
+    snprintf(path, sizeof(path), "%s/fd", procDir);
+    DIR* directory = opendir(path);
+    if (!directory) {
+        return false;
+    }
+    uint32_t entries = 0;
+    while (const struct dirent* entry = readdir(directory)) {
+        if (entry->d_name[0] != '.') entries++;
+    }
+    closedir(directory);
+    *count = entries > 0 && strcmp(procDir, PROC_SELF) == 0 ? entries - 1 : entries;
+    return true;
+}
+
+inline bool SampleProcResources(const char* procDir, ResourceSample* out) {
+    char text[PROC_FILE_LENGTH];
+    ResourceSample sample = {};
+
+    if (!ReadProcFile(procDir, "status", text, sizeof(text)) ||
+        !ParseProcStatusKb(text, "VmRSS", &sample.workingSet)) {
+        return false;
+    }
+    ParseProcStatusKb(text, "RssAnon", &sample.privateBytes);   // Linux 4.5 and later
+
+    if (!ReadProcFile(procDir, "stat", text, sizeof(text)) ||
+        !ParseProcStatCpuMs(text, sysconf(_SC_CLK_TCK), &sample.cpuTime)) {
+        return false;
+    }
+    if (!CountProcFds(procDir, &sample.handleCount)) {
+        return false;
+    }
+    *out = sample;
+    return true;
+}
+
+// ResourceHost of this process
+inline bool SampleSelfResources(ResourceSample* out) {
+    return SampleProcResources(PROC_SELF, out);
+}
+
+inline uint64_t GetThreadCpuNs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+inline double GetThreadCpuMsFromNs() {
+    return (double)GetThreadCpuNs() / 1e6;
+}
+
+inline const ResourceHost g_ProcResourceHost = { SampleSelfResources, GetThreadCpuNs, GetThreadCpuMsFromNs };
@@ -0,0 +1,122 @@
+// MouseJiggler - uinput input sink
+//
+// The built-in input sink on Linux (InputSink.h). Jiggles are relative motion
+// events of a virtual pointer created through /dev/uinput, so they reach the
+// kernel's input layer the same way a real mouse does and reset idle timers
+// with or without a display server. A batch is one write() of all its events,
+// each movement followed by a SYN_REPORT, so a catch-up burst costs one system
+// call. Needs write access to /dev/uinput (root, or a udev rule granting it to
+// the user). linux/UinputSinkPlugin.cpp exports the same sink as a plugin, the
+// reference for sinks loaded with InputSink=.
+
+#pragma once
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <stdint.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+#include "../InputSink.h"
+
+#define UINPUT_DEVICE_PATH      "/dev/uinput"
+#define UINPUT_DEVICE_NAME      "MouseJiggler virtual pointer"
+#define UINPUT_MAX_BATCH        32      // Events per write()
+
+// Create the virtual pointer; returns its descriptor, or -1 with errno set
+inline int OpenUinputPointer() {
+    int fd = open(UINPUT_DEVICE_PATH, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        return -1;
+    }
+
+    // A button makes input stacks classify the device as a mouse
+    struct uinput_setup setup;
+    memset(&setup, 0, sizeof(setup));
+    setup.id.bustype = BUS_VIRTUAL;
+    setup.id.vendor = 0x4D4A;   // 'MJ'
+    setup.id.product = 0x4A47;  // 'JG'
+    strncpy(setup.name, UINPUT_DEVICE_NAME, UINPUT_MAX_NAME_SIZE - 1);
+
+    if (ioctl(fd, UI_SET_EVBIT, EV_KEY) < 0 || ioctl(fd, UI_SET_KEYBIT, BTN_LEFT) < 0 ||
+        ioctl(fd, UI_SET_EVBIT, EV_REL) < 0 || ioctl(fd, UI_SET_RELBIT, REL_X) < 0 ||
+        ioctl(fd, UI_SET_RELBIT, REL_Y) < 0 ||
+        ioctl(fd, UI_DEV_SETUP, &setup) < 0 || ioctl(fd, UI_DEV_CREATE) < 0) {
+        int error = errno;
+        close(fd);
+        errno = error;
+        return -1;
+    }
+    return fd;
+}
+
+inline void CloseUinputPointer(int fd) {
+    if (fd >= 0) {
+        ioctl(fd, UI_DEV_DESTROY);
+        close(fd);
+    }
+}
+
+inline void SetUinputEvent(struct input_event* event, uint16_t type, uint16_t code, int32_t value) {
+    memset(event, 0, sizeof(*event));
+    event->type = type;
+    event->code = code;
+    event->value = value;
+}
+
+// Sink submit; the context is the descriptor. Key events carry Win32 virtual
+// key codes and are not supported. The kernel drops zero motion, so a movement
+// of (0, 0) is delivered but registers no activity; hosts jiggle out and back.
+inline uint32_t MJ_CALL UinputSinkSubmit(void* context, const MJInputEvent* events, uint32_t count,
+                                         uint64_t timestampUs, uint32_t* status) {
+    (void)timestampUs;
+    int fd = (int)(intptr_t)context;
+    uint32_t delivered = 0;
+
+    for (uint32_t first = 0; first < count; first += UINPUT_MAX_BATCH) {
+        uint32_t last = first + UINPUT_MAX_BATCH < count ? first + UINPUT_MAX_BATCH : count;
+        struct input_event inputs[UINPUT_MAX_BATCH * 3];
+        size_t used = 0;
+        uint32_t moves = 0;
+        for (uint32_t i = first; i < last; i++) {
+            if (events[i].type != MJ_EVENT_MOVE) {
+                status[i] = MJ_SINK_UNSUPPORTED;
+                continue;
+            }
+            if (events[i].dx) SetUinputEvent(&inputs[used++], EV_REL, REL_X, events[i].dx);
+            if (events[i].dy) SetUinputEvent(&inputs[used++], EV_REL, REL_Y, events[i].dy);
+            SetUinputEvent(&inputs[used++], EV_SYN, SYN_REPORT, 0);
+            moves++;
+        }
+        if (moves == 0) continue;
+
+        // uinput takes whole events, so a write succeeds or fails as a unit
+        ssize_t written = write(fd, inputs, used * sizeof(struct input_event));
+        uint32_t result = MJ_SINK_OK;
+        if (written != (ssize_t)(used * sizeof(struct input_event))) {
+            result = (written < 0 && (errno == EACCES || errno == EPERM)) ? MJ_SINK_DENIED : MJ_SINK_FAILED;
+        }
+        for (uint32_t i = first; i < last; i++) {
+            if (events[i].type == MJ_EVENT_MOVE) status[i] = result;
+        }
+        if (result == MJ_SINK_OK) delivered += moves;
+    }
+    return delivered;
+}
+
+inline void MJ_CALL UinputSinkDestroy(void* context) {
+    CloseUinputPointer((int)(intptr_t)context);
+}
+
+// Fill in a uinput sink that writes to 'fd' (a uinput device, or any descriptor
+// for measurements) and owns it
+inline void UseUinputSink(MJInputSink* sink, int fd) {
+    memset(sink, 0, sizeof(*sink));
+    sink->abiVersion = MJ_INPUT_SINK_ABI_VERSION;
+    sink->size = sizeof(MJInputSink);
+    sink->name = "uinput";
+    sink->context = (void*)(intptr_t)fd;
+    sink->submit = UinputSinkSubmit;
+    sink->destroy = UinputSinkDestroy;
+}
@@ -0,0 +1,21 @@
+// MouseJiggler - uinput sink as a plugin
+//
+// The reference for input sink plugins on Linux: the built-in uinput sink
+// (UinputSink.h) exported from a shared object. Build with make -C linux and
+// select it with InputSink=libmjuinput.so next to MouseJiggler.ini.
+
+#include "UinputSink.h"
+
+extern "C" __attribute__((visibility("default")))
+int MJ_CALL MJCreateInputSink(uint32_t hostAbiVersion, MJInputSink* sink) {
+    if (hostAbiVersion < 1) {
+        return 0;
+    }
+    int fd = OpenUinputPointer();
+    if (fd < 0) {
+        return 0;
+    }
+    UseUinputSink(sink, fd);
+    sink->name = "uinput (plugin)";
+    return 1;
+}
@@ -0,0 +1,335 @@
+// MouseJiggler - Linux daemon entry point
+//
+// Parses the command line, resolves the per-user paths, sets up the input sink
+// and runs the event loop in JigglerDaemon.h. With -C it is instead a
+// client that sends one control command to the running daemon and prints the
+// reply, with -l it lists every running instance from the registry, and with
+// --probe it measures injection through the sink (EvdevProbe.h). Build with
+// make -C linux.
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include "EvdevProbe.h"
+#include "JigglerDaemon.h"
+#include "UinputSink.h"
+
+static JigglerDaemon g_Jiggler;
+static void* g_SinkModule = NULL;   // Sink shared object, if one is loaded
+static IniFile g_SinkIni;
+
+// Null sink (-n or InputSink=Null): counts events and delivers nothing, to measure the daemon itself
+static uint64_t g_NullSinkEvents = 0;
+
+static uint32_t MJ_CALL NullSinkSubmit(void* context, const MJInputEvent* events, uint32_t count,
+                                       uint64_t timestampUs, uint32_t* status) {
+    (void)events;
+    (void)timestampUs;
+    *(uint64_t*)context += count;
+    for (uint32_t i = 0; i < count; i++) {
+        status[i] = MJ_SINK_OK;
+    }
+    return count;
+}
+
+static void UseNullSink(MJInputSink* sink) {
+    memset(sink, 0, sizeof(*sink));
+    sink->abiVersion = MJ_INPUT_SINK_ABI_VERSION;
+    sink->size = sizeof(MJInputSink);
+    sink->name = "Null";
+    sink->context = &g_NullSinkEvents;
+    sink->submit = NullSinkSubmit;
+}
+
+// Set up the sink named by InputSink= in [Settings], as LoadInputSink in Main.cpp
+// does: empty or "uinput" for the virtual pointer, "Null", or a shared object
+// exporting MJCreateInputSink (relative paths are next to the INI file). Unlike
+// the Windows build, a sink that cannot be loaded is an error rather than a
+// fallback: the uinput sink may not be usable either.
+static bool LoadDaemonInputSink(const char* iniPath, bool nullSink, MJInputSink* sink) {
+    char name[PATH_MAX];
+    LoadIniFile(iniPath, &g_SinkIni);
+    GetIniString(&g_SinkIni, "Settings", "InputSink", "", name, sizeof(name));
+
+    if (nullSink || strcasecmp(name, "Null") == 0) {
+        UseNullSink(sink);
+        return true;
+    }
+
+    if (name[0] == '\0' || strcasecmp(name, "uinput") == 0) {
+        int fd = OpenUinputPointer();
+        if (fd < 0) {
+            DaemonLog("cannot create the virtual pointer: %s: %s (needs write access; see -n)",
+                      UINPUT_DEVICE_PATH, strerror(errno));
+            return false;
+        }
+        UseUinputSink(sink, fd);
+        return true;
+    }
+
+    char path[PATH_MAX];
+    size_t length = strnlen(iniPath, sizeof(path) - 1);
+    memcpy(path, iniPath, length);
+    path[length] = '\0';
+    char* lastSlash = strrchr(path, '/');
+    if (name[0] != '/' && lastSlash) {
+        snprintf(lastSlash + 1, sizeof(path) - (size_t)(lastSlash + 1 - path), "%s", name);
+    } else {
+        snprintf(path, sizeof(path), "%s", name);
+    }
+
+    g_SinkModule = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+    if (!g_SinkModule) {
+        DaemonLog("cannot load input sink: %s", dlerror());
+        return false;
+    }
+
+    MJCreateInputSinkFn create = (MJCreateInputSinkFn)dlsym(g_SinkModule, MJ_INPUT_SINK_ENTRY);
+    MJInputSink loaded = {};    // Fields an older sink does not know stay zero
+    if (!create || !create(MJ_INPUT_SINK_ABI_VERSION, &loaded) ||
+        loaded.abiVersion == 0 || loaded.abiVersion > MJ_INPUT_SINK_ABI_VERSION ||
+        loaded.size < MJ_INPUT_SINK_V1_SIZE || !loaded.submit) {
+        DaemonLog("input sink failed to start or is not compatible: %s", path);
+        if (create && loaded.destroy) loaded.destroy(loaded.context);
+        dlclose(g_SinkModule);
+        g_SinkModule = NULL;
+        return false;
+    }
+    *sink = loaded;
+    return true;
+}
+
+static void UnloadDaemonInputSink(MJInputSink* sink) {
+    if (sink->destroy) {
+        sink->destroy(sink->context);
+    }
+    memset(sink, 0, sizeof(*sink));
+    if (g_SinkModule) {
+        dlclose(g_SinkModule);
+        g_SinkModule = NULL;
+    }
+}
+
+// $XDG_<name>_HOME, or $HOME/<fallback>; created (one level) if missing
+static void GetUserDirectory(const char* variable, const char* fallback, char* out, size_t outSize) {
+    const char* base = getenv(variable);
+    if (base && base[0] == '/') {
+        snprintf(out, outSize, "%s", base);
+    } else {
+        const char* home = getenv("HOME");
+        snprintf(out, outSize, "%s/%s", home ? home : "", fallback);
+    }
+    mkdir(out, 0700);
+}
+
+static void GetDefaultPaths(JigglerDaemon* daemon) {
+    char directory[PATH_MAX - 64];
+
+    GetUserDirectory("XDG_CONFIG_HOME", ".config", directory, sizeof(directory));
+    snprintf(daemon->iniPath, sizeof(daemon->iniPath), "%s/MouseJiggler", directory);
+    mkdir(daemon->iniPath, 0700);
+    snprintf(daemon->iniPath, sizeof(daemon->iniPath), "%s/MouseJiggler/MouseJiggler.ini", directory);
+
+    GetUserDirectory("XDG_STATE_HOME", ".local/state", directory, sizeof(directory));
+    snprintf(daemon->statePath, sizeof(daemon->statePath), "%s/MouseJiggler.state", directory);
+
+    const char* runtime = getenv("XDG_RUNTIME_DIR");
+    if (runtime && runtime[0] == '/') {
+        snprintf(daemon->socketPath, sizeof(daemon->socketPath), "%s/mousejiggler.sock", runtime);
+    } else {
+        snprintf(daemon->socketPath, sizeof(daemon->socketPath), "/tmp/mousejiggler-%u.sock", (unsigned)getuid());
+    }
+}
+
+// Send one command to the running daemon and print its reply
+static int SendControlCommand(const char* socketPath, const char* command) {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, socketPath, strnlen(socketPath, sizeof(address.sun_path) - 1));
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        fprintf(stderr, "mousejigglerd: not running (%s: %s)\n", socketPath, strerror(errno));
+        return 1;
+    }
+
+    char line[DAEMON_COMMAND_LENGTH];
+    snprintf(line, sizeof(line), "%s\n", command);
+    char reply[DAEMON_REPLY_LENGTH];
+    ssize_t length = -1;
+    if (send(fd, line, strlen(line), MSG_NOSIGNAL) == (ssize_t)strlen(line)) {
+        length = recv(fd, reply, sizeof(reply) - 1, 0);
+    }
+    close(fd);
+    if (length <= 0) {
+        fprintf(stderr, "mousejigglerd: no reply\n");
+        return 1;
+    }
+    reply[length] = '\0';
+    fputs(reply, stdout);
+    return strncmp(reply, "error", 5) == 0 ? 1 : 0;
+}
+
+// Every running instance on the machine (-l, --list), daemons and Windows builds alike
+static int ListInstances() {
+    static RegistryView view;
+    static InstanceOwner owners[REGISTRY_MAX_SLOTS];
+    static InstanceStatus statuses[REGISTRY_MAX_SLOTS];
+    OpenRegistryView(&view);
+    int found = ReadRegistryView(&view, owners, statuses);
+    CloseRegistryView(&view);
+
+    if (found == 0) {
+        printf("No running Mouse Jiggler instances found.\n");
+    }
+    for (int i = 0; i < found; i++) {
+        const InstanceStatus& status = statuses[i];
+        char resources[DAEMON_REPLY_LENGTH];
+        FormatResourceLine(resources, sizeof(resources), status, 0);
+        printf("Session %lu (PID %ld): %s, %lu s%s%s, %llu jiggles, %llu failed\n    %s",
+               (unsigned long)status.sessionId, (long)owners[i].pid, status.isJiggling ? "jiggling" : "idle",
+               (unsigned long)status.jigglePeriod, status.zenJiggle ? ", zen" : "",
+               status.enableTimeRestriction ? ", scheduled" : "",
+               (unsigned long long)status.jigglesSent, (unsigned long long)status.jiggleFailures, resources);
+    }
+    return 0;
+}
+
+// Injection probe (--probe): jiggle through the sink and read the jiggles back
+// from the virtual pointer's evdev node; runs without a display and writes
+// MouseJiggler-probe.txt next to the INI file, as the Windows build does
+static int RunInjectionProbe(const char* iniPath, const MJInputSink* sink, int samples) {
+    int evdevFd = -1;
+    if (sink->submit != NullSinkSubmit) {
+        // The built-in sink's context is its uinput descriptor
+        evdevFd = OpenUinputEvdev(sink->submit == UinputSinkSubmit ? (int)(intptr_t)sink->context : -1);
+        if (evdevFd < 0) {
+            DaemonLog("cannot read the virtual pointer's evdev node: %s (needs read access to /dev/input)",
+                      strerror(errno));
+        }
+    }
+
+    static char report[2048];
+    RunEvdevProbe(sink, evdevFd, samples, PROBE_TIMEOUT_MS, report, sizeof(report));
+    if (evdevFd >= 0) {
+        close(evdevFd);
+    }
+    fputs(report, stdout);
+
+    char reportPath[PATH_MAX];
+    size_t length = strnlen(iniPath, sizeof(reportPath) - 16);
+    memcpy(reportPath, iniPath, length);
+    reportPath[length] = '\0';
+    char* extension = strrchr(reportPath, '.');
+    if (extension && !strchr(extension, '/')) {
+        *extension = '\0';
+        length = (size_t)(extension - reportPath);
+    }
+    snprintf(reportPath + length, sizeof(reportPath) - length, "-probe.txt");
+    FILE* file = fopen(reportPath, "w");
+    if (!file) {
+        DaemonLog("cannot write %s: %s", reportPath, strerror(errno));
+    } else {
+        fputs(report, file);
+        fclose(file);
+    }
+    return evdevFd >= 0 ? 0 : 1;
+}
+
+static void ShowUsage() {
+    printf("Usage: mousejigglerd [options]\n\n"
+           "Options:\n"
+           "  -j, --jiggle               Start with jiggling enabled\n"
+           "  -z, --zen                  Zen jiggling (out and back within one batch)\n"
+           "  -s, --seconds <seconds>    Set number of seconds for the jiggle interval\n"
+           "  -p, --profile <name>       Use the named profile from MouseJiggler.ini\n"
+           "  -c, --config <file>        Settings file (default $XDG_CONFIG_HOME/MouseJiggler/MouseJiggler.ini)\n"
+           "  -S, --socket <path>        Control socket (default $XDG_RUNTIME_DIR/mousejiggler.sock)\n"
+           "  -n, --dry-run              Count jiggles without injecting them (the Null sink; no /dev/uinput needed)\n"
+           "  -C, --control <command>    Send a command to the running daemon: status, resources, start,\n"
+           "                             stop, toggle, reload, profile [name], quit\n"
+           "  -l, --list                 List every running instance with its resource usage\n"
+           "      --probe <samples>      Measure injection latency through the evdev node and write\n"
+           "                             MouseJiggler-probe.txt (needs read access to /dev/input)\n"
+           "  -h, --help                 Show help and usage information\n");
+}
+
+int main(int argc, char** argv) {
+    JigglerDaemon* daemon = &g_Jiggler;
+    GetDefaultPaths(daemon);
+
+    const char* control = NULL;
+    bool dryRun = false;
+    int probeSamples = 0;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        const char* value = i + 1 < argc ? argv[i + 1] : NULL;
+        if (strcmp(option, "-j") == 0 || strcmp(option, "--jiggle") == 0) {
+            daemon->overrides.startJiggling = true;
+        } else if (strcmp(option, "-z") == 0 || strcmp(option, "--zen") == 0) {
+            daemon->overrides.zenJiggle = true;
+        } else if ((strcmp(option, "-s") == 0 || strcmp(option, "--seconds") == 0) && value) {
+            int seconds = atoi(value);
+            if (seconds >= 1 && seconds <= 10800) {
+                daemon->overrides.jigglePeriod = seconds;
+            }
+            i++;
+        } else if ((strcmp(option, "-p") == 0 || strcmp(option, "--profile") == 0) && value) {
+            snprintf(daemon->overrides.profile, sizeof(daemon->overrides.profile), "%s", value);
+            i++;
+        } else if ((strcmp(option, "-c") == 0 || strcmp(option, "--config") == 0) && value) {
+            snprintf(daemon->iniPath, sizeof(daemon->iniPath), "%s", value);
+            i++;
+        } else if ((strcmp(option, "-S") == 0 || strcmp(option, "--socket") == 0) && value) {
+            snprintf(daemon->socketPath, sizeof(daemon->socketPath), "%s", value);
+            i++;
+        } else if (strcmp(option, "-n") == 0 || strcmp(option, "--dry-run") == 0) {
+            dryRun = true;
+        } else if (strcmp(option, "-l") == 0 || strcmp(option, "--list") == 0) {
+            return ListInstances();
+        } else if (strcmp(option, "--probe") == 0 && value) {
+            probeSamples = atoi(value);
+            i++;
+        } else if ((strcmp(option, "-C") == 0 || strcmp(option, "--control") == 0) && value) {
+            control = value;
+            i++;
+        } else {
+            ShowUsage();
+            return strcmp(option, "-h") == 0 || strcmp(option, "--help") == 0 ? 0 : 2;
+        }
+    }
+
+    if (control) {
+        return SendControlCommand(daemon->socketPath, control);
+    }
+
+    if (!LoadDaemonInputSink(daemon->iniPath, dryRun, &daemon->sink)) {
+        return 1;
+    }
+
+    if (probeSamples > 0) {
+        int result = RunInjectionProbe(daemon->iniPath, &daemon->sink, probeSamples);
+        UnloadDaemonInputSink(&daemon->sink);
+        return result;
+    }
+
+    int result = 1;
+    if (daemon->Open()) {
+        result = daemon->Run();
+
+        // Soak report of the run: wakeups per hour and CPU time
+        char status[DAEMON_REPLY_LENGTH];
+        daemon->FormatStatus(status, sizeof(status));
+        DaemonLog("%.*s", (int)strcspn(status, "\n"), status);
+    }
+
+    daemon->Close();
+    UnloadDaemonInputSink(&daemon->sink);
+    return result;
+}
@@ -0,0 +1,251 @@
+// MouseJiggler - Adaptive jiggling over simulated days
+//
+// Runs a day of jiggling through the jiggle task of JiggleTasks.h and the
+// controller of AdaptiveController.h for each of a set of idle models: a
+// simulated user whose input follows a pattern over the day, and a machine on
+// which movements below a given level do not reset the idle timer. Every model
+// runs twice, with a fixed period (the baseline, one jiggle per deadline) and
+// adaptively, and the test checks how many jiggles adaptive mode injects per day
+// against the baseline and that the machine never reaches its idle threshold.
+// No Win32 is needed; see tests/Makefile.
+
+#include <stdio.h>
+#include "../AdaptiveController.h"
+#include "../Cadence.h"
+#include "../JiggleTasks.h"
+#include "../Scheduler.h"
+#include "Check.h"
+
+#define SECOND_MS               1000ull
+#define MINUTE_MS               (60 * SECOND_MS)
+#define HOUR_MS                 (60 * MINUTE_MS)
+#define DAY_MS                  (24 * HOUR_MS)
+#define NO_INPUT                UINT64_MAX
+
+// A simulated user and machine
+struct IdleModel {
+    const char* name;
+    uint64_t (*lastInput)(uint64_t msOfDay);    // Time of day of the user's latest input, or NO_INPUT
+    int registersFrom;                          // Smallest ADAPTIVE_LEVEL_* that resets the idle timer
+};
+
+// Input every 'intervalMs' while active
+static uint64_t LastInputWhile(bool active, uint64_t msOfDay, uint64_t intervalMs) {
+    return active ? msOfDay - msOfDay % intervalMs : NO_INPUT;
+}
+
+// Away all day
+static uint64_t Away(uint64_t) {
+    return NO_INPUT;
+}
+
+// At the desk 09:00 - 12:00 and 13:00 - 17:30, input every 20 s
+static uint64_t OfficeDay(uint64_t msOfDay) {
+    if (msOfDay >= 17 * HOUR_MS + 30 * MINUTE_MS) return 17 * HOUR_MS + 30 * MINUTE_MS - 20 * SECOND_MS;
+    if (msOfDay >= 13 * HOUR_MS) return LastInputWhile(true, msOfDay, 20 * SECOND_MS);
+    if (msOfDay >= 12 * HOUR_MS) return 12 * HOUR_MS - 20 * SECOND_MS;
+    if (msOfDay >= 9 * HOUR_MS) return LastInputWhile(true, msOfDay, 20 * SECOND_MS);
+    return NO_INPUT;
+}
+
+// Reading all day: a scroll every 4 minutes
+static uint64_t Reading(uint64_t msOfDay) {
+    return LastInputWhile(true, msOfDay, 4 * MINUTE_MS);
+}
+
+// Busy all day: input every 10 s
+static uint64_t Busy(uint64_t msOfDay) {
+    return LastInputWhile(true, msOfDay, 10 * SECOND_MS);
+}
+
+static const IdleModel g_Models[] = {
+    { "away", Away, ADAPTIVE_LEVEL_ZEN },
+    { "office day", OfficeDay, ADAPTIVE_LEVEL_ZEN },
+    { "reading", Reading, ADAPTIVE_LEVEL_ZEN },
+    { "busy", Busy, ADAPTIVE_LEVEL_ZEN },
+    { "away, zen ignored", Away, ADAPTIVE_LEVEL_NUDGE },
+    { "away, only the pattern registers", Away, ADAPTIVE_LEVEL_PATTERN },
+};
+
+// Settings, as in Main.cpp
+static const uint64_t g_PeriodMs = MINUTE_MS;
+static const uint64_t g_ThresholdMs = 5 * MINUTE_MS;
+static const uint64_t g_DayStart = 7 * DAY_MS;
+
+static Scheduler g_Scheduler;
+static JiggleTasks g_Jiggle;
+static AdaptiveController g_Adaptive;
+static const IdleModel* g_Model = nullptr;
+static bool g_AdaptiveMode = false;
+
+// Simulated machine
+static uint64_t g_Now = 0;
+static uint64_t g_LastJiggleInput = 0;      // Latest jiggle that reset the idle timer
+static uint64_t g_InjectedAt = 0;
+static uint64_t g_Injected = 0;
+
+static uint64_t LastInput() {
+    uint64_t user = g_Model->lastInput(g_Now - g_DayStart);
+    user = user == NO_INPUT ? 0 : g_DayStart + user;
+    return user > g_LastJiggleInput ? user : g_LastJiggleInput;
+}
+
+static uint64_t VirtualNow() {
+    return g_Now;
+}
+
+static uint64_t VirtualIdleTime() {
+    return g_Now - LastInput();
+}
+
+static bool AlwaysOpen(uint64_t, uint64_t* nextChange) {
+    *nextChange = SCHEDULER_NEVER;
+    return true;
+}
+
+// Jiggle host, as in Main.cpp
+static uint64_t GetPeriodMs() { return g_PeriodMs; }
+static uint64_t GetPhaseMs() { return 0; }
+static int GetPolicy() { return MISSED_JIGGLE_ONCE; }
+static bool IsAdaptive() { return g_AdaptiveMode; }
+
+static uint64_t GetIdleWaitMs() {
+    return AdaptiveIdleWaitMs(g_ThresholdMs, g_PeriodMs);
+}
+
+static void CountUnneeded(uint64_t deadlines) {
+    g_Adaptive.CountUnneeded(deadlines);
+}
+
+static uint64_t SubmitJiggles(uint64_t, uint32_t count) {
+    g_InjectedAt = g_Now;
+    if (g_AdaptiveMode && !g_Adaptive.IsNeeded(VirtualIdleTime(), GetIdleWaitMs())) {
+        return 0;
+    }
+
+    int level = g_AdaptiveMode ? g_Adaptive.level : ADAPTIVE_LEVEL_PATTERN;
+    if (level >= g_Model->registersFrom) {
+        g_LastJiggleInput = g_Now;
+    }
+    g_Injected += count;
+    if (g_AdaptiveMode) {
+        g_Adaptive.injected += count;
+    }
+    return count;
+}
+
+static void Verify() {
+    g_Adaptive.Verify(g_LastJiggleInput >= g_InjectedAt, false);
+}
+
+static void DeadlineDone() {}
+static void Started() {}
+static void Stopped() {}
+static void SpawnFailed(int) { CHECK(!"spawn failed"); }
+
+static const JiggleHost g_JiggleHost = {
+    GetPeriodMs, GetPhaseMs, GetPolicy,
+    IsAdaptive, GetIdleWaitMs, CountUnneeded, Verify, ADAPTIVE_VERIFY_MS,
+    SubmitJiggles, DeadlineDone, Started, Stopped, SpawnFailed
+};
+
+struct DayResult {
+    uint64_t injected;
+    uint64_t maxIdle;               // Longest idle time the machine reached
+    uint64_t thresholdCrossings;    // Times it reached the threshold
+};
+
+// One day under the current model, sampling the idle time every second
+static DayResult RunDay(bool adaptive) {
+    g_AdaptiveMode = adaptive;
+    g_Adaptive = AdaptiveController();
+    g_Now = g_DayStart;
+    g_LastJiggleInput = g_DayStart;     // The user left at midnight
+    g_Injected = 0;
+
+    g_Scheduler.host.now = VirtualNow;
+    g_Scheduler.host.idleTime = VirtualIdleTime;
+    g_Scheduler.host.windowOpen = AlwaysOpen;
+    g_Jiggle.scheduler = &g_Scheduler;
+    g_Jiggle.host = &g_JiggleHost;
+    g_Jiggle.Start();
+
+    DayResult result = {};
+    bool aboveThreshold = false;
+    uint64_t wake = g_Scheduler.NextWake();
+    for (uint64_t t = g_DayStart; t < g_DayStart + DAY_MS; t += SECOND_MS) {
+        g_Now = t;
+        uint64_t idle = VirtualIdleTime();
+        if (idle > result.maxIdle) result.maxIdle = idle;
+        if (idle >= g_ThresholdMs && !aboveThreshold) result.thresholdCrossings++;
+        aboveThreshold = idle >= g_ThresholdMs;
+
+        while (wake != SCHEDULER_NEVER && wake <= t) {
+            if (wake > g_Now) g_Now = wake;
+            wake = g_Scheduler.Run();
+        }
+        g_Now = t;
+    }
+    g_Jiggle.Stop();
+    result.injected = g_Injected;
+    return result;
+}
+
+int main() {
+    const uint64_t baselineDeadlines = DAY_MS / g_PeriodMs;
+    unsigned long heap = g_HeapAllocations;
+
+    for (const IdleModel& model : g_Models) {
+        g_Model = &model;
+        DayResult fixed = RunDay(false);
+        DayResult adaptive = RunDay(true);
+
+        // The fixed period injects on every deadline and keeps every machine awake
+        CHECK(fixed.injected + 1 >= baselineDeadlines && fixed.injected <= baselineDeadlines);
+        CHECK(fixed.thresholdCrossings == 0);
+
+        // Adaptive mode accounts for every deadline (those passed during an idle wait
+        // when the wait ends) and never injects more
+        CHECK(g_Adaptive.deadlines <= baselineDeadlines);
+        if (adaptive.injected > 0) {
+            CHECK(g_Adaptive.deadlines + 2 >= baselineDeadlines);
+        }
+        CHECK(adaptive.injected == g_Adaptive.injected);
+        CHECK(adaptive.injected <= g_Adaptive.deadlines - g_Adaptive.skippedIdle);
+
+        // In every model it needs at most a third of the baseline
+        CHECK(adaptive.injected * 3 <= fixed.injected);
+
+        // Each crossing of the threshold follows a movement that did not register
+        CHECK(adaptive.thresholdCrossings <= g_Adaptive.verifyFailures);
+        if (model.registersFrom == ADAPTIVE_LEVEL_ZEN) {
+            CHECK(adaptive.thresholdCrossings == 0 && g_Adaptive.verifyFailures == 0);
+            CHECK(g_Adaptive.level == ADAPTIVE_LEVEL_ZEN);
+            CHECK(adaptive.maxIdle < g_ThresholdMs);
+        } else {
+            // It settles on the smallest level that works, retrying smaller ones ever more rarely
+            CHECK(g_Adaptive.level >= model.registersFrom);
+            CHECK(g_Adaptive.verifyFailures <= 8);
+        }
+
+        printf("AdaptiveDayTest: %s: %llu injected per day against %llu fixed (%.0f%%), longest idle %llu s, "
+               "%llu verify failures, level %d\n",
+               model.name, (unsigned long long)adaptive.injected, (unsigned long long)fixed.injected,
+               100.0 * (double)adaptive.injected / (double)fixed.injected,
+               (unsigned long long)(adaptive.maxIdle / SECOND_MS), (unsigned long long)g_Adaptive.verifyFailures,
+               g_Adaptive.level);
+
+        if (model.lastInput == Busy) {
+            CHECK(adaptive.injected == 0);
+        }
+        if (model.lastInput == OfficeDay) {
+            g_Model = &g_Models[0];
+            DayResult away = RunDay(true);
+            CHECK(adaptive.injected < away.injected);
+        }
+    }
+
+    CHECK(g_HeapAllocations == heap);
+    CHECK(g_SchedulerFrames.refused == 0);
+    return CheckSummary("AdaptiveDayTest");
+}
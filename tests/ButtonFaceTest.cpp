@@ -0,0 +1,260 @@
+// MouseJiggler - Play/pause button face tests
+//
+// Renders every face of ButtonFace.h at 96 and 144 DPI and compares it pixel for
+// pixel with the golden images in tests/golden (binary PPM, viewable in most
+// image viewers). A face that differs is written next to its golden image as
+// .actual.ppm; after an intended change to the drawing, `make -C tests golden`
+// rewrites the golden images. Also checks the geometry the golden images only
+// show (border widths, bar positions, a symmetric anti-aliased triangle, the
+// label layout) and that the cache renders each face once per size and DPI.
+// See tests/Makefile.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "../ButtonFace.h"
+#include "Check.h"
+
+#define TEST_MAX_PIXELS     (144 * 36)
+#define TEST_MAX_FACES      8
+
+// Fixed pool of face bitmaps, so the host needs no heap
+static uint32_t g_Pool[TEST_MAX_FACES][TEST_MAX_PIXELS];
+static bool g_InUse[TEST_MAX_FACES];
+static int g_Creates = 0;
+static int g_Destroys = 0;
+static int g_Labels = 0;
+static bool g_CreateFails = false;
+static ButtonFaceLayout g_LastLayout;
+
+static intptr_t CreateFace(int width, int height, ButtonFaceBitmap* bitmap) {
+    if (g_CreateFails || width * height > TEST_MAX_PIXELS) {
+        return 0;
+    }
+    for (int i = 0; i < TEST_MAX_FACES; i++) {
+        if (!g_InUse[i]) {
+            g_InUse[i] = true;
+            g_Creates++;
+            *bitmap = { g_Pool[i], width, height, width };
+            return i + 1;
+        }
+    }
+    return 0;
+}
+
+static void LabelFace(intptr_t face, const ButtonFaceLayout& layout) {
+    CHECK(face >= 1 && face <= TEST_MAX_FACES && g_InUse[face - 1]);
+    g_Labels++;
+    g_LastLayout = layout;
+}
+
+static void DestroyFace(intptr_t face) {
+    CHECK(face >= 1 && face <= TEST_MAX_FACES && g_InUse[face - 1]);
+    g_InUse[face - 1] = false;
+    g_Destroys++;
+}
+
+static const ButtonFaceHost g_TestHost = { CreateFace, LabelFace, DestroyFace };
+
+static uint32_t Pixel(const ButtonFaceBitmap& bitmap, int x, int y) {
+    return bitmap.pixels[y * bitmap.stride + x];
+}
+
+static void Render(uint32_t* pixels, int width, int height, int dpi, bool isJiggling, bool isHot,
+                   ButtonFaceBitmap* bitmap, ButtonFaceLayout* layout) {
+    *bitmap = { pixels, width, height, width };
+    RenderButtonFace(*bitmap, dpi, isJiggling, isHot, layout);
+}
+
+// Rounds as MulDiv does
+static void TestScale() {
+    CHECK(ScaleForDpi(12, 96) == 12);
+    CHECK(ScaleForDpi(1, 120) == 1 && ScaleForDpi(2, 120) == 3 && ScaleForDpi(5, 120) == 6);
+    CHECK(ScaleForDpi(1, 144) == 2 && ScaleForDpi(7, 144) == 11 && ScaleForDpi(15, 144) == 23);
+    CHECK(ScaleForDpi(14, 192) == 28);
+    CHECK(ScaleForDpi(-5, 144) == -8);
+}
+
+static bool WritePpm(const char* path, const ButtonFaceBitmap& bitmap) {
+    FILE* file = fopen(path, "wb");
+    if (!file) return false;
+    fprintf(file, "P6\n%d %d\n255\n", bitmap.width, bitmap.height);
+    for (int y = 0; y < bitmap.height; y++) {
+        for (int x = 0; x < bitmap.width; x++) {
+            uint32_t pixel = Pixel(bitmap, x, y);
+            unsigned char rgb[3] = { (unsigned char)(pixel >> 16), (unsigned char)(pixel >> 8), (unsigned char)pixel };
+            fwrite(rgb, 1, 3, file);
+        }
+    }
+    return fclose(file) == 0;
+}
+
+// Pixels that differ from the golden image, or -1 if it cannot be read or has another size
+static int ComparePpm(const char* path, const ButtonFaceBitmap& bitmap) {
+    FILE* file = fopen(path, "rb");
+    if (!file) return -1;
+    int width = 0, height = 0, maxValue = 0;
+    int differing = -1;
+    if (fscanf(file, "P6 %d %d %d", &width, &height, &maxValue) == 3 && fgetc(file) != EOF &&
+        width == bitmap.width && height == bitmap.height && maxValue == 255) {
+        differing = 0;
+        for (int y = 0; y < height && differing >= 0; y++) {
+            for (int x = 0; x < width; x++) {
+                unsigned char rgb[3];
+                if (fread(rgb, 1, 3, file) != 3) {
+                    differing = -1;
+                    break;
+                }
+                if (BUTTON_FACE_RGB(rgb[0], rgb[1], rgb[2]) != Pixel(bitmap, x, y)) differing++;
+            }
+        }
+    }
+    fclose(file);
+    return differing;
+}
+
+// Every face against its golden image
+static void TestGolden() {
+    static const struct { int width, height, dpi; } sizes[] = { { 96, 24, 96 }, { 144, 36, 144 } };
+    bool update = getenv("MJ_UPDATE_GOLDEN") != nullptr;
+    static uint32_t pixels[TEST_MAX_PIXELS];
+
+    for (const auto& size : sizes) {
+        for (int face = 0; face < BUTTON_FACE_COUNT; face++) {
+            bool isJiggling = face >= 2;
+            bool isHot = face % 2 == 1;
+            ButtonFaceBitmap bitmap;
+            ButtonFaceLayout layout;
+            Render(pixels, size.width, size.height, size.dpi, isJiggling, isHot, &bitmap, &layout);
+
+            char path[128];
+            snprintf(path, sizeof(path), "golden/ButtonFace-%d-%s%s.ppm", size.dpi,
+                     isJiggling ? "playing" : "paused", isHot ? "-hot" : "");
+            if (update) {
+                CHECK(WritePpm(path, bitmap));
+                continue;
+            }
+            int differing = ComparePpm(path, bitmap);
+            CHECK(differing == 0);
+            if (differing != 0) {
+                char actual[160];
+                snprintf(actual, sizeof(actual), "%.*s.actual.ppm", (int)(strlen(path) - 4), path);
+                WritePpm(actual, bitmap);
+                printf("ButtonFaceTest: %s: %d pixels differ (%s), written to %s\n", path, differing,
+                       differing < 0 ? "missing or another size" : "see the image", actual);
+            }
+        }
+    }
+}
+
+// The geometry the golden images encode, stated outright
+static void TestGeometry() {
+    static uint32_t pixels[TEST_MAX_PIXELS];
+    ButtonFaceBitmap bitmap;
+    ButtonFaceLayout layout;
+
+    // Paused at 96 DPI: white, a 1-pixel border, a green triangle from x 43 to 55
+    Render(pixels, 96, 24, 96, false, false, &bitmap, &layout);
+    CHECK(Pixel(bitmap, 0, 0) == BUTTON_FACE_BORDER && Pixel(bitmap, 95, 23) == BUTTON_FACE_BORDER);
+    CHECK(Pixel(bitmap, 1, 1) == BUTTON_FACE_PAUSED_BACKGROUND && Pixel(bitmap, 94, 22) == BUTTON_FACE_PAUSED_BACKGROUND);
+    CHECK(Pixel(bitmap, 44, 12) == BUTTON_FACE_PLAY_COLOR && Pixel(bitmap, 42, 12) == BUTTON_FACE_PAUSED_BACKGROUND);
+    CHECK(Pixel(bitmap, 56, 12) == BUTTON_FACE_PAUSED_BACKGROUND);
+    CHECK(layout.textLeft == 63 && layout.fontHeight == 14 && layout.textColor == BUTTON_FACE_PLAY_COLOR);
+    CHECK(!layout.isJiggling && layout.width == 96 && layout.height == 24 && layout.dpi == 96);
+
+    // The sloped edges are anti-aliased: some pixels lie strictly between the colours
+    int partial = 0;
+    for (int y = 0; y < 24; y++) {
+        for (int x = 0; x < 96; x++) {
+            uint32_t pixel = Pixel(bitmap, x, y);
+            if (pixel != BUTTON_FACE_PLAY_COLOR && pixel != BUTTON_FACE_PAUSED_BACKGROUND && pixel != BUTTON_FACE_BORDER) {
+                partial++;
+                CHECK((pixel >> 8 & 0xFF) >= 180 && (pixel & 0xFF) < 255);
+            }
+        }
+    }
+    CHECK(partial > 10);
+
+    // The triangle is symmetric about its horizontal axis, at every DPI
+    static const int dpis[] = { 96, 120, 144 };
+    for (int dpi : dpis) {
+        Render(pixels, 144, 36, dpi, false, false, &bitmap, &layout);
+        for (int y = 1; y < 18; y++) {
+            CHECK(memcmp(pixels + y * 144, pixels + (35 - y) * 144, 144 * sizeof(uint32_t)) == 0);
+        }
+    }
+
+    // Hot at 144 DPI: a 3-pixel border
+    Render(pixels, 144, 36, 144, false, true, &bitmap, &layout);
+    CHECK(Pixel(bitmap, 2, 2) == BUTTON_FACE_BORDER && Pixel(bitmap, 3, 3) == BUTTON_FACE_PAUSED_BACKGROUND);
+    CHECK(Pixel(bitmap, 141, 33) == BUTTON_FACE_BORDER && Pixel(bitmap, 140, 32) == BUTTON_FACE_PAUSED_BACKGROUND);
+
+    // Playing at 144 DPI: gray, red bars at x 63..69 and 75..81, rows 9..26
+    Render(pixels, 144, 36, 144, true, false, &bitmap, &layout);
+    CHECK(Pixel(bitmap, 1, 1) == BUTTON_FACE_BORDER && Pixel(bitmap, 2, 2) == BUTTON_FACE_PLAYING_BACKGROUND);
+    for (int x = 60; x < 85; x++) {
+        bool inBar = (x >= 63 && x < 69) || (x >= 75 && x < 81);
+        CHECK(Pixel(bitmap, x, 9) == (inBar ? BUTTON_FACE_PAUSE_COLOR : BUTTON_FACE_PLAYING_BACKGROUND));
+        CHECK(Pixel(bitmap, x, 26) == (inBar ? BUTTON_FACE_PAUSE_COLOR : BUTTON_FACE_PLAYING_BACKGROUND));
+        CHECK(Pixel(bitmap, x, 8) == BUTTON_FACE_PLAYING_BACKGROUND && Pixel(bitmap, x, 27) == BUTTON_FACE_PLAYING_BACKGROUND);
+    }
+    CHECK(layout.isJiggling && layout.textLeft == 95 && layout.fontHeight == 21 && layout.textColor == BUTTON_FACE_PAUSE_COLOR);
+
+    // Nothing is drawn outside a bitmap smaller than the icon
+    static uint32_t tiny[4 * 4 + 4];
+    for (uint32_t& pixel : tiny) pixel = 0xDEADBEEF;
+    Render(tiny, 4, 4, 192, false, true, &bitmap, &layout);
+    for (int i = 16; i < 20; i++) CHECK(tiny[i] == 0xDEADBEEF);
+}
+
+// Each face is rendered once per size and DPI, and only when first shown
+static void TestCache() {
+    ButtonFaceCache cache;
+    cache.host = &g_TestHost;
+    unsigned long heap = g_HeapAllocations;
+
+    intptr_t paused = cache.Get(96, 24, 96, false, false);
+    CHECK(paused != 0 && cache.renders == 1 && g_Creates == 1 && g_Labels == 1);
+    CHECK(!g_LastLayout.isJiggling && g_LastLayout.width == 96);
+    for (int i = 0; i < 100; i++) {
+        CHECK(cache.Get(96, 24, 96, false, false) == paused);
+        cache.Get(96, 24, 96, i % 2 == 0, i % 3 == 0);
+    }
+    CHECK(cache.renders == BUTTON_FACE_COUNT && g_Creates == BUTTON_FACE_COUNT && g_Labels == BUTTON_FACE_COUNT);
+    CHECK(g_Destroys == 0);
+
+    // A new DPI (moved to another monitor) or size drops every face
+    intptr_t playing = cache.Get(144, 36, 144, true, false);
+    CHECK(playing != 0 && g_Destroys == BUTTON_FACE_COUNT && cache.renders == BUTTON_FACE_COUNT + 1);
+    CHECK(g_LastLayout.isJiggling && g_LastLayout.dpi == 144);
+    cache.Get(144, 36, 144, true, false);
+    CHECK(cache.renders == BUTTON_FACE_COUNT + 1);
+    cache.Get(140, 36, 144, true, false);
+    CHECK(g_Destroys == BUTTON_FACE_COUNT + 1 && cache.renders == BUTTON_FACE_COUNT + 2);
+
+    // A theme change drops them too; the next paint renders again
+    cache.Reset();
+    CHECK(g_Destroys == BUTTON_FACE_COUNT + 2);
+    for (int i = 0; i < TEST_MAX_FACES; i++) CHECK(!g_InUse[i]);
+    CHECK(cache.Get(140, 36, 144, true, false) != 0 && cache.renders == BUTTON_FACE_COUNT + 3);
+
+    // A bitmap that cannot be created is retried on the next paint; an empty button gets none
+    cache.Reset();
+    g_CreateFails = true;
+    CHECK(cache.Get(96, 24, 96, false, true) == 0);
+    g_CreateFails = false;
+    CHECK(cache.Get(96, 24, 96, false, true) != 0);
+    CHECK(cache.Get(0, 24, 96, false, true) == 0);
+    cache.Reset();
+    for (int i = 0; i < TEST_MAX_FACES; i++) CHECK(!g_InUse[i]);
+
+    CHECK(g_HeapAllocations == heap);
+}
+
+int main() {
+    TestScale();
+    TestGolden();
+    TestGeometry();
+    TestCache();
+    return CheckSummary("ButtonFaceTest");
+}
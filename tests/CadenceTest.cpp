@@ -0,0 +1,137 @@
+// MouseJiggler - Cadence tests
+//
+// Drives the deadline arithmetic in Cadence.h with a virtual clock. No Win32
+// is needed; see tests/Makefile.
+
+#include <stdio.h>
+#include "../Cadence.h"
+#include "Check.h"
+
+static const uint64_t SECOND_MS = 1000;
+static const uint64_t DAY_MS = 24 * 3600 * SECOND_MS;
+static const uint64_t START_MS = 13300000000000ULL + 12345;    // Mid-2022 in FILETIME ms, off the grid
+
+// Deterministic jitter source (LCG)
+static uint32_t g_Random = 12345;
+
+static uint32_t NextRandom() {
+    g_Random = g_Random * 1103515245u + 12345u;
+    return g_Random >> 8;
+}
+
+static void TestNextAlignedDeadline() {
+    CHECK(NextAlignedDeadline(0, 60000, 0) == 60000);
+    CHECK(NextAlignedDeadline(59999, 60000, 0) == 60000);
+    CHECK(NextAlignedDeadline(60000, 60000, 0) == 120000);         // Strictly after 'now'
+    CHECK(NextAlignedDeadline(60000, 60000, 15000) == 75000);
+    CHECK(NextAlignedDeadline(75000, 60000, 15000) == 135000);
+    CHECK(NextAlignedDeadline(10000, 60000, 15000) == 15000);      // Before the first grid point
+    CHECK(NextAlignedDeadline(60000, 60000, 75000) == 75000);      // Phase wraps into the period
+    CHECK(IsOnGrid(NextAlignedDeadline(START_MS, 7000, 3000), 7000, 3000));
+    CHECK(!IsOnGrid(START_MS, 60000, 0));
+}
+
+static void TestAlignDeadline() {
+    CHECK(AlignDeadline(120000, 60000, 0) == 120000);              // Already on the grid
+    CHECK(AlignDeadline(150000, 60000, 0) == 180000);              // Saved under a 30 s period
+    CHECK(AlignDeadline(150000, 60000, 15000) == 195000);
+    CHECK(AlignDeadline(135000, 60000, 15000) == 135000);
+
+    // A resumed deadline always lands on the current grid, never before where it was
+    for (uint64_t due = START_MS; due < START_MS + 10 * 7000; due += 997) {
+        uint64_t aligned = AlignDeadline(due, 7000, 3000);
+        CHECK(IsOnGrid(aligned, 7000, 3000));
+        CHECK(aligned >= due && aligned < due + 7000);
+    }
+}
+
+static void TestResolveDeadline() {
+    const uint64_t period = 60000;
+    const uint64_t due = 600000;
+
+    // On time (and late by less than a period): one jiggle, next grid point
+    DeadlineOutcome outcome = ResolveDeadline(due, due + 59999, period, MISSED_JIGGLE_SKIP);
+    CHECK(outcome.jiggles == 1 && outcome.missed == 0 && outcome.nextDue == due + period);
+
+    // Five deadlines missed (e.g. across sleep)
+    uint64_t now = due + 5 * period + 10;
+    outcome = ResolveDeadline(due, now, period, MISSED_JIGGLE_SKIP);
+    CHECK(outcome.jiggles == 0 && outcome.missed == 5 && outcome.nextDue == due + 6 * period);
+    outcome = ResolveDeadline(due, now, period, MISSED_JIGGLE_ONCE);
+    CHECK(outcome.jiggles == 1 && outcome.nextDue == due + 6 * period);
+    outcome = ResolveDeadline(due, now, period, MISSED_JIGGLE_BURST);
+    CHECK(outcome.jiggles == 6 && outcome.nextDue == due + 6 * period);
+
+    // Bursts are capped
+    outcome = ResolveDeadline(due, due + 1000 * period, period, MISSED_JIGGLE_BURST);
+    CHECK(outcome.jiggles == MAX_JIGGLE_BURST && outcome.nextDue == due + 1001 * period);
+    CHECK(outcome.nextDue > due + 1000 * period);
+}
+
+// Run a month of deadlines on a virtual clock. Every timer fires late by up to
+// maxLateMs; with sleepEvery != 0 the machine also sleeps for up to two hours
+// after every sleepEvery-th deadline. Returns the number of jiggles.
+static uint64_t RunMonth(uint64_t period, uint64_t phase, int policy, uint64_t maxLateMs, int sleepEvery) {
+    uint64_t now = START_MS;
+    uint64_t end = START_MS + 30 * DAY_MS;
+    uint64_t first = NextAlignedDeadline(now, period, phase);
+    uint64_t due = first;
+    uint64_t handled = 0;
+    uint64_t jiggles = 0;
+
+    while (due <= end) {
+        now = due + (maxLateMs ? NextRandom() % maxLateMs : 0);
+        if (sleepEvery && handled % sleepEvery == (uint64_t)sleepEvery - 1) {
+            now += NextRandom() % (2 * 3600 * SECOND_MS);
+        }
+
+        DeadlineOutcome outcome = ResolveDeadline(due, now, period, policy);
+        CHECK(IsOnGrid(outcome.nextDue, period, phase));
+        CHECK(outcome.nextDue > now);
+        CHECK(outcome.nextDue == NextAlignedDeadline(now, period, phase));
+
+        jiggles += outcome.jiggles;
+        handled += outcome.missed + 1;
+        due = outcome.nextDue;
+    }
+
+    // Zero drift: after a month the deadline is exactly where the grid says
+    CHECK(due == first + handled * period);
+    if (!sleepEvery) {
+        CHECK(due == NextAlignedDeadline(end, period, phase));
+    }
+    return jiggles;
+}
+
+static void TestMonthWithoutDrift() {
+    static const uint64_t periods[] = { 1 * SECOND_MS, 7 * SECOND_MS, 60 * SECOND_MS, 3600 * SECOND_MS };
+    static const uint64_t phases[] = { 0, 3 * SECOND_MS, 45 * SECOND_MS };
+
+    for (size_t p = 0; p < sizeof(periods) / sizeof(periods[0]); p++) {
+        for (size_t f = 0; f < sizeof(phases) / sizeof(phases[0]); f++) {
+            uint64_t period = periods[p];
+            uint64_t phase = phases[f];
+
+            // Every grid point in the month gets exactly one jiggle, however late the timer
+            uint64_t first = NextAlignedDeadline(START_MS, period, phase);
+            uint64_t expected = (START_MS + 30 * DAY_MS - first) / period + 1;
+            uint64_t late = period > 1 ? period - 1 : 0;
+            CHECK(RunMonth(period, phase, MISSED_JIGGLE_ONCE, late < 900 ? late : 900, 0) == expected);
+            CHECK(RunMonth(period, phase, MISSED_JIGGLE_SKIP, late < 900 ? late : 900, 0) == expected);
+
+            // Sleeping drops deadlines but never moves the grid
+            uint64_t skipped = RunMonth(period, phase, MISSED_JIGGLE_SKIP, 20, 97);
+            uint64_t once = RunMonth(period, phase, MISSED_JIGGLE_ONCE, 20, 97);
+            CHECK(skipped <= expected && once <= expected);
+        }
+    }
+}
+
+int main() {
+    TestNextAlignedDeadline();
+    TestAlignDeadline();
+    TestResolveDeadline();
+    TestMonthWithoutDrift();
+
+    return CheckSummary("CadenceTest");
+}
@@ -0,0 +1,54 @@
+// MouseJiggler - Test support
+//
+// CHECK, the failure count and the closing summary line shared by the tests,
+// plus a heap allocation counter for the tests that assert no allocations once
+// startup is done. Include it from exactly one translation unit per test (it
+// replaces the global operator new and delete).
+
+#pragma once
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <new>
+
+static int g_Failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            printf("%s(%d): CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            g_Failures++; \
+        } \
+    } while (0)
+
+// Heap allocations made by anything in the process (operator new and new[])
+static unsigned long g_HeapAllocations = 0;
+
+void* operator new(size_t size) {
+    g_HeapAllocations++;
+    void* block = malloc(size ? size : 1);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+void* operator new[](size_t size) {
+    g_HeapAllocations++;
+    void* block = malloc(size ? size : 1);
+    if (!block) throw std::bad_alloc();
+    return block;
+}
+
+void operator delete(void* block) noexcept { free(block); }
+void operator delete(void* block, size_t) noexcept { free(block); }
+void operator delete[](void* block) noexcept { free(block); }
+void operator delete[](void* block, size_t) noexcept { free(block); }
+
+// Print the closing line of a test and return its exit code
+inline int CheckSummary(const char* testName) {
+    if (g_Failures > 0) {
+        printf("%s: %d check(s) failed\n", testName, g_Failures);
+        return 1;
+    }
+    printf("%s: passed\n", testName);
+    return 0;
+}
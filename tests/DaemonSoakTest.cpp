@@ -0,0 +1,221 @@
+// MouseJiggler - Linux daemon soak test
+//
+// Runs the real event loop of linux/JigglerDaemon.h (epoll, timerfd, signalfd,
+// inotify and the control socket) against a counting input sink, and drives it
+// from a second thread the way a user would: over the control socket, by
+// editing MouseJiggler.ini, by writing other files next to it and with SIGHUP.
+// It checks that an idle daemon does not wake up at all, that a jiggling one
+// wakes once per deadline, that only the INI file itself reloads the settings,
+// that -p and -z survive a reload, and that the loop never touches the heap.
+// Reports wakeups per hour and CPU time; MJ_SOAK_SECONDS sets the length of
+// each phase (make soak runs ten minutes each). Linux only; see tests/Makefile.
+
+#define REGISTRY_SHM_NAME "/ArkaneSystems.MouseJiggler.Soak%02d"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include "../linux/JigglerDaemon.h"
+#include "Check.h"
+
+static JigglerDaemon g_Jiggler;
+static char g_Directory[] = "/tmp/MouseJigglerSoakXXXXXX";
+static uint64_t g_Moves = 0;
+
+// What the driver measured, printed once the loop has stopped
+static int g_Seconds = 2;
+static uint64_t g_IdleWakeups = 0;
+static double g_IdleCpu = 0;
+static uint64_t g_JiggleWakeups = 0;
+static uint64_t g_Jiggles = 0;
+static double g_JiggleCpu = 0;
+
+static uint32_t MJ_CALL CountMoves(void* context, const MJInputEvent* events, uint32_t count,
+                                   uint64_t timestampUs, uint32_t* status) {
+    (void)context;
+    (void)timestampUs;
+    for (uint32_t i = 0; i < count; i++) {
+        CHECK(events[i].type == MJ_EVENT_MOVE);
+        status[i] = MJ_SINK_OK;
+    }
+    g_Moves += count;
+    return count;
+}
+
+static void WriteFile(const char* name, const char* text) {
+    char path[PATH_MAX];
+    snprintf(path, sizeof(path), "%s/%s", g_Directory, name);
+    FILE* file = fopen(path, "w");
+    if (file) {
+        fputs(text, file);
+        fclose(file);
+    }
+}
+
+// Send a command and wait for its one-line reply
+static void Command(int fd, const char* command, char* reply, size_t replySize) {
+    char line[DAEMON_COMMAND_LENGTH];
+    snprintf(line, sizeof(line), "%s\n", command);
+    send(fd, line, strlen(line), MSG_NOSIGNAL);
+
+    size_t length = 0;
+    reply[0] = '\0';
+    while (length + 1 < replySize && !strchr(reply, '\n')) {
+        ssize_t received = recv(fd, reply + length, replySize - 1 - length, 0);
+        if (received <= 0) break;
+        length += (size_t)received;
+        reply[length] = '\0';
+    }
+}
+
+static uint64_t StatusValue(const char* status, const char* key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), " %s=", key);
+    const char* field = strstr(status, pattern);
+    return field ? strtoull(field + strlen(pattern), NULL, 10) : UINT64_MAX;
+}
+
+static double StatusDouble(const char* status, const char* key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), " %s=", key);
+    const char* field = strstr(status, pattern);
+    return field ? strtod(field + strlen(pattern), NULL) : -1.0;
+}
+
+static void Settle() {
+    usleep(200 * 1000);
+}
+
+// The user's side of the soak, on its own thread. No heap use here either, so
+// the allocation count covers the loop.
+static void Drive() {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, g_Jiggler.socketPath, strlen(g_Jiggler.socketPath));
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0) {
+        CHECK(!"control socket");
+        kill(getpid(), SIGTERM);
+        return;
+    }
+
+    char before[DAEMON_REPLY_LENGTH];
+    char after[DAEMON_REPLY_LENGTH];
+    char reply[DAEMON_REPLY_LENGTH];
+
+    // Idle: nothing may wake the loop but the status command that ends the phase
+    Command(fd, "status", before, sizeof(before));
+    CHECK(strncmp(before, "idle ", 5) == 0);
+    sleep(g_Seconds);
+    Command(fd, "status", after, sizeof(after));
+    g_IdleWakeups = StatusValue(after, "wakeups") - StatusValue(before, "wakeups") - 1;
+    g_IdleCpu = StatusDouble(after, "cpu_s") - StatusDouble(before, "cpu_s");
+    CHECK(g_IdleWakeups == 0);
+
+    // Jiggling every second: one wakeup per deadline
+    Command(fd, "start", reply, sizeof(reply));
+    CHECK(strcmp(reply, "ok\n") == 0);
+    Command(fd, "status", before, sizeof(before));
+    sleep(g_Seconds);
+    Command(fd, "status", after, sizeof(after));
+    g_Jiggles = StatusValue(after, "jiggles") - StatusValue(before, "jiggles");
+    g_JiggleWakeups = StatusValue(after, "wakeups") - StatusValue(before, "wakeups") - 1;
+    g_JiggleCpu = StatusDouble(after, "cpu_s") - StatusDouble(before, "cpu_s");
+    CHECK(g_Jiggles + 1 >= (uint64_t)g_Seconds && g_Jiggles <= (uint64_t)g_Seconds + 1);
+    CHECK(g_JiggleWakeups <= g_Jiggles + 1);
+    CHECK(StatusValue(after, "failures") == 0);
+
+    // Other files in the INI file's directory wake the watch but reload nothing
+    WriteFile("MouseJiggler.state", "state");
+    WriteFile("MouseJiggler.ini.bak", "[Settings]\nJigglePeriod=9\n");
+    Settle();
+    Command(fd, "status", reply, sizeof(reply));
+    CHECK(StatusValue(reply, "reloads") == 0);
+    CHECK(StatusValue(reply, "settings") > 0);
+
+    // An edit of the INI file reloads it once; -p and -z still apply
+    WriteFile("MouseJiggler.ini", "[Settings]\nJigglePeriod=7\n[Profile:Fast]\nJigglePeriod=1\n");
+    Settle();
+    Command(fd, "status", reply, sizeof(reply));
+    CHECK(StatusValue(reply, "reloads") == 1);
+    CHECK(strstr(reply, " profile=Fast ") && StatusValue(reply, "period") == 1 && StatusValue(reply, "zen") == 1);
+
+    // So does SIGHUP
+    kill(getpid(), SIGHUP);
+    Settle();
+    Command(fd, "status", reply, sizeof(reply));
+    CHECK(StatusValue(reply, "reloads") == 2 && StatusValue(reply, "signal") == 1);
+    CHECK(strstr(reply, " profile=Fast ") && StatusValue(reply, "zen") == 1);
+
+    // Choosing [Settings] replaces -p, for this and later reloads; -z stays
+    Command(fd, "profile", reply, sizeof(reply));
+    CHECK(strcmp(reply, "ok\n") == 0);
+    Command(fd, "reload", reply, sizeof(reply));
+    Command(fd, "status", reply, sizeof(reply));
+    CHECK(strstr(reply, " profile=- ") && StatusValue(reply, "period") == 7 && StatusValue(reply, "zen") == 1);
+
+    // Resources come from /proc; reloads and commands were charged to their subsystems
+    Command(fd, "resources", reply, sizeof(reply));
+    CHECK(strncmp(reply, "fds=", 4) == 0);
+    CHECK(StatusValue(reply, "rss_kb") > 0 && StatusValue(reply, "rss_kb") != UINT64_MAX);
+    CHECK(StatusValue(reply, "start_fds") != UINT64_MAX && StatusValue(reply, "alert") == 0);
+    CHECK(StatusValue(reply, "timer_ms") != UINT64_MAX && StatusValue(reply, "control_ms") != UINT64_MAX);
+
+    Command(fd, "profile Missing", reply, sizeof(reply));
+    CHECK(strncmp(reply, "error", 5) == 0);
+    Command(fd, "bogus", reply, sizeof(reply));
+    CHECK(strncmp(reply, "error", 5) == 0);
+
+    Command(fd, "quit", reply, sizeof(reply));
+    close(fd);
+}
+
+int main() {
+    const char* seconds = getenv("MJ_SOAK_SECONDS");
+    if (seconds && atoi(seconds) > 0) {
+        g_Seconds = atoi(seconds);
+    }
+
+    if (!mkdtemp(g_Directory)) {
+        printf("DaemonSoakTest: no temporary directory\n");
+        return 1;
+    }
+    snprintf(g_Jiggler.iniPath, sizeof(g_Jiggler.iniPath), "%s/MouseJiggler.ini", g_Directory);
+    snprintf(g_Jiggler.statePath, sizeof(g_Jiggler.statePath), "%s/state", g_Directory);
+    snprintf(g_Jiggler.socketPath, sizeof(g_Jiggler.socketPath), "%s/control", g_Directory);
+    WriteFile("MouseJiggler.ini", "[Settings]\nJigglePeriod=2\n[Profile:Fast]\nJigglePeriod=1\n");
+
+    g_Jiggler.sink = { MJ_INPUT_SINK_ABI_VERSION, sizeof(MJInputSink), "Counting", nullptr, CountMoves, nullptr };
+    snprintf(g_Jiggler.overrides.profile, sizeof(g_Jiggler.overrides.profile), "Fast");
+    g_Jiggler.overrides.zenJiggle = true;
+
+    CHECK(g_Jiggler.Open());
+    CHECK(!g_Jiggler.jiggle.isJiggling);
+    std::thread driver(Drive);
+
+    unsigned long heap = g_HeapAllocations;
+    int result = g_Jiggler.Run();
+    CHECK(g_HeapAllocations == heap);
+    driver.join();
+
+    CHECK(result == 0);
+    CHECK(g_Moves == 2 * g_Jiggler.jigglesSent);   // Zen: out and back
+    g_Jiggler.Close();
+
+    char path[PATH_MAX];
+    const char* names[] = { "MouseJiggler.ini", "MouseJiggler.ini.bak", "MouseJiggler.state", "state", "control" };
+    for (const char* name : names) {
+        snprintf(path, sizeof(path), "%s/%s", g_Directory, name);
+        unlink(path);
+    }
+    rmdir(g_Directory);
+
+    printf("DaemonSoakTest: idle %d s: %llu wakeups (%.1f per hour), CPU %.3f ms (%.5f%%)\n",
+           g_Seconds, (unsigned long long)g_IdleWakeups, 3600.0 * (double)g_IdleWakeups / g_Seconds,
+           g_IdleCpu * 1000, 100.0 * g_IdleCpu / g_Seconds);
+    printf("DaemonSoakTest: jiggling %d s at 1 s: %llu wakeups for %llu jiggles (%.0f per hour), CPU %.3f ms (%.5f%%)\n",
+           g_Seconds, (unsigned long long)g_JiggleWakeups, (unsigned long long)g_Jiggles,
+           3600.0 * (double)g_JiggleWakeups / g_Seconds, g_JiggleCpu * 1000, 100.0 * g_JiggleCpu / g_Seconds);
+    return CheckSummary("DaemonSoakTest");
+}
@@ -0,0 +1,199 @@
+// MouseJiggler - evdev injection probe tests (Linux)
+//
+// Runs the probe of linux/EvdevProbe.h unattended: the uinput sink writes into a
+// pipe and the probe reads the events back from its other end, standing in for
+// the evdev node. Wrapping sinks lose jiggles, lose the back half of a zen jiggle
+// or scale the movement as pointer acceleration would, and the report has to
+// count each as observed or registered accordingly. If /dev/uinput is writable
+// and its evdev node readable, the probe also runs against a real virtual
+// pointer. See tests/Makefile.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "../linux/EvdevProbe.h"
+#include "Check.h"
+
+#define TEST_SAMPLES        20
+#define TEST_TIMEOUT_MS     20
+
+// A sink in front of the uinput sink that misbehaves in one way
+struct FaultySink {
+    MJInputSink inner;
+    int dropEvery;          // Lose every Nth submit (0 = none)
+    bool dropZenReturn;     // Deliver only the first move of a batch
+    int32_t scale;          // Multiply the movement
+    int submits;
+};
+
+static uint32_t MJ_CALL FaultySinkSubmit(void* context, const MJInputEvent* events, uint32_t count,
+                                         uint64_t timestampUs, uint32_t* status) {
+    FaultySink* faulty = (FaultySink*)context;
+    faulty->submits++;
+    if (faulty->dropEvery && faulty->submits % faulty->dropEvery == 0) {
+        for (uint32_t i = 0; i < count; i++) status[i] = MJ_SINK_OK;
+        return count;
+    }
+
+    MJInputEvent moves[PROBE_MAX_MOTIONS] = {};
+    uint32_t forwarded = faulty->dropZenReturn ? 1 : count;
+    for (uint32_t i = 0; i < forwarded; i++) {
+        moves[i] = events[i];
+        moves[i].dx *= faulty->scale;
+        moves[i].dy *= faulty->scale;
+    }
+    faulty->inner.submit(faulty->inner.context, moves, forwarded, timestampUs, status);
+    for (uint32_t i = forwarded; i < count; i++) status[i] = MJ_SINK_OK;
+    return count;
+}
+
+static void UseFaultySink(MJInputSink* sink, FaultySink* faulty, int fd) {
+    UseUinputSink(&faulty->inner, fd);
+    faulty->submits = 0;
+    memset(sink, 0, sizeof(*sink));
+    sink->abiVersion = MJ_INPUT_SINK_ABI_VERSION;
+    sink->size = sizeof(MJInputSink);
+    sink->name = "faulty";
+    sink->context = faulty;
+    sink->submit = FaultySinkSubmit;
+}
+
+// observed and registered counts of one movement type in the report; false if it is missing
+static bool ReportCounts(const char* report, const char* type, int* observed, int* registered) {
+    char prefix[16];
+    snprintf(prefix, sizeof(prefix), "\n%-8s ", type);
+    const char* line = strstr(report, prefix);
+    int samples;
+    return line && sscanf(line + 1 + 8, " %d/%d %d/%d", observed, &samples, registered, &samples) == 4;
+}
+
+static void CheckAllTypes(const char* report, int expectObserved, int expectRegistered, int expectZenRegistered) {
+    for (int type = 0; type <= DAEMON_PATTERN_COUNT; type++) {
+        const char* name = type == 0 ? "Zen" : g_DaemonPatterns[type - 1].name;
+        int observed = -1, registered = -1;
+        CHECK(ReportCounts(report, name, &observed, &registered));
+        CHECK(observed == expectObserved);
+        CHECK(registered == (type == 0 ? expectZenRegistered : expectRegistered));
+    }
+}
+
+// Run the probe through 'sink' writing to a fresh pipe; fills 'report'
+static void RunThroughPipe(MJInputSink* sink, FaultySink* faulty, char* report, size_t reportSize) {
+    int fds[2];
+    CHECK(pipe2(fds, O_CLOEXEC) == 0);
+    if (faulty) {
+        UseFaultySink(sink, faulty, fds[1]);
+    } else {
+        UseUinputSink(sink, fds[1]);
+    }
+    RunEvdevProbe(sink, fds[0], TEST_SAMPLES, TEST_TIMEOUT_MS, report, reportSize);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// Every jiggle comes back intact, promptly
+static void TestDelivered() {
+    MJInputSink sink;
+    char report[2048];
+    RunThroughPipe(&sink, nullptr, report, sizeof(report));
+    CHECK(strstr(report, "20 samples per movement type via uinput sink\n") != nullptr);
+    CheckAllTypes(report, TEST_SAMPLES, TEST_SAMPLES, TEST_SAMPLES);
+
+    // The latency columns are filled in and well under the timeout
+    const char* zen = strstr(report, "\nZen ");
+    long long p50 = -1, p90 = -1, p99 = -1, max = -1;
+    CHECK(zen && sscanf(zen, "\nZen %*d/%*d %*d/%*d %lld %lld %lld %lld", &p50, &p90, &p99, &max) == 4);
+    CHECK(p50 >= 0 && p50 <= p90 && p90 <= p99 && p99 <= max && max < TEST_TIMEOUT_MS * 1000);
+}
+
+// Lost jiggles are neither observed nor registered, and cost no more than the timeout
+static void TestDropped() {
+    MJInputSink sink;
+    FaultySink faulty = {};
+    faulty.dropEvery = 2;
+    faulty.scale = 1;
+    char report[2048];
+    int64_t start = ProbeClockUs();
+    RunThroughPipe(&sink, &faulty, report, sizeof(report));
+    int64_t elapsedMs = (ProbeClockUs() - start) / 1000;
+
+    CheckAllTypes(report, TEST_SAMPLES / 2, TEST_SAMPLES / 2, TEST_SAMPLES / 2);
+    int timeouts = (DAEMON_PATTERN_COUNT + 1) * TEST_SAMPLES / 2;
+    CHECK(elapsedMs >= timeouts * TEST_TIMEOUT_MS && elapsedMs < timeouts * TEST_TIMEOUT_MS + 1000);
+}
+
+// Zen without its way back is seen but does not register; single-move patterns are unaffected
+static void TestZenReturnDropped() {
+    MJInputSink sink;
+    FaultySink faulty = {};
+    faulty.dropZenReturn = true;
+    faulty.scale = 1;
+    char report[2048];
+    RunThroughPipe(&sink, &faulty, report, sizeof(report));
+    CheckAllTypes(report, TEST_SAMPLES, TEST_SAMPLES, 0);
+}
+
+// Scaled movement arrives but is not the jiggle that was injected
+static void TestScaled() {
+    MJInputSink sink;
+    FaultySink faulty = {};
+    faulty.scale = 2;
+    char report[2048];
+    RunThroughPipe(&sink, &faulty, report, sizeof(report));
+    CheckAllTypes(report, TEST_SAMPLES, 0, 0);
+}
+
+// Without a reader every jiggle is still injected, and none is observed
+static void TestNoReader() {
+    int fds[2];
+    CHECK(pipe2(fds, O_CLOEXEC | O_NONBLOCK) == 0);
+    MJInputSink sink;
+    UseUinputSink(&sink, fds[1]);
+    char report[2048];
+    RunEvdevProbe(&sink, -1, TEST_SAMPLES, TEST_TIMEOUT_MS, report, sizeof(report));
+    CHECK(strstr(report, "(no evdev node, nothing observed)") != nullptr);
+    CheckAllTypes(report, 0, 0, 0);
+    CHECK(strstr(report, "         -         -         -         -\n") != nullptr);
+
+    // Zen writes two reports, ZigZag two events and a report, Square and Nudge one event and a report
+    struct input_event events[1024];
+    ssize_t length = read(fds[0], events, sizeof(events));
+    CHECK(length == (ssize_t)(TEST_SAMPLES * (4 + 3 + 2 + 2) * sizeof(struct input_event)));
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// The real thing, if this machine lets us
+static void TestUinput() {
+    int fd = OpenUinputPointer();
+    if (fd < 0) {
+        printf("EvdevProbeTest: %s not writable, real device not probed\n", UINPUT_DEVICE_PATH);
+        return;
+    }
+    int evdevFd = OpenUinputEvdev(fd);
+    if (evdevFd < 0) {
+        printf("EvdevProbeTest: evdev node of the virtual pointer not readable, real device not probed\n");
+        CloseUinputPointer(fd);
+        return;
+    }
+
+    MJInputSink sink;
+    UseUinputSink(&sink, fd);
+    static char report[2048];
+    RunEvdevProbe(&sink, evdevFd, TEST_SAMPLES, PROBE_TIMEOUT_MS, report, sizeof(report));
+    CheckAllTypes(report, TEST_SAMPLES, TEST_SAMPLES, TEST_SAMPLES);
+    fputs(report, stdout);
+    close(evdevFd);
+    sink.destroy(sink.context);
+}
+
+int main() {
+    TestDelivered();
+    TestDropped();
+    TestZenReturnDropped();
+    TestScaled();
+    TestNoReader();
+    TestUinput();
+    return CheckSummary("EvdevProbeTest");
+}
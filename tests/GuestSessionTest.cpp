@@ -0,0 +1,439 @@
+// MouseJiggler - VM guest session tests
+//
+// Runs the QMP sessions of GuestSession.h two ways. Against a scripted host
+// (a clock the test sets and a log of what was sent) it checks negotiation,
+// pipelining, replies split across reads, and the connect, greeting and reply
+// timeouts. Against a fake QMP server on the loopback interface (IPv4, and IPv6
+// if available), driven by the same non-blocking connect, poll and recv steps
+// as Main.cpp, it checks that every jiggle arrives with its deltas and is
+// answered. See tests/Makefile.
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#include <wchar.h>
+#include "../GuestSession.h"
+#include "Check.h"
+
+static const char g_Greeting[] =
+    "{\"QMP\": {\"version\": {\"qemu\": {\"micro\": 0, \"minor\": 2, \"major\": 8}}, \"capabilities\": [\"oob\"]}}\r\n";
+static const char g_Return[] = "{\"return\": {}}\r\n";
+static const char g_Event[] =
+    "{\"timestamp\": {\"seconds\": 1, \"microseconds\": 2}, \"event\": \"NIC_RX_FILTER_CHANGED\", \"data\": {}}\r\n";
+static const char g_Error[] = "{\"error\": {\"class\": \"GenericError\", \"desc\": \"no input device\"}}\r\n";
+
+// Scripted host: the test sets the clock and reads what was sent
+static uint64_t g_NowUs = 1000000000;
+static char g_Sent[8192];
+static int g_SentLength = 0;
+static int g_Closes = 0;
+static bool g_SendFails = false;
+
+static uint64_t ScriptedNowUs() { return g_NowUs; }
+
+static bool ScriptedSend(intptr_t connection, const char* data, int length) {
+    (void)connection;
+    if (g_SendFails || g_SentLength + length >= (int)sizeof(g_Sent)) return false;
+    memcpy(g_Sent + g_SentLength, data, (size_t)length);
+    g_SentLength += length;
+    g_Sent[g_SentLength] = '\0';
+    return true;
+}
+
+static void ScriptedClose(intptr_t connection) {
+    (void)connection;
+    g_Closes++;
+}
+
+static const GuestHost g_ScriptedHost = { ScriptedNowUs, ScriptedSend, ScriptedClose };
+
+// Deliver text as if recv() had returned it
+static void Receive(GuestSession& session, const char* text) {
+    int length = (int)strlen(text);
+    CHECK(length <= session.ReceiveSpace());
+    memcpy(session.ReceiveBuffer(), text, (size_t)length);
+    session.OnReceived(length);
+}
+
+static void Negotiate(GuestSession& session) {
+    session.Connecting(7);
+    session.Connected();
+    g_SentLength = 0;
+    Receive(session, g_Greeting);
+    CHECK(strcmp(g_Sent, "{\"execute\":\"qmp_capabilities\"}\r\n") == 0);
+    CHECK(session.state == GUEST_NEGOTIATING);
+    Receive(session, g_Return);
+    CHECK(session.state == GUEST_READY);
+    g_SentLength = 0;
+}
+
+static void TestNegotiation() {
+    GuestSession session;
+    session.host = &g_ScriptedHost;
+    Negotiate(session);
+    CHECK(session.stats.connects == 1 && session.stats.errors == 0);
+
+    // An error reply to qmp_capabilities drops the connection
+    GuestSession refused;
+    refused.host = &g_ScriptedHost;
+    refused.Connecting(8);
+    refused.Connected();
+    Receive(refused, g_Greeting);
+    int closes = g_Closes;
+    Receive(refused, g_Error);
+    CHECK(refused.state == GUEST_DISCONNECTED && refused.connection == GUEST_NO_CONNECTION);
+    CHECK(g_Closes == closes + 1 && refused.stats.errors == 1);
+}
+
+// Commands are pipelined up to the depth; replies match them in order, events are skipped
+static void TestPipeline() {
+    GuestSession session;
+    session.host = &g_ScriptedHost;
+    Negotiate(session);
+
+    for (int i = 0; i < GUEST_PIPELINE_DEPTH; i++) {
+        CHECK(session.Jiggle(i, -i));
+        g_NowUs += 1000;
+    }
+    CHECK(strstr(g_Sent, "{\"axis\":\"x\",\"value\":3}},{\"type\":\"rel\",\"data\":{\"axis\":\"y\",\"value\":-3}}") != nullptr);
+    CHECK(!session.Jiggle(99, 99));     // Full: skipped and counted
+    CHECK(session.stats.commandsSent == GUEST_PIPELINE_DEPTH && session.stats.errors == 1);
+
+    // The first reply is 8 ms after its command, split across two reads around an event
+    Receive(session, g_Event);
+    Receive(session, "{\"retu");
+    CHECK(session.stats.replies == 0);
+    Receive(session, "rn\": {}}\r\n");
+    CHECK(session.stats.replies == 1 && session.stats.latencyMaxUs == 8000);
+
+    // One error reply; the rest in a single read
+    Receive(session, g_Error);
+    char rest[1024] = "";
+    for (int i = 2; i < GUEST_PIPELINE_DEPTH; i++) {
+        strcat(rest, g_Return);
+    }
+    Receive(session, rest);
+    CHECK(session.stats.replies == GUEST_PIPELINE_DEPTH && session.inflightCount == 0);
+    CHECK(session.stats.errors == 2);
+    CHECK(session.stats.latencyTotalUs == 8000ull * GUEST_PIPELINE_DEPTH - 1000ull * (GUEST_PIPELINE_DEPTH - 1) * GUEST_PIPELINE_DEPTH / 2);
+    CHECK(session.ReplyDue() == 0);
+
+    // A reply without a command is ignored
+    Receive(session, g_Return);
+    CHECK(session.stats.replies == GUEST_PIPELINE_DEPTH);
+
+    // A failed send is not in flight
+    g_SendFails = true;
+    CHECK(!session.Jiggle(1, 1));
+    g_SendFails = false;
+    CHECK(session.inflightCount == 0 && session.stats.errors == 3);
+}
+
+// A stalled connect, a silent greeting and an unanswered command each time out
+static void TestTimeouts() {
+    GuestSession session;
+    session.host = &g_ScriptedHost;
+
+    // Connect: nothing happens for GUEST_CONNECT_TIMEOUT_MS
+    session.Connecting(9);
+    uint64_t due = session.ReplyDue();
+    CHECK(due == g_NowUs / 1000 + GUEST_CONNECT_TIMEOUT_MS);
+    CHECK(!session.TimedOut(due - 1));
+    int closes = g_Closes;
+    CHECK(session.TimedOut(due));
+    CHECK(session.state == GUEST_DISCONNECTED && g_Closes == closes + 1 && session.stats.timeouts == 1);
+    CHECK(session.ReplyDue() == 0 && !session.TimedOut(due + 100000));
+
+    // Greeting: connected, but the monitor says nothing
+    session.Connecting(10);
+    g_NowUs += 3000000;
+    session.Connected();
+    CHECK(session.ReplyDue() == g_NowUs / 1000 + GUEST_REPLY_TIMEOUT_MS);
+    CHECK(session.TimedOut(g_NowUs / 1000 + GUEST_REPLY_TIMEOUT_MS) && session.stats.timeouts == 2);
+
+    // Reply: the oldest command sets the deadline, and a reply moves it on
+    Negotiate(session);
+    CHECK(session.ReplyDue() == 0);
+    uint64_t first = g_NowUs / 1000;
+    session.Jiggle(1, 0);
+    g_NowUs += 4000000;
+    session.Jiggle(-1, 0);
+    CHECK(session.ReplyDue() == first + GUEST_REPLY_TIMEOUT_MS);
+    Receive(session, g_Return);
+    CHECK(session.ReplyDue() == first + 4000 + GUEST_REPLY_TIMEOUT_MS);
+    CHECK(!session.TimedOut(first + GUEST_REPLY_TIMEOUT_MS));
+    CHECK(session.TimedOut(first + 4000 + GUEST_REPLY_TIMEOUT_MS) && session.stats.timeouts == 3);
+    CHECK(session.inflightCount == 0 && session.stats.connects == 2);
+}
+
+// A line longer than the buffer is not QMP
+static void TestOverlongLine() {
+    GuestSession session;
+    session.host = &g_ScriptedHost;
+    Negotiate(session);
+    static char junk[GUEST_RECEIVE_BUFFER];
+    memset(junk, 'x', GUEST_RECEIVE_BUFFER - 1);
+    junk[GUEST_RECEIVE_BUFFER / 2 - 1] = '\0';
+    Receive(session, junk);
+    CHECK(session.state == GUEST_READY);
+    junk[GUEST_RECEIVE_BUFFER / 2 - 1] = 'x';
+    junk[GUEST_RECEIVE_BUFFER / 2] = '\0';
+    Receive(session, junk);
+    CHECK(session.state == GUEST_DISCONNECTED && session.stats.errors == 1);
+}
+
+// Deadlines move by whole periods; missed ones are not made up
+static void TestReschedule() {
+    GuestSession session;
+    session.jigglePeriod = 60;
+    session.nextDue = 100000;
+    session.Reschedule(100000);
+    CHECK(session.nextDue == 160000);
+    session.Reschedule(160000 + 60000 * 5 + 1);
+    CHECK(session.nextDue == 160000 + 60000 * 6);
+}
+
+static void TestAddress() {
+    char address[64];
+    char* host;
+    char* port;
+
+    snprintf(address, sizeof(address), "127.0.0.1:4444");
+    CHECK(SplitGuestAddress(address, &host, &port) && strcmp(host, "127.0.0.1") == 0 && strcmp(port, "4444") == 0);
+    snprintf(address, sizeof(address), "localhost:4445");
+    CHECK(SplitGuestAddress(address, &host, &port) && strcmp(host, "localhost") == 0 && strcmp(port, "4445") == 0);
+    snprintf(address, sizeof(address), "[::1]:4446");
+    CHECK(SplitGuestAddress(address, &host, &port) && strcmp(host, "::1") == 0 && strcmp(port, "4446") == 0);
+    snprintf(address, sizeof(address), "[fe80::1%%eth0]:1");
+    CHECK(SplitGuestAddress(address, &host, &port) && strcmp(host, "fe80::1%eth0") == 0 && strcmp(port, "1") == 0);
+
+    const char* invalid[] = { "::1:4444", "[::1]", "[::1]4444", "[::1:4444", "[]:4444", "host:", ":4444", "noport", "" };
+    for (const char* text : invalid) {
+        snprintf(address, sizeof(address), "%s", text);
+        CHECK(!SplitGuestAddress(address, &host, &port));
+    }
+
+    // The same code serves TCHAR in the Windows build
+    wchar_t wide[] = L"[::1]:4444";
+    wchar_t* wideHost;
+    wchar_t* widePort;
+    CHECK(SplitGuestAddress(wide, &wideHost, &widePort) && wcscmp(wideHost, L"::1") == 0 && wcscmp(widePort, L"4444") == 0);
+}
+
+// POSIX host for the loopback runs
+static uint64_t MonotonicUs() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+static bool SocketSend(intptr_t connection, const char* data, int length) {
+    return send((int)connection, data, (size_t)length, MSG_NOSIGNAL) == length;
+}
+
+static void SocketClose(intptr_t connection) {
+    close((int)connection);
+}
+
+static const GuestHost g_SocketHost = { MonotonicUs, SocketSend, SocketClose };
+
+// Fake QMP monitor: greets, accepts qmp_capabilities, and answers every
+// input-send-event with an event and a reply, recording the deltas
+struct FakeMonitor {
+    int listener = -1;
+    int client = -1;
+    char received[8192];
+    int receivedLength = 0;
+    int capabilities = 0;
+    int jiggles = 0;
+    long sumX = 0;
+    long sumY = 0;
+
+    void Accept() {
+        client = accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (client >= 0) {
+            send(client, g_Greeting, sizeof(g_Greeting) - 1, MSG_NOSIGNAL);
+        }
+    }
+
+    void Read() {
+        ssize_t length = recv(client, received + receivedLength, sizeof(received) - 1 - (size_t)receivedLength, 0);
+        if (length <= 0) return;
+        receivedLength += (int)length;
+        received[receivedLength] = '\0';
+
+        char* lineStart = received;
+        char* lineEnd;
+        while ((lineEnd = strchr(lineStart, '\n')) != nullptr) {
+            *lineEnd = '\0';
+            if (strstr(lineStart, "qmp_capabilities")) {
+                capabilities++;
+                send(client, g_Return, sizeof(g_Return) - 1, MSG_NOSIGNAL);
+            } else if (strstr(lineStart, "input-send-event")) {
+                const char* x = strstr(lineStart, "\"axis\":\"x\",\"value\":");
+                const char* y = strstr(lineStart, "\"axis\":\"y\",\"value\":");
+                if (x && y) {
+                    jiggles++;
+                    sumX += atol(x + 19);
+                    sumY += atol(y + 19);
+                }
+                char reply[512];
+                int replyLength = snprintf(reply, sizeof(reply), "%s%s", g_Event, g_Return);
+                send(client, reply, (size_t)replyLength, MSG_NOSIGNAL);
+            }
+            lineStart = lineEnd + 1;
+        }
+        receivedLength = (int)(received + receivedLength - lineStart);
+        memmove(received, lineStart, (size_t)receivedLength);
+    }
+};
+
+// One pass of the event loop: the monitor's side, then the session's as OnGuestSocket does it
+static void Pump(FakeMonitor& monitor, GuestSession& session, int timeoutMs) {
+    struct pollfd fds[3];
+    int count = 0;
+    fds[count++] = { monitor.listener, POLLIN, 0 };
+    if (monitor.client >= 0) fds[count++] = { monitor.client, POLLIN, 0 };
+    int sessionIndex = -1;
+    if (session.connection != GUEST_NO_CONNECTION) {
+        sessionIndex = count;
+        fds[count++] = { (int)session.connection, (short)(session.state == GUEST_CONNECTING ? POLLOUT : POLLIN), 0 };
+    }
+    if (poll(fds, (nfds_t)count, timeoutMs) <= 0) return;
+
+    if (fds[0].revents & POLLIN) monitor.Accept();
+    if (monitor.client >= 0 && count > 1 && fds[1].fd == monitor.client && (fds[1].revents & POLLIN)) monitor.Read();
+
+    if (sessionIndex < 0 || fds[sessionIndex].revents == 0) return;
+    if (session.state == GUEST_CONNECTING) {
+        int error = 0;
+        socklen_t errorLength = sizeof(error);
+        getsockopt((int)session.connection, SOL_SOCKET, SO_ERROR, &error, &errorLength);
+        if (error != 0) {
+            session.stats.errors++;
+            session.Disconnect();
+        } else {
+            session.Connected();
+        }
+        return;
+    }
+    ssize_t received = recv((int)session.connection, session.ReceiveBuffer(), (size_t)session.ReceiveSpace(), 0);
+    if (received <= 0) {
+        if (received == 0 || errno != EAGAIN) session.Disconnect();
+        return;
+    }
+    session.OnReceived((int)received);
+}
+
+// Connect to the fake monitor at 'address' (as in the INI file), negotiate and jiggle
+static void RunLoopback(int family, const char* loopback) {
+    FakeMonitor monitor;
+    monitor.listener = socket(family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    CHECK(monitor.listener >= 0);
+    struct sockaddr_storage bound = {};
+    socklen_t boundLength;
+    if (family == AF_INET6) {
+        struct sockaddr_in6* in6 = (struct sockaddr_in6*)&bound;
+        in6->sin6_family = AF_INET6;
+        in6->sin6_addr = in6addr_loopback;
+        boundLength = sizeof(*in6);
+    } else {
+        struct sockaddr_in* in4 = (struct sockaddr_in*)&bound;
+        in4->sin_family = AF_INET;
+        in4->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        boundLength = sizeof(*in4);
+    }
+    if (bind(monitor.listener, (struct sockaddr*)&bound, boundLength) != 0 || listen(monitor.listener, 1) != 0) {
+        printf("GuestSessionTest: no %s loopback (%s), skipped\n", loopback, strerror(errno));
+        close(monitor.listener);
+        return;
+    }
+    getsockname(monitor.listener, (struct sockaddr*)&bound, &boundLength);
+    int boundPort = ntohs(family == AF_INET6 ? ((struct sockaddr_in6*)&bound)->sin6_port
+                                             : ((struct sockaddr_in*)&bound)->sin_port);
+
+    // Address= as a user would write it, resolved as LoadGuests does
+    char address[64];
+    snprintf(address, sizeof(address), family == AF_INET6 ? "[%s]:%d" : "%s:%d", loopback, boundPort);
+    char* host;
+    char* port;
+    CHECK(SplitGuestAddress(address, &host, &port));
+    struct addrinfo hints = {};
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_protocol = IPPROTO_TCP;
+    struct addrinfo* result = nullptr;
+    CHECK(getaddrinfo(host, port, &hints, &result) == 0 && result && result->ai_family == family);
+    if (!result) return;
+
+    GuestSession session;
+    session.host = &g_SocketHost;
+    int fd = socket(result->ai_family, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, IPPROTO_TCP);
+    int noDelay = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &noDelay, sizeof(noDelay));
+    session.Connecting(fd);
+    if (connect(fd, result->ai_addr, result->ai_addrlen) != 0 && errno != EINPROGRESS) {
+        session.Disconnect();
+    }
+    freeaddrinfo(result);
+
+    uint64_t deadline = MonotonicUs() + 5000000;
+    while (session.state != GUEST_READY && session.state != GUEST_DISCONNECTED && MonotonicUs() < deadline) {
+        Pump(monitor, session, 100);
+    }
+    CHECK(session.state == GUEST_READY && monitor.capabilities == 1);
+
+    // 100 jiggles, four in flight at a time
+    const int total = 100;
+    int sent = 0;
+    while (session.stats.replies < total && session.state == GUEST_READY && MonotonicUs() < deadline) {
+        while (sent < total && session.inflightCount < 4) {
+            CHECK(session.Jiggle(sent % 7 - 3, 2));
+            sent++;
+        }
+        Pump(monitor, session, 100);
+    }
+    while (monitor.jiggles < total && MonotonicUs() < deadline) {
+        Pump(monitor, session, 10);
+    }
+
+    long expectedX = 0;
+    for (int i = 0; i < total; i++) expectedX += i % 7 - 3;
+    CHECK(monitor.jiggles == total && monitor.sumX == expectedX && monitor.sumY == 2 * total);
+    CHECK(session.stats.commandsSent == total && session.stats.replies == total);
+    CHECK(session.stats.errors == 0 && session.stats.timeouts == 0 && session.stats.connects == 1);
+    CHECK(session.stats.latencyMaxUs < GUEST_REPLY_TIMEOUT_MS * 1000ull);
+    printf("GuestSessionTest: %s: %d jiggles answered, latency avg %.1f us, max %llu us\n", loopback, total,
+           (double)session.stats.latencyTotalUs / total, (unsigned long long)session.stats.latencyMaxUs);
+
+    // The monitor going away disconnects the session
+    close(monitor.client);
+    monitor.client = -1;
+    while (session.state != GUEST_DISCONNECTED && MonotonicUs() < deadline) {
+        Pump(monitor, session, 100);
+    }
+    CHECK(session.state == GUEST_DISCONNECTED && session.connection == GUEST_NO_CONNECTION);
+    close(monitor.listener);
+}
+
+int main() {
+    TestNegotiation();
+    TestPipeline();
+    TestTimeouts();
+    TestOverlongLine();
+    TestReschedule();
+    TestAddress();
+    RunLoopback(AF_INET, "127.0.0.1");
+    RunLoopback(AF_INET6, "::1");
+    return CheckSummary("GuestSessionTest");
+}
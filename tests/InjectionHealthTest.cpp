@@ -0,0 +1,244 @@
+// MouseJiggler - Injection health tests
+//
+// Runs the failure classifier and backoff of InjectionHealth.h against a fault
+// sink: an MJInputSink that fails on demand and counts every submit, so each
+// attempt made while injection cannot succeed is a wasted one. Checks that
+// backoff keeps the waste bounded for each failure class, that known blockers
+// (UIPI, a locked session) cost no attempts at all, and that success, unlock
+// and the elevated window losing focus resume injection on the next deadline.
+// No Win32 is needed; see tests/Makefile.
+
+#include <stdio.h>
+#include "../InjectionHealth.h"
+#include "Check.h"
+
+// Simulated environment
+static bool g_SinkFails = false;
+static bool g_SecureDesktop = false;
+static bool g_ForegroundAbove = false;
+static uint64_t g_Submits = 0;
+static uint64_t g_WastedSubmits = 0;
+static bool g_Fallback = false;
+static int g_FallbackChanges = 0;
+static int g_Recoveries = 0;
+
+static InjectionHealth g_Health;
+
+// Fault sink: refuses every event while g_SinkFails, or while UIPI would drop the
+// input (SendInput then reports success, so UIPI drops count as delivered but wasted)
+static uint32_t MJ_CALL FaultSinkSubmit(void* context, const MJInputEvent* events, uint32_t count,
+                                        uint64_t timestampUs, uint32_t* status) {
+    (void)context;
+    (void)events;
+    (void)timestampUs;
+    g_Submits++;
+    if (g_SinkFails || g_ForegroundAbove) {
+        g_WastedSubmits++;
+    }
+    for (uint32_t i = 0; i < count; i++) {
+        status[i] = g_SinkFails ? MJ_SINK_FAILED : MJ_SINK_OK;
+    }
+    return g_SinkFails ? 0 : count;
+}
+
+static const MJInputSink g_FaultSink = {
+    MJ_INPUT_SINK_ABI_VERSION, sizeof(MJInputSink), "Fault", nullptr, FaultSinkSubmit, nullptr
+};
+
+// Injection host, as PerformJiggleBatch in Main.cpp: submit, then classify any failure
+static int Inject(const MJInputEvent* events, uint32_t count, uint32_t* delivered) {
+    uint32_t status[16];
+    CHECK(count <= 16);
+    *delivered = g_FaultSink.submit(g_FaultSink.context, events, count, 0, status);
+    return *delivered == count ? INJECT_OK : g_Health.Classify();
+}
+
+static bool SecureDesktop() { return g_SecureDesktop; }
+static bool ForegroundAbove() { return g_ForegroundAbove; }
+
+static void Fallback(bool active) {
+    g_Fallback = active;
+    g_FallbackChanges++;
+}
+
+static void Recovered() {
+    g_Recoveries++;
+}
+
+static const InjectionHost g_Host = { SecureDesktop, ForegroundAbove, Inject, Fallback, Recovered };
+
+static void Reset() {
+    g_Health = InjectionHealth();
+    g_Health.host = &g_Host;
+    g_SinkFails = false;
+    g_SecureDesktop = false;
+    g_ForegroundAbove = false;
+    g_Submits = 0;
+    g_WastedSubmits = 0;
+    g_Fallback = false;
+    g_FallbackChanges = 0;
+    g_Recoveries = 0;
+}
+
+// One jiggle per deadline for 'deadlines' deadlines; returns how many were delivered
+static uint64_t RunDeadlines(uint64_t deadlines) {
+    MJInputEvent event = { MJ_EVENT_MOVE, 1, 0, 0, 0 };
+    uint64_t delivered = 0;
+    for (uint64_t i = 0; i < deadlines; i++) {
+        delivered += g_Health.Inject(&event, 1);
+    }
+    return delivered;
+}
+
+// Attempts a class makes in 'deadlines' consecutive failing deadlines: the
+// backoff doubles from 1 up to 'limit' periods skipped after each attempt
+static uint64_t ExpectedAttempts(uint64_t deadlines, int limit) {
+    uint64_t attempts = 0;
+    int backoff = 0;
+    for (uint64_t i = 0; i < deadlines; attempts++) {
+        backoff = backoff == 0 ? 1 : (backoff * 2 > limit ? limit : backoff * 2);
+        i += 1 + (uint64_t)backoff;
+    }
+    return attempts;
+}
+
+static void TestHealthy() {
+    Reset();
+    CHECK(RunDeadlines(100) == 100);
+    CHECK(g_Submits == 100 && g_WastedSubmits == 0);
+    CHECK(g_Health.skipped == 0 && g_Health.lastClass == INJECT_OK);
+    CHECK(g_FallbackChanges == 0 && g_Recoveries == 0);
+}
+
+static void TestTransient() {
+    const uint64_t deadlines = 1000;
+    Reset();
+    g_SinkFails = true;
+    CHECK(RunDeadlines(deadlines) == 0);
+    CHECK(g_Health.lastClass == INJECT_TRANSIENT);
+    CHECK(g_WastedSubmits == ExpectedAttempts(deadlines, INJECT_TRANSIENT_BACKOFF_MAX));
+    CHECK(g_Health.failures[INJECT_TRANSIENT] == g_WastedSubmits);
+    CHECK(g_Health.skipped + g_WastedSubmits == deadlines);
+    CHECK(!g_Fallback);
+    printf("InjectionHealthTest: transient failure for %llu deadlines: %llu wasted attempts\n",
+           (unsigned long long)deadlines, (unsigned long long)g_WastedSubmits);
+
+    // The sink recovers: the next attempt (within the capped backoff) succeeds and resets it all
+    g_SinkFails = false;
+    CHECK(RunDeadlines(INJECT_TRANSIENT_BACKOFF_MAX + 1) >= 1);
+    CHECK(g_Health.lastClass == INJECT_OK && g_Recoveries == 1);
+    CHECK(g_Health.backoff[INJECT_TRANSIENT] == 0 && g_Health.skipRemaining == 0);
+    CHECK(RunDeadlines(10) == 10);
+}
+
+static void TestSecureDesktop() {
+    const uint64_t deadlines = 1000;
+    Reset();
+    g_SinkFails = true;
+    g_SecureDesktop = true;
+    CHECK(RunDeadlines(deadlines) == 0);
+    CHECK(g_Health.lastClass == INJECT_SECURE_DESKTOP);
+    CHECK(g_WastedSubmits == ExpectedAttempts(deadlines, INJECT_BACKOFF_MAX));
+    CHECK(g_WastedSubmits < deadlines / INJECT_BACKOFF_MAX + 8);
+    CHECK(!g_Fallback);
+    printf("InjectionHealthTest: secure desktop for %llu deadlines: %llu wasted attempts\n",
+           (unsigned long long)deadlines, (unsigned long long)g_WastedSubmits);
+
+    // The lock screen goes away with an unlock, which retries on the next deadline
+    g_SinkFails = false;
+    g_SecureDesktop = false;
+    g_Health.SetSessionLocked(true);
+    g_Health.SetSessionLocked(false);
+    CHECK(RunDeadlines(1) == 1);
+    CHECK(g_Recoveries == 1);
+}
+
+static void TestUipi() {
+    const uint64_t deadlines = 1000;
+    Reset();
+    g_ForegroundAbove = true;
+    CHECK(RunDeadlines(deadlines) == 0);
+
+    // UIPI is detected before sending: no attempt is made, the keep-alive takes over
+    CHECK(g_Submits == 0 && g_WastedSubmits == 0);
+    CHECK(g_Health.lastClass == INJECT_BLOCKED);
+    CHECK(g_Fallback && g_FallbackChanges == 1);
+    CHECK(g_Health.failures[INJECT_BLOCKED] == ExpectedAttempts(deadlines, INJECT_BACKOFF_MAX));
+    CHECK(g_Health.skipped == deadlines);
+    printf("InjectionHealthTest: UIPI block for %llu deadlines: %llu wasted attempts, %llu checks\n",
+           (unsigned long long)deadlines, (unsigned long long)g_WastedSubmits,
+           (unsigned long long)g_Health.failures[INJECT_BLOCKED]);
+
+    // The elevated window loses the foreground: inject on the very next deadline
+    CHECK(g_Health.skipRemaining > 0);
+    g_ForegroundAbove = false;
+    CHECK(RunDeadlines(1) == 1);
+    CHECK(g_Health.lastClass == INJECT_OK && !g_Fallback && g_FallbackChanges == 2 && g_Recoveries == 1);
+}
+
+static void TestLockedAndDisconnected() {
+    Reset();
+    g_Health.SetSessionLocked(true);
+    CHECK(RunDeadlines(100) == 0);
+    CHECK(g_Submits == 0 && g_Health.skipped == 100);
+    g_Health.SetSessionLocked(false);
+    CHECK(RunDeadlines(1) == 1);
+
+    // A UIPI fallback ends with the lock: the user is away
+    g_ForegroundAbove = true;
+    RunDeadlines(1);
+    CHECK(g_Fallback);
+    g_Health.SetSessionLocked(true);
+    CHECK(!g_Fallback);
+    g_ForegroundAbove = false;
+    g_Health.SetSessionLocked(false);
+
+    // A disconnected session classifies as such even when the sink is reached
+    Reset();
+    g_SinkFails = true;
+    g_SecureDesktop = true;
+    g_Health.sessionDisconnected = true;
+    CHECK(g_Health.Classify() == INJECT_DISCONNECTED);
+    g_Health.SetSessionDisconnected(true);
+    CHECK(RunDeadlines(100) == 0 && g_Submits == 0);
+    g_SinkFails = false;
+    g_SecureDesktop = false;
+    g_Health.SetSessionDisconnected(false);
+    CHECK(RunDeadlines(1) == 1);
+}
+
+// Backoff of one class does not outlast a success, and classes back off independently
+static void TestBackoffGrowth() {
+    Reset();
+    g_SinkFails = true;
+    g_SecureDesktop = true;
+    int expected = 1;
+    for (int attempt = 0; attempt < 8; attempt++) {
+        uint64_t before = g_Submits;
+        RunDeadlines(1);
+        CHECK(g_Submits == before + 1);
+        CHECK(g_Health.backoff[INJECT_SECURE_DESKTOP] == expected);
+        CHECK(g_Health.skipRemaining == expected);
+        RunDeadlines((uint64_t)expected);
+        CHECK(g_Submits == before + 1);
+        expected = expected * 2 > INJECT_BACKOFF_MAX ? INJECT_BACKOFF_MAX : expected * 2;
+    }
+    CHECK(g_Health.backoff[INJECT_TRANSIENT] == 0);
+
+    g_SinkFails = false;
+    g_SecureDesktop = false;
+    RunDeadlines(1);
+    for (int i = 0; i < INJECT_CLASS_COUNT; i++) {
+        CHECK(g_Health.backoff[i] == 0);
+    }
+}
+
+int main() {
+    TestHealthy();
+    TestTransient();
+    TestSecureDesktop();
+    TestUipi();
+    TestLockedAndDisconnected();
+    TestBackoffGrowth();
+    return CheckSummary("InjectionHealthTest");
+}
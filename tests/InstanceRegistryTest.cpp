@@ -0,0 +1,182 @@
+// MouseJiggler - Instance registry tests
+//
+// Drives the slot protocol in InstanceRegistry.h from threads standing in for
+// processes: claims of free, live and abandoned slots, owners that come and go
+// while others try to take their slot, and readers copying a slot while its
+// owner rewrites it. No Win32 is needed; see tests/Makefile.
+
+#include <atomic>
+#include <thread>
+#include "../InstanceRegistry.h"
+#include "Check.h"
+
+// Simulated process table: PIDs below DEAD_PID are alive, each created at 1000 * pid
+#define DEAD_PID    2000000
+
+static uint64_t CreatedAt(int32_t pid) {
+    return 1000ull * (uint64_t)pid;
+}
+
+static bool SimulatedOwnerGone(int32_t pid, uint64_t created) {
+    if (pid <= 0 || pid >= DEAD_PID) {
+        return true;
+    }
+    return created != 0 && created != CreatedAt(pid);
+}
+
+static InstanceSlot* NewSlot() {
+    static InstanceSlot slots[8];
+    static int used = 0;
+    InstanceSlot* slot = &slots[used++];
+    memset((void*)slot, 0, sizeof(InstanceSlot));
+    return slot;
+}
+
+static void TestClaimAndRelease() {
+    InstanceSlot* slot = NewSlot();
+    CHECK(ClaimInstanceSlot(slot, 1, CreatedAt(1), SimulatedOwnerGone));
+    CHECK(slot->ownerPid.load() == 1 && slot->ownerCreated.load() == CreatedAt(1));
+
+    // A live owner keeps its slot
+    CHECK(!ClaimInstanceSlot(slot, 2, CreatedAt(2), SimulatedOwnerGone));
+
+    InstanceStatus status = {};
+    status.jigglesSent = 42;
+    WriteInstanceStatus(slot, &status);
+
+    InstanceOwner owner;
+    InstanceStatus read;
+    CHECK(ReadInstanceSlot(slot, &owner, &read));
+    CHECK(owner.pid == 1 && owner.created == CreatedAt(1) && read.jigglesSent == 42);
+
+    // Release clears the creation time along with the PID
+    ReleaseInstanceSlot(slot, 1);
+    CHECK(slot->ownerPid.load() == 0 && slot->ownerCreated.load() == 0);
+    CHECK(!ReadInstanceSlot(slot, &owner, &read));
+
+    // Releasing a slot that is not ours changes nothing
+    CHECK(ClaimInstanceSlot(slot, 2, CreatedAt(2), SimulatedOwnerGone));
+    ReleaseInstanceSlot(slot, 1);
+    CHECK(slot->ownerPid.load() == 2);
+}
+
+static void TestAbandonedSlots() {
+    // Owner exited
+    InstanceSlot* slot = NewSlot();
+    CHECK(ClaimInstanceSlot(slot, DEAD_PID, 7, SimulatedOwnerGone));
+    CHECK(ClaimInstanceSlot(slot, 3, CreatedAt(3), SimulatedOwnerGone));
+    CHECK(slot->ownerPid.load() == 3);
+
+    // PID reused by a different process
+    slot = NewSlot();
+    CHECK(ClaimInstanceSlot(slot, 4, CreatedAt(4) + 1, SimulatedOwnerGone));
+    CHECK(ClaimInstanceSlot(slot, 5, CreatedAt(5), SimulatedOwnerGone));
+
+    // Claimant died between its compare-and-swap and publishing its PID
+    slot = NewSlot();
+    slot->ownerPid.store(-DEAD_PID);
+    slot->sequence.store(7);    // ... and mid-write
+    CHECK(ClaimInstanceSlot(slot, 6, CreatedAt(6), SimulatedOwnerGone));
+    CHECK(slot->ownerPid.load() == 6 && (slot->sequence.load() & 1) == 0);
+
+    // A live claimant keeps it
+    slot = NewSlot();
+    slot->ownerPid.store(-7);
+    CHECK(!ClaimInstanceSlot(slot, 8, CreatedAt(8), SimulatedOwnerGone));
+
+    // A slot of another layout is never taken, even if its owner is gone
+    slot = NewSlot();
+    slot->ownerPid.store(DEAD_PID);
+    slot->magic = REGISTRY_MAGIC;
+    slot->version = REGISTRY_VERSION - 1;
+    CHECK(!ClaimInstanceSlot(slot, 9, CreatedAt(9), SimulatedOwnerGone));
+}
+
+// Two threads start live processes that each claim the slot, hold it briefly and
+// release it, while a third keeps starting processes that try to claim it too.
+// Everyone stays alive, so a claim must only ever succeed on a free slot: seeing
+// one owner's PID with the previous owner's creation time would let a claimant
+// take over a live slot.
+static void TestClaimRace() {
+    InstanceSlot* slot = NewSlot();
+    std::atomic<int> holders(0);
+    std::atomic<bool> done(false);
+    std::atomic<unsigned long> overlaps(0);
+    std::atomic<unsigned long> claims(0);
+
+    auto owner = [&](int32_t firstPid) {
+        for (int32_t pid = firstPid; pid < firstPid + 200000; pid++) {
+            if (!ClaimInstanceSlot(slot, pid, CreatedAt(pid), SimulatedOwnerGone)) continue;
+            if (holders.fetch_add(1) != 0) overlaps++;
+            claims++;
+            holders.fetch_sub(1);
+            ReleaseInstanceSlot(slot, pid);
+        }
+    };
+
+    std::thread first(owner, 100000);
+    std::thread second(owner, 300000);
+    std::thread third([&]() {
+        for (int32_t pid = 500000; !done.load() && pid < DEAD_PID; pid++) {
+            if (!ClaimInstanceSlot(slot, pid, CreatedAt(pid), SimulatedOwnerGone)) continue;
+            if (holders.fetch_add(1) != 0) overlaps++;
+            claims++;
+            holders.fetch_sub(1);
+            ReleaseInstanceSlot(slot, pid);
+        }
+    });
+    first.join();
+    second.join();
+    done = true;
+    third.join();
+
+    CHECK(overlaps.load() == 0);
+    CHECK(claims.load() > 0);
+    CHECK(slot->ownerPid.load() == 0);
+}
+
+// A reader copying a slot while its owner rewrites it never sees a mix of two
+// writes: every counter of a status is written with the same value
+static void TestNoTornReads() {
+    InstanceSlot* slot = NewSlot();
+    CHECK(ClaimInstanceSlot(slot, 30, CreatedAt(30), SimulatedOwnerGone));
+
+    std::atomic<bool> done(false);
+    std::thread writer([&]() {
+        InstanceStatus status = {};
+        for (uint64_t value = 1; value <= 500000; value++) {
+            status.jigglesSent = value;
+            status.jiggleFailures = value;
+            status.injectionsSkipped = value;
+            status.nextJiggleDue = value;
+            status.lastUpdate = value;
+            WriteInstanceStatus(slot, &status);
+        }
+        done = true;
+    });
+
+    unsigned long reads = 0, torn = 0;
+    while (!done.load()) {
+        InstanceOwner owner;
+        InstanceStatus status;
+        if (!ReadInstanceSlot(slot, &owner, &status)) continue;
+        reads++;
+        uint64_t value = status.jigglesSent;
+        if (status.jiggleFailures != value || status.injectionsSkipped != value ||
+            status.nextJiggleDue != value || status.lastUpdate != value || owner.pid != 30) {
+            torn++;
+        }
+    }
+    writer.join();
+
+    CHECK(torn == 0);
+    CHECK(reads > 0);
+}
+
+int main() {
+    TestClaimAndRelease();
+    TestAbandonedSlots();
+    TestClaimRace();
+    TestNoTornReads();
+    return CheckSummary("InstanceRegistryTest");
+}
@@ -0,0 +1,295 @@
+// MouseJiggler - Linux profile switch test
+//
+// Checks SetIniString of linux/IniFile.h on its own (replacing a key, adding one
+// to a section, adding a section, keeping CRLF), then runs the real event loop of
+// linux/JigglerDaemon.h and switches profiles over the control socket from a
+// second thread, as `mousejigglerd -C profile <name>` does. Every switch must
+// write MouseJiggler.ini exactly once (one IN_CLOSE_WRITE, seen through a watch
+// of its own), change only the ActiveProfile line, not reload the settings and
+// not touch the heap; switching to the active profile writes nothing; an edit by
+// someone else still reloads. Reports the command-to-reply latency of a switch.
+// Linux only; see tests/Makefile.
+
+#define REGISTRY_SHM_NAME "/ArkaneSystems.MouseJiggler.ProfileSwitch%02d"
+
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <thread>
+#include "../linux/JigglerDaemon.h"
+#include "Check.h"
+
+#define TEST_SWITCHES       300
+
+static JigglerDaemon g_Jiggler;
+static char g_Directory[] = "/tmp/MouseJigglerProfileXXXXXX";
+static int64_t g_LatencyUs[TEST_SWITCHES];
+
+static const char g_Ini[] =
+    "; Written by hand\n"
+    "[Settings]\n"
+    "JigglePeriod=60\n"
+    "ActiveProfile=Office\n"
+    "\n"
+    "[Profile:Office]\n"
+    "JigglePeriod=240\n"
+    "\n"
+    "[Profile:Presenting]\n"
+    "JigglePeriod=30\n"
+    "ZenJiggle=1\n";
+
+static uint32_t MJ_CALL AcceptMoves(void* context, const MJInputEvent* events, uint32_t count,
+                                    uint64_t timestampUs, uint32_t* status) {
+    (void)context;
+    (void)events;
+    (void)timestampUs;
+    for (uint32_t i = 0; i < count; i++) status[i] = MJ_SINK_OK;
+    return count;
+}
+
+static void PathOf(const char* name, char* path, size_t pathSize) {
+    snprintf(path, pathSize, "%s/%s", g_Directory, name);
+}
+
+static void WriteFile(const char* name, const char* text) {
+    char path[PATH_MAX];
+    PathOf(name, path, sizeof(path));
+    FILE* file = fopen(path, "w");
+    if (file) {
+        fputs(text, file);
+        fclose(file);
+    }
+}
+
+static size_t ReadFile(const char* name, char* text, size_t textSize) {
+    char path[PATH_MAX];
+    PathOf(name, path, sizeof(path));
+    FILE* file = fopen(path, "r");
+    size_t length = file ? fread(text, 1, textSize - 1, file) : 0;
+    text[length] = '\0';
+    if (file) fclose(file);
+    return length;
+}
+
+// Write 'before' to test.ini, set the key and compare the file with 'expected'
+static void CheckSet(const char* before, const char* section, const char* key, const char* value,
+                     const char* expected) {
+    static IniFile ini;
+    char path[PATH_MAX];
+    PathOf("test.ini", path, sizeof(path));
+    WriteFile("test.ini", before);
+    CHECK(SetIniString(&ini, path, section, key, value));
+
+    char text[1024];
+    ReadFile("test.ini", text, sizeof(text));
+    CHECK(strcmp(text, expected) == 0);
+    if (strcmp(text, expected) != 0) printf("ProfileSwitchTest: got\n%s\n", text);
+
+    char read[64];
+    CHECK(GetIniString(&ini, section, key, "?", read, sizeof(read)) && strcmp(read, value) == 0);
+    unlink(path);
+}
+
+static void TestSetIniString() {
+    // Replace the first occurrence; comments, spacing and the other lines stay
+    CheckSet("; c\n[Settings]\nA=1\nActiveProfile = Old\nB=2\nActiveProfile=Second\n",
+             "Settings", "ActiveProfile", "New",
+             "; c\n[Settings]\nA=1\nActiveProfile=New\nB=2\nActiveProfile=Second\n");
+    CheckSet("[settings]\nACTIVEPROFILE=Old\n", "Settings", "ActiveProfile", "",
+             "[settings]\nActiveProfile=\n");
+
+    // A missing key goes after the last line of its section, before the blank lines
+    CheckSet("[Settings]\nA=1\n\n[Profile:X]\nA=2\n", "Settings", "ActiveProfile", "X",
+             "[Settings]\nA=1\nActiveProfile=X\n\n[Profile:X]\nA=2\n");
+    CheckSet("[Settings]\nA=1", "Settings", "B", "2", "[Settings]\nA=1\nB=2\n");
+    CheckSet("[Settings]\n", "Settings", "B", "2", "[Settings]\nB=2\n");
+
+    // A missing section goes at the end
+    CheckSet("[Other]\nA=1", "Settings", "ActiveProfile", "X", "[Other]\nA=1\n[Settings]\nActiveProfile=X\n");
+    CheckSet("", "Settings", "ActiveProfile", "X", "[Settings]\nActiveProfile=X\n");
+
+    // CRLF files stay CRLF
+    CheckSet("[Settings]\r\nActiveProfile=Old\r\nA=1\r\n", "Settings", "ActiveProfile", "New",
+             "[Settings]\r\nActiveProfile=New\r\nA=1\r\n");
+    CheckSet("[Settings]\r\nA=1\r\n", "Settings", "ActiveProfile", "New",
+             "[Settings]\r\nA=1\r\nActiveProfile=New\r\n");
+
+    // A file that would outgrow the buffer is left alone
+    static IniFile ini;
+    static char big[INI_MAX_SIZE + 1];
+    memset(big, ';', INI_MAX_SIZE);
+    big[INI_MAX_SIZE - 1] = '\n';
+    big[INI_MAX_SIZE] = '\0';
+    char path[PATH_MAX];
+    PathOf("test.ini", path, sizeof(path));
+    WriteFile("test.ini", big);
+    CHECK(!SetIniString(&ini, path, "Settings", "ActiveProfile", "X") && errno == EFBIG);
+    struct stat st;
+    CHECK(stat(path, &st) == 0 && st.st_size == INI_MAX_SIZE);
+    unlink(path);
+}
+
+// Send a command and wait for its one-line reply
+static void Command(int fd, const char* command, char* reply, size_t replySize) {
+    char line[DAEMON_COMMAND_LENGTH];
+    snprintf(line, sizeof(line), "%s\n", command);
+    send(fd, line, strlen(line), MSG_NOSIGNAL);
+
+    size_t length = 0;
+    reply[0] = '\0';
+    while (length + 1 < replySize && !strchr(reply, '\n')) {
+        ssize_t received = recv(fd, reply + length, replySize - 1 - length, 0);
+        if (received <= 0) break;
+        length += (size_t)received;
+        reply[length] = '\0';
+    }
+}
+
+static uint64_t StatusValue(const char* status, const char* key) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), " %s=", key);
+    const char* field = strstr(status, pattern);
+    return field ? strtoull(field + strlen(pattern), NULL, 10) : UINT64_MAX;
+}
+
+// Completed writes of MouseJiggler.ini since the last call
+static int IniWrites(int watchFd) {
+    alignas(struct inotify_event) char buffer[4096];
+    int writes = 0;
+    ssize_t length;
+    while ((length = read(watchFd, buffer, sizeof(buffer))) > 0) {
+        for (char* position = buffer; position < buffer + length;) {
+            const struct inotify_event* event = (const struct inotify_event*)position;
+            if ((event->mask & IN_CLOSE_WRITE) && event->len > 0 && strcmp(event->name, "MouseJiggler.ini") == 0) {
+                writes++;
+            }
+            position += sizeof(struct inotify_event) + event->len;
+        }
+    }
+    return writes;
+}
+
+// The INI text with ActiveProfile set to 'name'
+static void ExpectedIni(const char* name, char* text, size_t textSize) {
+    const char* line = strstr(g_Ini, "ActiveProfile=Office\n");
+    snprintf(text, textSize, "%.*sActiveProfile=%s\n%s", (int)(line - g_Ini), g_Ini, name,
+             line + strlen("ActiveProfile=Office\n"));
+}
+
+static int CompareLatency(const void* a, const void* b) {
+    int64_t x = *(const int64_t*)a;
+    int64_t y = *(const int64_t*)b;
+    return (x > y) - (x < y);
+}
+
+// The user's side, on its own thread
+static void Drive() {
+    struct sockaddr_un address = {};
+    address.sun_family = AF_UNIX;
+    memcpy(address.sun_path, g_Jiggler.socketPath, strlen(g_Jiggler.socketPath));
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    int watchFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    if (fd < 0 || connect(fd, (struct sockaddr*)&address, sizeof(address)) != 0 ||
+        watchFd < 0 || inotify_add_watch(watchFd, g_Directory, IN_CLOSE_WRITE) < 0) {
+        CHECK(!"control socket or watch");
+        kill(getpid(), SIGTERM);
+        return;
+    }
+
+    char reply[DAEMON_REPLY_LENGTH];
+    char text[1024];
+    char expected[1024];
+    Command(fd, "status", reply, sizeof(reply));
+    CHECK(strstr(reply, " profile=Office ") && StatusValue(reply, "period") == 240);
+
+    // Switching to the active profile writes nothing
+    Command(fd, "profile Office", reply, sizeof(reply));
+    CHECK(strcmp(reply, "ok\n") == 0);
+    CHECK(IniWrites(watchFd) == 0);
+
+    // Each switch writes the file once and changes only ActiveProfile
+    static const char* const cycle[] = { "Presenting", "", "Office" };
+    static const int periods[] = { 30, 60, 240 };
+    for (int i = 0; i < TEST_SWITCHES; i++) {
+        const char* name = cycle[i % 3];
+        char command[DAEMON_COMMAND_LENGTH];
+        snprintf(command, sizeof(command), "profile %s", name);
+
+        int64_t sent = (int64_t)(DaemonClockNs(CLOCK_MONOTONIC) / 1000);
+        Command(fd, command, reply, sizeof(reply));
+        g_LatencyUs[i] = (int64_t)(DaemonClockNs(CLOCK_MONOTONIC) / 1000) - sent;
+        CHECK(strcmp(reply, "ok\n") == 0);
+
+        int writes = IniWrites(watchFd);
+        CHECK(writes == 1);
+        if (writes != 1) printf("ProfileSwitchTest: switch %d to '%s' wrote the file %d times\n", i, name, writes);
+        if (i < 3) {
+            ReadFile("MouseJiggler.ini", text, sizeof(text));
+            ExpectedIni(name, expected, sizeof(expected));
+            CHECK(strcmp(text, expected) == 0);
+            Command(fd, "status", reply, sizeof(reply));
+            CHECK(StatusValue(reply, "period") == (uint64_t)periods[i]);
+            CHECK(strstr(reply, i == 1 ? " profile=- " : i == 0 ? " profile=Presenting " : " profile=Office "));
+        }
+    }
+
+    // Back where it started, byte for byte, and none of it reloaded the settings
+    ReadFile("MouseJiggler.ini", text, sizeof(text));
+    CHECK(strcmp(text, g_Ini) == 0);
+    usleep(200 * 1000);
+    Command(fd, "status", reply, sizeof(reply));
+    CHECK(StatusValue(reply, "reloads") == 0);
+    CHECK(StatusValue(reply, "settings") > 0);
+    CHECK(IniWrites(watchFd) == 0);
+
+    // Someone else's edit still reloads, once
+    WriteFile("MouseJiggler.ini", "[Settings]\nJigglePeriod=45\nActiveProfile=\n[Profile:Office]\nJigglePeriod=240\n");
+    usleep(200 * 1000);
+    Command(fd, "status", reply, sizeof(reply));
+    CHECK(StatusValue(reply, "reloads") == 1);
+    CHECK(strstr(reply, " profile=- ") && StatusValue(reply, "period") == 45);
+
+    Command(fd, "quit", reply, sizeof(reply));
+    close(watchFd);
+    close(fd);
+}
+
+int main() {
+    if (!mkdtemp(g_Directory)) {
+        printf("ProfileSwitchTest: no temporary directory\n");
+        return 1;
+    }
+    TestSetIniString();
+
+    snprintf(g_Jiggler.iniPath, sizeof(g_Jiggler.iniPath), "%s/MouseJiggler.ini", g_Directory);
+    snprintf(g_Jiggler.socketPath, sizeof(g_Jiggler.socketPath), "%s/control", g_Directory);
+    WriteFile("MouseJiggler.ini", g_Ini);
+    g_Jiggler.sink = { MJ_INPUT_SINK_ABI_VERSION, sizeof(MJInputSink), "Accepting", nullptr, AcceptMoves, nullptr };
+
+    CHECK(g_Jiggler.Open());
+    std::thread driver(Drive);
+
+    unsigned long heap = g_HeapAllocations;
+    int result = g_Jiggler.Run();
+    CHECK(g_HeapAllocations == heap);
+    driver.join();
+    CHECK(result == 0);
+    g_Jiggler.Close();
+
+    char path[PATH_MAX];
+    const char* names[] = { "MouseJiggler.ini", "control" };
+    for (const char* name : names) {
+        PathOf(name, path, sizeof(path));
+        unlink(path);
+    }
+    rmdir(g_Directory);
+
+    qsort(g_LatencyUs, TEST_SWITCHES, sizeof(int64_t), CompareLatency);
+    int64_t p50 = g_LatencyUs[TEST_SWITCHES * 50 / 100];
+    int64_t p99 = g_LatencyUs[TEST_SWITCHES * 99 / 100];
+    int64_t max = g_LatencyUs[TEST_SWITCHES - 1];
+    CHECK(p50 < 20000 && max < 1000000);
+    printf("ProfileSwitchTest: %d switches, one write each: p50 %lld us, p99 %lld us, max %lld us\n",
+           TEST_SWITCHES, (long long)p50, (long long)p99, (long long)max);
+    return CheckSummary("ProfileSwitchTest");
+}
@@ -0,0 +1,88 @@
+// MouseJiggler - Instance registry reader benchmark (Linux)
+//
+// Claims every slot of a private registry on POSIX shared memory (see
+// linux/PosixRegistry.h), keeps one writer thread publishing into all of them,
+// and measures what a monitor pays to read the registry: the lock-free copy of
+// one slot, and a full scan with the liveness check of each owner. See
+// tests/Makefile (make bench).
+
+#define REGISTRY_SHM_NAME "/ArkaneSystems.MouseJiggler.Bench%02d"
+
+#include <atomic>
+#include <chrono>
+#include <stdio.h>
+#include <thread>
+#include "../linux/PosixRegistry.h"
+
+static double NsPer(std::chrono::steady_clock::duration elapsed, uint64_t count) {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)count;
+}
+
+int main() {
+    // One process owns every slot here; each claim takes the next free one
+    InstanceSlot* owned[REGISTRY_MAX_SLOTS] = {};
+    int indexes[REGISTRY_MAX_SLOTS] = {};
+    int slots = 0;
+    while (slots < REGISTRY_MAX_SLOTS && (owned[slots] = OpenInstanceRegistry(&indexes[slots])) != nullptr) {
+        slots++;
+    }
+    if (slots == 0) {
+        printf("RegistryBench: no shared memory\n");
+        return 1;
+    }
+
+    RegistryView view;
+    OpenRegistryView(&view);
+
+    for (int pass = 0; pass < 2; pass++) {
+        bool withWriter = pass == 1;
+        std::atomic<bool> done(false);
+        std::thread writer;
+        if (withWriter) {
+            writer = std::thread([&]() {
+                InstanceStatus status = {};
+                while (!done.load(std::memory_order_relaxed)) {
+                    status.jigglesSent++;
+                    for (int i = 0; i < slots; i++) {
+                        WriteInstanceStatus(owned[i], &status);
+                    }
+                }
+            });
+        }
+
+        const uint64_t reads = 20000000;
+        InstanceOwner owner;
+        InstanceStatus status;
+        uint64_t valid = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < reads; i++) {
+            valid += ReadInstanceSlot(view.slots[i % slots], &owner, &status) ? 1 : 0;
+        }
+        auto copyTime = std::chrono::steady_clock::now() - start;
+
+        const uint64_t scans = 2000;
+        InstanceOwner owners[REGISTRY_MAX_SLOTS];
+        InstanceStatus statuses[REGISTRY_MAX_SLOTS];
+        int found = 0;
+        start = std::chrono::steady_clock::now();
+        for (uint64_t i = 0; i < scans; i++) {
+            found = ReadRegistryView(&view, owners, statuses);
+        }
+        auto scanTime = std::chrono::steady_clock::now() - start;
+
+        done = true;
+        if (writer.joinable()) writer.join();
+
+        const char* label = withWriter ? "with a writer" : "idle";
+        printf("RegistryBench: %.1f ns per slot copy (%s, %.1f%% consistent)\n",
+               NsPer(copyTime, reads), label, 100.0 * (double)valid / (double)reads);
+        printf("RegistryBench: %.1f us per scan of %d slots with liveness checks (%s, %d found)\n",
+               NsPer(scanTime, scans) / 1000.0, slots, label, found);
+    }
+
+    CloseRegistryView(&view);
+    for (int i = 0; i < slots; i++) {
+        ReleaseInstanceRegistry(owned[i], indexes[i]);
+    }
+    return 0;
+}
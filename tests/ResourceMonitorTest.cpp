@@ -0,0 +1,264 @@
+// MouseJiggler - Resource monitor tests
+//
+// Runs the sampling, leak alerts and per-subsystem CPU split of
+// ResourceMonitor.h against a simulated process (a clock and counters the test
+// sets), then the /proc source of linux/ProcResources.h: parsing of status and
+// stat text, a fake /proc directory with known values, and this process itself,
+// which opens descriptors until the alert is raised and burns CPU inside a
+// subsystem scope. See tests/Makefile.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "../ResourceMonitor.h"
+#include "../linux/ProcResources.h"
+#include "Check.h"
+
+// Simulated process: a cycle counter at 3000 cycles per ms of thread CPU time
+#define FAKE_CYCLES_PER_MS  3000
+
+static uint64_t g_Cycles = 0;
+static ResourceSample g_Process = {};
+static bool g_SampleFails = false;
+
+static bool FakeSample(ResourceSample* out) {
+    if (g_SampleFails) return false;
+    *out = g_Process;
+    return true;
+}
+
+static uint64_t FakeThreadClock() { return g_Cycles; }
+static double FakeThreadCpuMs() { return (double)g_Cycles / FAKE_CYCLES_PER_MS; }
+
+static const ResourceHost g_FakeHost = { FakeSample, FakeThreadClock, FakeThreadCpuMs };
+
+static void Run(uint64_t ms) {
+    g_Cycles += ms * FAKE_CYCLES_PER_MS;
+}
+
+static bool Near(double value, double expected) {
+    return value > expected - 0.01 && value < expected + 0.01;
+}
+
+// Time is charged exclusively to the innermost scope, and not at all outside scopes
+static void TestSubsystems() {
+    ResourceMonitor monitor;
+    monitor.host = &g_FakeHost;
+    g_Cycles = 1000000;
+
+    Run(7);     // Outside any subsystem
+    {
+        SubsystemScope timer(monitor, SUBSYSTEM_TIMER);
+        Run(10);
+        {
+            SubsystemScope settings(monitor, SUBSYSTEM_SETTINGS);
+            Run(4);
+            {
+                SubsystemScope tray(monitor, SUBSYSTEM_TRAY);
+                Run(2);
+            }
+            Run(1);
+        }
+        Run(5);
+    }
+    Run(3);
+    {
+        SubsystemScope paint(monitor, SUBSYSTEM_PAINT);
+        Run(6);
+    }
+    CHECK(monitor.currentSubsystem == SUBSYSTEM_NONE);
+
+    double ms[SUBSYSTEM_COUNT];
+    monitor.SubsystemMs(ms);
+    CHECK(Near(ms[SUBSYSTEM_TIMER], 15.0));
+    CHECK(Near(ms[SUBSYSTEM_SETTINGS], 5.0));
+    CHECK(Near(ms[SUBSYSTEM_TRAY], 2.0));
+    CHECK(Near(ms[SUBSYSTEM_PAINT], 6.0));
+
+    // A sample keeps the split of its time
+    g_Process = {};
+    monitor.Sample();
+    {
+        SubsystemScope timer(monitor, SUBSYSTEM_TIMER);
+        Run(100);
+    }
+    CHECK(Near(monitor.subsystemMs[SUBSYSTEM_TIMER], 15.0));
+    monitor.SubsystemMs(ms);
+    CHECK(Near(ms[SUBSYSTEM_TIMER], 115.0));
+}
+
+// The first sample is the baseline; growth past a threshold raises the alert once
+static void TestAlerts() {
+    ResourceMonitor monitor;
+    monitor.host = &g_FakeHost;
+    g_Process = {};
+    g_Process.gdiObjects = 40;
+    g_Process.userObjects = 20;
+    g_Process.handleCount = 100;
+    g_Process.workingSet = 8 << 20;
+
+    CHECK(!monitor.Sample());
+    CHECK(monitor.baselineTaken && monitor.samples == 1 && monitor.baseline.handleCount == 100);
+
+    // Growth up to the thresholds is normal
+    g_Process.gdiObjects += RESOURCE_GDI_ALERT_GROWTH;
+    g_Process.userObjects += RESOURCE_USER_ALERT_GROWTH;
+    g_Process.handleCount += RESOURCE_HANDLE_ALERT_GROWTH;
+    CHECK(!monitor.Sample() && !monitor.alert);
+
+    // One more GDI object raises it, once
+    g_Process.gdiObjects++;
+    CHECK(monitor.Sample() && monitor.alert);
+    CHECK(!monitor.Sample() && monitor.alert);
+
+    // Back down clears it; a USER or kernel handle leak raises it again
+    g_Process.gdiObjects = 40;
+    CHECK(!monitor.Sample() && !monitor.alert);
+    g_Process.userObjects += 1;
+    CHECK(monitor.Sample());
+    g_Process.userObjects = 20;
+    CHECK(!monitor.Sample() && !monitor.alert);
+    g_Process.handleCount = 100 + RESOURCE_HANDLE_ALERT_GROWTH + 1;
+    CHECK(monitor.Sample());
+
+    // A failed sample keeps the previous one
+    uint32_t samples = monitor.samples;
+    g_SampleFails = true;
+    CHECK(!monitor.Sample());
+    g_SampleFails = false;
+    CHECK(monitor.samples == samples && monitor.alert && monitor.latest.handleCount == 601);
+    CHECK(monitor.baseline.handleCount == 100);
+}
+
+static void TestParsing() {
+    const char* status =
+        "Name:\tmousejigglerd\nUmask:\t0022\nState:\tS (sleeping)\nVmPeak:\t   10000 kB\n"
+        "VmRSS:\t    5120 kB\nRssAnon:\t     1024 kB\nRssFile:\t    4096 kB\n";
+    uint64_t bytes = 0;
+    CHECK(ParseProcStatusKb(status, "VmRSS", &bytes) && bytes == 5120ull * 1024);
+    CHECK(ParseProcStatusKb(status, "RssAnon", &bytes) && bytes == 1024ull * 1024);
+    CHECK(!ParseProcStatusKb(status, "VmSwap", &bytes));
+    CHECK(!ParseProcStatusKb(status, "Rss", &bytes));      // Only whole keys
+
+    // A command name with spaces and parentheses; utime 250 and stime 50 ticks at 100 Hz
+    const char* stat = "1234 (my (odd) name) S 1 1234 1234 0 -1 4194560 100 0 0 0 250 50 0 0 20 0 1 0 99 0 0";
+    uint64_t cpuMs = 0;
+    CHECK(ParseProcStatCpuMs(stat, 100, &cpuMs) && cpuMs == 3000);
+    CHECK(!ParseProcStatCpuMs("1234 (truncated) S 1", 100, &cpuMs));
+    CHECK(!ParseProcStatCpuMs("garbage", 100, &cpuMs));
+}
+
+static void WriteTestFile(const char* path, const char* text) {
+    FILE* file = fopen(path, "w");
+    CHECK(file != NULL);
+    if (file) {
+        fputs(text, file);
+        fclose(file);
+    }
+}
+
+// A fake /proc directory gives exactly its values
+static void TestFakeProc() {
+    char directory[] = "/tmp/mj-proc-XXXXXX";
+    CHECK(mkdtemp(directory) != NULL);
+    char path[256];
+    long ticks = sysconf(_SC_CLK_TCK);
+
+    snprintf(path, sizeof(path), "%s/status", directory);
+    WriteTestFile(path, "Name:\tfake\nVmRSS:\t2048 kB\nRssAnon:\t512 kB\n");
+    snprintf(path, sizeof(path), "%s/stat", directory);
+    char stat[256];
+    snprintf(stat, sizeof(stat), "42 (fake) S 1 42 42 0 -1 0 0 0 0 0 %ld %ld 0 0 20 0 1 0 5 0 0\n", ticks * 2, ticks);
+    WriteTestFile(path, stat);
+    snprintf(path, sizeof(path), "%s/fd", directory);
+    CHECK(mkdir(path, 0700) == 0);
+    for (int i = 0; i < 7; i++) {
+        snprintf(path, sizeof(path), "%s/fd/%d", directory, i);
+        WriteTestFile(path, "");
+    }
+
+    ResourceSample sample = {};
+    CHECK(SampleProcResources(directory, &sample));
+    CHECK(sample.workingSet == 2048ull * 1024 && sample.privateBytes == 512ull * 1024);
+    CHECK(sample.cpuTime == 3000 && sample.handleCount == 7);
+    CHECK(sample.gdiObjects == 0 && sample.userObjects == 0);
+
+    // Without stat the sample fails and changes nothing
+    snprintf(path, sizeof(path), "%s/stat", directory);
+    unlink(path);
+    ResourceSample untouched = {};
+    untouched.handleCount = 99;
+    CHECK(!SampleProcResources(directory, &untouched) && untouched.handleCount == 99);
+
+    for (int i = 0; i < 7; i++) {
+        snprintf(path, sizeof(path), "%s/fd/%d", directory, i);
+        unlink(path);
+    }
+    snprintf(path, sizeof(path), "%s/fd", directory);
+    rmdir(path);
+    snprintf(path, sizeof(path), "%s/status", directory);
+    unlink(path);
+    rmdir(directory);
+}
+
+// This process through /proc/self: a descriptor leak raises the alert, and CPU
+// burnt in a scope shows up in its subsystem
+static void TestSelf() {
+    ResourceMonitor monitor;
+    monitor.host = &g_ProcResourceHost;
+    CHECK(!monitor.Sample());
+    CHECK(monitor.latest.workingSet > 0 && monitor.latest.handleCount >= 3);
+
+    int before = (int)monitor.latest.handleCount;
+    static int leaked[RESOURCE_HANDLE_ALERT_GROWTH + 10];
+    int opened = 0;
+    for (int i = 0; i < RESOURCE_HANDLE_ALERT_GROWTH + 10; i++) {
+        leaked[i] = open("/dev/null", O_RDONLY | O_CLOEXEC);
+        if (leaked[i] < 0) break;
+        opened++;
+        if (i == 100) {
+            CHECK(!monitor.Sample() && !monitor.alert);
+            CHECK((int)monitor.latest.handleCount == before + 101);
+        }
+    }
+    bool raised = monitor.Sample();
+    if (opened == RESOURCE_HANDLE_ALERT_GROWTH + 10) {
+        CHECK(raised && monitor.alert);
+    } else {
+        printf("ResourceMonitorTest: only %d descriptors could be opened, alert not checked\n", opened);
+    }
+    for (int i = 0; i < opened; i++) {
+        close(leaked[i]);
+    }
+    CHECK(!monitor.Sample() && !monitor.alert && (int)monitor.latest.handleCount == before);
+
+    // 50 ms of CPU in the timer subsystem
+    uint64_t until = GetThreadCpuNs() + 50000000ull;
+    {
+        SubsystemScope timer(monitor, SUBSYSTEM_TIMER);
+        volatile uint64_t spin = 0;
+        while (GetThreadCpuNs() < until) spin = spin + 1;
+    }
+    monitor.Sample();
+    CHECK(monitor.subsystemMs[SUBSYSTEM_TIMER] >= 50.0 && monitor.subsystemMs[SUBSYSTEM_TIMER] < 60.0);
+    CHECK(monitor.subsystemMs[SUBSYSTEM_SETTINGS] == 0.0 && monitor.subsystemMs[SUBSYSTEM_TRAY] == 0.0);
+    CHECK(monitor.latest.cpuTime >= 30);     // stat counts in clock ticks, sampled by the kernel
+
+    printf("ResourceMonitorTest: /proc/self: %lu descriptors, %llu KB resident, %llu KB anonymous, "
+           "%llu ms CPU, %.1f ms in the timer subsystem\n",
+           (unsigned long)monitor.latest.handleCount, (unsigned long long)(monitor.latest.workingSet / 1024),
+           (unsigned long long)(monitor.latest.privateBytes / 1024), (unsigned long long)monitor.latest.cpuTime,
+           monitor.subsystemMs[SUBSYSTEM_TIMER]);
+}
+
+int main() {
+    TestSubsystems();
+    TestAlerts();
+    TestParsing();
+    TestFakeProc();
+    TestSelf();
+    return CheckSummary("ResourceMonitorTest");
+}
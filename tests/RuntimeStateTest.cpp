@@ -0,0 +1,125 @@
+// MouseJiggler - Runtime state tests
+//
+// Tears writes of the two-record state file at every byte and checks that
+// recovery always finds the last intact record. No Win32 is needed; see
+// tests/Makefile.
+
+#include <stdio.h>
+#include <string.h>
+#include "../RuntimeState.h"
+#include "Check.h"
+
+static RuntimeRecord MakeRecord(uint64_t sequence) {
+    RuntimeRecord record;
+    memset(&record, 0, sizeof(record));
+    record.sequence = sequence;
+    record.isJiggling = 1;
+    record.patternStep = (uint32_t)(sequence % 4);
+    record.nextJiggleDue = 13300000000000ULL + sequence * 60000;
+    record.jigglesSent = sequence * 3;
+    record.jiggleFailures = sequence / 7;
+    record.savedAt = 13300000000000ULL + sequence * 60000 - 1;
+    return record;
+}
+
+// Store records 1..count the way SaveRuntimeState does
+static void Fill(RuntimeStateFile* file, uint64_t count) {
+    memset(file, 0, sizeof(*file));
+    for (uint64_t sequence = 1; sequence <= count; sequence++) {
+        RuntimeRecord record = MakeRecord(sequence);
+        StoreRuntimeRecord(file, &record);
+    }
+}
+
+static void TestEmptyFile() {
+    RuntimeStateFile file;
+    memset(&file, 0, sizeof(file));
+
+    int torn = -1;
+    CHECK(SelectRuntimeRecord(&file, &torn) == NULL);
+    CHECK(torn == 0);
+}
+
+static void TestNewestWins() {
+    RuntimeStateFile file;
+    int torn = 0;
+
+    Fill(&file, 1);
+    const RuntimeRecord* newest = SelectRuntimeRecord(&file, &torn);
+    CHECK(newest && newest->sequence == 1 && torn == 0);
+
+    for (uint64_t count = 2; count < 10; count++) {
+        Fill(&file, count);
+        newest = SelectRuntimeRecord(&file, &torn);
+        CHECK(newest && newest->sequence == count && torn == 0);
+        CHECK(newest && memcmp(newest, &file.records[count % 2], sizeof(RuntimeRecord)) == 0);
+    }
+}
+
+// A crash while record 'sequence' was being copied leaves only its first 'length'
+// bytes in place; the rest of the slot still holds record sequence - 2
+static void TestTornWrites() {
+    for (uint64_t sequence = 1; sequence <= 4; sequence++) {
+        for (size_t length = 0; length < sizeof(RuntimeRecord); length++) {
+            RuntimeStateFile file;
+            Fill(&file, sequence - 1);
+
+            RuntimeRecord record = MakeRecord(sequence);
+            record.magic = STATE_MAGIC;
+            record.version = STATE_VERSION;
+            record.checksum = RuntimeRecordChecksum(&record);
+            memcpy(&file.records[sequence % 2], &record, length);
+
+            int torn = 0;
+            const RuntimeRecord* recovered = SelectRuntimeRecord(&file, &torn);
+            if (length >= offsetof(RuntimeRecord, checksum) + sizeof(record.checksum)) {
+                // Only the reserved field is missing: the new record is complete
+                CHECK(recovered && recovered->sequence == sequence);
+            } else if (sequence == 1) {
+                CHECK(recovered == NULL);
+            } else {
+                // Never a mix of the two writes: the previous record is used
+                CHECK(recovered && recovered->sequence == sequence - 1);
+                CHECK(recovered && memcmp(recovered, &file.records[(sequence - 1) % 2], sizeof(RuntimeRecord)) == 0);
+            }
+        }
+    }
+}
+
+// Single-bit damage anywhere in the checksummed bytes is detected
+static void TestBitFlips() {
+    for (size_t byte = 0; byte < offsetof(RuntimeRecord, reserved); byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            RuntimeStateFile file;
+            Fill(&file, 6);
+            ((uint8_t*)&file.records[0])[byte] ^= (uint8_t)(1 << bit);
+
+            int torn = 0;
+            const RuntimeRecord* recovered = SelectRuntimeRecord(&file, &torn);
+            CHECK(recovered && recovered->sequence == 5);
+        }
+    }
+}
+
+// Records of another version are ignored rather than reported as torn
+static void TestOtherVersion() {
+    RuntimeStateFile file;
+    Fill(&file, 2);
+    file.records[0].version = STATE_VERSION + 1;
+    file.records[0].checksum = RuntimeRecordChecksum(&file.records[0]);
+
+    int torn = 0;
+    const RuntimeRecord* recovered = SelectRuntimeRecord(&file, &torn);
+    CHECK(recovered && recovered->sequence == 1);
+    CHECK(torn == 0);
+}
+
+int main() {
+    TestEmptyFile();
+    TestNewestWins();
+    TestTornWrites();
+    TestBitFlips();
+    TestOtherVersion();
+
+    return CheckSummary("RuntimeStateTest");
+}
@@ -0,0 +1,79 @@
+// MouseJiggler - Scheduler benchmark
+//
+// Measures what the coroutine scheduler adds to each jiggle: one Run() that
+// polls the waiting tasks and resumes the jiggle task, which records the
+// deadline and waits for the next one. The jiggle itself is a counter, so the
+// figure is pure scheduling overhead. See tests/Makefile (make bench).
+
+#include <chrono>
+#include <stdio.h>
+#include "../Scheduler.h"
+#include "../Cadence.h"
+#include "../TimeWindow.h"
+
+static uint64_t g_Now = 0;
+static uint64_t g_Jiggles = 0;
+static const TimeWindow g_Window = { 0, 0, 0 };
+
+static uint64_t VirtualNow() {
+    return g_Now;
+}
+
+static uint64_t VirtualIdleTime() {
+    return 0;
+}
+
+static bool VirtualWindowOpen(uint64_t now, uint64_t* nextChange) {
+    *nextChange = now + MsUntilWindowCheck(g_Window, (uint32_t)(now % WINDOW_DAY_MS));
+    return false;
+}
+
+// The shape of the application's jiggle loop
+static SchedulerTask JiggleLoop(uint64_t period) {
+    uint64_t due = NextAlignedDeadline(g_Now, period, 0);
+    for (;;) {
+        co_await sleep_until(due);
+        DeadlineOutcome outcome = ResolveDeadline(due, g_Now, period, MISSED_JIGGLE_ONCE);
+        g_Jiggles += outcome.jiggles;
+        due = outcome.nextDue;
+    }
+}
+
+// A second task waiting on the time window, as when the time restriction is on
+static SchedulerTask WindowLoop() {
+    for (;;) {
+        co_await next_window_open();
+        co_await next_window_close();
+    }
+}
+
+static double Measure(bool withWindow, uint64_t jiggles) {
+    Scheduler scheduler;
+    scheduler.host.now = VirtualNow;
+    scheduler.host.idleTime = VirtualIdleTime;
+    scheduler.host.windowOpen = VirtualWindowOpen;
+    g_Now = 0;
+    g_Jiggles = 0;
+
+    scheduler.Spawn(JiggleLoop(1000));
+    if (withWindow) scheduler.Spawn(WindowLoop());
+
+    auto start = std::chrono::steady_clock::now();
+    uint64_t wake = scheduler.NextWake();
+    while (g_Jiggles < jiggles) {
+        g_Now = wake;
+        wake = scheduler.Run();
+    }
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)g_Jiggles;
+}
+
+int main() {
+    const uint64_t jiggles = 10000000;
+
+    Measure(false, jiggles / 10);   // Warm up
+    printf("SchedulerBench: %.1f ns per jiggle (jiggle task only)\n", Measure(false, jiggles));
+    printf("SchedulerBench: %.1f ns per jiggle (with time window task)\n", Measure(true, jiggles));
+    return 0;
+}
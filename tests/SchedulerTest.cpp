@@ -0,0 +1,255 @@
+// MouseJiggler - Scheduler tests
+//
+// Runs coroutine tasks on a virtual clock, idle timer and time window, and checks
+// that frames come from the pool rather than the heap. No Win32 is needed; see
+// tests/Makefile.
+
+#include <stdio.h>
+#include "../Scheduler.h"
+#include "../TimeWindow.h"
+#include "Check.h"
+
+// Virtual environment
+static uint64_t g_Now = 0;
+static uint64_t g_LastInput = 0;
+static TimeWindow g_Window = { 9 * 60, 17 * 60, 0x7F };
+
+static uint64_t VirtualNow() {
+    return g_Now;
+}
+
+static uint64_t VirtualIdleTime() {
+    return g_Now - g_LastInput;
+}
+
+static bool VirtualWindowOpen(uint64_t now, uint64_t* nextChange) {
+    uint32_t msOfDay = (uint32_t)(now % WINDOW_DAY_MS);
+    *nextChange = now + MsUntilWindowCheck(g_Window, msOfDay);
+    return IsInTimeWindow(g_Window, (int)((now / WINDOW_DAY_MS + 1) % 7), (int)(msOfDay / 60000));
+}
+
+static void ResetEnvironment(Scheduler* scheduler) {
+    g_Now = 0;
+    g_LastInput = 0;
+    scheduler->host.now = VirtualNow;
+    scheduler->host.idleTime = VirtualIdleTime;
+    scheduler->host.windowOpen = VirtualWindowOpen;
+}
+
+// Advance the virtual clock to each wake time in turn until 'end'
+static void RunUntil(Scheduler* scheduler, uint64_t end) {
+    uint64_t wake = scheduler->Run();
+    while (wake != SCHEDULER_NEVER && wake <= end) {
+        if (wake > g_Now) g_Now = wake;
+        wake = scheduler->Run();
+    }
+    g_Now = end;
+    scheduler->Run();
+}
+
+static int g_Ticks = 0;
+static uint64_t g_TickTimes[16];
+
+static SchedulerTask Ticker(uint64_t first, uint64_t period, int count) {
+    for (int i = 0; i < count; i++) {
+        co_await sleep_until(first + i * period);
+        g_TickTimes[g_Ticks++] = g_Now;
+    }
+}
+
+static void TestSleepUntil() {
+    Scheduler scheduler;
+    ResetEnvironment(&scheduler);
+    g_Ticks = 0;
+
+    uint32_t id = scheduler.Spawn(Ticker(1000, 500, 4));
+    CHECK(id != 0);
+    CHECK(g_Ticks == 0);
+    CHECK(scheduler.NextWake() == 1000);
+
+    RunUntil(&scheduler, 10000);
+    CHECK(g_Ticks == 4);
+    CHECK(g_TickTimes[0] == 1000 && g_TickTimes[3] == 2500);
+
+    // The finished task released its slot and frame
+    CHECK(scheduler.NextWake() == SCHEDULER_NEVER);
+    CHECK(!g_SchedulerFrames.used[0]);
+
+    // A deadline in the past does not suspend at all
+    g_Ticks = 0;
+    scheduler.Spawn(Ticker(0, 1, 3));
+    CHECK(g_Ticks == 3);
+}
+
+static int g_IdleWakes = 0;
+
+static SchedulerTask IdleWatcher(uint64_t idleMs) {
+    for (;;) {
+        co_await idle_for(idleMs);
+        g_IdleWakes++;
+        g_LastInput = g_Now;    // The jiggle counts as input
+    }
+}
+
+static void TestIdleFor() {
+    Scheduler scheduler;
+    ResetEnvironment(&scheduler);
+    g_IdleWakes = 0;
+
+    uint32_t id = scheduler.Spawn(IdleWatcher(60000));
+    CHECK(scheduler.NextWake() == 60000);
+
+    // User input at 30 s pushes the wake-up out to 90 s
+    g_Now = 30000;
+    g_LastInput = 30000;
+    RunUntil(&scheduler, 89999);
+    CHECK(g_IdleWakes == 0);
+    RunUntil(&scheduler, 90000);
+    CHECK(g_IdleWakes == 1);
+    RunUntil(&scheduler, 90000 + 10 * 60000);
+    CHECK(g_IdleWakes == 11);
+
+    scheduler.Cancel(id);
+    CHECK(scheduler.NextWake() == SCHEDULER_NEVER);
+}
+
+static int g_Opened = 0;
+static int g_Closed = 0;
+
+static SchedulerTask WindowWatcher() {
+    for (;;) {
+        co_await next_window_open();
+        g_Opened++;
+        co_await next_window_close();
+        g_Closed++;
+    }
+}
+
+static void TestWindow() {
+    Scheduler scheduler;
+    ResetEnvironment(&scheduler);
+    g_Opened = g_Closed = 0;
+
+    // Day 0 (1601-01-01) is a Monday; the window is 09:00 - 17:00 every day
+    scheduler.Spawn(WindowWatcher());
+    CHECK(g_Opened == 0);
+    RunUntil(&scheduler, 9 * 3600 * 1000 - 1);
+    CHECK(g_Opened == 0);
+    RunUntil(&scheduler, 9 * 3600 * 1000);
+    CHECK(g_Opened == 1 && g_Closed == 0);
+    RunUntil(&scheduler, 17 * 3600 * 1000);
+    CHECK(g_Opened == 1 && g_Closed == 1);
+
+    // A week with the weekend off
+    g_Window.daysMask = 0x3E;
+    RunUntil(&scheduler, 7 * (uint64_t)WINDOW_DAY_MS);
+    CHECK(g_Opened == 5 && g_Closed == 5);
+
+    // Overnight window: open at once (it is midnight), then at 22:00 on each of the 7 days
+    g_Window.startMinutes = 22 * 60;
+    g_Window.endMinutes = 6 * 60;
+    g_Window.daysMask = 0x7F;
+    int opened = g_Opened;
+    RunUntil(&scheduler, 14 * (uint64_t)WINDOW_DAY_MS);
+    CHECK(g_Opened - opened == 8);
+
+    g_Window.startMinutes = 9 * 60;
+    g_Window.endMinutes = 17 * 60;
+}
+
+static uint32_t g_Victim = 0;
+static Scheduler* g_CancelScheduler = nullptr;
+
+static SchedulerTask Forever() {
+    for (;;) {
+        co_await sleep_until(SCHEDULER_NEVER - 1);
+    }
+}
+
+static SchedulerTask CancelSelf() {
+    co_await sleep_until(10);
+    g_CancelScheduler->Cancel(g_Victim);   // g_Victim is this task
+    co_await sleep_until(0);
+    g_Ticks = 100;  // Never reached: cancelled at the wait above
+}
+
+static void TestCancel() {
+    Scheduler scheduler;
+    ResetEnvironment(&scheduler);
+
+    uint32_t first = scheduler.Spawn(Forever());
+    CHECK(first != 0);
+    scheduler.Cancel(first);
+    CHECK(!g_SchedulerFrames.used[0]);
+
+    // Stale ids do not touch the task that reused the slot
+    uint32_t second = scheduler.Spawn(Forever());
+    scheduler.Cancel(first);
+    CHECK(scheduler.NextWake() == SCHEDULER_NEVER - 1);
+    scheduler.Cancel(second);
+
+    // A task that cancels itself is destroyed at its next wait
+    g_Ticks = 0;
+    g_CancelScheduler = &scheduler;
+    g_Victim = scheduler.Spawn(CancelSelf());
+    RunUntil(&scheduler, 100);
+    CHECK(g_Ticks == 0);
+    CHECK(scheduler.NextWake() == SCHEDULER_NEVER);
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        CHECK(!g_SchedulerFrames.used[i]);
+    }
+}
+
+static void TestPool() {
+    Scheduler scheduler;
+    ResetEnvironment(&scheduler);
+
+    uint32_t ids[SCHEDULER_MAX_TASKS];
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        ids[i] = scheduler.Spawn(Forever());
+        CHECK(ids[i] != 0);
+    }
+
+    // Pool exhausted: the task is refused, not allocated from the heap
+    uint32_t refused = g_SchedulerFrames.refused;
+    unsigned long heap = g_HeapAllocations;
+    CHECK(scheduler.Spawn(Forever()) == 0);
+    CHECK(g_SchedulerFrames.refused == refused + 1);
+    CHECK(g_HeapAllocations == heap);
+
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        scheduler.Cancel(ids[i]);
+    }
+}
+
+// Steady state: spawning, waiting, resuming and cancelling never touch the heap
+static void TestNoHeap() {
+    Scheduler scheduler;
+    ResetEnvironment(&scheduler);
+    g_Ticks = 0;
+    g_IdleWakes = 0;
+
+    unsigned long heap = g_HeapAllocations;
+    for (int round = 0; round < 100; round++) {
+        uint32_t idle = scheduler.Spawn(IdleWatcher(60000));
+        uint32_t window = scheduler.Spawn(WindowWatcher());
+        g_Ticks = 0;
+        scheduler.Spawn(Ticker(g_Now + 1, 1000, 16));
+        RunUntil(&scheduler, g_Now + 3600 * 1000);
+        scheduler.Cancel(idle);
+        scheduler.Cancel(window);
+    }
+    CHECK(g_HeapAllocations == heap);
+    CHECK(g_IdleWakes > 0);
+}
+
+int main() {
+    TestSleepUntil();
+    TestIdleFor();
+    TestWindow();
+    TestCancel();
+    TestPool();
+    TestNoHeap();
+
+    return CheckSummary("SchedulerTest");
+}
@@ -0,0 +1,196 @@
+// MouseJiggler - Simulated day
+//
+// Runs a virtual day of jiggling through the same jiggle tasks, scheduler, cadence,
+// time window and runtime state code as Main.cpp: the window opens and closes, the machine
+// sleeps through deadlines, and the period changes mid-afternoon. An allocation
+// tracker fails the test if anything touches the heap once startup is done. No
+// Win32 is needed; see tests/Makefile.
+
+#include <stdio.h>
+#include "../Cadence.h"
+#include "../JiggleTasks.h"
+#include "../RuntimeState.h"
+#include "../Scheduler.h"
+#include "../TimeWindow.h"
+#include "Check.h"
+
+#define MINUTE_MS               (60ull * 1000)
+#define HOUR_MS                 (60 * MINUTE_MS)
+
+// The day starts on a Monday at midnight, local time = virtual clock
+static const uint64_t g_DayStart = 7 * WINDOW_DAY_MS;
+
+// Settings, as in Main.cpp
+static uint64_t g_PeriodMs = MINUTE_MS;
+static const uint64_t g_PhaseMs = 0;
+static const int g_Policy = MISSED_JIGGLE_BURST;
+static const TimeWindow g_Window = { 9 * 60, 17 * 60 + 30, 0x3E };   // 09:00 - 17:30, Mon-Fri
+
+static Scheduler g_Scheduler;
+static JiggleTasks g_Jiggle;
+
+static RuntimeStateFile g_StateFile;
+static uint64_t g_StateSequence = 0;
+
+// What the simulated input sink saw
+static uint64_t g_Now = 0;
+static uint64_t g_Jiggles = 0;
+static uint64_t g_Batches = 0;
+static uint64_t g_LargestBatch = 0;
+static uint64_t g_OutsideWindow = 0;
+static uint64_t g_OffGrid = 0;
+static uint64_t g_Wakeups = 0;
+static int g_SpawnFailures = 0;
+
+static uint64_t VirtualNow() {
+    return g_Now;
+}
+
+static uint64_t VirtualIdleTime() {
+    return 0;
+}
+
+static bool VirtualWindowOpen(uint64_t now, uint64_t* nextChange) {
+    uint32_t msOfDay = (uint32_t)(now % WINDOW_DAY_MS);
+    *nextChange = now + MsUntilWindowCheck(g_Window, msOfDay);
+    return IsInTimeWindow(g_Window, (int)((now / WINDOW_DAY_MS + 1) % 7), (int)(msOfDay / 60000));
+}
+
+// Jiggle host: the settings above, no adaptive mode
+static uint64_t GetPeriodMs() { return g_PeriodMs; }
+static uint64_t GetPhaseMs() { return g_PhaseMs; }
+static int GetPolicy() { return g_Policy; }
+static bool IsAdaptive() { return false; }
+static uint64_t GetIdleWaitMs() { return 0; }
+static void CountUnneeded(uint64_t) {}
+static void Verify() {}
+static void Started() {}
+static void Stopped() {}
+
+static void SpawnFailed(int) {
+    g_SpawnFailures++;
+}
+
+// Jiggle host: the simulated input sink
+static uint64_t SubmitBatch(uint64_t due, uint32_t count) {
+    uint64_t unused;
+    if (!VirtualWindowOpen(g_Now, &unused)) g_OutsideWindow++;
+    if (!IsOnGrid(due, g_PeriodMs, g_PhaseMs)) g_OffGrid++;
+
+    g_Jiggles += count;
+    g_Batches++;
+    if (count > g_LargestBatch) g_LargestBatch = count;
+    return count;
+}
+
+// Jiggle host: persist the state after each deadline, as Main.cpp does
+static void SaveRuntimeState() {
+    RuntimeRecord record = {};
+    record.sequence = ++g_StateSequence;
+    record.isJiggling = g_Jiggle.isJiggling ? 1 : 0;
+    record.nextJiggleDue = g_Jiggle.nextDue;
+    record.jigglesSent = g_Jiggles;
+    record.savedAt = g_Now;
+    StoreRuntimeRecord(&g_StateFile, &record);
+}
+
+static const JiggleHost g_JiggleHost = {
+    GetPeriodMs, GetPhaseMs, GetPolicy,
+    IsAdaptive, GetIdleWaitMs, CountUnneeded, Verify, 100,
+    SubmitBatch, SaveRuntimeState, Started, Stopped, SpawnFailed
+};
+
+// Holds a pooled frame until cancelled
+static SchedulerTask WaitForever() {
+    co_await sleep_until(SCHEDULER_NEVER);
+}
+
+// Fire the scheduler timer at each wake time until 'end'; a timer cannot fire
+// while the machine is asleep, so 'end' may lie past several deadlines
+static void RunUntil(uint64_t end) {
+    uint64_t wake = g_Scheduler.NextWake();
+    while (wake != SCHEDULER_NEVER && wake <= end) {
+        if (wake > g_Now) g_Now = wake;
+        g_Wakeups++;
+        wake = g_Scheduler.Run();
+    }
+    g_Now = end;
+}
+
+static void SleepUntil(uint64_t end) {
+    g_Now = end;
+    g_Wakeups++;
+    g_Scheduler.Run();     // WM_POWERBROADCAST on resume
+}
+
+int main() {
+    // Startup
+    g_Now = g_DayStart;
+    g_Scheduler.host.now = VirtualNow;
+    g_Scheduler.host.idleTime = VirtualIdleTime;
+    g_Scheduler.host.windowOpen = VirtualWindowOpen;
+    g_Jiggle.scheduler = &g_Scheduler;
+    g_Jiggle.host = &g_JiggleHost;
+    g_Jiggle.RestartTimeWindowTask(true);
+    CHECK(g_Jiggle.timeWindowTask != 0);
+    CHECK(!g_Jiggle.isJiggling);
+
+    unsigned long heap = g_HeapAllocations;
+
+    // Morning: the window opens at 09:00, the first deadline is 09:01
+    RunUntil(g_DayStart + 12 * HOUR_MS + 30000);
+    CHECK(g_Jiggle.isJiggling);
+    CHECK(g_Jiggles == 180);
+
+    // Asleep 12:00:30 - 12:15:30: the 12:01 deadline catches up with one batch of 10
+    SleepUntil(g_DayStart + 12 * HOUR_MS + 15 * MINUTE_MS + 30000);
+    CHECK(g_LargestBatch == MAX_JIGGLE_BURST);
+    CHECK(g_Jiggles == 190);
+    CHECK(g_Jiggle.nextDue == g_DayStart + 12 * HOUR_MS + 16 * MINUTE_MS);
+
+    // Afternoon: 12:16 - 15:00, then the period changes to 30 s
+    RunUntil(g_DayStart + 15 * HOUR_MS);
+    CHECK(g_Jiggles == 355);
+    g_PeriodMs = 30000;
+    g_Jiggle.ScheduleNext();
+
+    // 15:00:30 - 17:29:30 (299 deadlines); the window closes at 17:30 and stays shut overnight
+    RunUntil(g_DayStart + WINDOW_DAY_MS);
+    CHECK(!g_Jiggle.isJiggling);
+    CHECK(g_Jiggles == 654);
+    CHECK(g_Batches == 180 + 1 + 165 + 299);
+
+    unsigned long allocations = g_HeapAllocations - heap;
+
+    CHECK(g_OutsideWindow == 0);
+    CHECK(g_OffGrid == 0);
+    CHECK(allocations == 0);
+    CHECK(g_SpawnFailures == 0);
+    CHECK(g_SchedulerFrames.refused == 0);
+
+    // The runtime state file holds the end of the day
+    int torn = 0;
+    const RuntimeRecord* record = SelectRuntimeRecord(&g_StateFile, &torn);
+    CHECK(record != NULL && torn == 0);
+    CHECK(record && record->jigglesSent == g_Jiggles && record->sequence == g_StateSequence);
+
+    // With the frame pool full, starting fails loudly instead of only looking active
+    uint32_t fillers[SCHEDULER_MAX_TASKS] = {};
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        fillers[i] = g_Scheduler.Spawn(WaitForever());
+    }
+    g_Jiggle.Start();
+    CHECK(!g_Jiggle.isJiggling);
+    CHECK(g_Jiggle.jiggleTask == 0);
+    CHECK(g_SpawnFailures == 1);
+    for (int i = 0; i < SCHEDULER_MAX_TASKS; i++) {
+        g_Scheduler.Cancel(fillers[i]);
+    }
+    g_Jiggle.Start();
+    CHECK(g_Jiggle.isJiggling && g_Jiggle.jiggleTask != 0);
+
+    printf("SimulatedDayTest: %llu jiggles in %llu batches, %llu wakeups, %lu allocations after startup\n",
+           (unsigned long long)g_Jiggles, (unsigned long long)g_Batches, (unsigned long long)g_Wakeups,
+           allocations);
+    return CheckSummary("SimulatedDayTest");
+}
@@ -0,0 +1,67 @@
+// MouseJiggler - Input sink batch benchmark (Linux)
+//
+// Measures what a jiggle costs through the uinput sink (linux/UinputSink.h) when
+// each event is its own submit, against whole batches of MAX_JIGGLE_BURST events
+// (a catch-up burst, one write() per batch). The sink writes to /dev/null, which
+// isolates the submit path and the system call; if /dev/uinput is writable the
+// same runs are repeated against a real virtual pointer, which adds the input
+// layer's cost. See tests/Makefile (make bench).
+
+#include <chrono>
+#include <stdio.h>
+#include "../Cadence.h"
+#include "../linux/UinputSink.h"
+
+static double NsPer(std::chrono::steady_clock::duration elapsed, uint64_t count) {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)count;
+}
+
+// Submit 'total' out-and-back moves 'batch' at a time; returns ns per event
+static double Measure(MJInputSink* sink, uint32_t batch, uint64_t total, uint64_t* delivered) {
+    MJInputEvent events[MAX_JIGGLE_BURST] = {};
+    uint32_t status[MAX_JIGGLE_BURST];
+    for (uint32_t i = 0; i < MAX_JIGGLE_BURST; i++) {
+        events[i].dx = (i % 2) ? -1 : 1;
+    }
+
+    *delivered = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t sent = 0; sent < total; sent += batch) {
+        *delivered += sink->submit(sink->context, events, batch, sent, status);
+    }
+    return NsPer(std::chrono::steady_clock::now() - start, total);
+}
+
+static void Run(const char* label, MJInputSink* sink, uint64_t total) {
+    uint64_t delivered;
+    double single = Measure(sink, 1, total, &delivered);
+    printf("SinkBench: %s: %.0f ns per event, one event per submit (%llu delivered)\n",
+           label, single, (unsigned long long)delivered);
+    double batched = Measure(sink, MAX_JIGGLE_BURST, total, &delivered);
+    printf("SinkBench: %s: %.0f ns per event, %d per submit (%.0f ns per batch, %.1fx cheaper per event, %llu delivered)\n",
+           label, batched, MAX_JIGGLE_BURST, batched * MAX_JIGGLE_BURST, single / batched,
+           (unsigned long long)delivered);
+}
+
+int main() {
+    MJInputSink sink;
+    int fd = open("/dev/null", O_WRONLY | O_CLOEXEC);
+    if (fd < 0) {
+        printf("SinkBench: no /dev/null\n");
+        return 1;
+    }
+    UseUinputSink(&sink, fd);
+    sink.destroy = nullptr;     // Not a uinput device; closed below
+    Run("/dev/null", &sink, 2000000);
+    close(fd);
+
+    fd = OpenUinputPointer();
+    if (fd < 0) {
+        printf("SinkBench: %s not writable, skipping the virtual pointer\n", UINPUT_DEVICE_PATH);
+        return 0;
+    }
+    UseUinputSink(&sink, fd);
+    Run(UINPUT_DEVICE_PATH, &sink, 200000);
+    sink.destroy(sink.context);
+    return 0;
+}
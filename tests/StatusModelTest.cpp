@@ -0,0 +1,309 @@
+// MouseJiggler - Status model tests
+//
+// Drives StatusModel.h through a host that renders the tooltip as Main.cpp does
+// (same text, a shell call only when the text changes) and counts every view
+// update. Checks that each field change bumps the model version once, that every
+// view updates exactly when a field it shows changed and never otherwise, that
+// views absent at the time (no tray icon, no dialog) catch up when they appear,
+// and the update counters Main.cpp reports on exit. No Win32 is needed; see
+// tests/Makefile.
+
+#include <stdio.h>
+#include <string.h>
+#include "../StatusModel.h"
+#include "Check.h"
+
+static StatusTracker g_Status;
+
+// Simulated views
+static bool g_TrayIcon = true;
+static bool g_Dialog = true;
+static char g_Tooltip[128] = "";
+static char g_ScheduleText[128] = "";
+static int g_ScheduleBuilds = 0;
+static int g_ButtonRepaints = 0;
+static int g_LabelUpdates = 0;
+static int g_Publishes = 0;
+
+static bool HasTrayIcon() { return g_TrayIcon; }
+static bool HasDialog() { return g_Dialog; }
+
+static void BuildScheduleText() {
+    const StatusModel& status = g_Status.model;
+    snprintf(g_ScheduleText, sizeof(g_ScheduleText), "%02d:%02d - %02d:%02d (days %02x)",
+             status.startMinutes / 60, status.startMinutes % 60, status.endMinutes / 60, status.endMinutes % 60,
+             (unsigned)status.enabledDaysMask);
+    g_ScheduleBuilds++;
+}
+
+// As SetTrayTooltip in Main.cpp
+static bool SetTooltip() {
+    const StatusModel& status = g_Status.model;
+    char text[128];
+    if (!status.isJiggling) {
+        if (status.enableTimeRestriction) {
+            snprintf(text, sizeof(text), "Not jiggling. %.64s", g_ScheduleText);
+        } else {
+            snprintf(text, sizeof(text), "Not jiggling the mouse.");
+        }
+    } else if (status.enableTimeRestriction) {
+        snprintf(text, sizeof(text), "Jiggling %d s, %s Zen. %.64s", status.jigglePeriod,
+                 status.zenJiggle ? "with" : "without", g_ScheduleText);
+    } else {
+        snprintf(text, sizeof(text), "Jiggling %d s, %s Zen.", status.jigglePeriod,
+                 status.zenJiggle ? "with" : "without");
+    }
+    if (status.resourceAlert && strlen(text) + 16 < sizeof(text)) {
+        strcat(text, " Resource alert!");
+    }
+
+    if (strcmp(text, g_Tooltip) == 0) {
+        return false;
+    }
+    strcpy(g_Tooltip, text);
+    return true;
+}
+
+static void RepaintButton() { g_ButtonRepaints++; }
+static void UpdatePeriodLabel() { g_LabelUpdates++; }
+static void Publish() { g_Publishes++; }
+
+static const StatusHost g_Host = {
+    HasTrayIcon, HasDialog, BuildScheduleText, SetTooltip, RepaintButton, UpdatePeriodLabel, Publish
+};
+
+// Views updated by one notification
+struct Updates {
+    uint64_t tooltipRebuilds;
+    uint64_t shellCalls;
+    int scheduleBuilds;
+    int buttonRepaints;
+    int labelUpdates;
+    int publishes;
+};
+
+static Updates Notify(const StatusValues& values) {
+    StatusStats before = g_Status.stats;
+    int schedule = g_ScheduleBuilds, button = g_ButtonRepaints, label = g_LabelUpdates, publish = g_Publishes;
+    g_Status.Notify(values);
+
+    CHECK(g_Status.stats.updatesRequested == before.updatesRequested + 1);
+    CHECK(g_Status.stats.buttonRepaints - before.buttonRepaints == (uint64_t)(g_ButtonRepaints - button));
+    CHECK(g_Status.stats.labelUpdates - before.labelUpdates == (uint64_t)(g_LabelUpdates - label));
+    CHECK(g_Status.stats.publishes - before.publishes == (uint64_t)(g_Publishes - publish));
+
+    Updates updates;
+    updates.tooltipRebuilds = g_Status.stats.tooltipRebuilds - before.tooltipRebuilds;
+    updates.shellCalls = g_Status.stats.shellCalls - before.shellCalls;
+    updates.scheduleBuilds = g_ScheduleBuilds - schedule;
+    updates.buttonRepaints = g_ButtonRepaints - button;
+    updates.labelUpdates = g_LabelUpdates - label;
+    updates.publishes = g_Publishes - publish;
+    return updates;
+}
+
+static bool Nothing(const Updates& updates) {
+    return updates.tooltipRebuilds == 0 && updates.shellCalls == 0 && updates.scheduleBuilds == 0 &&
+        updates.buttonRepaints == 0 && updates.labelUpdates == 0 && updates.publishes == 0;
+}
+
+static StatusValues Defaults() {
+    StatusValues values = {};
+    values.isJiggling = false;
+    values.zenJiggle = false;
+    values.jigglePeriod = 60;
+    values.enableTimeRestriction = false;
+    values.startMinutes = 9 * 60;
+    values.endMinutes = 17 * 60 + 30;
+    values.enabledDaysMask = 0x3e;      // Monday to Friday
+    values.resourceAlert = false;
+    values.resourceSamples = 0;
+    return values;
+}
+
+static void Reset() {
+    g_Status = StatusTracker();
+    g_Status.host = &g_Host;
+    g_TrayIcon = true;
+    g_Dialog = true;
+    g_Tooltip[0] = '\0';
+    g_ScheduleText[0] = '\0';
+}
+
+// Each changed field bumps the version once; setting the same value does nothing
+static void TestVersions() {
+    StatusModel model = {};
+    StatusValues values = Defaults();
+    model.Refresh(values);
+    CHECK(model.version == 4);      // Period, start, end and days differ from zero
+    CHECK(model.jigglePeriodVersion > 0 && model.isJigglingVersion == 0);
+
+    model.Refresh(values);
+    CHECK(model.version == 4);
+
+    values.isJiggling = true;
+    values.zenJiggle = true;
+    model.Refresh(values);
+    CHECK(model.version == 6);
+    CHECK(model.isJigglingVersion == 5 && model.zenJiggleVersion == 6);
+    CHECK(model.TooltipChangedSince(4) && !model.TooltipChangedSince(6));
+    CHECK(!model.ScheduleChangedSince(4));
+
+    values.enabledDaysMask |= 1;
+    model.Refresh(values);
+    CHECK(model.version == 7 && model.enabledDaysMaskVersion == 7 && model.ScheduleChangedSince(6));
+
+    // A change undone before the next refresh is no change
+    StatusValues undone = values;
+    undone.jigglePeriod = 30;
+    undone.jigglePeriod = values.jigglePeriod;
+    model.Refresh(undone);
+    CHECK(model.version == 7);
+}
+
+// Every view renders on the first notification, then only on changes it shows
+static void TestTransitions() {
+    Reset();
+    StatusValues values = Defaults();
+
+    Updates updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 1 && updates.shellCalls == 1);
+    CHECK(updates.labelUpdates == 1 && updates.publishes == 1);
+    CHECK(updates.buttonRepaints == 0);     // Not jiggling, as the button was drawn
+    CHECK(updates.scheduleBuilds == 0);     // No time restriction, no schedule text
+    CHECK(strcmp(g_Tooltip, "Not jiggling the mouse.") == 0);
+
+    // Nothing changed: every view skips
+    for (int i = 0; i < 100; i++) {
+        CHECK(Nothing(Notify(values)));
+    }
+
+    // Start jiggling: tooltip and button, not the period label
+    values.isJiggling = true;
+    updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 1 && updates.shellCalls == 1);
+    CHECK(updates.buttonRepaints == 1 && updates.labelUpdates == 0 && updates.publishes == 1);
+    CHECK(strcmp(g_Tooltip, "Jiggling 60 s, without Zen.") == 0);
+
+    // New period: tooltip and label, not the button
+    values.jigglePeriod = 30;
+    updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 1 && updates.shellCalls == 1);
+    CHECK(updates.buttonRepaints == 0 && updates.labelUpdates == 1 && updates.publishes == 1);
+    CHECK(strcmp(g_Tooltip, "Jiggling 30 s, without Zen.") == 0);
+
+    // Hours edited while the time restriction is off: the tooltip is rebuilt to
+    // the same text, so the shell is not called
+    values.startMinutes = 8 * 60;
+    updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 1 && updates.shellCalls == 0 && updates.scheduleBuilds == 0);
+    CHECK(updates.buttonRepaints == 0 && updates.labelUpdates == 0 && updates.publishes == 1);
+
+    // Time restriction on: the schedule text is built once, and reused while only
+    // fields outside it change
+    values.enableTimeRestriction = true;
+    updates = Notify(values);
+    CHECK(updates.scheduleBuilds == 1 && updates.shellCalls == 1);
+    CHECK(strcmp(g_Tooltip, "Jiggling 30 s, without Zen. 08:00 - 17:30 (days 3e)") == 0);
+
+    values.zenJiggle = true;
+    updates = Notify(values);
+    CHECK(updates.scheduleBuilds == 0 && updates.tooltipRebuilds == 1 && updates.shellCalls == 1);
+
+    values.resourceAlert = true;
+    updates = Notify(values);
+    CHECK(updates.scheduleBuilds == 0 && updates.shellCalls == 1);
+    CHECK(strstr(g_Tooltip, " Resource alert!") != NULL);
+
+    // A resource sample updates the CPU split the tooltip shows, and nothing else
+    values.resourceSamples++;
+    updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 1 && updates.scheduleBuilds == 0);
+    CHECK(updates.buttonRepaints == 0 && updates.labelUpdates == 0 && updates.publishes == 1);
+
+    values.enabledDaysMask = 0x7f;
+    updates = Notify(values);
+    CHECK(updates.scheduleBuilds == 1 && updates.shellCalls == 1);
+    CHECK(strstr(g_Tooltip, "(days 7f)") != NULL);
+
+    // Several fields at once: one rebuild per view
+    values.isJiggling = false;
+    values.jigglePeriod = 45;
+    values.endMinutes = 18 * 60;
+    updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 1 && updates.shellCalls == 1 && updates.scheduleBuilds == 1);
+    CHECK(updates.buttonRepaints == 1 && updates.labelUpdates == 1 && updates.publishes == 1);
+    CHECK(strcmp(g_Tooltip, "Not jiggling. 08:00 - 18:00 (days 7f) Resource alert!") == 0);
+
+    CHECK(Nothing(Notify(values)));
+}
+
+// Views that do not exist yet are brought up to date when they appear
+static void TestMissingViews() {
+    Reset();
+    StatusValues values = Defaults();
+    g_TrayIcon = false;
+    g_Dialog = false;
+
+    Updates updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 0 && updates.labelUpdates == 0 && updates.publishes == 1);
+
+    values.isJiggling = true;
+    updates = Notify(values);
+    CHECK(updates.tooltipRebuilds == 0 && updates.buttonRepaints == 0 && updates.publishes == 1);
+
+    // The dialog appears: button and label catch up on the next notification
+    g_Dialog = true;
+    updates = Notify(values);
+    CHECK(updates.buttonRepaints == 1 && updates.labelUpdates == 1 && updates.publishes == 0);
+    CHECK(Nothing(Notify(values)));
+
+    // The tray icon appears (or Explorer restarted): a new icon gets its tooltip
+    // even though nothing changed
+    g_TrayIcon = true;
+    uint64_t rebuilds = g_Status.stats.tooltipRebuilds;
+    g_Status.TrayIconCreated(values);
+    CHECK(g_Status.stats.tooltipRebuilds == rebuilds + 1);
+    CHECK(strcmp(g_Tooltip, "Jiggling 60 s, without Zen.") == 0);
+    CHECK(Nothing(Notify(values)));
+
+    g_Tooltip[0] = '\0';
+    g_Status.TrayIconCreated(values);
+    CHECK(strcmp(g_Tooltip, "Jiggling 60 s, without Zen.") == 0);
+}
+
+// A day of settings edits and state flips, as the counters Main.cpp reports on exit
+static void TestCounters() {
+    Reset();
+    StatusValues values = Defaults();
+    unsigned long heap = g_HeapAllocations;
+
+    // Every minute: a time check that changes nothing; every hour: jiggling flips
+    for (int minute = 0; minute < 24 * 60; minute++) {
+        values.isJiggling = (minute / 60) % 2 == 1;
+        Notify(values);
+    }
+
+    const StatusStats& stats = g_Status.stats;
+    CHECK(stats.updatesRequested == 24 * 60);
+    CHECK(stats.tooltipRebuilds == 24);     // The first update, then 23 flips
+    CHECK(stats.shellCalls == 24);
+    CHECK(stats.buttonRepaints == 23);
+    CHECK(stats.labelUpdates == 1);
+    CHECK(stats.publishes == 24);
+    CHECK(g_HeapAllocations == heap);
+
+    printf("StatusModelTest: %llu updates requested, %llu tooltip rebuilds, %llu shell calls, "
+           "%llu button repaints, %llu label updates\n",
+           (unsigned long long)stats.updatesRequested, (unsigned long long)stats.tooltipRebuilds,
+           (unsigned long long)stats.shellCalls, (unsigned long long)stats.buttonRepaints,
+           (unsigned long long)stats.labelUpdates);
+}
+
+int main() {
+    TestVersions();
+    TestTransitions();
+    TestMissingViews();
+    TestCounters();
+    return CheckSummary("StatusModelTest");
+}
@@ -0,0 +1,88 @@
+// MouseJiggler - Tracer benchmark
+//
+// Measures what MJ_TRACE_SCOPE costs per event (a scope records two): with
+// tracing off, on while the writer keeps up (recording a buffer at a time and
+// letting the writer catch up between buffers, outside the timed part), and on
+// with the writer stalled so every event is dropped. The writer goes to
+// /dev/null, or to a pipe nobody reads. See tests/Makefile (make bench).
+
+#include <chrono>
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include "../Trace.h"
+
+static volatile uint64_t g_Work = 0;
+
+static double NsPer(std::chrono::steady_clock::duration elapsed, uint64_t count) {
+    return std::chrono::duration<double, std::nano>(elapsed).count() / (double)count;
+}
+
+// 'scopes' scopes around a counter; returns the time taken
+static std::chrono::steady_clock::duration RecordScopes(uint64_t scopes) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < scopes; i++) {
+        MJ_TRACE_SCOPE("Bench");
+        g_Work = g_Work + 1;
+    }
+    return std::chrono::steady_clock::now() - start;
+}
+
+static std::chrono::steady_clock::duration CountOnly(uint64_t scopes) {
+    auto start = std::chrono::steady_clock::now();
+    for (uint64_t i = 0; i < scopes; i++) {
+        g_Work = g_Work + 1;
+    }
+    return std::chrono::steady_clock::now() - start;
+}
+
+static bool AllBuffersFree() {
+    std::lock_guard<std::mutex> guard(g_Trace.lock);
+    int count = 0;
+    for (TraceBuffer* buffer = g_Trace.free; buffer; buffer = buffer->next) count++;
+    return count == TRACE_BUFFER_COUNT;
+}
+
+int main() {
+    const uint64_t scopes = 10000000;
+    double baseline = NsPer(CountOnly(scopes), scopes);
+    double off = NsPer(RecordScopes(scopes), scopes * 2);
+    printf("TraceBench: off: %.2f ns per event (the loop alone: %.2f ns per iteration)\n", off, baseline);
+
+    // On, a buffer at a time so the writer keeps up
+    FILE* file = fopen("/dev/null", "w");
+    if (!file || !TraceStart(file, (uint32_t)getpid())) {
+        printf("TraceBench: cannot start tracing\n");
+        return 1;
+    }
+    const uint64_t rounds = 500;
+    const uint64_t perRound = TRACE_BUFFER_EVENTS / 2;       // One buffer
+    std::chrono::steady_clock::duration recording = {};
+    for (uint64_t round = 0; round < rounds; round++) {
+        recording += RecordScopes(perRound);
+        while (!AllBuffersFree()) {
+            usleep(100);
+        }
+    }
+    uint64_t dropped = g_Trace.dropped;
+    TraceStop();
+    printf("TraceBench: on: %.2f ns per event recorded (%llu events, %llu dropped)\n",
+           NsPer(recording, rounds * perRound * 2), (unsigned long long)(rounds * perRound * 2),
+           (unsigned long long)dropped);
+
+    // On with the writer stuck: after the buffers fill, every event is dropped
+    signal(SIGPIPE, SIG_IGN);
+    int pipeFds[2];
+    if (pipe(pipeFds) != 0 || !(file = fdopen(pipeFds[1], "w")) || !TraceStart(file, (uint32_t)getpid())) {
+        printf("TraceBench: cannot start tracing\n");
+        return 1;
+    }
+    RecordScopes(TRACE_BUFFER_COUNT * TRACE_BUFFER_EVENTS);    // Use up the buffers
+    auto dropping = RecordScopes(scopes);
+    dropped = g_Trace.dropped;
+    close(pipeFds[0]);      // The writer's pending write fails and it can finish
+    TraceStop();
+    printf("TraceBench: on, writer stalled: %.2f ns per dropped event (%llu dropped)\n",
+           NsPer(dropping, scopes * 2), (unsigned long long)dropped);
+    return 0;
+}
@@ -0,0 +1,186 @@
+// MouseJiggler - Tracer tests
+//
+// Records scopes through Trace.h into real files and pipes and reads the JSON
+// back: every begin has its end, each thread's timestamps never go backwards,
+// nothing is lost while the writer keeps up, and a writer that stalls (a pipe
+// nobody reads) makes the tracer drop and count events instead of allocating.
+// Nothing may touch the heap between TraceStart and TraceStop. See tests/Makefile.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include "../Trace.h"
+#include "Check.h"
+
+struct TraceSummary {
+    uint64_t begins;
+    uint64_t ends;
+    uint64_t dropped;
+    uint32_t threads;               // Distinct tids
+    bool ordered;                   // Timestamps never decrease within a thread
+    bool balanced;                  // No thread ends more scopes than it began
+    bool closed;                    // The file ends with the footer
+};
+
+static std::string ReadAll(FILE* file) {
+    std::string text;
+    char chunk[65536];
+    size_t length;
+    while ((length = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        text.append(chunk, length);
+    }
+    return text;
+}
+
+static TraceSummary Summarize(const std::string& text) {
+    TraceSummary summary = {};
+    summary.ordered = true;
+    summary.balanced = true;
+    unsigned long long lastTs[64] = {};
+    long long depth[64] = {};
+
+    const char* position = text.c_str();
+    while ((position = strstr(position, "{\"name\":")) != NULL) {
+        char phase = 0;
+        unsigned long long ts = 0;
+        unsigned long pid = 0, tid = 0;
+        const char* fields = strstr(position, "\"ph\":\"");
+        if (!fields || sscanf(fields, "\"ph\":\"%c\",\"ts\":%llu,\"pid\":%lu,\"tid\":%lu", &phase, &ts, &pid, &tid) != 4 ||
+            tid == 0 || tid >= 64) {
+            summary.balanced = false;
+            break;
+        }
+        if (tid > summary.threads) summary.threads = (uint32_t)tid;
+        if (ts < lastTs[tid]) summary.ordered = false;
+        lastTs[tid] = ts;
+        if (phase == 'B') {
+            summary.begins++;
+            depth[tid]++;
+        } else {
+            summary.ends++;
+            if (--depth[tid] < 0) summary.balanced = false;
+        }
+        position = fields;
+    }
+
+    const char* footer = strstr(text.c_str(), "\n],\"droppedEvents\":");
+    summary.closed = footer != NULL;
+    summary.dropped = footer ? strtoull(footer + strlen("\n],\"droppedEvents\":"), NULL, 10) : 0;
+    return summary;
+}
+
+static void RecordScopes(int count) {
+    for (int i = 0; i < count; i++) {
+        MJ_TRACE_SCOPE("Outer");
+        MJ_TRACE_SCOPE("Inner");
+    }
+}
+
+// While the writer keeps up (fewer events than the buffers hold) nothing is dropped
+static void TestComplete() {
+    FILE* file = tmpfile();
+    int descriptor = dup(fileno(file));
+    CHECK(TraceStart(file, 1));
+
+    const int scopes = TRACE_BUFFER_EVENTS / 2;     // Four events each: two buffers
+    unsigned long heap = g_HeapAllocations;
+    RecordScopes(scopes);
+    CHECK(g_HeapAllocations == heap);
+    TraceStop();
+
+    FILE* readBack = fdopen(descriptor, "r");
+    rewind(readBack);
+    TraceSummary summary = Summarize(ReadAll(readBack));
+    fclose(readBack);
+
+    CHECK(summary.closed);
+    CHECK(summary.dropped == 0);
+    CHECK(summary.begins == 2ull * scopes && summary.ends == 2ull * scopes);
+    CHECK(summary.ordered && summary.balanced);
+    CHECK(summary.threads >= 1);
+}
+
+// Several threads record at once, each into its own buffers
+static void TestThreads() {
+    FILE* file = tmpfile();
+    int descriptor = dup(fileno(file));
+    CHECK(TraceStart(file, 1));
+
+    const int threads = 3;
+    const int scopes = 500;
+    std::thread workers[threads];
+    for (int i = 0; i < threads; i++) {
+        workers[i] = std::thread([]() {
+            RecordScopes(scopes);
+            TraceHandOff();     // A thread hands its partial buffer over before it ends
+        });
+    }
+    for (int i = 0; i < threads; i++) {
+        workers[i].join();
+    }
+    TraceStop();
+
+    FILE* readBack = fdopen(descriptor, "r");
+    rewind(readBack);
+    TraceSummary summary = Summarize(ReadAll(readBack));
+    fclose(readBack);
+
+    CHECK(summary.closed && summary.dropped == 0);
+    CHECK(summary.begins == 2ull * threads * scopes && summary.ends == summary.begins);
+    CHECK(summary.ordered && summary.balanced);
+    CHECK(g_Trace.threads >= (uint32_t)threads);
+}
+
+// A writer stuck on a full pipe: the buffers run out and events are dropped, not allocated
+static void TestStalledWriter() {
+    int pipeFds[2];
+    CHECK(pipe(pipeFds) == 0);
+    FILE* file = fdopen(pipeFds[1], "w");
+    CHECK(TraceStart(file, 1));
+
+    const int scopes = 20 * TRACE_BUFFER_EVENTS;
+    unsigned long heap = g_HeapAllocations;
+    RecordScopes(scopes);
+    CHECK(g_HeapAllocations == heap);
+    uint64_t dropped = g_Trace.dropped;
+    CHECK(dropped > 0);
+
+    // Drain the pipe so the writer can finish
+    std::string text;
+    std::thread reader([&]() {
+        FILE* readEnd = fdopen(pipeFds[0], "r");
+        text = ReadAll(readEnd);
+        fclose(readEnd);
+    });
+    TraceStop();
+    reader.join();
+
+    TraceSummary summary = Summarize(text);
+    CHECK(summary.closed);
+    CHECK(summary.dropped == g_Trace.dropped);
+    CHECK(summary.begins + summary.ends + summary.dropped == 4ull * scopes);
+    CHECK(summary.ordered);
+    printf("TraceTest: stalled writer: %llu of %llu events written, %llu dropped, no allocations\n",
+           (unsigned long long)(summary.begins + summary.ends), 4ull * scopes,
+           (unsigned long long)summary.dropped);
+}
+
+// Off, a scope records nothing
+static void TestDisabled() {
+    uint64_t threads = g_Trace.threads;
+    CHECK(!g_Trace.enabled);
+    RecordScopes(1000);
+    CHECK(t_TraceBuffer == nullptr && g_Trace.threads == threads);
+}
+
+int main() {
+    TestDisabled();
+    TestComplete();
+    TestThreads();
+    TestStalledWriter();
+    TestDisabled();
+    return CheckSummary("TraceTest");
+}